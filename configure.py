@@ -195,7 +195,28 @@ tests = [
     'tests/distributed_test',
     'tests/rpc',
     'tests/semaphore_test',
+    'tests/abort_source_test',
+    'tests/async_sequence_test',
+    'tests/log_test',
+    'tests/tcp_sack_test',
+    'tests/loopback_test',
+    'tests/tcp_congestion_bench',
+    'tests/tcp_latency_bench',
+    'tests/tcp_sack_bench',
     'tests/packet_test',
+    'tests/gso_test',
+    'tests/gro_test',
+    'tests/ip_checksum_test',
+    'tests/ip_checksum_perf',
+    'tests/flat_hash_map_test',
+    'tests/tcp_connection_table_perf',
+    'tests/crc32c_test',
+    'tests/crc32c_perf',
+    'tests/coroutine_perf',
+    'tests/parallel_for_each_perf',
+    'tests/exception_perf',
+    'tests/format_perf',
+    'tests/scheduling_group_test',
     ]
 
 apps = [
@@ -233,6 +254,10 @@ arg_parser.add_argument('--debuginfo', action = 'store', dest = 'debuginfo', typ
                         help = 'Enable(1)/disable(0)compiler debug information generation')
 add_tristate(arg_parser, name = 'hwloc', dest = 'hwloc', help = 'hwloc support')
 add_tristate(arg_parser, name = 'xen', dest = 'xen', help = 'Xen support')
+add_tristate(arg_parser, name = 'xdp', dest = 'xdp', help = 'AF_XDP network device support')
+add_tristate(arg_parser, name = 'lz4', dest = 'lz4', help = 'lz4 compressing streams')
+arg_parser.add_argument('--enable-coroutines', dest = 'coroutines', action = 'store_true', default = False,
+                        help = 'Build in C++20 mode with coroutine support for future<> (core/coroutine.hh)')
 args = arg_parser.parse_args()
 
 libnet = [
@@ -243,15 +268,17 @@ libnet = [
     'net/ethernet.cc',
     'net/arp.cc',
     'net/native-stack.cc',
-    'net/ip_checksum.cc',
     'net/udp.cc',
     'net/tcp.cc',
     'net/dhcp.cc',
+    'net/loopback.cc',
     ]
 
 core = [
     'core/reactor.cc',
     'core/fstream.cc',
+    'core/crc32c.cc',
+    'core/checksummed-stream.cc',
     'core/posix.cc',
     'core/memory.cc',
     'core/resource.cc',
@@ -260,9 +287,13 @@ core = [
     'core/thread.cc',
     'core/dpdk_rte.cc',
     'util/conversions.cc',
+    'util/log.cc',
     'net/packet.cc',
     'net/posix-stack.cc',
     'net/net.cc',
+    'net/gso.cc',
+    'net/gro.cc',
+    'net/ip_checksum.cc',
     'rpc/rpc.cc',
     ]
 
@@ -312,6 +343,35 @@ if apply_tristate(args.xen, test = have_xen,
             ]
     xen_used=True
 
+def have_xdp():
+    source  = '#include <linux/bpf.h>\n'
+    source += '#include <linux/if_xdp.h>\n'
+    source += 'int x = XDP_USE_NEED_WAKEUP + BPF_LINK_CREATE;\n'
+
+    return try_compile(compiler = args.cxx, source = source)
+
+xdp_used = False
+if apply_tristate(args.xdp, test = have_xdp,
+                  note = 'Note: kernel headers too old for AF_XDP.  No AF_XDP support.',
+                  missing = 'Error: kernel headers with AF_XDP support not installed.'):
+    defines.append("HAVE_XDP")
+    libnet += [ 'net/xdp.cc' ]
+    all_artifacts += [ 'tests/xdp_test' ]
+    xdp_used = True
+
+def have_lz4():
+    return try_compile(compiler = args.cxx, source = '#include <lz4.h>\nint x = LZ4_compressBound(1);\n')
+
+lz4_used = False
+if apply_tristate(args.lz4, test = have_lz4,
+                  note = 'Note: lz4-devel not installed.  No lz4 compressing streams.',
+                  missing = 'Error: required package lz4-devel not installed.'):
+    libs += ' -llz4'
+    defines.append("HAVE_LZ4")
+    core += [ 'core/lz4-stream.cc' ]
+    all_artifacts += [ 'tests/lz4_stream_test', 'tests/lz4_stream_perf' ]
+    lz4_used = True
+
 if xen_used and args.dpdk_target:
     print("Error: only xen or dpdk can be used, not both.")
     sys.exit(1)
@@ -334,11 +394,19 @@ deps = {
     'tests/l3_test': ['tests/l3_test.cc'] + core + libnet,
     'tests/ip_test': ['tests/ip_test.cc'] + core + libnet,
     'tests/tcp_test': ['tests/tcp_test.cc'] + core + libnet,
+    'tests/tcp_sack_test': ['tests/tcp_sack_test.cc'] + core + libnet + boost_test_lib,
+    'tests/loopback_test': ['tests/loopback_test.cc'] + core + libnet + boost_test_lib,
+    'tests/tcp_congestion_bench': ['tests/tcp_congestion_bench.cc'] + core + libnet,
+    'tests/tcp_latency_bench': ['tests/tcp_latency_bench.cc'] + core + libnet,
+    'tests/tcp_sack_bench': ['tests/tcp_sack_bench.cc'] + core + libnet,
     'tests/timertest': ['tests/timertest.cc'] + core,
     'tests/futures_test': ['tests/futures_test.cc'] + core + boost_test_lib,
     'tests/alloc_test': ['tests/alloc_test.cc'] + core + boost_test_lib,
     'tests/foreign_ptr_test': ['tests/foreign_ptr_test.cc'] + core + boost_test_lib,
     'tests/semaphore_test': ['tests/semaphore_test.cc'] + core + boost_test_lib,
+    'tests/abort_source_test': ['tests/abort_source_test.cc'] + core + boost_test_lib,
+    'tests/async_sequence_test': ['tests/async_sequence_test.cc'] + core + boost_test_lib,
+    'tests/log_test': ['tests/log_test.cc'] + core + boost_test_lib,
     'tests/smp_test': ['tests/smp_test.cc'] + core,
     'tests/thread_test': ['tests/thread_test.cc'] + core + boost_test_lib,
     'tests/thread_context_switch': ['tests/thread_context_switch.cc'] + core,
@@ -359,8 +427,28 @@ deps = {
     'tests/distributed_test': ['tests/distributed_test.cc'] + core,
     'tests/rpc': ['tests/rpc.cc'] + core + libnet,
     'tests/packet_test': ['tests/packet_test.cc'] + core + libnet,
+    'tests/gso_test': ['tests/gso_test.cc'] + core + libnet,
+    'tests/gro_test': ['tests/gro_test.cc'] + core + libnet,
+    'tests/ip_checksum_test': ['tests/ip_checksum_test.cc'] + core + libnet,
+    'tests/ip_checksum_perf': ['tests/ip_checksum_perf.cc'] + core + libnet,
+    'tests/flat_hash_map_test': ['tests/flat_hash_map_test.cc'] + core,
+    'tests/tcp_connection_table_perf': ['tests/tcp_connection_table_perf.cc'] + core + libnet,
+    'tests/crc32c_test': ['tests/crc32c_test.cc'] + core + boost_test_lib,
+    'tests/crc32c_perf': ['tests/crc32c_perf.cc', 'core/crc32c.cc'],
+    'tests/coroutine_perf': ['tests/coroutine_perf.cc'] + core,
+    'tests/parallel_for_each_perf': ['tests/parallel_for_each_perf.cc'] + core,
+    'tests/exception_perf': ['tests/exception_perf.cc'] + core,
+    'tests/format_perf': ['tests/format_perf.cc'] + core,
+    'tests/scheduling_group_test': ['tests/scheduling_group_test.cc'] + core + boost_test_lib,
 }
 
+if lz4_used:
+    deps['tests/lz4_stream_test'] = ['tests/lz4_stream_test.cc'] + core + boost_test_lib
+    deps['tests/lz4_stream_perf'] = ['tests/lz4_stream_perf.cc'] + core
+
+if xdp_used:
+    deps['tests/xdp_test'] = ['tests/xdp_test.cc'] + core
+
 warnings = [
     '-Wno-mismatched-tags',  # clang-only
     ]
@@ -455,6 +543,18 @@ sanitize_flags = sanitize_vptr_flag(args.cxx)
 
 modes['debug']['sanitize'] += ' ' + sanitize_flags
 
+cxx_dialect = '-std=gnu++1y'
+
+def have_coroutines():
+    return try_compile(compiler = args.cxx, flags = ['-std=gnu++2a', '-fcoroutines'], source = '#include <coroutine>\n')
+
+if args.coroutines:
+    if not have_coroutines():
+        print('Error: --enable-coroutines requires a compiler with C++20 coroutine support.')
+        sys.exit(1)
+    cxx_dialect = '-std=gnu++2a -fcoroutines'
+    defines.append('SEASTAR_COROUTINES_ENABLED')
+
 def have_hwloc():
     return try_compile(compiler = args.cxx, source = '#include <hwloc.h>\n#include <numa.h>')
 
@@ -509,7 +609,7 @@ with open(buildfile, 'w') as f:
         builddir = {outdir}
         cxx = {cxx}
         # we disable _FORTIFY_SOURCE because it generates false positives with longjmp() (core/thread.cc)
-        cxxflags = -std=gnu++1y {dbgflag} {fpie} -Wall -Werror -fvisibility=hidden -pthread -I. -U_FORTIFY_SOURCE {user_cflags} {warnings} {defines}
+        cxxflags = {cxx_dialect} {dbgflag} {fpie} -Wall -Werror -fvisibility=hidden -pthread -I. -U_FORTIFY_SOURCE {user_cflags} {warnings} {defines}
         ldflags = {dbgflag} -Wl,--no-as-needed {static} {pie} -fvisibility=hidden -pthread {user_ldflags}
         libs = {libs}
         pool link_pool
@@ -574,7 +674,7 @@ with open(buildfile, 'w') as f:
                         Description: Advanced C++ framework for high-performance server applications on modern hardware.
                         Version: 1.0
                         Libs: -L{srcdir}/{builddir} -Wl,--whole-archive,-lseastar,--no-whole-archive {dbgflag} -Wl,--no-as-needed {static} {pie} -fvisibility=hidden -pthread {user_ldflags} {libs} {sanitize_libs}
-                        Cflags: -std=gnu++1y {dbgflag} {fpie} -Wall -Werror -fvisibility=hidden -pthread -I{srcdir} -I{srcdir}/{builddir}/gen {user_cflags} {warnings} {defines} {sanitize} {opt}
+                        Cflags: {cxx_dialect} {dbgflag} {fpie} -Wall -Werror -fvisibility=hidden -pthread -I{srcdir} -I{srcdir}/{builddir}/gen {user_cflags} {warnings} {defines} {sanitize} {opt}
                         ''').format(builddir = 'build/' + mode, srcdir = os.getcwd(), **vars)
                 f.write('build $builddir/{}/{}: gen\n  text = {}\n'.format(mode, binary, repr(pc)))
             elif binary.endswith('.a'):
@@ -0,0 +1,146 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#pragma once
+
+#include <boost/intrusive/list.hpp>
+#include <functional>
+#include <exception>
+
+namespace seastar {
+
+/// \addtogroup fiber-module
+/// @{
+
+namespace bi = boost::intrusive;
+
+/// Exception returned by abortable waits when their \ref abort_source
+/// is triggered.
+class abort_requested_exception : public std::exception {
+public:
+    virtual const char* what() const noexcept override {
+        return "abort requested";
+    }
+};
+
+/// Facility to communicate a cancellation request to a fiber.
+///
+/// Operations that support cancellation take an \c abort_source reference
+/// and \ref subscribe() a callback to it for the duration of the wait.
+/// \ref request_abort() invokes all current callbacks, which typically
+/// fail the pending future with \ref abort_requested_exception and release
+/// the resources (timers, wait list entries) held by the wait.
+///
+/// An abort_source can be shared by any number of waits, and must outlive
+/// them.  Requesting an abort is sticky: once requested, waits started
+/// later fail immediately.
+class abort_source {
+    using subscription_callback_type = std::function<void()>;
+public:
+    /// Registration of a callback with an \ref abort_source.
+    ///
+    /// Destroying (or moving from) the subscription unregisters the
+    /// callback, so a wait that completes normally simply drops it.
+    class subscription {
+        using hook_type = bi::list_member_hook<bi::link_mode<bi::auto_unlink>>;
+        hook_type _link;
+        subscription_callback_type _cb;
+        friend class abort_source;
+    public:
+        subscription() = default;
+        subscription(subscription&& x) noexcept : _cb(std::move(x._cb)) {
+            _link.swap_nodes(x._link);
+        }
+        subscription& operator=(subscription&& x) noexcept {
+            if (this != &x) {
+                _link.unlink();
+                _cb = std::move(x._cb);
+                _link.swap_nodes(x._link);
+            }
+            return *this;
+        }
+        /// Unregisters the callback, if still registered.
+        void unsubscribe() {
+            _link.unlink();
+        }
+        /// Returns true if the callback is registered and has not run yet.
+        explicit operator bool() const {
+            return _link.is_linked();
+        }
+    };
+private:
+    using subscription_list_type = bi::list<subscription,
+            bi::member_hook<subscription, subscription::hook_type, &subscription::_link>,
+            bi::constant_time_size<false>>;
+    subscription_list_type _subscriptions;
+    bool _abort_requested = false;
+public:
+    abort_source() = default;
+    abort_source(abort_source&&) = default;
+    abort_source& operator=(abort_source&&) = default;
+
+    /// Registers \c cb to be called when an abort is requested.
+    ///
+    /// \c cb must not throw.  If an abort was already requested, \c cb
+    /// is not registered and an inactive subscription is returned;
+    /// callers should check \ref abort_requested() first.
+    ///
+    /// \return a subscription object which keeps \c cb registered for as
+    ///         long as it lives.
+    subscription subscribe(subscription_callback_type cb) {
+        subscription s;
+        if (!_abort_requested) {
+            s._cb = std::move(cb);
+            _subscriptions.push_back(s);
+        }
+        return s;
+    }
+
+    /// Requests an abort, invoking every registered callback once.
+    ///
+    /// Callbacks are unregistered before they run, so they may destroy
+    /// their own subscription.
+    void request_abort() {
+        _abort_requested = true;
+        while (!_subscriptions.empty()) {
+            auto& s = _subscriptions.front();
+            _subscriptions.pop_front();
+            auto cb = std::move(s._cb);
+            cb();
+        }
+    }
+
+    /// Returns true if \ref request_abort() was called.
+    bool abort_requested() const {
+        return _abort_requested;
+    }
+
+    /// Throws \ref abort_requested_exception if an abort was requested.
+    void check() const {
+        if (_abort_requested) {
+            throw abort_requested_exception();
+        }
+    }
+};
+
+/// @}
+
+} // namespace seastar
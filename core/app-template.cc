@@ -23,6 +23,7 @@
 #include "core/reactor.hh"
 #include "core/scollectd.hh"
 #include "core/print.hh"
+#include "util/log.hh"
 #include <boost/program_options.hpp>
 #include <boost/make_shared.hpp>
 #include <fstream>
@@ -34,6 +35,11 @@ app_template::app_template()
         : _opts("App options") {
     _opts.add_options()
             ("help,h", "show help message")
+            ("default-log-level", bpo::value<sstring>()->default_value("info"),
+                    "default log level for all loggers (error, warn, info, debug or trace)")
+            ("logger-log-level", bpo::value<std::vector<sstring>>()->composing(),
+                    "log level of a single logger, as <logger>=<level>; may be repeated")
+            ("log-file", bpo::value<sstring>(), "write log messages to this file instead of stderr")
             ;
     _opts.add(reactor::get_options_description());
     _opts.add(smp::get_options_description());
@@ -54,6 +60,29 @@ app_template::add_positional_options(std::initializer_list<positional_option> op
 }
 
 
+void
+app_template::configure_logging(const bpo::variables_map& configuration) {
+    auto& registry = seastar::global_logger_registry();
+    registry.set_all_loggers_level(seastar::parse_log_level(configuration["default-log-level"].as<sstring>()));
+    if (configuration.count("logger-log-level")) {
+        for (auto&& spec : configuration["logger-log-level"].as<std::vector<sstring>>()) {
+            auto eq = std::find(spec.begin(), spec.end(), '=');
+            if (eq == spec.end()) {
+                throw std::invalid_argument(sprint("bad --logger-log-level '%s', expected <logger>=<level>", spec));
+            }
+            auto name = sstring(spec.begin(), eq - spec.begin());
+            try {
+                registry.set_logger_level(name, seastar::parse_log_level(sstring(eq + 1, spec.end() - eq - 1)));
+            } catch (std::out_of_range&) {
+                throw std::invalid_argument(sprint("unknown logger '%s'", name));
+            }
+        }
+    }
+    if (configuration.count("log-file")) {
+        seastar::set_log_output(configuration["log-file"].as<sstring>());
+    }
+}
+
 bpo::variables_map&
 app_template::configuration() {
     return *_configuration;
@@ -105,6 +134,12 @@ app_template::run_deprecated(int ac, char ** av, std::function<void ()>&& func)
         std::cout << _opts << "\n";
         return 1;
     }
+    try {
+        configure_logging(configuration);
+    } catch (std::exception& e) {
+        print("error: %s\n", e.what());
+        return 2;
+    }
     configuration.emplace("argv0", boost::program_options::variable_value(std::string(av[0]), false));
     smp::configure(configuration);
     _configuration = {std::move(configuration)};
@@ -122,5 +157,6 @@ app_template::run_deprecated(int ac, char ** av, std::function<void ()>&& func)
     });
     auto exit_code = engine().run();
     smp::cleanup();
+    seastar::flush_logs();
     return exit_code;
 }
@@ -31,6 +31,8 @@ class app_template {
     boost::program_options::options_description _opts;
     boost::program_options::positional_options_description _pos_opts;
     boost::optional<boost::program_options::variables_map> _configuration;
+private:
+    void configure_logging(const boost::program_options::variables_map& configuration);
 public:
     struct positional_option {
         const char* name;
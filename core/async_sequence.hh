@@ -0,0 +1,635 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#pragma once
+
+#include "future.hh"
+#include "future-util.hh"
+#include "shared_ptr.hh"
+#include "stream.hh"
+#include "pipe.hh"
+#include "circular_buffer.hh"
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <algorithm>
+#include <experimental/optional>
+
+namespace seastar {
+
+/// \addtogroup fiber-module
+/// @{
+
+template <typename T>
+class async_sequence;
+
+/// Interface for implementing an \ref async_sequence.
+template <typename T>
+class async_sequence_impl {
+public:
+    virtual ~async_sequence_impl() {}
+    /// Returns the next batch of values.  An empty batch marks the end
+    /// of the sequence, so implementations must not return one earlier.
+    virtual future<std::vector<T>> next_batch() = 0;
+};
+
+/// \brief Pull-based asynchronous sequence of values.
+///
+/// Unlike a \ref stream / \ref subscription pair, where the producer pushes
+/// one value at a time and waits on a future per value, an async_sequence
+/// is pulled by its consumer, a batch at a time, through \ref next_batch().
+/// Each stage of a pipeline produces values only when asked, so a pipeline
+/// holds at most one batch per stage, plus what its \ref buffer() stages
+/// explicitly allow.
+///
+/// Combinators consume the sequence they are called on and return a new
+/// one:
+/// \code
+///   std::move(entries).filter(is_regular).map(name_of).chunk(64).buffer(1024)
+/// \endcode
+///
+/// Only one \ref next_batch() call may be outstanding at a time, and the
+/// sequence must be kept alive until it resolves.
+template <typename T>
+class async_sequence {
+    std::unique_ptr<async_sequence_impl<T>> _impl;
+public:
+    using value_type = T;
+
+    explicit async_sequence(std::unique_ptr<async_sequence_impl<T>> impl) : _impl(std::move(impl)) {}
+    async_sequence(async_sequence&&) noexcept = default;
+    async_sequence& operator=(async_sequence&&) noexcept = default;
+
+    /// Returns the next batch of values; an empty batch marks the end of
+    /// the sequence.  Failures of any upstream stage are delivered here.
+    future<std::vector<T>> next_batch() {
+        return _impl->next_batch();
+    }
+
+    /// Calls \c func on every batch until the sequence ends.
+    ///
+    /// \param func callable taking a \c std::vector<T>, returning either
+    ///             \c void or a \c future<>; the next batch is not pulled
+    ///             until the future resolves.
+    /// \return a future that resolves when the sequence ends, or fails with
+    ///         the first exception of the sequence or of \c func.
+    template <typename Func>
+    future<> consume(Func func) &&;
+
+    /// Calls \c func synchronously on every value until the sequence ends.
+    template <typename Func>
+    future<> for_each(Func func) &&;
+
+    /// Collects all the values of the sequence.
+    future<std::vector<T>> to_vector() &&;
+
+    /// Transforms every value with \c func (T -> U).
+    template <typename Func>
+    async_sequence<std::result_of_t<Func(T&&)>> map(Func func) &&;
+
+    /// Drops values for which \c pred returns false.
+    template <typename Pred>
+    async_sequence<T> filter(Pred pred) &&;
+
+    /// Regroups values into batches of exactly \c n values (the last batch
+    /// may be shorter).
+    async_sequence<T> chunk(size_t n) &&;
+
+    /// Reads ahead of the consumer in the background, until at least
+    /// \c max_buffered values are waiting.  Since whole batches are
+    /// buffered, the limit may be exceeded by up to one upstream batch.
+    async_sequence<T> buffer(size_t max_buffered) &&;
+};
+
+/// Creates an \ref async_sequence from an implementation class.
+template <typename T, typename Impl, typename... Args>
+inline
+async_sequence<T>
+make_async_sequence(Args&&... args) {
+    return async_sequence<T>(std::make_unique<Impl>(std::forward<Args>(args)...));
+}
+
+/// \cond internal
+namespace internal {
+
+template <typename T>
+class ready_sequence_impl : public async_sequence_impl<T> {
+    std::vector<T> _values;
+public:
+    explicit ready_sequence_impl(std::vector<T> values) : _values(std::move(values)) {}
+    virtual future<std::vector<T>> next_batch() override {
+        auto ret = std::move(_values);
+        _values.clear();
+        return make_ready_future<std::vector<T>>(std::move(ret));
+    }
+};
+
+template <typename T, typename Func>
+class mapped_sequence_impl : public async_sequence_impl<std::result_of_t<Func(T&&)>> {
+    using result_type = std::result_of_t<Func(T&&)>;
+    async_sequence<T> _source;
+    Func _func;
+public:
+    mapped_sequence_impl(async_sequence<T> source, Func func)
+        : _source(std::move(source)), _func(std::move(func)) {}
+    virtual future<std::vector<result_type>> next_batch() override {
+        return _source.next_batch().then([this] (std::vector<T> batch) {
+            std::vector<result_type> ret;
+            ret.reserve(batch.size());
+            for (auto& v : batch) {
+                ret.push_back(_func(std::move(v)));
+            }
+            return ret;
+        });
+    }
+};
+
+template <typename T, typename Pred>
+class filtered_sequence_impl : public async_sequence_impl<T> {
+    async_sequence<T> _source;
+    Pred _pred;
+public:
+    filtered_sequence_impl(async_sequence<T> source, Pred pred)
+        : _source(std::move(source)), _pred(std::move(pred)) {}
+    virtual future<std::vector<T>> next_batch() override {
+        return _source.next_batch().then([this] (std::vector<T> batch) {
+            if (batch.empty()) {
+                return make_ready_future<std::vector<T>>(std::move(batch));
+            }
+            batch.erase(std::remove_if(batch.begin(), batch.end(), [this] (const T& v) {
+                return !_pred(v);
+            }), batch.end());
+            if (batch.empty()) {
+                // an empty batch would end the sequence; try the next one
+                return next_batch();
+            }
+            return make_ready_future<std::vector<T>>(std::move(batch));
+        });
+    }
+};
+
+template <typename T>
+class chunked_sequence_impl : public async_sequence_impl<T> {
+    async_sequence<T> _source;
+    size_t _n;
+    // values not yet returned are _pending[_pos...]
+    std::vector<T> _pending;
+    size_t _pos = 0;
+    bool _eof = false;
+private:
+    size_t available() const {
+        return _pending.size() - _pos;
+    }
+    std::vector<T> take() {
+        if (_pos == 0 && _pending.size() <= _n) {
+            auto ret = std::move(_pending);
+            _pending.clear();
+            return ret;
+        }
+        auto begin = _pending.begin() + _pos;
+        auto count = std::min(_n, available());
+        std::vector<T> ret(std::make_move_iterator(begin), std::make_move_iterator(begin + count));
+        _pos += count;
+        if (_pos == _pending.size()) {
+            _pending.clear();
+            _pos = 0;
+        }
+        return ret;
+    }
+    void append(std::vector<T> batch) {
+        if (_pending.empty()) {
+            _pending = std::move(batch);
+            return;
+        }
+        _pending.erase(_pending.begin(), _pending.begin() + _pos);
+        _pos = 0;
+        _pending.insert(_pending.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+    }
+public:
+    chunked_sequence_impl(async_sequence<T> source, size_t n)
+        : _source(std::move(source)), _n(n) {
+        assert(n > 0);
+    }
+    virtual future<std::vector<T>> next_batch() override {
+        if (available() >= _n || (_eof && available())) {
+            return make_ready_future<std::vector<T>>(take());
+        }
+        if (_eof) {
+            return make_ready_future<std::vector<T>>();
+        }
+        return _source.next_batch().then([this] (std::vector<T> batch) {
+            if (batch.empty()) {
+                _eof = true;
+            } else {
+                append(std::move(batch));
+            }
+            return next_batch();
+        });
+    }
+};
+
+template <typename T>
+class buffered_sequence_impl : public async_sequence_impl<T> {
+    struct state {
+        async_sequence<T> source;
+        size_t max_buffered;
+        circular_buffer<std::vector<T>> batches;
+        size_t buffered = 0;
+        bool fetching = false;
+        bool eof = false;
+        bool closed = false;
+        std::exception_ptr ex;
+        std::experimental::optional<promise<>> waiter;
+
+        state(async_sequence<T> source, size_t max_buffered)
+            : source(std::move(source)), max_buffered(max_buffered) {}
+        void wake() {
+            if (waiter) {
+                waiter->set_value();
+                waiter = std::experimental::nullopt;
+            }
+        }
+    };
+    lw_shared_ptr<state> _s;
+private:
+    static void fill(lw_shared_ptr<state> s) {
+        if (s->fetching || s->eof || s->ex || s->closed || s->buffered >= s->max_buffered) {
+            return;
+        }
+        s->fetching = true;
+        s->source.next_batch().then_wrapped([s] (future<std::vector<T>> f) {
+            s->fetching = false;
+            try {
+                auto batch = f.get0();
+                if (batch.empty()) {
+                    s->eof = true;
+                } else {
+                    s->buffered += batch.size();
+                    s->batches.push_back(std::move(batch));
+                }
+            } catch (...) {
+                s->ex = std::current_exception();
+            }
+            s->wake();
+            fill(s);
+        });
+    }
+public:
+    buffered_sequence_impl(async_sequence<T> source, size_t max_buffered)
+        : _s(make_lw_shared<state>(std::move(source), max_buffered)) {
+        fill(_s);
+    }
+    virtual ~buffered_sequence_impl() {
+        // a fetch still in flight keeps the state alive; don't start more
+        _s->closed = true;
+    }
+    virtual future<std::vector<T>> next_batch() override {
+        if (!_s->batches.empty()) {
+            auto batch = std::move(_s->batches.front());
+            _s->batches.pop_front();
+            _s->buffered -= batch.size();
+            fill(_s);
+            return make_ready_future<std::vector<T>>(std::move(batch));
+        }
+        if (_s->ex) {
+            return make_exception_future<std::vector<T>>(_s->ex);
+        }
+        if (_s->eof) {
+            return make_ready_future<std::vector<T>>();
+        }
+        _s->waiter = promise<>();
+        auto f = _s->waiter->get_future();
+        fill(_s);
+        return f.then([this] {
+            return next_batch();
+        });
+    }
+};
+
+template <typename T>
+class merged_sequence_impl : public async_sequence_impl<T> {
+    struct state {
+        std::vector<async_sequence<T>> sources;
+        // batches ready to be returned, with the index of their source
+        circular_buffer<std::pair<size_t, std::vector<T>>> ready;
+        size_t active;
+        std::exception_ptr ex;
+        std::experimental::optional<promise<>> waiter;
+
+        explicit state(std::vector<async_sequence<T>> sources)
+            : sources(std::move(sources)), active(this->sources.size()) {}
+    };
+    lw_shared_ptr<state> _s;
+private:
+    // At most one fetch per source is in flight, and a source is not read
+    // again until its previous batch was returned, bounding memory to one
+    // batch per source.
+    static void fetch(lw_shared_ptr<state> s, size_t i) {
+        s->sources[i].next_batch().then_wrapped([s, i] (future<std::vector<T>> f) {
+            try {
+                auto batch = f.get0();
+                if (batch.empty()) {
+                    --s->active;
+                } else {
+                    s->ready.emplace_back(i, std::move(batch));
+                }
+            } catch (...) {
+                --s->active;
+                if (!s->ex) {
+                    s->ex = std::current_exception();
+                }
+            }
+            if (s->waiter) {
+                s->waiter->set_value();
+                s->waiter = std::experimental::nullopt;
+            }
+        });
+    }
+public:
+    explicit merged_sequence_impl(std::vector<async_sequence<T>> sources)
+        : _s(make_lw_shared<state>(std::move(sources))) {
+        for (size_t i = 0; i < _s->sources.size(); ++i) {
+            fetch(_s, i);
+        }
+    }
+    virtual future<std::vector<T>> next_batch() override {
+        if (!_s->ready.empty()) {
+            auto e = std::move(_s->ready.front());
+            _s->ready.pop_front();
+            if (!_s->ex) {
+                fetch(_s, e.first);
+            }
+            return make_ready_future<std::vector<T>>(std::move(e.second));
+        }
+        if (_s->ex) {
+            return make_exception_future<std::vector<T>>(_s->ex);
+        }
+        if (!_s->active) {
+            return make_ready_future<std::vector<T>>();
+        }
+        _s->waiter = promise<>();
+        return _s->waiter->get_future().then([this] {
+            return next_batch();
+        });
+    }
+};
+
+template <typename T, typename Item>
+struct subscription_sequence_state {
+    std::vector<T> buffer;
+    size_t max_buffered;
+    bool eof = false;
+    bool closed = false;
+    std::exception_ptr ex;
+    std::experimental::optional<promise<>> consumer;
+    std::experimental::optional<promise<>> producer;
+    // Owned here rather than by the sequence, so that a producer that is
+    // still running when the sequence is destroyed does not find its
+    // subscription gone; released when the stream ends.
+    std::experimental::optional<subscription<Item>> sub;
+
+    explicit subscription_sequence_state(size_t max_buffered) : max_buffered(max_buffered) {}
+    void append(T&& v) {
+        buffer.push_back(std::move(v));
+    }
+    void append(std::vector<T>&& batch) {
+        if (buffer.empty()) {
+            buffer = std::move(batch);
+        } else {
+            buffer.insert(buffer.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+        }
+    }
+    void wake_consumer() {
+        if (consumer) {
+            consumer->set_value();
+            consumer = std::experimental::nullopt;
+        }
+    }
+    future<> push(Item&& item) {
+        if (closed) {
+            return make_exception_future<>(cached_exception_ptr<broken_pipe_exception>());
+        }
+        append(std::move(item));
+        wake_consumer();
+        if (buffer.size() < max_buffered) {
+            return make_ready_future<>();
+        }
+        producer = promise<>();
+        return producer->get_future();
+    }
+};
+
+template <typename T, typename Item>
+class subscription_sequence_impl : public async_sequence_impl<T> {
+    using state = subscription_sequence_state<T, Item>;
+    lw_shared_ptr<state> _s;
+public:
+    explicit subscription_sequence_impl(lw_shared_ptr<state> s) : _s(std::move(s)) {}
+    virtual ~subscription_sequence_impl() {
+        _s->closed = true;
+        if (_s->producer) {
+            _s->producer->set_exception(cached_exception_ptr<broken_pipe_exception>());
+            _s->producer = std::experimental::nullopt;
+        }
+    }
+    virtual future<std::vector<T>> next_batch() override {
+        if (!_s->buffer.empty()) {
+            auto batch = std::move(_s->buffer);
+            _s->buffer.clear();
+            if (_s->producer) {
+                _s->producer->set_value();
+                _s->producer = std::experimental::nullopt;
+            }
+            return make_ready_future<std::vector<T>>(std::move(batch));
+        }
+        if (_s->ex) {
+            return make_exception_future<std::vector<T>>(_s->ex);
+        }
+        if (_s->eof) {
+            return make_ready_future<std::vector<T>>();
+        }
+        _s->consumer = promise<>();
+        return _s->consumer->get_future().then([this] {
+            return next_batch();
+        });
+    }
+};
+
+template <typename T, typename Item, typename Start>
+inline
+async_sequence<T>
+make_subscription_sequence(size_t max_buffered, Start&& start) {
+    using state = subscription_sequence_state<T, Item>;
+    auto s = make_lw_shared<state>(max_buffered);
+    s->sub.emplace(start([s] (Item item) {
+        return s->push(std::move(item));
+    }));
+    s->sub->done().then_wrapped([s] (future<> f) {
+        try {
+            f.get();
+            s->eof = true;
+        } catch (...) {
+            s->ex = std::current_exception();
+        }
+        s->wake_consumer();
+        // drops the callback, and with it the reference cycle through s
+        s->sub = std::experimental::nullopt;
+    });
+    return make_async_sequence<T, subscription_sequence_impl<T, Item>>(std::move(s));
+}
+
+} // namespace internal
+/// \endcond
+
+/// Creates an \ref async_sequence holding the given values.
+template <typename T>
+inline
+async_sequence<T>
+make_ready_async_sequence(std::vector<T> values) {
+    return make_async_sequence<T, internal::ready_sequence_impl<T>>(std::move(values));
+}
+
+/// Adapts a push-based \ref stream of values to an \ref async_sequence.
+///
+/// \c start is called with the callback to be registered with the stream,
+/// and must return the started subscription (for example by passing the
+/// callback to \ref stream::listen()).  Values pushed by the producer are
+/// buffered until pulled; once \c max_buffered values are waiting, the
+/// future returned to the producer does not resolve until the consumer
+/// pulls them, so the producer is throttled to the consumer's pace.
+///
+/// If the sequence is destroyed before the stream ends, the producer sees
+/// a \ref broken_pipe_exception.
+template <typename T, typename Start>
+inline
+async_sequence<T>
+make_async_sequence_from_subscription(size_t max_buffered, Start&& start) {
+    return internal::make_subscription_sequence<T, T>(max_buffered, std::forward<Start>(start));
+}
+
+/// Adapts a push-based \ref stream of value batches, such as
+/// \ref file::list_directory_batched(), to an \ref async_sequence.
+///
+/// Like \ref make_async_sequence_from_subscription(), but the stream
+/// produces \c std::vector<T> batches, which are passed on without being
+/// split into individual values.
+template <typename T, typename Start>
+inline
+async_sequence<T>
+make_async_sequence_from_batched_subscription(size_t max_buffered, Start&& start) {
+    return internal::make_subscription_sequence<T, std::vector<T>>(max_buffered, std::forward<Start>(start));
+}
+
+/// Merges several sequences into one.
+///
+/// All sources are read concurrently, with at most one batch per source
+/// in flight or waiting, and batches are returned in the order in which
+/// they become available.  The merged sequence ends when all sources
+/// end; it fails with the first failure of any source.
+template <typename T>
+inline
+async_sequence<T>
+merge(std::vector<async_sequence<T>> sources) {
+    return make_async_sequence<T, internal::merged_sequence_impl<T>>(std::move(sources));
+}
+
+template <typename T>
+template <typename Func>
+inline
+future<>
+async_sequence<T>::consume(Func func) && {
+    return do_with(std::move(*this), std::move(func), [] (async_sequence<T>& seq, Func& func) {
+        return repeat([&seq, &func] {
+            return seq.next_batch().then([&func] (std::vector<T> batch) {
+                if (batch.empty()) {
+                    return make_ready_future<stop_iteration>(stop_iteration::yes);
+                }
+                using futurator = futurize<std::result_of_t<Func(std::vector<T>&&)>>;
+                return futurator::apply(func, std::move(batch)).then([] {
+                    return stop_iteration::no;
+                });
+            });
+        });
+    });
+}
+
+template <typename T>
+template <typename Func>
+inline
+future<>
+async_sequence<T>::for_each(Func func) && {
+    return std::move(*this).consume([func = std::move(func)] (std::vector<T> batch) mutable {
+        for (auto& v : batch) {
+            func(std::move(v));
+        }
+    });
+}
+
+template <typename T>
+inline
+future<std::vector<T>>
+async_sequence<T>::to_vector() && {
+    auto result = make_lw_shared<std::vector<T>>();
+    return std::move(*this).consume([result] (std::vector<T> batch) {
+        if (result->empty()) {
+            *result = std::move(batch);
+        } else {
+            result->insert(result->end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+        }
+    }).then([result] {
+        return std::move(*result);
+    });
+}
+
+template <typename T>
+template <typename Func>
+inline
+async_sequence<std::result_of_t<Func(T&&)>>
+async_sequence<T>::map(Func func) && {
+    using impl = internal::mapped_sequence_impl<T, Func>;
+    return make_async_sequence<std::result_of_t<Func(T&&)>, impl>(std::move(*this), std::move(func));
+}
+
+template <typename T>
+template <typename Pred>
+inline
+async_sequence<T>
+async_sequence<T>::filter(Pred pred) && {
+    return make_async_sequence<T, internal::filtered_sequence_impl<T, Pred>>(std::move(*this), std::move(pred));
+}
+
+template <typename T>
+inline
+async_sequence<T>
+async_sequence<T>::chunk(size_t n) && {
+    return make_async_sequence<T, internal::chunked_sequence_impl<T>>(std::move(*this), n);
+}
+
+template <typename T>
+inline
+async_sequence<T>
+async_sequence<T>::buffer(size_t max_buffered) && {
+    return make_async_sequence<T, internal::buffered_sequence_impl<T>>(std::move(*this), max_buffered);
+}
+
+/// @}
+
+} // namespace seastar
@@ -0,0 +1,89 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#include "checksummed-stream.hh"
+#include "chunking-sink.hh"
+#include "crc32c.hh"
+#include "unaligned.hh"
+#include "net/byteorder.hh"
+
+static constexpr size_t checksummed_frame_header_size = 8;
+
+class checksumming_sink_impl : public chunking_sink_impl {
+    char _header[checksummed_frame_header_size];
+public:
+    checksumming_sink_impl(output_stream<char> out, checksummed_output_stream_options options)
+            : chunking_sink_impl(std::move(out), options.chunk_size) {
+        assert(_chunk_size && _chunk_size <= checksummed_stream_max_chunk_size);
+    }
+protected:
+    virtual future<> write_frame(const char* p, size_t n) override {
+        *unaligned_cast<uint32_t*>(_header) = net::hton(uint32_t(n));
+        *unaligned_cast<uint32_t*>(_header + 4) = net::hton(crc32c_of(p, n));
+        return _out.write(_header, checksummed_frame_header_size).then([this, p, n] {
+            return _out.write(p, n);
+        });
+    }
+};
+
+class verifying_source_impl : public data_source_impl {
+    input_stream<char> _in;
+public:
+    explicit verifying_source_impl(input_stream<char> in)
+            : _in(std::move(in)) {}
+    virtual future<temporary_buffer<char>> get() override {
+        return _in.read_exactly(checksummed_frame_header_size).then([this] (temporary_buffer<char> hdr) {
+            if (hdr.empty()) {
+                // end of stream
+                return make_ready_future<temporary_buffer<char>>();
+            }
+            if (hdr.size() != checksummed_frame_header_size) {
+                throw checksum_error("checksummed stream: truncated frame header");
+            }
+            size_t size = net::ntoh(*unaligned_cast<uint32_t*>(hdr.get()));
+            uint32_t expected = net::ntoh(*unaligned_cast<uint32_t*>(hdr.get() + 4));
+            if (!size || size > checksummed_stream_max_chunk_size) {
+                throw checksum_error("checksummed stream: bad frame header");
+            }
+            return _in.read_exactly(size).then([size, expected] (temporary_buffer<char> payload) {
+                if (payload.size() != size) {
+                    throw checksum_error("checksummed stream: truncated frame");
+                }
+                if (crc32c_of(payload.get(), payload.size()) != expected) {
+                    throw checksum_error("checksummed stream: checksum mismatch");
+                }
+                return payload;
+            });
+        });
+    }
+    virtual future<> close() override {
+        return _in.close();
+    }
+};
+
+output_stream<char> make_checksummed_output_stream(output_stream<char> out, checksummed_output_stream_options options) {
+    data_sink ds(std::make_unique<checksumming_sink_impl>(std::move(out), options));
+    return output_stream<char>(std::move(ds), options.chunk_size, true);
+}
+
+input_stream<char> make_checksummed_input_stream(input_stream<char> in) {
+    return input_stream<char>(data_source(std::make_unique<verifying_source_impl>(std::move(in))));
+}
@@ -0,0 +1,69 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#pragma once
+
+// Checksumming adapters for streams
+//
+// The output adapter splits the data written to it into chunks and writes
+// each one, preceded by its CRC32C, into an underlying output_stream.  The
+// input adapter verifies every chunk as it passes through, so corruption is
+// reported as soon as the damaged chunk is read rather than at the end of
+// the stream.  Both can be layered over any stream, for example a file
+// stream.
+//
+// Each frame has the following format:
+//
+//   uint32_t (big endian)  payload size
+//   uint32_t (big endian)  crc32c of the payload
+//   char[payload size]     payload
+
+#include "iostream.hh"
+#include <stdexcept>
+
+/// Largest chunk size supported by the checksummed stream format.
+static constexpr size_t checksummed_stream_max_chunk_size = 4 << 20;
+
+/// Thrown when a checksummed stream fails verification.
+class checksum_error : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/// Data structure describing options for creating a checksummed output stream
+struct checksummed_output_stream_options {
+    size_t chunk_size = 64 * 1024;  ///< Amount of data covered by a single checksum
+};
+
+/// Create an output_stream that checksums everything written to it and
+/// writes the data, along with the checksums, into \c out.
+///
+/// Closing the returned stream closes \c out as well.
+output_stream<char> make_checksummed_output_stream(
+        output_stream<char> out,
+        checksummed_output_stream_options options = {});
+
+/// Create an input_stream that reads data written by a checksummed output
+/// stream from \c in, verifying it on the way.
+///
+/// A read fails with \ref checksum_error when a chunk does not match its
+/// checksum or the stream is truncated.
+input_stream<char> make_checksummed_input_stream(input_stream<char> in);
@@ -0,0 +1,73 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#pragma once
+
+// Base for sinks that cut what is written to them into chunks of at most
+// a given size and write each chunk, framed in some way, into an
+// underlying output_stream; used by the lz4 and the checksummed streams.
+
+#include "iostream.hh"
+#include "future-util.hh"
+#include "do_with.hh"
+#include "net/packet.hh"
+#include <algorithm>
+
+class chunking_sink_impl : public data_sink_impl {
+protected:
+    output_stream<char> _out;
+    size_t _chunk_size;
+public:
+    chunking_sink_impl(output_stream<char> out, size_t chunk_size)
+            : _out(std::move(out)), _chunk_size(chunk_size) {}
+    virtual future<> put(net::packet data) override {
+        return do_with(std::move(data), [this] (net::packet& p) {
+            return do_for_each(p.fragments().begin(), p.fragments().end(), [this] (net::fragment f) {
+                return write_chunks(f.base, f.size);
+            });
+        });
+    }
+    virtual future<> put(temporary_buffer<char> buf) override {
+        auto p = buf.get();
+        auto size = buf.size();
+        return write_chunks(p, size).then([d = buf.release()] {});
+    }
+    virtual future<> flush() override {
+        return _out.flush();
+    }
+    virtual future<> close() override {
+        return _out.close();
+    }
+protected:
+    // Writes a single chunk of at most _chunk_size bytes into _out.  The
+    // caller keeps [p, p + n) alive until the returned future resolves.
+    virtual future<> write_frame(const char* p, size_t n) = 0;
+private:
+    future<> write_chunks(const char* p, size_t n) {
+        if (!n) {
+            return make_ready_future<>();
+        }
+        auto now = std::min(n, _chunk_size);
+        return write_frame(p, now).then([this, p, n, now] {
+            return write_chunks(p + now, n - now);
+        });
+    }
+};
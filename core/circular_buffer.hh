@@ -152,7 +152,7 @@ class circular_buffer {
     private:
         CB* cb;
         size_t idx;
-        cbiterator<CB, ValueType>(CB* b, size_t i) : cb(b), idx(i) {}
+        cbiterator(CB* b, size_t i) : cb(b), idx(i) {}
         friend class circular_buffer;
     };
     friend class iterator;
@@ -232,7 +232,7 @@ template <typename T, typename Alloc>
 inline
 circular_buffer<T, Alloc>::~circular_buffer() {
     for_each([this] (T& obj) {
-        _impl.destroy(&obj);
+        std::allocator_traits<Alloc>::destroy(_impl, &obj);
     });
     _impl.deallocate(_impl.storage, _impl.capacity);
 }
@@ -250,7 +250,7 @@ circular_buffer<T, Alloc>::expand() {
         });
     } catch (...) {
         while (p != new_storage) {
-            _impl.destroy(--p);
+            std::allocator_traits<Alloc>::destroy(_impl, --p);
         }
         _impl.deallocate(new_storage, new_cap);
         throw;
@@ -281,7 +281,7 @@ void
 circular_buffer<T, Alloc>::push_front(const T& data) {
     maybe_expand();
     auto p = &_impl.storage[mask(_impl.begin - 1)];
-    _impl.construct(p, data);
+    std::allocator_traits<Alloc>::construct(_impl, p, data);
     --_impl.begin;
 }
 
@@ -291,7 +291,7 @@ void
 circular_buffer<T, Alloc>::push_front(T&& data) {
     maybe_expand();
     auto p = &_impl.storage[mask(_impl.begin - 1)];
-    _impl.construct(p, std::move(data));
+    std::allocator_traits<Alloc>::construct(_impl, p, std::move(data));
     --_impl.begin;
 }
 
@@ -302,7 +302,7 @@ void
 circular_buffer<T, Alloc>::emplace_front(Args&&... args) {
     maybe_expand();
     auto p = &_impl.storage[mask(_impl.begin - 1)];
-    _impl.construct(p, std::forward<Args>(args)...);
+    std::allocator_traits<Alloc>::construct(_impl, p, std::forward<Args>(args)...);
     --_impl.begin;
 }
 
@@ -312,7 +312,7 @@ void
 circular_buffer<T, Alloc>::push_back(const T& data) {
     maybe_expand();
     auto p = &_impl.storage[mask(_impl.end)];
-    _impl.construct(p, data);
+    std::allocator_traits<Alloc>::construct(_impl, p, data);
     ++_impl.end;
 }
 
@@ -322,7 +322,7 @@ void
 circular_buffer<T, Alloc>::push_back(T&& data) {
     maybe_expand();
     auto p = &_impl.storage[mask(_impl.end)];
-    _impl.construct(p, std::move(data));
+    std::allocator_traits<Alloc>::construct(_impl, p, std::move(data));
     ++_impl.end;
 }
 
@@ -333,7 +333,7 @@ void
 circular_buffer<T, Alloc>::emplace_back(Args&&... args) {
     maybe_expand();
     auto p = &_impl.storage[mask(_impl.end)];
-    _impl.construct(p, std::forward<Args>(args)...);
+    std::allocator_traits<Alloc>::construct(_impl, p, std::forward<Args>(args)...);
     ++_impl.end;
 }
 
@@ -355,7 +355,7 @@ template <typename T, typename Alloc>
 inline
 void
 circular_buffer<T, Alloc>::pop_front() {
-    _impl.destroy(&front());
+    std::allocator_traits<Alloc>::destroy(_impl, &front());
     ++_impl.begin;
 }
 
@@ -363,7 +363,7 @@ template <typename T, typename Alloc>
 inline
 void
 circular_buffer<T, Alloc>::pop_back() {
-    _impl.destroy(&back());
+    std::allocator_traits<Alloc>::destroy(_impl, &back());
     --_impl.end;
 }
 
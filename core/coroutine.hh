@@ -0,0 +1,183 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#pragma once
+
+/// \file
+///
+/// C++20 coroutine support for \ref future.
+///
+/// Including this header makes \c future<T...> usable as a coroutine
+/// return type, and makes futures awaitable:
+///
+/// \code
+///     future<int> read_and_sum(input_stream<char>& in) {
+///         int sum = 0;
+///         for (;;) {
+///             auto buf = co_await in.read();
+///             if (buf.empty()) {
+///                 co_return sum;
+///             }
+///             sum += std::accumulate(buf.begin(), buf.end(), 0);
+///         }
+///     }
+/// \endcode
+///
+/// Awaiting a future that is already available resumes the coroutine
+/// immediately, without scheduling a task; only a future that is not yet
+/// available costs a continuation.  The coroutine frame is allocated with
+/// \c operator new, and so comes from the seastar allocator.  An exception
+/// escaping the coroutine fails the returned future.
+///
+/// Requires a compiler in C++20 mode with coroutines enabled (configure
+/// with \c --enable-coroutines).
+
+#include "future.hh"
+
+#if !defined(__cpp_impl_coroutine) && !defined(__cpp_coroutines)
+#error "core/coroutine.hh requires C++20 coroutines; configure with --enable-coroutines"
+#endif
+
+#include <coroutine>
+
+namespace seastar {
+
+namespace internal {
+
+template <typename... T>
+class coroutine_promise_base {
+protected:
+    promise<T...> _promise;
+public:
+    future<T...> get_return_object() noexcept {
+        return _promise.get_future();
+    }
+    std::suspend_never initial_suspend() noexcept {
+        return {};
+    }
+    // The frame is destroyed as soon as the coroutine finishes; the
+    // promise hands its state over to the future when it is destroyed.
+    std::suspend_never final_suspend() noexcept {
+        return {};
+    }
+    void unhandled_exception() noexcept {
+        _promise.set_exception(std::current_exception());
+    }
+};
+
+template <typename... T>
+class coroutine_promise : public coroutine_promise_base<T...> {
+public:
+    void return_value(std::tuple<T...>&& value) noexcept {
+        this->_promise.set_value(std::move(value));
+    }
+};
+
+template <typename T>
+class coroutine_promise<T> : public coroutine_promise_base<T> {
+public:
+    template <typename U>
+    void return_value(U&& value) {
+        this->_promise.set_value(std::forward<U>(value));
+    }
+};
+
+template <>
+class coroutine_promise<> : public coroutine_promise_base<> {
+public:
+    void return_void() noexcept {
+        this->_promise.set_value();
+    }
+};
+
+template <typename... T>
+class future_awaiter_base {
+protected:
+    future<T...> _future;
+public:
+    explicit future_awaiter_base(future<T...>&& f) noexcept : _future(std::move(f)) {}
+    future_awaiter_base(const future_awaiter_base&) = delete;
+    future_awaiter_base(future_awaiter_base&&) = delete;
+
+    bool await_ready() noexcept {
+        return _future.available();
+    }
+
+    template <typename U>
+    void await_suspend(std::coroutine_handle<U> h) {
+        // Same as future::wait(), with the coroutine taking the place of
+        // the thread: the continuation stores the result back into our
+        // future and resumes the coroutine, which picks it up in
+        // await_resume().
+        _future.schedule([this, h] (future_state<T...>&& state) mutable {
+            *_future.state() = std::move(state);
+            h.resume();
+        });
+    }
+};
+
+template <typename... T>
+class future_awaiter : public future_awaiter_base<T...> {
+public:
+    using future_awaiter_base<T...>::future_awaiter_base;
+    std::tuple<T...> await_resume() {
+        return this->_future.get();
+    }
+};
+
+template <typename T>
+class future_awaiter<T> : public future_awaiter_base<T> {
+public:
+    using future_awaiter_base<T>::future_awaiter_base;
+    T await_resume() {
+        return this->_future.get0();
+    }
+};
+
+template <>
+class future_awaiter<> : public future_awaiter_base<> {
+public:
+    using future_awaiter_base<>::future_awaiter_base;
+    void await_resume() {
+        this->_future.get();
+    }
+};
+
+}
+
+}
+
+template <typename... T>
+inline
+seastar::internal::future_awaiter<T...>
+operator co_await(future<T...> f) noexcept {
+    return seastar::internal::future_awaiter<T...>(std::move(f));
+}
+
+namespace std {
+
+template <typename... T, typename... Args>
+struct coroutine_traits<future<T...>, Args...> {
+    using promise_type = seastar::internal::coroutine_promise<T...>;
+};
+
+}
@@ -0,0 +1,172 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#include "crc32c.hh"
+#include <array>
+#include <cstring>
+#include <cpuid.h>
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+
+namespace crc32c_impl {
+
+// CRC32C polynomial, bit-reflected
+static constexpr uint32_t poly = 0x82f63b78;
+
+static std::array<uint32_t, 256> make_table() {
+    std::array<uint32_t, 256> table;
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int j = 0; j < 8; ++j) {
+            c = c & 1 ? (c >> 1) ^ poly : c >> 1;
+        }
+        table[i] = c;
+    }
+    return table;
+}
+
+// Multiplies two polynomials modulo the CRC polynomial, in the bit-reflected
+// representation used by the crc register (bit 31 is x^0).
+static uint32_t multiply_mod_poly(uint32_t a, uint32_t b) {
+    uint32_t m = uint32_t(1) << 31;
+    uint32_t p = 0;
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if (!(a & (m - 1))) {
+                break;
+            }
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ poly : b >> 1;
+    }
+    return p;
+}
+
+// x^n modulo the CRC polynomial
+static uint32_t x_pow_mod_poly(uint64_t n) {
+    uint32_t result = uint32_t(1) << 31;
+    uint32_t x_2k = uint32_t(1) << 30;
+    for (; n; n >>= 1) {
+        if (n & 1) {
+            result = multiply_mod_poly(result, x_2k);
+        }
+        x_2k = multiply_mod_poly(x_2k, x_2k);
+    }
+    return result;
+}
+
+static bool cpu_has(unsigned ecx_bit) {
+    unsigned eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & ecx_bit);
+}
+
+bool has_sse42() {
+    static const bool ret = cpu_has(bit_SSE4_2);
+    return ret;
+}
+
+bool has_pclmul() {
+    static const bool ret = cpu_has(bit_PCLMUL);
+    return ret;
+}
+
+static inline uint64_t load64(const char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint32_t update_table(uint32_t crc, const char* data, size_t size) {
+    static const std::array<uint32_t, 256> table = make_table();
+    auto p = reinterpret_cast<const uint8_t*>(data);
+    while (size--) {
+        crc = table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+__attribute__((target("sse4.2")))
+uint32_t update_sse42(uint32_t crc, const char* data, size_t size) {
+    uint64_t c = crc;
+    for (; size >= 8; size -= 8, data += 8) {
+        c = _mm_crc32_u64(c, load64(data));
+    }
+    crc = c;
+    for (; size; --size) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return crc;
+}
+
+// The crc32 instruction has a latency of 3 cycles but can start every
+// cycle, so we feed it three independent streams of stream_size bytes each.
+// The stream crcs are then combined: crc(A|B|C) is
+// crc(A) * x^(8 * 2 * stream_size) + crc(B) * x^(8 * stream_size) + crc(C).
+static constexpr size_t stream_size = 1024;
+
+// Multiplying a 32-bit crc by a constant k with pclmul and reducing the
+// 64-bit product with crc32 yields crc * k * x^33, so shifting by n bits
+// requires k = x^(n - 33).
+struct shift_constants {
+    uint32_t one_stream = x_pow_mod_poly(8 * stream_size - 33);
+    uint32_t two_streams = x_pow_mod_poly(8 * 2 * stream_size - 33);
+};
+
+__attribute__((target("sse4.2,pclmul")))
+static inline uint32_t shift(uint64_t crc, uint32_t k) {
+    auto product = _mm_clmulepi64_si128(_mm_cvtsi32_si128(crc), _mm_cvtsi32_si128(k), 0);
+    return _mm_crc32_u64(0, _mm_cvtsi128_si64(product));
+}
+
+__attribute__((target("sse4.2,pclmul")))
+uint32_t update_sse42_pclmul(uint32_t crc, const char* data, size_t size) {
+    static const shift_constants shift_by;
+    for (; size >= 3 * stream_size; size -= 3 * stream_size, data += 3 * stream_size) {
+        uint64_t c0 = crc, c1 = 0, c2 = 0;
+        for (size_t i = 0; i < stream_size; i += 8) {
+            c0 = _mm_crc32_u64(c0, load64(data + i));
+            c1 = _mm_crc32_u64(c1, load64(data + stream_size + i));
+            c2 = _mm_crc32_u64(c2, load64(data + 2 * stream_size + i));
+        }
+        crc = shift(c0, shift_by.two_streams) ^ shift(c1, shift_by.one_stream) ^ uint32_t(c2);
+    }
+    return update_sse42(crc, data, size);
+}
+
+}
+
+using update_fn = uint32_t (*)(uint32_t crc, const char* data, size_t size);
+
+static update_fn pick_update() {
+    using namespace crc32c_impl;
+    if (has_sse42() && has_pclmul()) {
+        return update_sse42_pclmul;
+    } else if (has_sse42()) {
+        return update_sse42;
+    }
+    return update_table;
+}
+
+void crc32c::process(const char* data, size_t size) {
+    static const update_fn update = pick_update();
+    _crc = update(_crc, data, size);
+}
@@ -0,0 +1,67 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#pragma once
+
+// CRC32C (Castagnoli) checksum
+//
+// Uses the SSE 4.2 crc32 instruction when the processor has it.  Large
+// buffers are split into three interleaved streams to hide the latency of
+// the instruction, and the partial results are combined with carry-less
+// multiplication (PCLMULQDQ).  Processors without SSE 4.2 fall back to a
+// table-driven implementation.  The choice is made at run time, so no
+// special compiler flags are needed.
+
+#include <cstdint>
+#include <cstddef>
+
+/// Incrementally computes the CRC32C of a sequence of buffers.
+class crc32c {
+    uint32_t _crc = 0xffffffff;
+public:
+    /// Adds \c size bytes at \c data to the checksum.
+    void process(const char* data, size_t size);
+    /// Returns the checksum of everything processed so far.
+    uint32_t get() const { return ~_crc; }
+};
+
+/// Computes the CRC32C of a single buffer.
+inline uint32_t crc32c_of(const char* data, size_t size) {
+    crc32c c;
+    c.process(data, size);
+    return c.get();
+}
+
+/// \cond internal
+// The individual implementations, exposed for tests and benchmarks.  They
+// operate on the raw (not inverted) crc register.
+namespace crc32c_impl {
+
+bool has_sse42();
+bool has_pclmul();
+uint32_t update_table(uint32_t crc, const char* data, size_t size);
+// require has_sse42()
+uint32_t update_sse42(uint32_t crc, const char* data, size_t size);
+// require has_sse42() && has_pclmul()
+uint32_t update_sse42_pclmul(uint32_t crc, const char* data, size_t size);
+
+}
+/// \endcond
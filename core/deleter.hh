@@ -218,7 +218,10 @@ void deleter::append(deleter d) {
             next_d->_impl = next_impl = new free_deleter_impl(to_raw_object(next_impl));
         }
         if (next_impl->refs != 1) {
-            next_d->_impl = next_impl = make_object_deleter_impl(std::move(next_impl->next), deleter(next_impl));
+            // Others hold the rest of the chain and still need all of it:
+            // keep it whole, behind a link of our own
+            next_d->_impl = make_object_deleter_impl(deleter(next_impl), std::move(d));
+            return;
         }
         next_d = &next_impl->next;
         next_impl = next_d->_impl;
@@ -23,11 +23,13 @@
 #define FILE_HH_
 
 #include "stream.hh"
+#include "async_sequence.hh"
 #include "sstring.hh"
 #include "core/shared_ptr.hh"
 #include "core/align.hh"
 #include "core/future-util.hh"
 #include <experimental/optional>
+#include <chrono>
 #include <system_error>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
@@ -51,6 +53,31 @@ enum class directory_entry_type {
     socket,
 };
 
+/// Metadata of a file, as returned by \ref stat_files().
+struct file_metadata {
+    /// Type of the file.
+    directory_entry_type type;
+    /// Permission bits (the lower 12 bits of \c st_mode).
+    mode_t permissions;
+    uint64_t inode;
+    uint32_t nlink;
+    uid_t uid;
+    gid_t gid;
+    /// Size of the file, in bytes.
+    uint64_t size;
+    /// Number of 512-byte blocks allocated to the file.
+    uint64_t blocks;
+    /// Preferred I/O block size.
+    uint32_t block_size;
+    std::chrono::system_clock::time_point modification_time;
+    /// Required memory alignment for O_DIRECT I/O on this file, or 0 if the
+    /// kernel or filesystem does not report it.
+    uint32_t dio_mem_align = 0;
+    /// Required file offset (and length) alignment for O_DIRECT I/O on this
+    /// file, or 0 if the kernel or filesystem does not report it.
+    uint32_t dio_offset_align = 0;
+};
+
 /// Enumeration describing the type of a particular filesystem
 enum class fs_type {
     other,
@@ -101,6 +128,7 @@ class file_impl {
     virtual future<uint64_t> size(void) = 0;
     virtual future<> close() = 0;
     virtual subscription<directory_entry> list_directory(std::function<future<> (directory_entry de)> next) = 0;
+    virtual subscription<std::vector<directory_entry>> list_directory_batched(std::function<future<> (std::vector<directory_entry> batch)> next) = 0;
 
     friend class reactor;
 };
@@ -122,8 +150,10 @@ class posix_file_impl : public file_impl {
     future<size_t> size(void);
     virtual future<> close() override;
     virtual subscription<directory_entry> list_directory(std::function<future<> (directory_entry de)> next) override;
+    virtual subscription<std::vector<directory_entry>> list_directory_batched(std::function<future<> (std::vector<directory_entry> batch)> next) override;
 private:
     void query_dma_alignment();
+    future<> read_directory(std::function<future<> (std::vector<directory_entry>)> consume);
 };
 
 class blockdev_file_impl : public posix_file_impl {
@@ -379,6 +409,28 @@ class file {
         return _file_impl->list_directory(std::move(next));
     }
 
+    /// Returns a directory listing, given that this file object is a directory,
+    /// delivering entries in batches.
+    ///
+    /// Each batch holds the entries returned by a single large \c getdents64()
+    /// call, so listing a big directory costs one continuation per batch rather
+    /// than one per entry.  Entry types are taken from the directory itself
+    /// where the filesystem provides them, without a \c stat() per entry.
+    subscription<std::vector<directory_entry>> list_directory_batched(std::function<future<> (std::vector<directory_entry> batch)> next) {
+        return _file_impl->list_directory_batched(std::move(next));
+    }
+
+    /// Returns a directory listing, given that this file object is a directory,
+    /// as a pull-based sequence.
+    ///
+    /// Entries are read ahead of the consumer in \ref list_directory_batched()
+    /// batches, pausing once \c max_buffered entries are waiting.
+    seastar::async_sequence<directory_entry> list_directory_sequence(size_t max_buffered = 4096) {
+        return seastar::make_async_sequence_from_batched_subscription<directory_entry>(max_buffered, [this] (auto next) {
+            return this->list_directory_batched(std::move(next));
+        });
+    }
+
     /**
      * Read a data bulk containing the provided addresses range that starts at
      * the given offset and ends at either the address aligned to
@@ -0,0 +1,346 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#ifndef FLAT_HASH_MAP_HH_
+#define FLAT_HASH_MAP_HH_
+
+// An open addressing hash map, for lookup heavy tables such as the one
+// finding the connection a received packet belongs to.
+//
+// Entries are stored in a single array, in groups of 16 slots.  Every slot
+// has a control byte, kept in an array of its own: empty, erased, or seven
+// bits of the hash of the key in the slot.  A lookup compares the control
+// bytes of a whole group with those bits in a couple of SSE2 instructions
+// and only compares keys where they match, so it usually touches one cache
+// line of control bytes and a single entry.  Groups are probed
+// quadratically, and the table grows once it is 7/8 full.
+//
+// Unlike with std::unordered_map, inserting may move entries, which
+// invalidates iterators and references to them; erasing invalidates only
+// those to the erased entry.
+
+#include "prefetch.hh"
+#include <emmintrin.h>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+class flat_hash_map : private Hash, private KeyEqual {
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+    using size_type = size_t;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+private:
+    static constexpr size_t group_size = 16;
+    // Control bytes of slots not in use have the sign bit set
+    static constexpr int8_t ctrl_empty = -128;
+    static constexpr int8_t ctrl_erased = -2;
+    struct slot {
+        typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type storage;
+        value_type& value() { return *reinterpret_cast<value_type*>(&storage); }
+    };
+    struct alignas(group_size) group {
+        int8_t ctrl[group_size];
+    };
+    std::unique_ptr<group[]> _groups;
+    std::unique_ptr<slot[]> _slots;
+    size_t _nr_groups = 0;
+    size_t _size = 0;
+    // Empty slots we may still use before growing
+    size_t _growth_left = 0;
+public:
+    template <typename Map, typename Value>
+    class iterator_type {
+        Map* _map;
+        size_t _idx;
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Value;
+        using difference_type = ptrdiff_t;
+        using pointer = Value*;
+        using reference = Value&;
+        iterator_type(Map* map, size_t idx) : _map(map), _idx(idx) {}
+        template <typename OtherMap, typename OtherValue>
+        iterator_type(const iterator_type<OtherMap, OtherValue>& x) : _map(x._map), _idx(x._idx) {}
+        reference operator*() const { return _map->_slots[_idx].value(); }
+        pointer operator->() const { return &_map->_slots[_idx].value(); }
+        iterator_type& operator++() {
+            _idx = _map->next_used(_idx + 1);
+            return *this;
+        }
+        iterator_type operator++(int) {
+            auto old = *this;
+            ++*this;
+            return old;
+        }
+        bool operator==(const iterator_type& x) const { return _idx == x._idx; }
+        bool operator!=(const iterator_type& x) const { return _idx != x._idx; }
+        template <typename OtherMap, typename OtherValue>
+        friend class iterator_type;
+        friend class flat_hash_map;
+    };
+    using iterator = iterator_type<flat_hash_map, value_type>;
+    using const_iterator = iterator_type<const flat_hash_map, const value_type>;
+public:
+    flat_hash_map() = default;
+    flat_hash_map(flat_hash_map&& x) noexcept
+        : Hash(std::move(x)), KeyEqual(std::move(x))
+        , _groups(std::move(x._groups)), _slots(std::move(x._slots))
+        , _nr_groups(x._nr_groups), _size(x._size), _growth_left(x._growth_left) {
+        x._nr_groups = x._size = x._growth_left = 0;
+    }
+    flat_hash_map& operator=(flat_hash_map&& x) noexcept {
+        if (this != &x) {
+            this->~flat_hash_map();
+            new (this) flat_hash_map(std::move(x));
+        }
+        return *this;
+    }
+    ~flat_hash_map() {
+        clear();
+    }
+
+    size_t size() const { return _size; }
+    bool empty() const { return !_size; }
+    size_t capacity() const { return _nr_groups * group_size; }
+
+    iterator begin() { return { this, next_used(0) }; }
+    iterator end() { return { this, capacity() }; }
+    const_iterator begin() const { return { this, next_used(0) }; }
+    const_iterator end() const { return { this, capacity() }; }
+
+    iterator find(const Key& key) {
+        return { this, find_index(key) };
+    }
+    const_iterator find(const Key& key) const {
+        return { this, find_index(key) };
+    }
+    size_t count(const Key& key) const {
+        return find_index(key) != capacity();
+    }
+
+    // Constructs the value in place from args, unless key is present
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(const Key& key, Args&&... args) {
+        auto idx = find_index(key);
+        if (idx != capacity()) {
+            return { iterator(this, idx), false };
+        }
+        if (!_growth_left) {
+            grow();
+        }
+        auto h = hash(key);
+        idx = find_free(h);
+        if (ctrl(idx) == ctrl_empty) {
+            --_growth_left;
+        }
+        new (&_slots[idx].storage) value_type(std::piecewise_construct,
+                std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+        ctrl(idx) = tag(h);
+        ++_size;
+        return { iterator(this, idx), true };
+    }
+    std::pair<iterator, bool> insert(const value_type& v) {
+        return emplace(v.first, v.second);
+    }
+    std::pair<iterator, bool> insert(value_type&& v) {
+        return emplace(v.first, std::move(v.second));
+    }
+    T& operator[](const Key& key) {
+        return emplace(key).first->second;
+    }
+
+    void erase(iterator i) {
+        auto idx = i._idx;
+        _slots[idx].value().~value_type();
+        --_size;
+        // No probe went past a group that has never been full, so a slot
+        // there can go back to empty; elsewhere a lookup must know to
+        // carry on past it.
+        auto g = load(idx / group_size);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(ctrl_empty)))) {
+            ctrl(idx) = ctrl_empty;
+            ++_growth_left;
+        } else {
+            ctrl(idx) = ctrl_erased;
+        }
+    }
+    size_t erase(const Key& key) {
+        auto i = find(key);
+        if (i == end()) {
+            return 0;
+        }
+        erase(i);
+        return 1;
+    }
+    void clear() {
+        for (size_t idx = next_used(0); idx != capacity(); idx = next_used(idx + 1)) {
+            _slots[idx].value().~value_type();
+        }
+        for (size_t g = 0; g < _nr_groups; ++g) {
+            std::fill_n(_groups[g].ctrl, group_size, ctrl_empty);
+        }
+        _size = 0;
+        _growth_left = max_load(_nr_groups);
+    }
+    // Makes room for n entries without growing
+    void reserve(size_t n) {
+        size_t groups = std::max<size_t>(_nr_groups, 1);
+        while (max_load(groups) < n) {
+            groups *= 2;
+        }
+        if (groups != _nr_groups) {
+            rehash(groups);
+        }
+    }
+
+    // Brings the control bytes the lookup of key would look at first into
+    // the cache, for a lookup of it shortly
+    void prefetch(const Key& key) const {
+        if (_nr_groups) {
+            ::prefetch<1>(const_cast<group*>(&_groups[hash(key) & (_nr_groups - 1)]));
+        }
+    }
+private:
+    size_t hash(const Key& key) const {
+        // Mixed, as std::hash of integers is the identity, and we take
+        // bits from both ends
+        uint64_t h = Hash::operator()(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+    static int8_t tag(size_t h) {
+        return h >> 57;
+    }
+    static size_t max_load(size_t groups) {
+        return groups * group_size / 8 * 7;
+    }
+    int8_t& ctrl(size_t idx) {
+        return _groups[idx / group_size].ctrl[idx % group_size];
+    }
+    __m128i load(size_t g) const {
+        return _mm_load_si128(reinterpret_cast<const __m128i*>(&_groups[g]));
+    }
+    // Calls func with each group index in the probe sequence of h until it
+    // returns true.  Visits every group, as the group count is a power of
+    // two.
+    template <typename Func>
+    void probe(size_t h, Func&& func) const {
+        auto mask = _nr_groups - 1;
+        auto g = h & mask;
+        for (size_t step = 1; !func(g); ++step) {
+            g = (g + step) & mask;
+        }
+    }
+    size_t find_index(const Key& key) const {
+        if (!_size) {
+            return capacity();
+        }
+        auto h = hash(key);
+        auto t = _mm_set1_epi8(tag(h));
+        auto e = _mm_set1_epi8(ctrl_empty);
+        size_t ret = capacity();
+        probe(h, [&] (size_t g) {
+            auto ctrl = load(g);
+            unsigned match = _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, t));
+            while (match) {
+                auto idx = g * group_size + __builtin_ctz(match);
+                if (KeyEqual::operator()(_slots[idx].value().first, key)) {
+                    ret = idx;
+                    return true;
+                }
+                match &= match - 1;
+            }
+            // The key would have been placed here, or before
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, e)) != 0;
+        });
+        return ret;
+    }
+    // First empty or erased slot in the probe sequence of h
+    size_t find_free(size_t h) const {
+        size_t ret = 0;
+        probe(h, [&] (size_t g) {
+            unsigned free = _mm_movemask_epi8(load(g));
+            if (free) {
+                ret = g * group_size + __builtin_ctz(free);
+            }
+            return free != 0;
+        });
+        return ret;
+    }
+    size_t next_used(size_t idx) const {
+        auto cap = capacity();
+        for (; idx < cap; ++idx) {
+            if (_groups[idx / group_size].ctrl[idx % group_size] >= 0) {
+                break;
+            }
+        }
+        return std::min(idx, cap);
+    }
+    // Out of empty slots: double the table, or, if many of the slots in
+    // use are erased ones, rebuild it at the same size without them
+    void grow() {
+        if (!_nr_groups) {
+            rehash(1);
+        } else if (_size >= max_load(_nr_groups) / 2) {
+            rehash(_nr_groups * 2);
+        } else {
+            rehash(_nr_groups);
+        }
+    }
+    void rehash(size_t groups) {
+        auto old_groups = std::move(_groups);
+        auto old_slots = std::move(_slots);
+        auto old_nr_groups = _nr_groups;
+        _groups.reset(new group[groups]);
+        _slots.reset(new slot[groups * group_size]);
+        _nr_groups = groups;
+        for (size_t g = 0; g < groups; ++g) {
+            std::fill_n(_groups[g].ctrl, group_size, ctrl_empty);
+        }
+        _growth_left = max_load(groups) - _size;
+        for (size_t idx = 0; idx < old_nr_groups * group_size; ++idx) {
+            if (old_groups[idx / group_size].ctrl[idx % group_size] < 0) {
+                continue;
+            }
+            auto& v = old_slots[idx].value();
+            auto h = hash(v.first);
+            auto new_idx = find_free(h);
+            new (&_slots[new_idx].storage) value_type(std::move(v));
+            ctrl(new_idx) = tag(h);
+            v.~value_type();
+        }
+    }
+};
+
+#endif
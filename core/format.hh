@@ -0,0 +1,430 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#pragma once
+
+// Number to text conversion used by to_sstring(), sprint() and the json
+// formatter.  Integers are converted two digits at a time from a table.
+// Floating point numbers are printed with the Grisu2 algorithm (Florian
+// Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with
+// Integers", PLDI 2010), whose output always reads back as the same value
+// and has the fewest digits that do so in all but a tiny fraction of cases,
+// where it has one more.
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace seastar {
+
+namespace internal {
+
+/// Longest output of \ref format_integer(), including the sign.
+constexpr size_t max_integer_chars = 20 + 1;
+/// Longest output of \ref format_floating(), including the sign.
+constexpr size_t max_floating_chars = 32;
+
+inline const char* digit_pairs() {
+    static const char pairs[] =
+            "00010203040506070809"
+            "10111213141516171819"
+            "20212223242526272829"
+            "30313233343536373839"
+            "40414243444546474849"
+            "50515253545556575859"
+            "60616263646566676869"
+            "70717273747576777879"
+            "80818283848586878889"
+            "90919293949596979899";
+    return pairs;
+}
+
+/// Writes the decimal digits of \c v so that they end just before \c end.
+///
+/// \return pointer to the first digit written.
+inline char* format_unsigned_backward(char* end, uint64_t v) {
+    auto pairs = digit_pairs();
+    while (v >= 100) {
+        auto i = (v % 100) * 2;
+        v /= 100;
+        end -= 2;
+        std::memcpy(end, pairs + i, 2);
+    }
+    if (v >= 10) {
+        end -= 2;
+        std::memcpy(end, pairs + v * 2, 2);
+    } else {
+        *--end = char('0' + v);
+    }
+    return end;
+}
+
+template <typename T>
+inline
+std::enable_if_t<std::is_unsigned<T>::value, char*>
+format_integer_backward(char* end, T v) {
+    return format_unsigned_backward(end, v);
+}
+
+template <typename T>
+inline
+std::enable_if_t<std::is_signed<T>::value, char*>
+format_integer_backward(char* end, T v) {
+    if (v >= 0) {
+        return format_unsigned_backward(end, uint64_t(v));
+    }
+    auto p = format_unsigned_backward(end, uint64_t(0) - uint64_t(v));
+    *--p = '-';
+    return p;
+}
+
+/// Writes the decimal representation of an integer, which takes at most
+/// \ref max_integer_chars characters, to \c p.
+///
+/// \return pointer past the last character written.
+template <typename T>
+inline char* format_integer(char* p, T v) {
+    char buf[max_integer_chars];
+    auto end = buf + sizeof(buf);
+    auto begin = format_integer_backward(end, v);
+    std::memcpy(p, begin, end - begin);
+    return p + (end - begin);
+}
+
+namespace grisu {
+
+// f * 2^e, not normalized unless noted.
+struct diy_fp {
+    uint64_t f;
+    int e;
+
+    static diy_fp sub(diy_fp x, diy_fp y) {
+        return { x.f - y.f, x.e };
+    }
+    // x * y / 2^64, rounded
+    static diy_fp mul(diy_fp x, diy_fp y) {
+        auto p = static_cast<unsigned __int128>(x.f) * y.f;
+        auto h = uint64_t(p >> 64);
+        auto l = uint64_t(p);
+        return { h + (l >> 63), x.e + y.e + 64 };
+    }
+    static diy_fp normalize(diy_fp x) {
+        auto shift = __builtin_clzll(x.f);
+        return { x.f << shift, x.e - shift };
+    }
+    static diy_fp normalize_to(diy_fp x, int e) {
+        return { x.f << (x.e - e), e };
+    }
+};
+
+// The value and the midpoints to its neighbours, all normalized to the
+// same exponent.  Any number strictly between minus and plus reads back
+// as the value.
+struct boundaries {
+    diy_fp w;
+    diy_fp minus;
+    diy_fp plus;
+};
+
+// value must be finite and positive.
+template <typename F>
+inline boundaries compute_boundaries(F value) {
+    constexpr int precision = std::numeric_limits<F>::digits;
+    constexpr int bias = std::numeric_limits<F>::max_exponent - 1 + (precision - 1);
+    constexpr int min_exp = 1 - bias;
+    constexpr uint64_t hidden_bit = uint64_t(1) << (precision - 1);
+    using bits_type = std::conditional_t<precision == 24, uint32_t, uint64_t>;
+    static_assert(sizeof(bits_type) == sizeof(F), "unsupported floating point type");
+
+    bits_type bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto biased_e = uint64_t(bits >> (precision - 1));
+    auto fraction = uint64_t(bits) & (hidden_bit - 1);
+
+    auto v = biased_e == 0
+            ? diy_fp{ fraction, min_exp }
+            : diy_fp{ fraction + hidden_bit, int(biased_e) - bias };
+    // The gap to the next smaller value is half as wide when the value is
+    // a power of two, as the exponent decreases below it.
+    bool lower_boundary_is_closer = fraction == 0 && biased_e > 1;
+    auto m_plus = diy_fp{ 2 * v.f + 1, v.e - 1 };
+    auto m_minus = lower_boundary_is_closer
+            ? diy_fp{ 4 * v.f - 1, v.e - 2 }
+            : diy_fp{ 2 * v.f - 1, v.e - 1 };
+    auto w_plus = diy_fp::normalize(m_plus);
+    auto w_minus = diy_fp::normalize_to(m_minus, w_plus.e);
+    return { diy_fp::normalize(v), w_minus, w_plus };
+}
+
+// 10^k ~= f * 2^e, f normalized.
+struct cached_power {
+    uint64_t f;
+    int e;
+    int k;
+};
+
+// The digit generation loop needs the scaled value's binary exponent
+// within [-60, -32], so its integral part fits in 32 bits.
+constexpr int min_target_exp = -60;
+constexpr int cached_powers_min_dec_exp = -300;
+constexpr int cached_powers_dec_step = 8;
+constexpr int nr_cached_powers = 79;
+
+// Rounds 10^k to 64 significant bits.  Only used to fill the table, so it
+// favours simplicity: a little-endian big integer holds 10^k, or 2^s / 10^-k
+// for negative k, computed by repeated multiplication or division by ten.
+inline cached_power compute_cached_power(int k) {
+    std::vector<uint32_t> n;
+    int s = 0;
+    if (k >= 0) {
+        n.push_back(1);
+        for (int i = 0; i < k; ++i) {
+            uint64_t carry = 0;
+            for (auto& w : n) {
+                auto x = uint64_t(w) * 10 + carry;
+                w = uint32_t(x);
+                carry = x >> 32;
+            }
+            if (carry) {
+                n.push_back(uint32_t(carry));
+            }
+        }
+    } else {
+        // leave about 128 significant bits in the quotient
+        s = 128 + (-k * 3322 + 999) / 1000;
+        n.assign(s / 32 + 1, 0);
+        n[s / 32] = uint32_t(1) << (s % 32);
+        for (int i = 0; i < -k; ++i) {
+            uint64_t rem = 0;
+            for (auto w = n.rbegin(); w != n.rend(); ++w) {
+                auto x = (rem << 32) | *w;
+                *w = uint32_t(x / 10);
+                rem = x % 10;
+            }
+        }
+    }
+    while (n.back() == 0) {
+        n.pop_back();
+    }
+    int bits = int(n.size()) * 32 - __builtin_clz(n.back());
+    auto bit = [&] (int i) -> uint64_t {
+        return i < 0 ? 0 : (n[i / 32] >> (i % 32)) & 1;
+    };
+    uint64_t f = 0;
+    for (int i = bits - 1; i >= bits - 64; --i) {
+        f = (f << 1) | bit(i);
+    }
+    int e = bits - 64 - s;
+    if (bit(bits - 65)) {
+        if (++f == 0) {
+            f = uint64_t(1) << 63;
+            ++e;
+        }
+    }
+    return { f, e, k };
+}
+
+inline const cached_power* cached_powers() {
+    static const auto table = [] {
+        std::array<cached_power, nr_cached_powers> t;
+        for (int i = 0; i < nr_cached_powers; ++i) {
+            t[i] = compute_cached_power(cached_powers_min_dec_exp + i * cached_powers_dec_step);
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+// Returns a power of ten c such that multiplying a number with binary
+// exponent e by it gives an exponent in [-60, -32].
+inline cached_power get_cached_power_for_binary_exponent(int e) {
+    int f = min_target_exp - e - 1;
+    // ceil(f * log10(2))
+    int k = (f * 78913) / (1 << 18) + int(f > 0);
+    int index = (-cached_powers_min_dec_exp + k + (cached_powers_dec_step - 1)) / cached_powers_dec_step;
+    return cached_powers()[index];
+}
+
+inline int find_largest_pow10(uint32_t n, uint32_t& pow10) {
+    static const uint32_t powers[] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+    };
+    int digits = 10;
+    while (digits > 1 && n < powers[digits - 1]) {
+        --digits;
+    }
+    pow10 = powers[digits - 1];
+    return digits;
+}
+
+// Moves the last digit towards w while staying within the boundaries.
+inline void round_weed(char* buf, int len, uint64_t dist, uint64_t delta, uint64_t rest, uint64_t ten_k) {
+    while (rest < dist
+            && delta - rest >= ten_k
+            && (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+        buf[len - 1]--;
+        rest += ten_k;
+    }
+}
+
+// Generates the shortest digits of a number in (m_minus, m_plus), as close
+// to w as possible.  All three share the exponent, which is in
+// [-60, -32].
+inline void digit_gen(char* buf, int& len, int& decimal_exponent, diy_fp m_minus, diy_fp w, diy_fp m_plus) {
+    auto delta = diy_fp::sub(m_plus, m_minus).f;
+    auto dist = diy_fp::sub(m_plus, w).f;
+    auto one = diy_fp{ uint64_t(1) << -m_plus.e, m_plus.e };
+
+    auto p1 = uint32_t(m_plus.f >> -one.e);
+    auto p2 = m_plus.f & (one.f - 1);
+
+    uint32_t pow10;
+    int n = find_largest_pow10(p1, pow10);
+    while (n > 0) {
+        auto d = p1 / pow10;
+        p1 %= pow10;
+        buf[len++] = char('0' + d);
+        --n;
+        auto rest = (uint64_t(p1) << -one.e) + p2;
+        if (rest <= delta) {
+            decimal_exponent += n;
+            round_weed(buf, len, dist, delta, rest, uint64_t(pow10) << -one.e);
+            return;
+        }
+        pow10 /= 10;
+    }
+    int m = 0;
+    while (true) {
+        p2 *= 10;
+        auto d = p2 >> -one.e;
+        p2 &= one.f - 1;
+        buf[len++] = char('0' + d);
+        ++m;
+        delta *= 10;
+        dist *= 10;
+        if (p2 <= delta) {
+            break;
+        }
+    }
+    decimal_exponent -= m;
+    round_weed(buf, len, dist, delta, p2, one.f);
+}
+
+// Finds digits d and an exponent x such that d * 10^x reads back as value,
+// with as few digits as possible.  value must be finite and positive.
+template <typename F>
+inline void grisu2(char* buf, int& len, int& decimal_exponent, F value) {
+    auto b = compute_boundaries(value);
+    auto cached = get_cached_power_for_binary_exponent(b.plus.e);
+    auto c = diy_fp{ cached.f, cached.e };
+    auto w = diy_fp::mul(b.w, c);
+    auto w_minus = diy_fp::mul(b.minus, c);
+    auto w_plus = diy_fp::mul(b.plus, c);
+    // mul() is off by up to half a unit; shrink the interval to stay safe
+    auto m_minus = diy_fp{ w_minus.f + 1, w_minus.e };
+    auto m_plus = diy_fp{ w_plus.f - 1, w_plus.e };
+    len = 0;
+    decimal_exponent = -cached.k;
+    digit_gen(buf, len, decimal_exponent, m_minus, w, m_plus);
+}
+
+inline char* append_exponent(char* p, int e) {
+    *p++ = e < 0 ? '-' : '+';
+    if (e > -10 && e < 10) {
+        *p++ = '0';
+    }
+    return format_integer(p, uint32_t(e < 0 ? -e : e));
+}
+
+}
+
+/// Writes a short decimal representation of \c value that reads back as
+/// the same value to \c p; at most \ref max_floating_chars characters.
+/// See the top of this file for how short.
+///
+/// The layout follows printf's \c %g: fixed notation, without trailing
+/// zeros or decimal point, unless the decimal exponent is below -4 or not
+/// below \c max_digits10, in which case scientific notation is used.
+///
+/// \return pointer past the last character written.
+template <typename F>
+inline char* format_floating(char* p, F value) {
+    static_assert(std::is_same<F, float>::value || std::is_same<F, double>::value,
+            "only float and double are supported");
+    if (std::signbit(value)) {
+        *p++ = '-';
+        value = -value;
+    }
+    if (std::isnan(value)) {
+        std::memcpy(p, "nan", 3);
+        return p + 3;
+    }
+    if (std::isinf(value)) {
+        std::memcpy(p, "inf", 3);
+        return p + 3;
+    }
+    if (value == 0) {
+        *p++ = '0';
+        return p;
+    }
+    char digits[32];
+    int len, decimal_exponent;
+    grisu::grisu2(digits, len, decimal_exponent, value);
+    // value is 0.digits * 10^point
+    int point = len + decimal_exponent;
+    if (point - 1 < -4 || point - 1 >= std::numeric_limits<F>::max_digits10) {
+        *p++ = digits[0];
+        if (len > 1) {
+            *p++ = '.';
+            std::memcpy(p, digits + 1, len - 1);
+            p += len - 1;
+        }
+        *p++ = 'e';
+        return grisu::append_exponent(p, point - 1);
+    }
+    if (point <= 0) {
+        *p++ = '0';
+        *p++ = '.';
+        std::memset(p, '0', -point);
+        p += -point;
+        std::memcpy(p, digits, len);
+        return p + len;
+    }
+    if (point >= len) {
+        std::memcpy(p, digits, len);
+        p += len;
+        std::memset(p, '0', point - len);
+        return p + (point - len);
+    }
+    std::memcpy(p, digits, point);
+    p += point;
+    *p++ = '.';
+    std::memcpy(p, digits + point, len - point);
+    return p + (len - point);
+}
+
+} // namespace internal
+
+} // namespace seastar
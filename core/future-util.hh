@@ -29,8 +29,10 @@
 #include "future.hh"
 #include "shared_ptr.hh"
 #include "do_with.hh"
+#include "timer.hh"
 #include <tuple>
 #include <iterator>
+#include <cassert>
 #include <vector>
 #include <experimental/optional>
 
@@ -133,6 +135,121 @@ parallel_for_each(Range&& range, Func&& func) {
             std::forward<Func>(func));
 }
 
+/// \cond internal
+
+template <typename Iterator, typename Func>
+class max_concurrent_for_each_state {
+    Iterator _begin;
+    Iterator _end;
+    Func _func;
+    size_t _concurrency;
+    size_t _in_flight = 0;
+    std::experimental::optional<std::exception_ptr> _ex;
+    promise<> _pr;
+public:
+    max_concurrent_for_each_state(Iterator begin, Iterator end, size_t concurrency, Func func)
+        : _begin(std::move(begin)), _end(std::move(end)), _func(std::move(func))
+        , _concurrency(concurrency) {}
+    future<> get_future() {
+        return _pr.get_future();
+    }
+    // Starts invocations until either the concurrency limit is reached, the
+    // range is exhausted, or an invocation failed.  Invocations that complete
+    // immediately do not occupy a slot, so a run of ready futures is consumed
+    // in a loop instead of through continuations.
+    void pump() {
+        while (_in_flight < _concurrency && _begin != _end && !_ex) {
+            future<> f = make_ready_future<>();
+            try {
+                f = _func(*_begin++);
+            } catch (...) {
+                _ex = std::current_exception();
+                break;
+            }
+            if (f.available()) {
+                if (f.failed()) {
+                    _ex = f.get_exception();
+                }
+                continue;
+            }
+            ++_in_flight;
+            f.then_wrapped([this] (future<> f) {
+                --_in_flight;
+                if (f.failed()) {
+                    // We can only store one exception; keep the first.
+                    auto ex = f.get_exception();
+                    if (!_ex) {
+                        _ex = std::move(ex);
+                    }
+                }
+                pump();
+            });
+        }
+        if (_in_flight == 0) {
+            if (_ex) {
+                _pr.set_exception(std::move(*_ex));
+            } else {
+                _pr.set_value();
+            }
+        }
+    }
+};
+
+/// \endcond
+
+/// Run tasks in parallel, with bounded concurrency (iterator version).
+///
+/// Like \ref parallel_for_each(), but at most \c concurrency invocations of
+/// \c func are outstanding at any time; the next element is started as soon
+/// as one of them completes.  Bookkeeping is a single allocation for the
+/// whole range, independent of its length.
+///
+/// Once an invocation fails, no further elements are started; the returned
+/// future resolves with that exception after the invocations already in
+/// flight have completed.
+///
+/// \param begin an \c InputIterator designating the beginning of the range
+/// \param end an \c InputIterator designating the end of the range
+/// \param concurrency maximum number of invocations of \c func in flight;
+///                    must be greater than zero
+/// \param func Function to apply to each element in the range (returning
+///             a \c future<>)
+/// \return a \c future<> that resolves when all started invocations
+///         complete.  If one of them failed, the return value contains
+///         the first exception.
+template <typename Iterator, typename Func>
+inline
+future<>
+max_concurrent_for_each(Iterator begin, Iterator end, size_t concurrency, Func&& func) {
+    assert(concurrency > 0);
+    if (begin == end) {
+        return make_ready_future<>();
+    }
+    using state = max_concurrent_for_each_state<Iterator, std::decay_t<Func>>;
+    return do_with(state(std::move(begin), std::move(end), concurrency, std::forward<Func>(func)), [] (state& s) {
+        auto f = s.get_future();
+        s.pump();
+        return f;
+    });
+}
+
+/// Run tasks in parallel, with bounded concurrency (range version).
+///
+/// \param range A range of objects to iterate run \c func on
+/// \param concurrency maximum number of invocations of \c func in flight
+/// \param func  A callable, accepting reference to the range's
+///              \c value_type, and returning a \c future<>.
+/// \return a \c future<> that becomes ready when the range was processed,
+///         or when the invocations in flight after the first failure have
+///         completed.
+template <typename Range, typename Func>
+inline
+future<>
+max_concurrent_for_each(Range&& range, size_t concurrency, Func&& func) {
+    return max_concurrent_for_each(std::begin(range), std::end(range), concurrency,
+            std::forward<Func>(func));
+}
+
 // The AsyncAction concept represents an action which can complete later than
 // the actual function invocation. It is represented by a function which
 // returns a future which resolves when the action is done.
@@ -557,6 +674,61 @@ map_reduce(Range&& range, Mapper&& mapper, Initial initial, Reduce reduce) {
             std::move(initial), std::move(reduce));
 }
 
+/// Asynchronous map/reduce transformation, with bounded concurrency.
+///
+/// Like the unbounded map_reduce(), but at most \c concurrency invocations
+/// of \c mapper are in flight at any time (see max_concurrent_for_each()).
+/// Results are reduced in completion order, so \c reduce should be
+/// associative and commutative.
+///
+/// \param begin beginning of object range to operate on
+/// \param end end of object range to operate on
+/// \param concurrency maximum number of invocations of \c mapper in flight
+/// \param mapper map function to call on each object, returning a future
+/// \param initial initial input value to reduce function
+/// \param reduce binary function for merging two result values from \c mapper
+///
+/// \return the reduced value, or the first exception raised by \c mapper;
+///         no further objects are mapped after a failure.
+template <typename Iterator, typename Mapper, typename Initial, typename Reduce>
+inline
+future<Initial>
+map_reduce(Iterator begin, Iterator end, size_t concurrency, Mapper&& mapper, Initial initial, Reduce reduce) {
+    struct state {
+        Initial result;
+        Reduce reduce;
+        std::decay_t<Mapper> mapper;
+    };
+    return do_with(state{std::move(initial), std::move(reduce), std::forward<Mapper>(mapper)},
+            [begin = std::move(begin), end = std::move(end), concurrency] (state& s) mutable {
+        return max_concurrent_for_each(std::move(begin), std::move(end), concurrency, [&s] (auto&& x) {
+            return s.mapper(std::forward<decltype(x)>(x)).then([&s] (auto&& value) {
+                s.result = s.reduce(std::move(s.result), std::move(value));
+            });
+        }).then([&s] {
+            return make_ready_future<Initial>(std::move(s.result));
+        });
+    });
+}
+
+/// Asynchronous map/reduce transformation, with bounded concurrency
+/// (range version).
+///
+/// \param range object range to operate on
+/// \param concurrency maximum number of invocations of \c mapper in flight
+/// \param mapper map function to call on each object, returning a future
+/// \param initial initial input value to reduce function
+/// \param reduce binary function for merging two result values from \c mapper
+///
+/// \return the reduced value, or the first exception raised by \c mapper
+template <typename Range, typename Mapper, typename Initial, typename Reduce>
+inline
+future<Initial>
+map_reduce(Range&& range, size_t concurrency, Mapper&& mapper, Initial initial, Reduce reduce) {
+    return map_reduce(std::begin(range), std::end(range), concurrency, std::forward<Mapper>(mapper),
+            std::move(initial), std::move(reduce));
+}
+
 // Implements @Reducer concept. Calculates the result by
 // adding elements to the accumulator.
 template <typename Result, typename Addend = Result>
@@ -581,6 +753,58 @@ future<> now() {
 // Returns a future which is not ready but is scheduled to resolve soon.
 future<> later();
 
+/// Exception returned by \ref with_timeout() when the deadline passes
+/// before the wrapped future resolves.
+class timed_out_error : public std::exception {
+public:
+    virtual const char* what() const noexcept override {
+        return "timedout";
+    }
+};
+
+/// \cond internal
+struct default_timeout_exception_factory {
+    static const std::exception_ptr& timeout() {
+        return cached_exception_ptr<timed_out_error>();
+    }
+};
+/// \endcond
+
+/// Waits for a future, giving up at a deadline.
+///
+/// Returns a future which resolves with the value of \c f, or fails with
+/// the exception produced by \c ExceptionFactory::timeout() (by default
+/// \ref timed_out_error) if \c f did not resolve by \c timeout.
+///
+/// The operation behind \c f is not cancelled; its eventual result is
+/// discarded.  To release the resources held by the operation itself,
+/// use the abortable variant of the wait together with a
+/// \ref seastar::abort_source.
+///
+/// \param timeout deadline, on either \c timer<>::clock or \c lowres_clock
+/// \param f future to wait for
+/// \return \c f's result, or an exceptional future on timeout
+template <typename ExceptionFactory = default_timeout_exception_factory, typename Clock, typename Duration, typename... T>
+future<T...> with_timeout(std::chrono::time_point<Clock, Duration> timeout, future<T...> f) {
+    if (f.available()) {
+        return f;
+    }
+    auto pr = std::make_unique<promise<T...>>();
+    auto result = pr->get_future();
+    timer<Clock> tmr([&pr = *pr] {
+        pr.set_exception(ExceptionFactory::timeout());
+    });
+    tmr.arm(timeout);
+    f.then_wrapped([pr = std::move(pr), tmr = std::move(tmr)] (future<T...> f) mutable {
+        if (tmr.cancel()) {
+            f.forward_to(std::move(*pr));
+        } else {
+            f.ignore_ready_future();
+        }
+    });
+    return result;
+}
+
 /// @}
 
 #endif /* CORE_FUTURE_UTIL_HH_ */
@@ -27,6 +27,7 @@
 #include <stdexcept>
 #include <memory>
 #include <type_traits>
+#include <typeinfo>
 #include <assert.h>
 
 
@@ -72,6 +73,13 @@ void switch_out(thread_context* from);
 
 }
 
+namespace internal {
+
+template <typename... T>
+class future_awaiter_base;
+
+}
+
 }
 
 
@@ -1019,6 +1027,8 @@ class future {
     friend future<U...> make_exception_future(std::exception_ptr ex) noexcept;
     template <typename... U, typename Exception>
     friend future<U...> make_exception_future(Exception&& ex) noexcept;
+    template <typename... U>
+    friend class seastar::internal::future_awaiter_base;
     /// \endcond
 };
 
@@ -1095,6 +1105,66 @@ future<T...> make_exception_future(Exception&& ex) noexcept {
     return make_exception_future<T...>(std::make_exception_ptr(std::forward<Exception>(ex)));
 }
 
+/// \brief Returns a preallocated \c std::exception_ptr holding a
+/// default-constructed \c Exception.
+///
+/// Failing a future normally allocates a fresh exception object.  For
+/// exceptions that carry no per-instance state, such as timeouts and
+/// broken pipes, one object per thread can be shared by every failure,
+/// which makes the error path allocation-free:
+/// \code
+///   pr.set_exception(cached_exception_ptr<semaphore_timed_out>());
+/// \endcode
+template <typename Exception>
+inline
+const std::exception_ptr& cached_exception_ptr() {
+    static thread_local const std::exception_ptr ex = std::make_exception_ptr(Exception());
+    return ex;
+}
+
+/// \brief Inspects an exception without rethrowing it.
+///
+/// Returns a pointer to the exception held by \c ex if it is an
+/// \c Exception (or derived from it), and \c nullptr otherwise.  Unlike
+/// \c std::rethrow_exception() within a try/catch block, this does not
+/// unwind the stack, so continuations can classify failures cheaply:
+/// \code
+///   f.then_wrapped([] (future<> f) {
+///       if (f.failed()) {
+///           auto ex = f.get_exception();
+///           if (try_catch<semaphore_timed_out>(ex)) {
+///               ...
+///           }
+///       }
+///   });
+/// \endcode
+template <typename Exception>
+inline
+Exception* try_catch(const std::exception_ptr& ex) noexcept {
+    static_assert(!std::is_pointer<Exception>::value && !std::is_reference<Exception>::value,
+                  "try_catch<> takes a class type");
+    if (!ex) {
+        return nullptr;
+    }
+#ifdef __GLIBCXX__
+    // Ask the type's RTTI the same question the personality routine asks
+    // when matching a catch clause, adjusting the pointer for base classes.
+    void* obj = *reinterpret_cast<void* const*>(&ex);
+    if (typeid(Exception).__do_catch(ex.__cxa_exception_type(), &obj, 1)) {
+        return static_cast<Exception*>(obj);
+    }
+    return nullptr;
+#else
+    try {
+        std::rethrow_exception(ex);
+    } catch (Exception& e) {
+        return &e;
+    } catch (...) {
+    }
+    return nullptr;
+#endif
+}
+
 /// @}
 
 /// \cond internal
@@ -57,7 +57,15 @@ future<> output_stream<CharType>::write(net::packet p) {
         return make_ready_future<>();
     }
 
-    assert(!_end && "Mixing buffered writes and zero-copy writes not supported yet");
+    if (_end) {
+        // push out previously buffered data ahead of the zero-copy payload
+        _buf.trim(_end);
+        _end = 0;
+        auto head = std::move(_buf);
+        net::packet front(net::fragment{head.get_write(), head.size()}, head.release());
+        front.append(std::move(p));
+        p = std::move(front);
+    }
 
     if (!_trim_to_size || p.len() <= _size) {
         // TODO: aggregate buffers for later coalescing. Currently we flush right
@@ -77,7 +85,14 @@ future<> output_stream<CharType>::write(temporary_buffer<CharType> p) {
     if (p.empty()) {
         return make_ready_future<>();
     }
-    assert(!_end && "Mixing buffered writes and zero-copy writes not supported yet");
+    if (_end) {
+        // push out previously buffered data ahead of the zero-copy payload
+        _buf.trim(_end);
+        _end = 0;
+        return put(std::move(_buf)).then([this, p = std::move(p)] () mutable {
+            return write(std::move(p));
+        });
+    }
     if (!_trim_to_size || p.size() <= _size) {
         // TODO: aggregate buffers for later coalescing.
         return _fd.put(std::move(p));
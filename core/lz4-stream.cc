@@ -0,0 +1,133 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#include "lz4-stream.hh"
+#include "chunking-sink.hh"
+#include "unaligned.hh"
+#include "net/byteorder.hh"
+#include <lz4.h>
+
+static constexpr size_t lz4_frame_header_size = 8;
+
+class lz4_compressing_sink_impl : public chunking_sink_impl {
+    // Compressed frames are built here and copied into _out, so a single
+    // buffer serves the whole stream.
+    temporary_buffer<char> _frame;
+public:
+    lz4_compressing_sink_impl(output_stream<char> out, lz4_output_stream_options options)
+            : chunking_sink_impl(std::move(out), options.chunk_size)
+            , _frame(lz4_frame_header_size + LZ4_compressBound(_chunk_size)) {
+        assert(_chunk_size && _chunk_size <= lz4_stream_max_chunk_size);
+    }
+protected:
+    virtual future<> write_frame(const char* p, size_t n) override {
+        auto hdr = _frame.get_write();
+        auto payload = hdr + lz4_frame_header_size;
+        auto compressed = LZ4_compress_default(p, payload, n, _frame.size() - lz4_frame_header_size);
+        bool store = compressed <= 0 || size_t(compressed) >= n;
+        size_t stored = store ? n : compressed;
+        *unaligned_cast<uint32_t*>(hdr) = net::hton(uint32_t(n));
+        *unaligned_cast<uint32_t*>(hdr + 4) = net::hton(uint32_t(stored));
+        if (store) {
+            return _out.write(hdr, lz4_frame_header_size).then([this, p, n] {
+                return _out.write(p, n);
+            });
+        }
+        return _out.write(hdr, lz4_frame_header_size + stored);
+    }
+};
+
+class lz4_decompressing_source_impl : public data_source_impl {
+    // Frames are decompressed into a single buffer, lent to the reader
+    // until it drops what it was given.  It is allocated for the first
+    // frame and grown only when a larger one comes, so it stays the size
+    // of the writer's chunks.  Shared with the deleters of the buffers
+    // handed out, which may outlive us.
+    struct block {
+        std::unique_ptr<char[]> data;
+        size_t size = 0;
+        bool lent = false;
+    };
+    input_stream<char> _in;
+    lw_shared_ptr<block> _block = make_lw_shared<block>();
+public:
+    explicit lz4_decompressing_source_impl(input_stream<char> in)
+            : _in(std::move(in)) {}
+    virtual future<temporary_buffer<char>> get() override {
+        return _in.read_exactly(lz4_frame_header_size).then([this] (temporary_buffer<char> hdr) {
+            if (hdr.empty()) {
+                // end of stream
+                return make_ready_future<temporary_buffer<char>>();
+            }
+            if (hdr.size() != lz4_frame_header_size) {
+                throw lz4_stream_error("lz4 stream: truncated frame header");
+            }
+            size_t size = net::ntoh(*unaligned_cast<uint32_t*>(hdr.get()));
+            size_t stored = net::ntoh(*unaligned_cast<uint32_t*>(hdr.get() + 4));
+            if (!size || size > lz4_stream_max_chunk_size || stored > size_t(LZ4_compressBound(size))) {
+                throw lz4_stream_error("lz4 stream: bad frame header");
+            }
+            return _in.read_exactly(stored).then([this, size, stored] (temporary_buffer<char> payload) {
+                if (payload.size() != stored) {
+                    throw lz4_stream_error("lz4 stream: truncated frame");
+                }
+                if (stored == size) {
+                    // stored uncompressed, hand it over as is
+                    return payload;
+                }
+                auto buf = block_buffer(size);
+                auto r = LZ4_decompress_safe(payload.get(), buf.get_write(), stored, size);
+                if (r < 0 || size_t(r) != size) {
+                    throw lz4_stream_error("lz4 stream: corrupt frame");
+                }
+                return buf;
+            });
+        });
+    }
+    virtual future<> close() override {
+        return _in.close();
+    }
+private:
+    // The block, unless the reader still holds on to part of the last
+    // frame, in which case the frame gets a buffer of its own
+    temporary_buffer<char> block_buffer(size_t size) {
+        if (_block->lent) {
+            return temporary_buffer<char>(size);
+        }
+        if (size > _block->size) {
+            _block->data.reset(new char[size]);
+            _block->size = size;
+        }
+        _block->lent = true;
+        return temporary_buffer<char>(_block->data.get(), size, make_deleter([b = _block] {
+            b->lent = false;
+        }));
+    }
+};
+
+output_stream<char> make_lz4_output_stream(output_stream<char> out, lz4_output_stream_options options) {
+    data_sink ds(std::make_unique<lz4_compressing_sink_impl>(std::move(out), options));
+    return output_stream<char>(std::move(ds), options.chunk_size, true);
+}
+
+input_stream<char> make_lz4_input_stream(input_stream<char> in) {
+    return input_stream<char>(data_source(std::make_unique<lz4_decompressing_source_impl>(std::move(in))));
+}
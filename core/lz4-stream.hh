@@ -0,0 +1,69 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#pragma once
+
+// LZ4 compression adapters for streams
+//
+// The output adapter splits the data written to it into chunks, compresses
+// each chunk independently and writes it, preceded by a small header, into
+// an underlying output_stream.  The input adapter reverses the process.
+// Since chunks are independent, memory use is bounded by the chunk size no
+// matter how long the stream is, and both adapters can be layered over any
+// stream - a file stream, or a connected_socket's streams.
+//
+// Each frame has the following format:
+//
+//   uint32_t (big endian)  uncompressed size
+//   uint32_t (big endian)  stored size; equal to the uncompressed size if the
+//                          chunk did not compress and is stored as is
+//   char[stored size]      payload
+
+#include "iostream.hh"
+#include <stdexcept>
+
+/// Largest chunk size supported by the lz4 stream format.
+static constexpr size_t lz4_stream_max_chunk_size = 4 << 20;
+
+/// Thrown when reading a corrupted lz4 stream.
+class lz4_stream_error : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/// Data structure describing options for creating an lz4 output stream
+struct lz4_output_stream_options {
+    size_t chunk_size = 64 * 1024;  ///< Amount of uncompressed data in a frame
+};
+
+/// Create an output_stream that compresses everything written to it
+/// and writes the result into \c out.
+///
+/// Closing the returned stream closes \c out as well.
+output_stream<char> make_lz4_output_stream(
+        output_stream<char> out,
+        lz4_output_stream_options options = {});
+
+/// Create an input_stream that decompresses data written by an lz4
+/// output stream and read from \c in.
+///
+/// A corrupted or truncated frame fails the read with \ref lz4_stream_error.
+input_stream<char> make_lz4_input_stream(input_stream<char> in);
@@ -23,6 +23,7 @@
 
 #include "future.hh"
 #include "queue.hh"
+#include "abort_source.hh"
 
 #include <experimental/optional>
 
@@ -90,9 +91,15 @@ class pipe_buffer {
     future<std::experimental::optional<T>> read() {
         return _buf.pop_eventually();
     }
+    future<std::experimental::optional<T>> read(abort_source& as) {
+        return _buf.pop_eventually(as);
+    }
     future<> write(T&& data) {
         return _buf.push_eventually(std::move(data));
     }
+    future<> write(T&& data, abort_source& as) {
+        return _buf.push_eventually(std::move(data), as);
+    }
     bool readable() const {
         return _write_open || !_buf.empty();
     }
@@ -102,7 +109,7 @@ class pipe_buffer {
     bool close_read() {
         // If a writer blocking (on a full queue), need to stop it.
         if (_buf.full()) {
-            _buf.abort(std::make_exception_ptr(broken_pipe_exception()));
+            _buf.abort(cached_exception_ptr<broken_pipe_exception>());
         }
         _read_open = false;
         return !_write_open;
@@ -156,6 +163,23 @@ class pipe_reader {
             return make_ready_future<std::experimental::optional<T>>();
         }
     }
+    /// \brief Read next item from the pipe, unless aborted
+    ///
+    /// Like \ref read(), but if \c as requests an abort while waiting for
+    /// the buffer to become non-empty, the returned future fails with
+    /// \ref abort_requested_exception and nothing is consumed.
+    future<std::experimental::optional<T>> read(abort_source& as) {
+        if (_unread) {
+            auto ret = std::move(*_unread);
+            _unread = {};
+            return make_ready_future<std::experimental::optional<T>>(std::move(ret));
+        }
+        if (_bufp->readable()) {
+            return _bufp->read(as);
+        } else {
+            return make_ready_future<std::experimental::optional<T>>();
+        }
+    }
     /// \brief Return an item to the front of the pipe
     ///
     /// Pushes the given item to the front of the pipe, so it will be
@@ -207,7 +231,19 @@ class pipe_writer {
         if (_bufp->writeable()) {
             return _bufp->write(std::move(data));
         } else {
-            return make_exception_future<>(broken_pipe_exception());
+            return make_exception_future<>(cached_exception_ptr<broken_pipe_exception>());
+        }
+    }
+    /// \brief Write an item to the pipe, unless aborted
+    ///
+    /// Like \ref write(), but if \c as requests an abort while waiting for
+    /// room in the buffer, the returned future fails with
+    /// \ref abort_requested_exception and \c data is dropped.
+    future<> write(T&& data, abort_source& as) {
+        if (_bufp->writeable()) {
+            return _bufp->write(std::move(data), as);
+        } else {
+            return make_exception_future<>(cached_exception_ptr<broken_pipe_exception>());
         }
     }
     ~pipe_writer() {
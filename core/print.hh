@@ -65,14 +65,138 @@ print(const char* fmt, A&&... a) {
     return print(bfmt, std::forward<A>(a)...);
 }
 
+namespace seastar {
+
+namespace internal {
+
+// Argument types that sprint() formats without boost::format, producing
+// the same text an ostream would.  Characters and bools are left out, as
+// their formatting depends on the conversion.
+template <typename T>
+struct is_fast_format_arg : std::integral_constant<bool,
+        (std::is_integral<T>::value
+                && !std::is_same<T, bool>::value
+                && !std::is_same<T, char>::value
+                && !std::is_same<T, signed char>::value
+                && !std::is_same<T, unsigned char>::value)
+        || std::is_floating_point<T>::value
+        || std::is_same<T, sstring>::value
+        || std::is_same<T, std::string>::value
+        || std::is_same<T, const char*>::value
+        || std::is_same<T, char*>::value> {
+};
+
+template <typename... T>
+struct all_fast_format_args : std::true_type {};
+
+template <typename T0, typename... T>
+struct all_fast_format_args<T0, T...> : std::integral_constant<bool,
+        is_fast_format_arg<T0>::value && all_fast_format_args<T...>::value> {
+};
+
+template <typename T>
+inline
+std::enable_if_t<std::is_integral<T>::value>
+append_format_arg(std::string& out, T v) {
+    char buf[max_integer_chars];
+    auto end = buf + sizeof(buf);
+    out.append(format_integer_backward(end, v), end);
+}
+
+// ostream's default floating point format is %g
+inline void append_format_arg(std::string& out, double v) {
+    char buf[32];
+    out.append(buf, std::snprintf(buf, sizeof(buf), "%g", v));
+}
+
+inline void append_format_arg(std::string& out, long double v) {
+    char buf[48];
+    out.append(buf, std::snprintf(buf, sizeof(buf), "%Lg", v));
+}
+
+inline void append_format_arg(std::string& out, const char* v) {
+    out.append(v);
+}
+
+inline void append_format_arg(std::string& out, const sstring& v) {
+    out.append(v.begin(), v.size());
+}
+
+inline void append_format_arg(std::string& out, const std::string& v) {
+    out.append(v);
+}
+
+// Handles the common case of a format made only of %s, %d, %i, %u and %%,
+// which boost::format applies to any argument type alike.  Returns false
+// if the format needs boost::format, including for a wrong number of
+// arguments, so that it reports the error.
+inline bool fast_format(std::string& out, const char* fmt) {
+    while (auto pct = std::strchr(fmt, '%')) {
+        out.append(fmt, pct);
+        if (pct[1] != '%') {
+            return false;
+        }
+        out.push_back('%');
+        fmt = pct + 2;
+    }
+    out.append(fmt);
+    return true;
+}
+
+template <typename A0, typename... A>
+inline bool fast_format(std::string& out, const char* fmt, const A0& a0, const A&... a) {
+    while (auto pct = std::strchr(fmt, '%')) {
+        out.append(fmt, pct);
+        switch (pct[1]) {
+        case '%':
+            out.push_back('%');
+            fmt = pct + 2;
+            continue;
+        case 's': case 'd': case 'i': case 'u':
+            append_format_arg(out, a0);
+            return fast_format(out, pct + 2, a...);
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
 template <typename... A>
 std::string
-sprint(const char* fmt, A&&... a) {
+boost_sprint(const char* fmt, A&&... a) {
     boost::format bfmt(fmt);
     apply_format(bfmt, std::forward<A>(a)...);
     return bfmt.str();
 }
 
+template <typename... A>
+std::string
+sprint(std::false_type, const char* fmt, A&&... a) {
+    return boost_sprint(fmt, std::forward<A>(a)...);
+}
+
+template <typename... A>
+std::string
+sprint(std::true_type, const char* fmt, A&&... a) {
+    std::string out;
+    if (fast_format(out, fmt, a...)) {
+        return out;
+    }
+    return boost_sprint(fmt, std::forward<A>(a)...);
+}
+
+} // namespace internal
+
+} // namespace seastar
+
+template <typename... A>
+std::string
+sprint(const char* fmt, A&&... a) {
+    return seastar::internal::sprint(seastar::internal::all_fast_format_args<std::decay_t<A>...>(),
+            fmt, std::forward<A>(a)...);
+}
+
 template <typename... A>
 std::string
 sprint(const sstring& fmt, A&&... a) {
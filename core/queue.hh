@@ -24,6 +24,7 @@
 
 #include "circular_buffer.hh"
 #include "future.hh"
+#include "abort_source.hh"
 #include <queue>
 #include <experimental/optional>
 
@@ -33,6 +34,8 @@ class queue {
     size_t _max;
     std::experimental::optional<promise<>> _not_empty;
     std::experimental::optional<promise<>> _not_full;
+    seastar::abort_source::subscription _not_empty_abort;
+    seastar::abort_source::subscription _not_full_abort;
 private:
     void notify_not_empty();
     void notify_not_full();
@@ -67,14 +70,30 @@ class queue {
     // Returns a future<> that becomes available when push() can be called.
     future<> not_full();
 
+    // Like not_empty(), but fails with abort_requested_exception as soon as
+    // @as requests an abort.
+    future<> not_empty(seastar::abort_source& as);
+
+    // Like not_full(), but fails with abort_requested_exception as soon as
+    // @as requests an abort.
+    future<> not_full(seastar::abort_source& as);
+
     // Pops element now or when ther is some. Returns a future that becomes
     // available when some element is available.
     future<T> pop_eventually();
 
+    // Like pop_eventually(), but gives up without popping when @as requests
+    // an abort.
+    future<T> pop_eventually(seastar::abort_source& as);
+
     // Pushes the element now or when there is room. Returns a future<> which
     // resolves when data was pushed.
     future<> push_eventually(T&& data);
 
+    // Like push_eventually(), but gives up and drops @data when @as requests
+    // an abort.
+    future<> push_eventually(T&& data, seastar::abort_source& as);
+
     size_t size() const { return _q.size(); }
 
     // Destroy any items in the queue, and pass the provided exception to any
@@ -86,10 +105,12 @@ class queue {
         if (_not_full) {
             _not_full->set_exception(ex);
             _not_full= std::experimental::nullopt;
+            _not_full_abort.unsubscribe();
         }
         if (_not_empty) {
             _not_empty->set_exception(std::move(ex));
             _not_empty = std::experimental::nullopt;
+            _not_empty_abort.unsubscribe();
         }
     }
 };
@@ -106,6 +127,7 @@ void queue<T>::notify_not_empty() {
     if (_not_empty) {
         _not_empty->set_value();
         _not_empty = std::experimental::optional<promise<>>();
+        _not_empty_abort.unsubscribe();
     }
 }
 
@@ -115,6 +137,7 @@ void queue<T>::notify_not_full() {
     if (_not_full) {
         _not_full->set_value();
         _not_full = std::experimental::optional<promise<>>();
+        _not_full_abort.unsubscribe();
     }
 }
 
@@ -153,6 +176,18 @@ future<T> queue<T>::pop_eventually() {
     }
 }
 
+template <typename T>
+inline
+future<T> queue<T>::pop_eventually(seastar::abort_source& as) {
+    if (empty()) {
+        return not_empty(as).then([this] {
+            return make_ready_future<T>(pop());
+        });
+    } else {
+        return make_ready_future<T>(pop());
+    }
+}
+
 template <typename T>
 inline
 future<> queue<T>::push_eventually(T&& data) {
@@ -168,6 +203,21 @@ future<> queue<T>::push_eventually(T&& data) {
     }
 }
 
+template <typename T>
+inline
+future<> queue<T>::push_eventually(T&& data, seastar::abort_source& as) {
+    if (full()) {
+        return not_full(as).then([this, data = std::move(data)] () mutable {
+            _q.push(std::move(data));
+            notify_not_empty();
+        });
+    } else {
+        _q.push(std::move(data));
+        notify_not_empty();
+        return make_ready_future<>();
+    }
+}
+
 template <typename T>
 template <typename Func>
 inline
@@ -217,4 +267,38 @@ future<> queue<T>::not_full() {
     }
 }
 
+template <typename T>
+inline
+future<> queue<T>::not_empty(seastar::abort_source& as) {
+    if (!empty()) {
+        return make_ready_future<>();
+    } else if (as.abort_requested()) {
+        return make_exception_future<>(cached_exception_ptr<seastar::abort_requested_exception>());
+    } else {
+        auto f = not_empty();
+        _not_empty_abort = as.subscribe([this] {
+            _not_empty->set_exception(cached_exception_ptr<seastar::abort_requested_exception>());
+            _not_empty = std::experimental::nullopt;
+        });
+        return f;
+    }
+}
+
+template <typename T>
+inline
+future<> queue<T>::not_full(seastar::abort_source& as) {
+    if (!full()) {
+        return make_ready_future<>();
+    } else if (as.abort_requested()) {
+        return make_exception_future<>(cached_exception_ptr<seastar::abort_requested_exception>());
+    } else {
+        auto f = not_full();
+        _not_full_abort = as.subscribe([this] {
+            _not_full->set_exception(cached_exception_ptr<seastar::abort_requested_exception>());
+            _not_full = std::experimental::nullopt;
+        });
+        return f;
+    }
+}
+
 #endif /* QUEUE_HH_ */
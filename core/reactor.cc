@@ -306,7 +306,7 @@ void reactor::timer_thread_func() {
                 if (tmr.expired()) {
                     _timer_due = 0;
                     _engine_thread->unsafe_stop();
-                    _pending_tasks.push_front(make_task([this] {
+                    add_high_priority_task(make_task([this] {
                         complete_timers(_timers, _expired_timers, [this] {
                             if (!_timers.empty()) {
                                 enable_timer(_timers.get_next_timeout());
@@ -647,7 +647,10 @@ future<>
 reactor::remove_file(sstring pathname) {
     return engine()._thread_pool.submit<syscall_result<int>>([this, pathname] {
         return wrap_syscall<int>(::remove(pathname.c_str()));
-    }).then([] (syscall_result<int> sr) {
+    }).then([this, pathname] (syscall_result<int> sr) {
+        // Only now, as a lookup made while the file was being removed may
+        // have cached it again
+        invalidate_file_metadata(pathname);
         sr.throw_if_error();
         return make_ready_future<>();
     });
@@ -657,7 +660,10 @@ future<>
 reactor::rename_file(sstring old_pathname, sstring new_pathname) {
     return engine()._thread_pool.submit<syscall_result<int>>([this, old_pathname, new_pathname] {
         return wrap_syscall<int>(::rename(old_pathname.c_str(), new_pathname.c_str()));
-    }).then([] (syscall_result<int> sr) {
+    }).then([this, old_pathname, new_pathname] (syscall_result<int> sr) {
+        // As with remove_file()
+        invalidate_file_metadata(old_pathname);
+        invalidate_file_metadata(new_pathname);
         sr.throw_if_error();
         return make_ready_future<>();
     });
@@ -739,6 +745,184 @@ reactor::file_exists(sstring pathname) {
     });
 }
 
+// From statx(2).  Defined here, along with the flags we use, since libc
+// headers may predate it.
+struct kernel_statx_timestamp {
+    int64_t tv_sec;
+    uint32_t tv_nsec;
+    int32_t reserved;
+};
+
+struct kernel_statx {
+    uint32_t stx_mask;
+    uint32_t stx_blksize;
+    uint64_t stx_attributes;
+    uint32_t stx_nlink;
+    uint32_t stx_uid;
+    uint32_t stx_gid;
+    uint16_t stx_mode;
+    uint16_t spare0;
+    uint64_t stx_ino;
+    uint64_t stx_size;
+    uint64_t stx_blocks;
+    uint64_t stx_attributes_mask;
+    kernel_statx_timestamp stx_atime;
+    kernel_statx_timestamp stx_btime;
+    kernel_statx_timestamp stx_ctime;
+    kernel_statx_timestamp stx_mtime;
+    uint32_t stx_rdev_major;
+    uint32_t stx_rdev_minor;
+    uint32_t stx_dev_major;
+    uint32_t stx_dev_minor;
+    uint64_t stx_mnt_id;
+    uint32_t stx_dio_mem_align;
+    uint32_t stx_dio_offset_align;
+    uint64_t spare3[12];
+};
+
+static_assert(sizeof(kernel_statx) == 256, "struct statx layout mismatch");
+
+static constexpr uint32_t statx_basic_stats = 0x7ff;
+static constexpr uint32_t statx_dioalign = 0x2000;
+
+#if !defined(__NR_statx) && defined(__x86_64__)
+#define __NR_statx 332
+#endif
+
+// Runs in the syscall thread, so must not allocate.  Returns 0 or an errno
+// value.  Falls back to stat() on kernels without statx().
+static int statx_or_stat(const char* name, kernel_statx* stx) {
+#ifdef __NR_statx
+    auto ret = ::syscall(__NR_statx, AT_FDCWD, name, 0, statx_basic_stats | statx_dioalign, stx);
+    if (ret == 0) {
+        return 0;
+    }
+    if (errno != ENOSYS) {
+        return errno;
+    }
+#endif
+    struct stat st;
+    if (::stat(name, &st) == -1) {
+        return errno;
+    }
+    *stx = {};
+    stx->stx_mask = statx_basic_stats;
+    stx->stx_blksize = st.st_blksize;
+    stx->stx_nlink = st.st_nlink;
+    stx->stx_uid = st.st_uid;
+    stx->stx_gid = st.st_gid;
+    stx->stx_mode = st.st_mode;
+    stx->stx_ino = st.st_ino;
+    stx->stx_size = st.st_size;
+    stx->stx_blocks = st.st_blocks;
+    stx->stx_mtime.tv_sec = st.st_mtim.tv_sec;
+    stx->stx_mtime.tv_nsec = st.st_mtim.tv_nsec;
+    return 0;
+}
+
+static file_metadata to_file_metadata(const kernel_statx& stx) {
+    file_metadata md;
+    md.type = stat_to_entry_type(stx.stx_mode);
+    md.permissions = stx.stx_mode & 07777;
+    md.inode = stx.stx_ino;
+    md.nlink = stx.stx_nlink;
+    md.uid = stx.stx_uid;
+    md.gid = stx.stx_gid;
+    md.size = stx.stx_size;
+    md.blocks = stx.stx_blocks;
+    md.block_size = stx.stx_blksize;
+    md.modification_time = std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                    std::chrono::seconds(stx.stx_mtime.tv_sec) + std::chrono::nanoseconds(stx.stx_mtime.tv_nsec)));
+    if (stx.stx_mask & statx_dioalign) {
+        md.dio_mem_align = stx.stx_dio_mem_align;
+        md.dio_offset_align = stx.stx_dio_offset_align;
+    }
+    return md;
+}
+
+future<std::vector<std::experimental::optional<file_metadata>>>
+reactor::stat_files(std::vector<sstring> names) {
+    // Paths are handed to the syscall thread in chunks, so a large request
+    // takes few round trips without needing an unbounded result buffer.
+    static constexpr size_t chunk_size = 256;
+    struct work {
+        std::vector<sstring> names;
+        std::vector<std::experimental::optional<file_metadata>> results;
+        std::unique_ptr<kernel_statx[]> buffer{new kernel_statx[chunk_size]};
+        int errors[chunk_size];
+        size_t done = 0;
+    };
+    auto w = make_lw_shared<work>();
+    w->names = std::move(names);
+    w->results.reserve(w->names.size());
+    return do_until([w] { return w->done == w->names.size(); }, [w, this] {
+        auto n = std::min(chunk_size, w->names.size() - w->done);
+        return _thread_pool.submit<int>([w, n] {
+            for (size_t i = 0; i < n; ++i) {
+                w->errors[i] = statx_or_stat(w->names[w->done + i].c_str(), &w->buffer[i]);
+            }
+            return 0;
+        }).then([w, n] (int) {
+            for (size_t i = 0; i < n; ++i) {
+                auto error = w->errors[i];
+                if (error == ENOENT || error == ENOTDIR) {
+                    w->results.emplace_back();
+                } else if (error) {
+                    throw std::system_error(error, std::system_category(), w->names[w->done + i]);
+                } else {
+                    w->results.emplace_back(to_file_metadata(w->buffer[i]));
+                }
+            }
+            w->done += n;
+        });
+    }).then([w] {
+        return std::move(w->results);
+    });
+}
+
+future<std::vector<std::experimental::optional<file_metadata>>>
+reactor::cached_stat_files(std::vector<sstring> names) {
+    std::vector<std::experimental::optional<file_metadata>> results(names.size());
+    std::vector<size_t> missing;
+    std::vector<sstring> missing_names;
+    for (size_t i = 0; i < names.size(); ++i) {
+        auto it = _file_metadata_cache.find(names[i]);
+        if (it != _file_metadata_cache.end()) {
+            results[i] = it->second;
+        } else {
+            missing.push_back(i);
+            missing_names.push_back(names[i]);
+        }
+    }
+    if (missing.empty()) {
+        return make_ready_future<std::vector<std::experimental::optional<file_metadata>>>(std::move(results));
+    }
+    auto generation = _file_metadata_generation;
+    return stat_files(std::move(missing_names)).then([this, generation, names = std::move(names),
+            results = std::move(results), missing = std::move(missing)] (auto fetched) mutable {
+        for (size_t i = 0; i < missing.size(); ++i) {
+            if (generation == _file_metadata_generation) {
+                _file_metadata_cache[names[missing[i]]] = fetched[i];
+            }
+            results[missing[i]] = std::move(fetched[i]);
+        }
+        return std::move(results);
+    });
+}
+
+void
+reactor::invalidate_file_metadata(const sstring& name) {
+    _file_metadata_cache.erase(name);
+    ++_file_metadata_generation;
+}
+
+void
+reactor::invalidate_file_metadata() {
+    _file_metadata_cache.clear();
+    ++_file_metadata_generation;
+}
+
 future<fs_type>
 reactor::file_system_at(sstring pathname) {
     return _thread_pool.submit<syscall_result_extra<struct statfs>>([pathname] {
@@ -921,91 +1105,121 @@ blockdev_file_impl::size(void) {
     });
 }
 
-subscription<directory_entry>
-posix_file_impl::list_directory(std::function<future<> (directory_entry de)> next) {
+// From getdents64(2):
+struct linux_dirent64 {
+    ino64_t        d_ino;     /* 64-bit inode number */
+    off64_t        d_off;     /* 64-bit offset to next structure */
+    unsigned short d_reclen;  /* Size of this dirent */
+    unsigned char  d_type;    /* File type */
+    char           d_name[];  /* Filename (null-terminated) */
+};
+
+static std::experimental::optional<directory_entry_type> dirent_type(unsigned char d_type) {
+    switch (d_type) {
+    case DT_BLK:
+        return directory_entry_type::block_device;
+    case DT_CHR:
+        return directory_entry_type::char_device;
+    case DT_DIR:
+        return directory_entry_type::directory;
+    case DT_FIFO:
+        return directory_entry_type::fifo;
+    case DT_LNK:
+        return directory_entry_type::link;
+    case DT_REG:
+        return directory_entry_type::regular;
+    case DT_SOCK:
+        return directory_entry_type::socket;
+    default:
+        // unknown (DT_UNKNOWN, or a filesystem that does not fill d_type)
+        return {};
+    }
+}
+
+future<>
+posix_file_impl::read_directory(std::function<future<> (std::vector<directory_entry>)> consume) {
+    // A large buffer lets a single getdents64() return thousands of
+    // entries, so big directories take few trips to the syscall thread.
+    static constexpr size_t buffer_size = 128 * 1024;
     struct work {
-        stream<directory_entry> s;
-        unsigned current = 0;
-        unsigned total = 0;
+        std::function<future<> (std::vector<directory_entry>)> consume;
+        std::unique_ptr<char[]> buffer{new char[buffer_size]};
         bool eof = false;
-        int error = 0;
-        char buffer[8192];
     };
 
     // While it would be natural to use fdopendir()/readdir(),
     // our syscall thread pool doesn't support malloc(), which is
-    // required for this to work.  So resort to using getdents()
-    // instead.
-
-    // From getdents(2):
-    struct linux_dirent {
-        unsigned long  d_ino;     /* Inode number */
-        unsigned long  d_off;     /* Offset to next linux_dirent */
-        unsigned short d_reclen;  /* Length of this linux_dirent */
-        char           d_name[];  /* Filename (null-terminated) */
-        /* length is actually (d_reclen - 2 -
-                             offsetof(struct linux_dirent, d_name)) */
-        /*
-        char           pad;       // Zero padding byte
-        char           d_type;    // File type (only since Linux
-                                  // 2.6.4); offset is (d_reclen - 1)
-         */
-    };
-
+    // required for this to work.  So resort to using getdents64()
+    // into a buffer allocated here instead.
     auto w = make_lw_shared<work>();
-    auto ret = w->s.listen(std::move(next));
-    w->s.started().then([w, this] {
-        auto eofcond = [w] { return w->eof; };
-        return do_until(eofcond, [w, this] {
-            if (w->current == w->total) {
-                return engine()._thread_pool.submit<syscall_result<long>>([w , this] () {
-                    auto ret = ::syscall(__NR_getdents, _fd, reinterpret_cast<linux_dirent*>(w->buffer), sizeof(w->buffer));
-                    return wrap_syscall(ret);
-                }).then([w] (syscall_result<long> ret) {
-                    ret.throw_if_error();
-                    if (ret.result == 0) {
-                        w->eof = true;
-                    } else {
-                        w->current = 0;
-                        w->total = ret.result;
-                    }
-                });
+    w->consume = std::move(consume);
+    return do_until([w] { return w->eof; }, [w, this] {
+        return engine()._thread_pool.submit<syscall_result<long>>([w, this] () {
+            auto ret = ::syscall(__NR_getdents64, _fd, w->buffer.get(), buffer_size);
+            return wrap_syscall(ret);
+        }).then([w] (syscall_result<long> ret) {
+            ret.throw_if_error();
+            if (ret.result == 0) {
+                w->eof = true;
+                return make_ready_future<>();
             }
-            auto start = w->buffer + w->current;
-            auto de = reinterpret_cast<linux_dirent*>(start);
-            std::experimental::optional<directory_entry_type> type;
-            switch (start[de->d_reclen - 1]) {
-            case DT_BLK:
-                type = directory_entry_type::block_device;
-                break;
-            case DT_CHR:
-                type = directory_entry_type::char_device;
-                break;
-            case DT_DIR:
-                type = directory_entry_type::directory;
-                break;
-            case DT_FIFO:
-                type = directory_entry_type::fifo;
-                break;
-            case DT_REG:
-                type = directory_entry_type::regular;
-                break;
-            case DT_SOCK:
-                type = directory_entry_type::socket;
-                break;
-            default:
-                // unknown, ignore
-                ;
+            std::vector<directory_entry> batch;
+            long pos = 0;
+            while (pos < ret.result) {
+                auto de = reinterpret_cast<linux_dirent64*>(w->buffer.get() + pos);
+                pos += de->d_reclen;
+                sstring name = de->d_name;
+                if (name == "." || name == "..") {
+                    continue;
+                }
+                batch.push_back(directory_entry{std::move(name), dirent_type(de->d_type)});
             }
-            w->current += de->d_reclen;
-            sstring name = de->d_name;
-            if (name == "." || name == "..") {
+            if (batch.empty()) {
                 return make_ready_future<>();
             }
-            return w->s.produce({std::move(name), type});
+            return w->consume(std::move(batch));
         });
-    }).then([w] {
-        w->s.close();
+    });
+}
+
+subscription<std::vector<directory_entry>>
+posix_file_impl::list_directory_batched(std::function<future<> (std::vector<directory_entry> batch)> next) {
+    auto s = make_lw_shared<stream<std::vector<directory_entry>>>();
+    auto ret = s->listen(std::move(next));
+    s->started().then([s, this] {
+        return read_directory([s] (std::vector<directory_entry> batch) {
+            return s->produce(std::move(batch));
+        });
+    }).then_wrapped([s] (future<> f) {
+        try {
+            f.get();
+            s->close();
+        } catch (...) {
+            s->set_exception(std::current_exception());
+        }
+    });
+    return ret;
+}
+
+subscription<directory_entry>
+posix_file_impl::list_directory(std::function<future<> (directory_entry de)> next) {
+    auto s = make_lw_shared<stream<directory_entry>>();
+    auto ret = s->listen(std::move(next));
+    s->started().then([s, this] {
+        return read_directory([s] (std::vector<directory_entry> batch) {
+            return do_with(std::move(batch), [s] (std::vector<directory_entry>& batch) {
+                return do_for_each(batch, [s] (directory_entry& de) {
+                    return s->produce(std::move(de));
+                });
+            });
+        });
+    }).then_wrapped([s] (future<> f) {
+        try {
+            f.get();
+            s->close();
+        } catch (...) {
+            s->set_exception(std::current_exception());
+        }
     });
     return ret;
 }
@@ -1112,7 +1326,7 @@ reactor::register_collectd_metrics() {
                     , scollectd::per_cpu_plugin_instance
                     , "queue_length", "tasks-pending")
                     , scollectd::make_typed(scollectd::data_type::GAUGE
-                            , std::bind(&decltype(_pending_tasks)::size, &_pending_tasks))
+                            , [this] { return pending_tasks(); })
             ),
             // total_operations value:DERIVE:0:U
             scollectd::add_polled_metric(scollectd::type_instance_id("reactor"
@@ -1228,6 +1442,54 @@ reactor::register_collectd_metrics() {
     } };
 }
 
+void reactor::activate(scheduling_group& sg) {
+    sg._active = true;
+    sg._runnable_since = std::chrono::steady_clock::now();
+    sg._vruntime = std::max(sg._vruntime, _last_vruntime);
+    _active_scheduling_groups.push_back(&sg);
+}
+
+// Runs tasks from the runnable group that has used the least CPU time
+// relative to its shares, until the task quota expires or the group runs
+// out of tasks, and charges the time to the group.
+void reactor::run_some_tasks() {
+    if (_active_scheduling_groups.empty()) {
+        return;
+    }
+    auto it = std::min_element(_active_scheduling_groups.begin(), _active_scheduling_groups.end(),
+            [] (scheduling_group* a, scheduling_group* b) { return a->_vruntime < b->_vruntime; });
+    auto sg = *it;
+    auto start = std::chrono::steady_clock::now();
+    sg->_queue_delay += start - sg->_runnable_since;
+    auto tasks_processed = _tasks_processed;
+    g_current_scheduling_group = sg;
+    run_tasks(sg->_tasks);
+    g_current_scheduling_group = nullptr;
+    auto end = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+    sg->_runtime += elapsed;
+    sg->_tasks_processed += _tasks_processed - tasks_processed;
+    sg->_vruntime += double(elapsed.count()) / sg->_shares;
+    _last_vruntime = sg->_vruntime;
+    if (sg->_tasks.empty()) {
+        sg->_active = false;
+        // the vector may have grown while the tasks ran
+        auto i = std::find(_active_scheduling_groups.begin(), _active_scheduling_groups.end(), sg);
+        std::swap(*i, _active_scheduling_groups.back());
+        _active_scheduling_groups.pop_back();
+    } else {
+        sg->_runnable_since = end;
+    }
+}
+
+size_t reactor::pending_tasks() const {
+    size_t n = 0;
+    for (auto sg : _active_scheduling_groups) {
+        n += sg->_tasks.size();
+    }
+    return n;
+}
+
 void reactor::run_tasks(circular_buffer<std::unique_ptr<task>>& tasks) {
     _task_quota_finished = false;
     future_avail_count = 0;
@@ -1247,6 +1509,7 @@ void reactor::force_poll() {
 
 int reactor::run() {
     auto collectd_metrics = register_collectd_metrics();
+    _default_scheduling_group.register_collectd_metrics();
 
 #ifndef HAVE_OSV
     poller io_poller([&] { return process_io(); });
@@ -1360,12 +1623,12 @@ int reactor::run() {
     bool idle = false;
 
     while (true) {
-        run_tasks(_pending_tasks);
+        run_some_tasks();
         if (_stopped) {
             load_timer.cancel();
             // Final tasks may include sending the last response to cpu 0, so run them
-            while (!_pending_tasks.empty()) {
-                run_tasks(_pending_tasks);
+            while (have_pending_tasks()) {
+                run_some_tasks();
             }
             while (!_at_destroy_tasks.empty()) {
                 run_tasks(_at_destroy_tasks);
@@ -1376,7 +1639,7 @@ int reactor::run() {
             break;
         }
 
-        if (!poll_once() && _pending_tasks.empty()) {
+        if (!poll_once() && !have_pending_tasks()) {
             idle_end = std::chrono::high_resolution_clock::now();
             if (!idle) {
                 idle_start = idle_end;
@@ -2039,6 +2302,8 @@ __thread size_t future_avail_count = 0;
 
 __thread reactor* local_engine;
 
+__thread scheduling_group* g_current_scheduling_group;
+
 class reactor_notifier_epoll : public reactor_notifier {
     writeable_eventfd _write;
     readable_eventfd _read;
@@ -2331,6 +2596,22 @@ future<bool> file_exists(sstring name) {
     return engine().file_exists(name);
 }
 
+future<std::vector<std::experimental::optional<file_metadata>>> stat_files(std::vector<sstring> names) {
+    return engine().stat_files(std::move(names));
+}
+
+future<std::vector<std::experimental::optional<file_metadata>>> cached_stat_files(std::vector<sstring> names) {
+    return engine().cached_stat_files(std::move(names));
+}
+
+void invalidate_file_metadata(const sstring& name) {
+    engine().invalidate_file_metadata(name);
+}
+
+void invalidate_file_metadata() {
+    engine().invalidate_file_metadata();
+}
+
 future<> link_file(sstring oldpath, sstring newpath) {
     return engine().link_file(std::move(oldpath), std::move(newpath));
 }
@@ -2348,11 +2629,113 @@ future<connected_socket> connect(socket_address sa) {
 }
 
 void reactor::add_high_priority_task(std::unique_ptr<task>&& t) {
-    _pending_tasks.push_front(std::move(t));
+    auto sg = t->group() ? t->group() : &_default_scheduling_group;
+    sg->_tasks.push_front(std::move(t));
+    if (!sg->_active) {
+        activate(*sg);
+    }
     // break .then() chains
     future_avail_count = max_inlined_continuations - 1;
 }
 
+scheduling_group::scheduling_group(default_group_tag)
+        : _name("main"), _shares(1000) {
+}
+
+scheduling_group::scheduling_group(sstring name, unsigned shares)
+        : _name(std::move(name)), _shares(shares) {
+    assert(shares > 0);
+    register_collectd_metrics();
+}
+
+scheduling_group::~scheduling_group() {
+    // the default group may still hold tasks when the reactor goes away
+    assert(_tasks.empty() || this == &engine().default_scheduling_group());
+}
+
+void scheduling_group::set_shares(unsigned shares) {
+    assert(shares > 0);
+    _shares = shares;
+}
+
+void scheduling_group::register_collectd_metrics() {
+    _collectd_regs = {
+            scollectd::add_polled_metric(scollectd::type_instance_id("scheduler"
+                    , scollectd::per_cpu_plugin_instance
+                    , "derive", _name + "-runtime-ms")
+                    , scollectd::make_typed(scollectd::data_type::DERIVE
+                            , [this] { return uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(_runtime).count()); })
+            ),
+            scollectd::add_polled_metric(scollectd::type_instance_id("scheduler"
+                    , scollectd::per_cpu_plugin_instance
+                    , "derive", _name + "-queue-delay-ms")
+                    , scollectd::make_typed(scollectd::data_type::DERIVE
+                            , [this] { return uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(_queue_delay).count()); })
+            ),
+            scollectd::add_polled_metric(scollectd::type_instance_id("scheduler"
+                    , scollectd::per_cpu_plugin_instance
+                    , "total_operations", _name + "-tasks-processed")
+                    , scollectd::make_typed(scollectd::data_type::DERIVE, _tasks_processed)
+            ),
+            scollectd::add_polled_metric(scollectd::type_instance_id("scheduler"
+                    , scollectd::per_cpu_plugin_instance
+                    , "queue_length", _name + "-tasks-pending")
+                    , scollectd::make_typed(scollectd::data_type::GAUGE
+                            , [this] { return _tasks.size(); })
+            ),
+    };
+}
+
+void named_semaphore::register_collectd_metrics() {
+    _collectd_regs = {
+            scollectd::add_polled_metric(scollectd::type_instance_id("semaphore"
+                    , scollectd::per_cpu_plugin_instance
+                    , "queue_length", _name + "-waiters")
+                    , scollectd::make_typed(scollectd::data_type::GAUGE
+                            , [this] { return waiters(); })
+            ),
+            scollectd::add_polled_metric(scollectd::type_instance_id("semaphore"
+                    , scollectd::per_cpu_plugin_instance
+                    , "total_operations", _name + "-waits")
+                    , scollectd::make_typed(scollectd::data_type::DERIVE, _wait_stats.waits)
+            ),
+            scollectd::add_polled_metric(scollectd::type_instance_id("semaphore"
+                    , scollectd::per_cpu_plugin_instance
+                    , "total_operations", _name + "-timeouts")
+                    , scollectd::make_typed(scollectd::data_type::DERIVE, _wait_stats.timeouts)
+            ),
+            scollectd::add_polled_metric(scollectd::type_instance_id("semaphore"
+                    , scollectd::per_cpu_plugin_instance
+                    , "total_operations", _name + "-aborts")
+                    , scollectd::make_typed(scollectd::data_type::DERIVE, _wait_stats.aborts)
+            ),
+            scollectd::add_polled_metric(scollectd::type_instance_id("semaphore"
+                    , scollectd::per_cpu_plugin_instance
+                    , "derive", _name + "-wait-time-us")
+                    , scollectd::make_typed(scollectd::data_type::DERIVE, _wait_stats.wait_time_us)
+            ),
+    };
+    // one counter per histogram bucket, named after its upper bound
+    uint64_t limit = 10;
+    for (unsigned i = 0; i < semaphore_wait_stats::histogram_buckets; ++i, limit *= 10) {
+        auto bound = i + 1 < semaphore_wait_stats::histogram_buckets ? "lt-" + to_sstring(limit) + "us" : sstring("inf");
+        _collectd_regs.emplace_back(
+            scollectd::add_polled_metric(scollectd::type_instance_id("semaphore"
+                    , scollectd::per_cpu_plugin_instance
+                    , "total_operations", _name + "-wait-" + bound)
+                    , scollectd::make_typed(scollectd::data_type::DERIVE, _wait_stats.wait_time_histogram[i])
+            ));
+    }
+}
+
+scheduling_group& current_scheduling_group() {
+    return g_current_scheduling_group ? *g_current_scheduling_group : engine().default_scheduling_group();
+}
+
+scheduling_group& default_scheduling_group() {
+    return engine().default_scheduling_group();
+}
+
 future<> later() {
     promise<> p;
     auto f = p.get_future();
@@ -65,6 +65,7 @@
 #include "core/enum.hh"
 #include <boost/range/irange.hpp>
 #include "timer.hh"
+#include "scheduling.hh"
 
 #ifdef HAVE_OSV
 #include <osv/sched.hh>
@@ -729,7 +730,12 @@ class reactor {
     uint64_t _aio_writes = 0;
     uint64_t _aio_write_bytes = 0;
     uint64_t _fsyncs = 0;
-    circular_buffer<std::unique_ptr<task>> _pending_tasks;
+    scheduling_group _default_scheduling_group{scheduling_group::default_group_tag()};
+    // Groups with queued tasks, and the vruntime of the group that ran last
+    // (which newly runnable groups start from, so they cannot build up
+    // credit while idle).
+    std::vector<scheduling_group*> _active_scheduling_groups;
+    double _last_vruntime = 0;
     circular_buffer<std::unique_ptr<task>> _at_destroy_tasks;
     std::chrono::duration<double> _task_quota;
     sig_atomic_t _task_quota_finished;
@@ -781,8 +787,17 @@ class reactor {
     signals _signals;
     thread_pool _thread_pool;
     friend thread_pool;
+    // Results of cached_stat_files(), including negative ones.  Bumping the
+    // generation on invalidation keeps lookups that were in flight at the
+    // time from re-populating the cache with stale results.
+    std::unordered_map<sstring, std::experimental::optional<file_metadata>> _file_metadata_cache;
+    uint64_t _file_metadata_generation = 0;
 
     void run_tasks(circular_buffer<std::unique_ptr<task>>& tasks);
+    void run_some_tasks();
+    void activate(scheduling_group& sg);
+    bool have_pending_tasks() const { return !_active_scheduling_groups.empty(); }
+    size_t pending_tasks() const;
     bool posix_reuseport_detect();
 public:
     static boost::program_options::options_description get_options_description();
@@ -819,6 +834,10 @@ class reactor {
     future<std::experimental::optional<directory_entry_type>>  file_type(sstring name);
     future<uint64_t> file_size(sstring pathname);
     future<bool> file_exists(sstring pathname);
+    future<std::vector<std::experimental::optional<file_metadata>>> stat_files(std::vector<sstring> names);
+    future<std::vector<std::experimental::optional<file_metadata>>> cached_stat_files(std::vector<sstring> names);
+    void invalidate_file_metadata(const sstring& name);
+    void invalidate_file_metadata();
     future<fs_type> file_system_at(sstring pathname);
     future<> remove_file(sstring pathname);
     future<> rename_file(sstring old_pathname, sstring new_pathname);
@@ -842,13 +861,21 @@ class reactor {
         _at_destroy_tasks.push_back(make_task(std::forward<Func>(func)));
     }
 
-    void add_task(std::unique_ptr<task>&& t) { _pending_tasks.push_back(std::move(t)); }
+    void add_task(std::unique_ptr<task>&& t) {
+        auto sg = t->group() ? t->group() : &_default_scheduling_group;
+        sg->_tasks.push_back(std::move(t));
+        if (!sg->_active) {
+            activate(*sg);
+        }
+    }
     void force_poll();
 
     void add_high_priority_task(std::unique_ptr<task>&&);
 
     network_stack& net() { return *_network_stack; }
     unsigned cpu_id() const { return _id; }
+    uint64_t tasks_processed() const { return _tasks_processed; }
+    scheduling_group& default_scheduling_group() { return _default_scheduling_group; }
 
     void start_epoll() {
         if (!_epoll_poller) {
@@ -0,0 +1,126 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#pragma once
+
+#include "future.hh"
+#include "task.hh"
+#include "circular_buffer.hh"
+#include "sstring.hh"
+#include "scollectd.hh"
+#include <chrono>
+#include <memory>
+
+/// \addtogroup fiber-module
+/// @{
+
+/// \brief A group of tasks sharing the CPU with other groups by shares.
+///
+/// Every task belongs to a scheduling group: the group that was running
+/// when the task was created, i.e. when \c then() was called or the task
+/// was scheduled.  So continuations, and \ref seastar::thread "threads",
+/// spawned from a group's task stay in that group and are accounted to it.
+/// Use \ref with_scheduling_group() to start work in a group; anything not
+/// started that way runs in the default group.
+///
+/// When several groups have runnable tasks, the reactor runs the one that
+/// has used the least CPU time relative to its shares, so under contention
+/// a group with twice the shares gets twice the CPU time.  A group does not
+/// build up credit while idle, and a group that is alone on the CPU may use
+/// all of it.  Background work can thus be given few shares without either
+/// starving it or letting it delay latency-sensitive work beyond its share.
+///
+/// Scheduling groups are per-shard.  A group must outlive all tasks
+/// created in it.
+class scheduling_group {
+    sstring _name;
+    unsigned _shares;
+    circular_buffer<std::unique_ptr<task>> _tasks;
+    // CPU time used divided by shares; the reactor runs the runnable group
+    // with the lowest value.
+    double _vruntime = 0;
+    bool _active = false;
+    std::chrono::steady_clock::time_point _runnable_since;
+    std::chrono::nanoseconds _runtime{0};
+    std::chrono::nanoseconds _queue_delay{0};
+    uint64_t _tasks_processed = 0;
+    scollectd::registrations _collectd_regs;
+private:
+    struct default_group_tag {};
+    scheduling_group(default_group_tag);
+    void register_collectd_metrics();
+public:
+    /// Creates a scheduling group on the current shard.
+    ///
+    /// \param name name of the group, used in metrics
+    /// \param shares relative share of the CPU (the default group has 1000)
+    scheduling_group(sstring name, unsigned shares);
+    scheduling_group(scheduling_group&&) = delete;
+    ~scheduling_group();
+    const sstring& name() const { return _name; }
+    unsigned shares() const { return _shares; }
+    void set_shares(unsigned shares);
+    /// CPU time used by the group's tasks so far.
+    std::chrono::nanoseconds runtime() const { return _runtime; }
+    /// Time the group spent with runnable tasks while other groups, or the
+    /// reactor's polling, held the CPU.
+    std::chrono::nanoseconds queue_delay() const { return _queue_delay; }
+    /// Number of tasks run in this group so far.
+    uint64_t tasks_processed() const { return _tasks_processed; }
+
+    friend class reactor;
+};
+
+/// Returns the group of the currently running task.
+scheduling_group& current_scheduling_group();
+
+/// Returns this shard's default scheduling group.
+scheduling_group& default_scheduling_group();
+
+/// Runs \c func in a scheduling group.
+///
+/// \c func, and everything it spawns, runs in \c sg.  If \c sg is the
+/// current group, \c func is called immediately; otherwise it is queued in
+/// \c sg as a new task.
+///
+/// \param sg the scheduling group to run in
+/// \param func a callable taking no arguments
+/// \return whatever \c func returns, as a future
+template <typename Func>
+inline
+futurize_t<std::result_of_t<Func()>>
+with_scheduling_group(scheduling_group& sg, Func func) {
+    using futurator = futurize<std::result_of_t<Func()>>;
+    if (&sg == &current_scheduling_group()) {
+        return futurator::apply(std::move(func));
+    }
+    typename futurator::promise_type pr;
+    auto f = pr.get_future();
+    auto t = make_task([pr = std::move(pr), func = std::move(func)] () mutable {
+        futurator::apply(std::move(func)).forward_to(std::move(pr));
+    });
+    t->set_group(&sg);
+    schedule(std::move(t));
+    return f;
+}
+
+/// @}
@@ -43,6 +43,8 @@
 
 #include "sstring.hh"
 #include "future.hh"
+#include <vector>
+#include <experimental/optional>
 
 // iostream.hh
 template <class CharType> class input_stream;
@@ -59,6 +61,7 @@ class file;
 class file_open_options;
 enum class open_flags;
 enum class fs_type;
+struct file_metadata;
 
 // Networking API
 
@@ -254,6 +257,35 @@ future<uint64_t> file_size(sstring name);
 /// \param name name of the file to check
 future<bool> file_exists(sstring name);
 
+/// Returns the metadata of several files in one batch.
+///
+/// The lookups are performed with \c statx() (or \c stat() on older
+/// kernels) in the syscall thread, many paths per round trip, so this is
+/// much cheaper than calling \ref file_size() or \ref file_exists() for
+/// each file.  Symbolic links are followed.
+///
+/// \param names names of the files to look up
+/// \return a vector with an element per name, in order; disengaged if the
+///         file does not exist.  Other errors fail the whole batch.
+future<std::vector<std::experimental::optional<file_metadata>>> stat_files(std::vector<sstring> names);
+
+/// Like \ref stat_files(), but served from a per-shard cache where possible.
+///
+/// Results, including non-existence, are remembered by name until
+/// invalidated with \ref invalidate_file_metadata().  \ref remove_file() and
+/// \ref rename_file() invalidate the names they touch on the calling shard
+/// once the change is made; any other change (writes, changes made by other
+/// shards or processes) must be invalidated explicitly.
+future<std::vector<std::experimental::optional<file_metadata>>> cached_stat_files(std::vector<sstring> names);
+
+/// Drops the cached metadata of a file on this shard.
+///
+/// \param name name of the file, exactly as passed to \ref cached_stat_files()
+void invalidate_file_metadata(const sstring& name);
+
+/// Drops all cached file metadata on this shard.
+void invalidate_file_metadata();
+
 /// Creates a hard link for a file
 ///
 /// \param oldpath existing file name
@@ -27,6 +27,11 @@
 #include <stdexcept>
 #include <exception>
 #include "timer.hh"
+#include "abort_source.hh"
+#include "scollectd.hh"
+#include "sstring.hh"
+#include <array>
+#include <chrono>
 
 /// \addtogroup fiber-module
 /// @{
@@ -53,6 +58,8 @@ class semaphore_timed_out : public std::exception {
     }
 };
 
+struct semaphore_wait_stats;
+
 /// \brief Counted resource guard.
 ///
 /// This is a standard computer science semaphore, adapted
@@ -67,28 +74,98 @@ class semaphore_timed_out : public std::exception {
 /// similar to POSIX's `pthread_cancel()`, with \ref wait() acting
 /// as a cancellation point.
 class semaphore {
+public:
+    using clock = typename timer<>::clock;
+    using time_point = typename timer<>::time_point;
+    using duration = typename timer<>::duration;
 private:
     size_t _count;
+    // Deadline of a timed waiter.  Waiters leave _wait_list only from the
+    // front, so each one is named by its position counted from the first
+    // waiter ever queued; _head_id is the id of _wait_list.front().
+    struct expiry {
+        using time_point = semaphore::time_point;
+        using duration = semaphore::duration;
+        time_point deadline;
+        uint64_t id;
+        bi::list_member_hook<> link;
+        expiry(time_point deadline_, uint64_t id_) : deadline(deadline_), id(id_) {}
+        time_point get_timeout() const { return deadline; }
+        // For timer_set's destructor, which never finds an expiry in it
+        void cancel() { abort(); }
+    };
+    using expiry_set = seastar::timer_set<expiry, &expiry::link>;
+    // The deadlines belong to the waiters; the set lets go of them before
+    // it is destroyed rather than cancel them
+    struct expiry_set_deleter {
+        void operator()(expiry_set* s) const {
+            s->clear();
+            delete s;
+        }
+    };
     struct entry {
         promise<> pr;
         size_t nr;
-        timer<> tr;
-        // points at pointer back to this, to track the entry object as it moves
-        std::unique_ptr<entry*> tracker;
+        time_point queued;
+        seastar::abort_source::subscription sub;
+        // Owned here, as entries move around in _wait_list
+        std::unique_ptr<expiry> exp;
         entry(promise<>&& pr_, size_t nr_) : pr(std::move(pr_)), nr(nr_) {}
-        entry(entry&& x) noexcept
-                : pr(std::move(x.pr)), nr(x.nr), tr(std::move(x.tr)), tracker(std::move(x.tracker)) {
-            if (tracker) {
-                *tracker = this;
-            }
-        }
-        entry** track() {
-            tracker = std::make_unique<entry*>(this);
-            return tracker.get();
-        }
-        entry& operator=(entry&&) noexcept = delete;
     };
     circular_buffer<entry> _wait_list;
+    uint64_t _head_id = 0;
+    size_t _waiters = 0;
+    // Deadlines of the timed waiters still waiting, in the same structure
+    // the reactor keeps its timers in, so adding and removing one is O(1)
+    // whatever the order deadlines come in.  A single timer is armed for
+    // the earliest one.  Allocated with the first timed wait, and held by
+    // pointer so that the semaphore stays movable.
+    std::unique_ptr<expiry_set, expiry_set_deleter> _expiry_set;
+    timer<> _expiry_timer;
+protected:
+    semaphore_wait_stats* _stats = nullptr;
+private:
+    entry* live_entry(uint64_t id) {
+        if (id < _head_id) {
+            return nullptr;
+        }
+        auto& e = _wait_list[id - _head_id];
+        return e.nr ? &e : nullptr;
+    }
+    void pop_front_waiter() {
+        _wait_list.pop_front();
+        ++_head_id;
+    }
+    void arm_expiry_timer(time_point deadline) {
+        // set the callback here rather than at construction, as the
+        // semaphore may have been moved since
+        _expiry_timer.set_callback([this] { expire(); });
+        _expiry_timer.rearm(deadline);
+    }
+    void add_expiry(entry& e, time_point deadline, uint64_t id) {
+        if (!_expiry_set) {
+            _expiry_set.reset(new expiry_set);
+        }
+        e.exp = std::make_unique<expiry>(deadline, id);
+        if (_expiry_set->insert(*e.exp)) {
+            arm_expiry_timer(_expiry_set->get_next_timeout());
+        }
+    }
+    // Called once the waiter no longer waits.  The timer stays armed; if
+    // it fires for nothing, expire() rearms it for what is left.
+    void remove_expiry(entry& e) {
+        if (e.exp && e.exp->link.is_linked()) {
+            _expiry_set->remove(*e.exp);
+        }
+    }
+    void expire();
+    void fail_waiter(entry& e, const std::exception_ptr& ex) {
+        e.pr.set_exception(ex);
+        e.nr = 0;
+        e.sub.unsubscribe();
+        remove_expiry(e);
+        --_waiters;
+    }
 public:
     /// Constructs a semaphore object with a specific number of units
     /// in its internal counter.  The default is 1, suitable for use as
@@ -106,16 +183,7 @@ class semaphore {
     /// \return a future that becomes ready when sufficient units are availble
     ///         to satisfy the request.  If the semaphore was \ref broken(), may
     ///         contain an exception.
-    future<> wait(size_t nr = 1) {
-        if (_count >= nr && _wait_list.empty()) {
-            _count -= nr;
-            return make_ready_future<>();
-        }
-        promise<> pr;
-        auto fut = pr.get_future();
-        _wait_list.push_back(entry(std::move(pr), nr));
-        return fut;
-    }
+    future<> wait(size_t nr = 1);
     /// Waits until at least a specific number of units are available in the
     /// counter, and reduces the counter by that amount of units.  If the request
     /// cannot be satisfied in time, the request is aborted.
@@ -129,22 +197,24 @@ class semaphore {
     ///         to satisfy the request.  On timeout, the future contains a
     ///         \ref semaphore_timed_out exception.  If the semaphore was
     ///         \ref broken(), may contain an exception.
-    future<> wait(typename timer<>::duration timeout, size_t nr = 1) {
+    future<> wait(duration timeout, size_t nr = 1) {
         auto fut = wait(nr);
         if (!fut.available()) {
-            // Since circular_buffer<> can cause objects to move around,
-            // track them via entry::tracker
-            entry** e = _wait_list.back().track();
-            (*e)->tr.set_callback([e, this] {
-                (*e)->pr.set_exception(semaphore_timed_out());
-                (*e)->nr = 0;
-                (*e)->tracker = nullptr;
-                signal(0);
-            });
-            (*e)->tr.arm(timeout);
+            add_expiry(_wait_list.back(), clock::now() + timeout, _head_id + _wait_list.size() - 1);
         }
         return std::move(fut);
     }
+    /// Waits until at least a specific number of units are available in the
+    /// counter, and reduces the counter by that amount of units.  If an abort
+    /// is requested through \c as first, the request is withdrawn.
+    ///
+    /// \param as abort source which can cancel the wait; must outlive it.
+    /// \param nr Amount of units to wait for (default 1).
+    /// \return a future that becomes ready when sufficient units are availble
+    ///         to satisfy the request.  On abort, the future contains a
+    ///         \ref seastar::abort_requested_exception exception.  If the
+    ///         semaphore was \ref broken(), may contain an exception.
+    future<> wait(seastar::abort_source& as, size_t nr = 1);
     /// Deposits a specified number of units into the counter.
     ///
     /// The counter is incremented by the specified number of units.
@@ -154,18 +224,7 @@ class semaphore {
     /// the amount requested.
     ///
     /// \param nr Number of units to deposit (default 1).
-    void signal(size_t nr = 1) {
-        _count += nr;
-        while (!_wait_list.empty() && _wait_list.front().nr <= _count) {
-            auto& x = _wait_list.front();
-            if (x.nr) {
-               _count -= x.nr;
-               x.pr.set_value();
-               x.tr.cancel();
-            }
-            _wait_list.pop_front();
-        }
-    }
+    void signal(size_t nr = 1);
     /// Attempts to reduce the counter value by a specified number of units.
     ///
     /// If sufficient units are available in the counter, and if no
@@ -189,13 +248,16 @@ class semaphore {
     /// Does not take into account any waiters.
     size_t current() const { return _count; }
 
+    /// Returns the number of fibers currently waiting on the semaphore.
+    size_t waiters() const { return _waiters; }
+
     /// Signal to waiters that an error occurred.  \ref wait() will see
     /// an exceptional future<> containing a \ref broken_semaphore exception.
     /// The future is made available immediately.
     ///
     /// This may only be used once per semaphore; after using it the
     /// semaphore is in an indeterminate state and should not be waited on.
-    void broken() { broken(std::make_exception_ptr(broken_semaphore())); }
+    void broken() { broken(cached_exception_ptr<broken_semaphore>()); }
 
     /// Signal to waiters that an error occurred.  \ref wait() will see
     /// an exceptional future<> containing the provided exception parameter.
@@ -217,17 +279,147 @@ class semaphore {
     void broken(std::exception_ptr ex);
 };
 
+/// Wait statistics of a \ref named_semaphore.
+struct semaphore_wait_stats {
+    /// Number of histogram buckets; bucket \c i counts waits shorter than
+    /// 10^(i+1) microseconds, and the last one also counts all longer waits.
+    static constexpr unsigned histogram_buckets = 8;
+    /// Number of waits that had to queue.
+    uint64_t waits = 0;
+    /// Number of queued waits that timed out.
+    uint64_t timeouts = 0;
+    /// Number of queued waits that were aborted.
+    uint64_t aborts = 0;
+    /// Total time spent queued by waits that were satisfied.
+    uint64_t wait_time_us = 0;
+    /// Distribution of the time spent queued by waits that were satisfied.
+    std::array<uint64_t, histogram_buckets> wait_time_histogram{};
+
+    void record_wait(semaphore::duration d) {
+        auto us = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+        wait_time_us += us;
+        unsigned bucket = 0;
+        for (uint64_t limit = 10; bucket < histogram_buckets - 1 && us >= limit; limit *= 10) {
+            ++bucket;
+        }
+        ++wait_time_histogram[bucket];
+    }
+};
+
+inline
+future<>
+semaphore::wait(size_t nr) {
+    if (_count >= nr && _wait_list.empty()) {
+        _count -= nr;
+        return make_ready_future<>();
+    }
+    promise<> pr;
+    auto fut = pr.get_future();
+    _wait_list.push_back(entry(std::move(pr), nr));
+    ++_waiters;
+    if (_stats) {
+        _wait_list.back().queued = clock::now();
+        ++_stats->waits;
+    }
+    return fut;
+}
+
+inline
+future<>
+semaphore::wait(seastar::abort_source& as, size_t nr) {
+    if (as.abort_requested()) {
+        return make_exception_future<>(cached_exception_ptr<seastar::abort_requested_exception>());
+    }
+    auto fut = wait(nr);
+    if (!fut.available()) {
+        auto id = _head_id + _wait_list.size() - 1;
+        _wait_list.back().sub = as.subscribe([this, id] {
+            fail_waiter(*live_entry(id), cached_exception_ptr<seastar::abort_requested_exception>());
+            if (_stats) {
+                ++_stats->aborts;
+            }
+            signal(0);
+        });
+    }
+    return std::move(fut);
+}
+
+inline
+void
+semaphore::signal(size_t nr) {
+    _count += nr;
+    while (!_wait_list.empty() && _wait_list.front().nr <= _count) {
+        auto& x = _wait_list.front();
+        if (x.nr) {
+            _count -= x.nr;
+            x.pr.set_value();
+            --_waiters;
+            remove_expiry(x);
+            if (_stats) {
+                _stats->record_wait(clock::now() - x.queued);
+            }
+        }
+        pop_front_waiter();
+    }
+}
+
+inline
+void
+semaphore::expire() {
+    auto expired = _expiry_set->expire(clock::now());
+    while (!expired.empty()) {
+        auto id = expired.front().id;
+        expired.pop_front();
+        fail_waiter(*live_entry(id), cached_exception_ptr<semaphore_timed_out>());
+        if (_stats) {
+            ++_stats->timeouts;
+        }
+    }
+    if (!_expiry_set->empty()) {
+        arm_expiry_timer(_expiry_set->get_next_timeout());
+    }
+    signal(0);
+}
+
 inline
 void
 semaphore::broken(std::exception_ptr xp) {
     while (!_wait_list.empty()) {
         auto& x = _wait_list.front();
-        x.pr.set_exception(xp);
-        x.tr.cancel();
-        _wait_list.pop_front();
+        if (x.nr) {
+            fail_waiter(x, xp);
+        }
+        pop_front_waiter();
     }
+    _expiry_timer.cancel();
 }
 
+/// A \ref semaphore that keeps \ref semaphore_wait_stats "wait statistics"
+/// and exports them, along with its queue length, to collectd under the
+/// "semaphore" plugin, prefixed by its name.
+///
+/// Unlike \ref semaphore, a named_semaphore cannot be moved.
+class named_semaphore : public semaphore {
+    sstring _name;
+    semaphore_wait_stats _wait_stats;
+    scollectd::registrations _collectd_regs;
+private:
+    void register_collectd_metrics();
+public:
+    /// Constructs a named semaphore on the current shard.
+    ///
+    /// \param name name of the semaphore, used in metrics
+    /// \param count number of initial units present in the counter (default 1).
+    explicit named_semaphore(sstring name, size_t count = 1)
+            : semaphore(count), _name(std::move(name)) {
+        _stats = &_wait_stats;
+        register_collectd_metrics();
+    }
+    named_semaphore(named_semaphore&&) = delete;
+    const sstring& name() const { return _name; }
+    const semaphore_wait_stats& wait_stats() const { return _wait_stats; }
+};
+
 /// @}
 
 #endif /* CORE_SEMAPHORE_HH_ */
@@ -28,6 +28,7 @@
 #include "core/shared_ptr.hh"
 #include "core/reactor.hh"
 #include "core/future.hh"
+#include "core/abort_source.hh"
 
 template <typename Clock = std::chrono::high_resolution_clock, typename Rep, typename Period>
 future<> sleep(std::chrono::duration<Rep, Period> dur) {
@@ -44,3 +45,37 @@ future<> sleep(std::chrono::duration<Rep, Period> dur) {
     future<> fut = s->done.get_future();
     return fut.then([s] { delete s; });
 }
+
+/// Returns a future which completes after a specified time has elapsed,
+/// or fails with \ref seastar::abort_requested_exception as soon as \c as
+/// requests an abort.  On abort the timer is cancelled immediately.
+///
+/// \param dur minimum amount of time before the returned future becomes ready.
+/// \param as abort source which can cut the sleep short; must outlive it.
+template <typename Clock = std::chrono::high_resolution_clock, typename Rep, typename Period>
+future<> sleep_abortable(std::chrono::duration<Rep, Period> dur, seastar::abort_source& as) {
+    if (as.abort_requested()) {
+        return make_exception_future<>(cached_exception_ptr<seastar::abort_requested_exception>());
+    }
+    struct sleeper {
+        promise<> done;
+        timer<Clock> tmr;
+        seastar::abort_source::subscription sub;
+        sleeper(std::chrono::duration<Rep, Period> dur, seastar::abort_source& as)
+            : tmr([this] { done.set_value(); })
+        {
+            sub = as.subscribe([this] {
+                if (tmr.cancel()) {
+                    done.set_exception(cached_exception_ptr<seastar::abort_requested_exception>());
+                }
+            });
+            tmr.arm(dur);
+        }
+    };
+    sleeper *s = new sleeper(dur, as);
+    future<> fut = s->done.get_future();
+    return fut.then_wrapped([s] (future<> f) {
+        delete s;
+        return f;
+    });
+}
@@ -34,6 +34,7 @@
 #include <type_traits>
 #include <experimental/string_view>
 #include "core/temporary_buffer.hh"
+#include "core/format.hh"
 
 template <typename char_type, typename Size, Size max_size>
 class basic_sstring;
@@ -84,44 +85,61 @@ class basic_sstring {
         return string_type(reinterpret_cast<ch_type*>(tmp), len);
     }
 
+    template <typename string_type, typename T>
+    static inline string_type to_sstring_integer(T value) {
+        char tmp[seastar::internal::max_integer_chars];
+        auto end = tmp + sizeof(tmp);
+        auto begin = seastar::internal::format_integer_backward(end, value);
+        using ch_type = typename string_type::value_type;
+        return string_type(reinterpret_cast<ch_type*>(begin), end - begin);
+    }
+
+    template <typename string_type, typename T>
+    static inline string_type to_sstring_floating(T value) {
+        char tmp[seastar::internal::max_floating_chars];
+        auto len = seastar::internal::format_floating(tmp, value) - tmp;
+        using ch_type = typename string_type::value_type;
+        return string_type(reinterpret_cast<ch_type*>(tmp), len);
+    }
+
     template <typename string_type>
     static inline string_type to_sstring(int value) {
-        return to_sstring_sprintf<string_type>(value, "%d");
+        return to_sstring_integer<string_type>(value);
     }
 
     template <typename string_type>
     static inline string_type to_sstring(unsigned value) {
-        return to_sstring_sprintf<string_type>(value, "%u");
+        return to_sstring_integer<string_type>(value);
     }
 
     template <typename string_type>
     static inline string_type to_sstring(long value) {
-        return to_sstring_sprintf<string_type>(value, "%ld");
+        return to_sstring_integer<string_type>(value);
     }
 
     template <typename string_type>
     static inline string_type to_sstring(unsigned long value) {
-        return to_sstring_sprintf<string_type>(value, "%lu");
+        return to_sstring_integer<string_type>(value);
     }
 
     template <typename string_type>
     static inline string_type to_sstring(long long value) {
-        return to_sstring_sprintf<string_type>(value, "%lld");
+        return to_sstring_integer<string_type>(value);
     }
 
     template <typename string_type>
     static inline string_type to_sstring(unsigned long long value) {
-        return to_sstring_sprintf<string_type>(value, "%llu");
+        return to_sstring_integer<string_type>(value);
     }
 
     template <typename string_type>
     static inline string_type to_sstring(float value) {
-        return to_sstring_sprintf<string_type>(value, "%g");
+        return to_sstring_floating<string_type>(value);
     }
 
     template <typename string_type>
     static inline string_type to_sstring(double value) {
-        return to_sstring_sprintf<string_type>(value, "%g");
+        return to_sstring_floating<string_type>(value);
     }
 
     template <typename string_type>
@@ -168,13 +168,15 @@ stream<T...>::produce(T... data) {
         return ret;
     }
     return ret.then_wrapped([this] (auto&& f) {
-        try {
-            f.get();
-        } catch (...) {
-            _done.set_exception(std::current_exception());
+        if (f.failed()) {
+            // Propagate without rethrowing; this is the hot path when a
+            // consumer fails under load.
+            auto ex = f.get_exception();
+            _done.set_exception(ex);
             // FIXME: tell the producer to stop producing
-            throw;
+            return make_exception_future<>(std::move(ex));
         }
+        return make_ready_future<>();
     });
 }
 
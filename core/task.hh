@@ -23,10 +23,19 @@
 
 #include <memory>
 
+class scheduling_group;
+
+// The scheduling group whose tasks are currently running on this shard
+// (nullptr stands for the default group).  New tasks join this group.
+extern __thread scheduling_group* g_current_scheduling_group;
+
 class task {
+    scheduling_group* _sg = g_current_scheduling_group;
 public:
     virtual ~task() noexcept {}
     virtual void run() noexcept = 0;
+    scheduling_group* group() const { return _sg; }
+    void set_group(scheduling_group* sg) { _sg = sg; }
 };
 
 void schedule(std::unique_ptr<task> t);
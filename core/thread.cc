@@ -22,8 +22,12 @@
 
 #include "thread.hh"
 #include "posix.hh"
+#include "align.hh"
+#include "memory.hh"
 #include <ucontext.h>
+#include <sys/mman.h>
 #include <algorithm>
+#include <unordered_map>
 
 /// \cond internal
 
@@ -38,12 +42,78 @@ thread_context::thread_context(thread_attributes attr, std::function<void ()> fu
     setup();
 }
 
-std::unique_ptr<char[]>
-thread_context::make_stack() {
-    auto stack = std::make_unique<char[]>(_stack_size);
+// Thread stacks are mmap()ed with a PROT_NONE guard page below them, so
+// that an overflow faults instead of silently corrupting the heap.  Since
+// mapping and unmapping costs much more than the short-lived threads that
+// seastar::async() typically runs, freed stacks are kept in a per-shard
+// pool and reused.
+class stack_pool {
+    static constexpr size_t guard_size = memory::page_size;
+    static constexpr size_t max_pooled_bytes = 8 << 20;
+    std::unordered_map<size_t, std::vector<char*>> _free;
+    size_t _pooled_bytes = 0;
+public:
+    ~stack_pool() {
+        for (auto&& sizes : _free) {
+            for (auto stack : sizes.second) {
+                unmap(stack, sizes.first);
+            }
+        }
+    }
+    char* get(size_t size) {
+        auto i = _free.find(size);
+        if (i == _free.end() || i->second.empty()) {
+            return map(size);
+        }
+        auto stack = i->second.back();
+        i->second.pop_back();
+        _pooled_bytes -= size;
+        return stack;
+    }
+    void put(char* stack, size_t size) noexcept {
+        if (_pooled_bytes + size > max_pooled_bytes) {
+            unmap(stack, size);
+            return;
+        }
+        try {
+            _free[size].push_back(stack);
+            _pooled_bytes += size;
+        } catch (...) {
+            unmap(stack, size);
+        }
+    }
+private:
+    static char* map(size_t size) {
+        auto p = ::mmap(nullptr, guard_size + size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+        throw_system_error_on(p == MAP_FAILED, "mmap");
+        auto r = ::mprotect(p, guard_size, PROT_NONE);
+        if (r == -1) {
+            auto e = errno;
+            ::munmap(p, guard_size + size);
+            throw std::system_error(e, std::system_category(), "mprotect");
+        }
+        return static_cast<char*>(p) + guard_size;
+    }
+    static void unmap(char* stack, size_t size) noexcept {
+        ::munmap(stack - guard_size, guard_size + size);
+    }
+};
+
+static thread_local stack_pool g_stack_pool;
+
+void
+thread_context::stack_deleter::operator()(char* stack) const noexcept {
+    g_stack_pool.put(stack, size);
+}
+
+thread_context::stack_holder
+thread_context::make_stack(size_t size) {
+    size = align_up(size, memory::page_size);
+    auto stack = stack_holder(g_stack_pool.get(size), stack_deleter{size});
 #ifdef DEBUG
     // Avoid ASAN false positive due to garbage on stack
-    std::fill_n(stack.get(), _stack_size, 0);
+    std::fill_n(stack.get(), size, 0);
 #endif
     return stack;
 }
@@ -59,7 +129,7 @@ thread_context::setup() {
     auto r = getcontext(&initial_context);
     throw_system_error_on(r == -1);
     initial_context.uc_stack.ss_sp = _stack.get();
-    initial_context.uc_stack.ss_size = _stack_size;
+    initial_context.uc_stack.ss_size = _stack.get_deleter().size;
     initial_context.uc_link = nullptr;
     makecontext(&initial_context, main, 2, int(q), int(q >> 32));
     auto prev = g_current_context;
@@ -84,6 +84,9 @@ class thread_context;
 class thread_attributes {
 public:
     thread_scheduling_group* scheduling_group = nullptr;
+    /// Size of the thread's stack, in bytes.  Rounded up to a whole number
+    /// of pages; a guard page below the stack catches overflows.
+    size_t stack_size = 128*1024;
 };
 
 namespace thread_impl {
@@ -107,9 +110,15 @@ extern thread_local jmp_buf_link g_unthreaded_context;
 // \c thread itself because \c thread is movable, and we want pointers
 // to this state to be captured.
 class thread_context {
+    // Returns the stack to the per-shard pool it was taken from.
+    struct stack_deleter {
+        size_t size;
+        void operator()(char* stack) const noexcept;
+    };
+    using stack_holder = std::unique_ptr<char[], stack_deleter>;
+
     thread_attributes _attr;
-    static constexpr size_t _stack_size = 128*1024;
-    std::unique_ptr<char[]> _stack{make_stack()};
+    stack_holder _stack{make_stack(_attr.stack_size)};
     std::function<void ()> _func;
     jmp_buf_link _context;
     promise<> _done;
@@ -120,7 +129,7 @@ class thread_context {
     static void s_main(unsigned int lo, unsigned int hi);
     void setup();
     void main();
-    static std::unique_ptr<char[]> make_stack();
+    static stack_holder make_stack(size_t size);
 public:
     thread_context(thread_attributes attr, std::function<void ()> func);
     void switch_in();
@@ -227,34 +236,25 @@ thread::join() {
 /// which allows it to block (using \ref future::get()).  The
 /// result of the callable is returned as a future.
 ///
+/// \param attr a \ref thread_attributes instance
 /// \param func a callable to be executed in a thread
 /// \param args a parameter pack to be forwarded to \c func.
 /// \return whatever \c func returns, as a future.
-///
-/// Example:
-/// \code
-///    future<int> compute_sum(int a, int b) {
-///        return seastar::async([a, b] {
-///            // some blocking code:
-///            sleep(1s).get();
-///            return a + b;
-///        });
-///    }
-/// \endcode
 template <typename Func, typename... Args>
 inline
 futurize_t<std::result_of_t<std::decay_t<Func>(std::decay_t<Args>...)>>
-async(Func&& func, Args&&... args) {
+async(thread_attributes attr, Func&& func, Args&&... args) {
     using return_type = std::result_of_t<std::decay_t<Func>(std::decay_t<Args>...)>;
     struct work {
+        thread_attributes attr;
         Func func;
         std::tuple<Args...> args;
         promise<return_type> pr;
         thread th;
     };
-    return do_with(work{std::forward<Func>(func), std::forward_as_tuple(std::forward<Args>(args)...)}, [] (work& w) mutable {
+    return do_with(work{std::move(attr), std::forward<Func>(func), std::forward_as_tuple(std::forward<Args>(args)...)}, [] (work& w) mutable {
         auto ret = w.pr.get_future();
-        w.th = thread([&w] {
+        w.th = thread(std::move(w.attr), [&w] {
             futurize<return_type>::apply(std::move(w.func), std::move(w.args)).forward_to(std::move(w.pr));
         });
         return w.th.join().then([ret = std::move(ret)] () mutable {
@@ -263,6 +263,33 @@ async(Func&& func, Args&&... args) {
     });
 }
 
+/// Executes a callable in a seastar thread.
+///
+/// Runs a block of code in a threaded context,
+/// which allows it to block (using \ref future::get()).  The
+/// result of the callable is returned as a future.
+///
+/// \param func a callable to be executed in a thread
+/// \param args a parameter pack to be forwarded to \c func.
+/// \return whatever \c func returns, as a future.
+///
+/// Example:
+/// \code
+///    future<int> compute_sum(int a, int b) {
+///        return seastar::async([a, b] {
+///            // some blocking code:
+///            sleep(1s).get();
+///            return a + b;
+///        });
+///    }
+/// \endcode
+template <typename Func, typename... Args>
+inline
+futurize_t<std::result_of_t<std::decay_t<Func>(std::decay_t<Args>...)>>
+async(Func&& func, Args&&... args) {
+    return async(thread_attributes{}, std::forward<Func>(func), std::forward<Args>(args)...);
+}
+
 /// @}
 
 }
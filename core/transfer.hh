@@ -36,14 +36,15 @@
 
 #include <type_traits>
 #include <utility>
+#include <memory>
 
 template <typename T, typename Alloc>
 inline
 void
 transfer_pass1(Alloc& a, T* from, T* to,
         typename std::enable_if<std::is_nothrow_move_constructible<T>::value>::type* = nullptr) {
-    a.construct(to, std::move(*from));
-    a.destroy(from);
+    std::allocator_traits<Alloc>::construct(a, to, std::move(*from));
+    std::allocator_traits<Alloc>::destroy(a, from);
 }
 
 template <typename T, typename Alloc>
@@ -58,7 +59,7 @@ inline
 void
 transfer_pass1(Alloc& a, T* from, T* to,
         typename std::enable_if<!std::is_nothrow_move_constructible<T>::value>::type* = nullptr) {
-    a.construct(to, *from);
+    std::allocator_traits<Alloc>::construct(a, to, *from);
 }
 
 template <typename T, typename Alloc>
@@ -66,7 +67,7 @@ inline
 void
 transfer_pass2(Alloc& a, T* from, T* to,
         typename std::enable_if<!std::is_nothrow_move_constructible<T>::value>::type* = nullptr) {
-    a.destroy(from);
+    std::allocator_traits<Alloc>::destroy(a, from);
 }
 
 #endif /* TRANSFER_HH_ */
@@ -92,6 +92,66 @@ struct reader {
     }
 };
 
+/**
+ * Streams a file into the connection output stream without copying it.
+ * The file is read with DMA, and each buffer is handed over to the
+ * output stream as is, so at most buffer_size * (read_ahead + 2) bytes
+ * of the file are held in memory at any given time.
+ */
+struct streamer {
+    static constexpr size_t buffer_size = 32 * 1024;
+    streamer(file f, uint64_t length)
+            : is(make_file_input_stream(std::move(f), options())), remain(length) {
+    }
+    input_stream<char> is;
+    // bytes promised by Content-Length that were not sent yet
+    uint64_t remain;
+
+    static file_input_stream_options options() {
+        file_input_stream_options opts;
+        opts.buffer_size = buffer_size;
+        opts.read_ahead = 1;
+        return opts;
+    }
+
+    future<> write(output_stream<char>& out) {
+        return do_until([this] { return !remain || is.eof(); }, [this, &out] {
+            return is.read().then([this, &out] (temporary_buffer<char> buf) {
+                // the file may have grown since we sent the headers
+                if (buf.size() > remain) {
+                    buf.trim(remain);
+                }
+                remain -= buf.size();
+                return out.write(std::move(buf));
+            });
+        }).then([this] {
+            // The file shrank since we sent the headers.  The body cannot
+            // be completed, so fail the reply, which closes the connection
+            // rather than leaving the client to read the next response as
+            // the rest of this one.
+            if (remain) {
+                throw std::runtime_error("file shrank while being sent");
+            }
+        });
+    }
+};
+
+static future<std::unique_ptr<reply>> stream_file(file f,
+        std::unique_ptr<reply> rep) {
+    return f.size().then([f, rep = std::move(rep)] (uint64_t size) mutable {
+        rep->write_body(size, [f, size] (output_stream<char>& out) {
+            auto s = make_lw_shared<streamer>(f, size);
+            return s->write(out).finally([s, f] () mutable {
+                return s->is.close().finally([f] () mutable {
+                    return f.close();
+                });
+            });
+        });
+        rep->done();
+        return make_ready_future<std::unique_ptr<reply>>(std::move(rep));
+    });
+}
+
 future<std::unique_ptr<reply>> file_interaction_handler::read(
         const sstring& file_name, std::unique_ptr<request> req,
         std::unique_ptr<reply> rep) {
@@ -99,6 +159,10 @@ future<std::unique_ptr<reply>> file_interaction_handler::read(
     rep->set_content_type(extension);
     return engine().open_file_dma(file_name, open_flags::ro).then(
             [rep = std::move(rep), extension, this, req = std::move(req)](file f) mutable {
+                if (transformer == nullptr) {
+                    // nothing to modify, send the file as is
+                    return stream_file(std::move(f), std::move(rep));
+                }
                 std::shared_ptr<reader> r = std::make_shared<reader>(std::move(f), std::move(rep));
 
                 return r->is.consume(*r).then([r, extension, this, req = std::move(req)]() {
@@ -32,7 +32,9 @@
 #pragma once
 
 #include "core/sstring.hh"
+#include "core/iostream.hh"
 #include <unordered_map>
+#include <functional>
 #include "http/mime_types.hh"
 
 namespace httpd {
@@ -73,6 +75,15 @@ struct reply {
      */
     sstring _content;
 
+    /**
+     * A function that streams the body directly into the connection's
+     * output stream. When set, it is used instead of _content, and
+     * _content_length holds the number of bytes it is going to write.
+     */
+    using body_writer_type = std::function<future<>(output_stream<char>&)>;
+    body_writer_type _body_writer;
+    uint64_t _content_length = 0;
+
     sstring _response_line;
     reply()
             : _status(status_type::ok) {
@@ -115,6 +126,26 @@ struct reply {
         return *this;
     }
 
+    /**
+     * Stream the body instead of holding it in memory.
+     * The writer is called once the headers were written, and must write
+     * exactly length bytes to the output stream.
+     * @param length the body length, used for the Content-Length header
+     * @param writer the function that writes the body
+     */
+    reply& write_body(uint64_t length, body_writer_type writer) {
+        _content_length = length;
+        _body_writer = std::move(writer);
+        return *this;
+    }
+
+    /**
+     * The length of the body that would be sent with the reply
+     */
+    uint64_t content_length() const {
+        return _body_writer ? _content_length : _content.size();
+    }
+
     reply& done(const sstring& content_type) {
         return set_content_type(content_type).done();
     }
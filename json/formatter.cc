@@ -38,11 +38,11 @@ sstring formatter::to_json(const char* str) {
 }
 
 sstring formatter::to_json(int n) {
-    return to_string(n);
+    return to_sstring(n);
 }
 
 sstring formatter::to_json(long n) {
-    return to_string(n);
+    return to_sstring(n);
 }
 
 sstring formatter::to_json(float f) {
@@ -80,7 +80,7 @@ sstring formatter::to_json(const jsonable& obj) {
 }
 
 sstring formatter::to_json(unsigned long l) {
-    return to_string(l);
+    return to_sstring(l);
 }
 
 }
@@ -141,6 +141,11 @@ class udp_channel {
     udp_channel() {}
     udp_channel(std::unique_ptr<udp_channel_impl> impl) : _impl(std::move(impl)) {}
     future<udp_datagram> receive() { return _impl->receive(); }
+    // The returned future resolves once the datagram is accepted for
+    // sending, which may be before it reaches the network; it waits while
+    // too much is already waiting to go out.  Like the network, the stack
+    // may still drop the datagram, and errors sending it are not reported.
+    // Sends waiting for room may fail once the channel is closed.
     future<> send(ipv4_addr dst, const char* msg) { return _impl->send(std::move(dst), msg); }
     future<> send(ipv4_addr dst, packet p) { return _impl->send(std::move(dst), std::move(p)); }
     bool is_closed() const { return _impl->is_closed(); }
@@ -0,0 +1,183 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#include "gro.hh"
+#include "ip.hh"
+#include "ip_checksum.hh"
+#include "tcp.hh"
+#include <algorithm>
+#include <cstddef>
+
+namespace net {
+
+gro::gro(deliver_fn deliver, bool csum_offload)
+    : _deliver(std::move(deliver)), _csum_offload(csum_offload) {
+    _flows.reserve(max_flows);
+}
+
+void gro::receive(packet p, ethernet_address from) {
+    auto iph = p.get_header<ip_hdr>(0);
+    if (!iph || iph->ip_proto != uint8_t(ip_protocol_num::tcp)) {
+        _deliver(std::move(p), from);
+        return;
+    }
+    auto src_ip = iph->src_ip;
+    auto dst_ip = iph->dst_ip;
+    auto th = p.get_header<tcp_hdr>(iph->ihl * 4);
+    if (!th) {
+        _deliver(std::move(p), from);
+        return;
+    }
+    // Compared in network byte order
+    uint16_t src_port = th->src_port;
+    uint16_t dst_port = th->dst_port;
+    auto f = std::find_if(_flows.begin(), _flows.end(), [&] (flow& f) {
+        auto fiph = f.p.get_header<ip_hdr>(0);
+        auto fth = f.p.get_header<tcp_hdr>(sizeof(ip_hdr));
+        return fth->src_port == src_port && fth->dst_port == dst_port
+                && fiph->src_ip == src_ip && fiph->dst_ip == dst_ip;
+    });
+
+    if (!mergeable(p)) {
+        if (f != _flows.end()) {
+            flush(f);
+        }
+        _deliver(std::move(p), from);
+        return;
+    }
+    p.offload_info_ref().csum_verified = true;
+    auto h = ntoh(*p.get_header<tcp_hdr>(sizeof(ip_hdr)));
+    if (f != _flows.end()) {
+        if (append(*f, p)) {
+            // The sender wants what it has sent so far seen now
+            if (h.f_psh) {
+                flush(f);
+            }
+            return;
+        }
+        flush(f);
+    }
+    if (h.f_psh) {
+        _deliver(std::move(p), from);
+        return;
+    }
+    if (_flows.size() == max_flows) {
+        flush(_flows.begin());
+    }
+    uint16_t hdr_len = sizeof(ip_hdr) + h.data_offset * 4;
+    // Made contiguous now, so that the header pointers we take later stay
+    // good however we look at them
+    p.get_header(0, hdr_len);
+    uint32_t next_seq = tcp_seq(h.seq).raw + (p.len() - hdr_len);
+    _flows.push_back(flow{std::move(p), from, hdr_len, next_seq, 1});
+}
+
+// Whether p is a segment that may be merged with others: one with no IP
+// options or fragmentation, carrying data and an ACK but no other flags
+// than PSH, with good checksums
+bool gro::mergeable(packet& p) {
+    auto iph = p.get_header<ip_hdr>(0);
+    if (iph->ver != 4 || iph->ihl != sizeof(ip_hdr) / 4) {
+        return false;
+    }
+    auto ip = ntoh(*iph);
+    if (ip.mf() || ip.offset() || ip.len != p.len()) {
+        return false;
+    }
+    auto th = p.get_header<tcp_hdr>(sizeof(ip_hdr));
+    size_t tcp_hdr_len = th->data_offset * 4;
+    if (tcp_hdr_len < sizeof(tcp_hdr) || ip.len <= sizeof(ip_hdr) + tcp_hdr_len) {
+        return false;
+    }
+    if (!th->f_ack || th->f_syn || th->f_fin || th->f_rst || th->f_urg || th->rsvd2) {
+        return false;
+    }
+    if (_csum_offload) {
+        return true;
+    }
+    if (ip_checksum(p.get_header<ip_hdr>(0), sizeof(ip_hdr)) != 0) {
+        return false;
+    }
+    checksummer csum;
+    ipv4_traits::tcp_pseudo_header_checksum(csum, ip.src_ip, ip.dst_ip, ip.len - sizeof(ip_hdr));
+    size_t skip = sizeof(ip_hdr);
+    for (auto&& f : p.fragments()) {
+        if (skip < f.size) {
+            csum.sum(f.base + skip, f.size - skip);
+        }
+        skip -= std::min(skip, f.size);
+    }
+    return csum.get() == 0;
+}
+
+// Appends p's payload to f, if it carries on where f ends and its headers
+// are the same but for the lengths, IP id, window and checksums
+bool gro::append(flow& f, packet& p) {
+    auto h = ntoh(*p.get_header<tcp_hdr>(sizeof(ip_hdr)));
+    size_t data_len = p.len() - f.hdr_len;
+    if (sizeof(ip_hdr) + h.data_offset * 4 != f.hdr_len || tcp_seq(h.seq).raw != f.next_seq
+            || f.p.len() + data_len > ip_packet_len_max) {
+        return false;
+    }
+    auto hdr = p.get_header(0, f.hdr_len);
+    auto fhdr = f.p.get_header(0, f.hdr_len);
+    auto same = [hdr, fhdr] (size_t from, size_t to) {
+        return std::equal(hdr + from, hdr + to, fhdr + from);
+    };
+    const size_t tcp_off = sizeof(ip_hdr);
+    if (!same(0, offsetof(ip_hdr, len))
+            || !same(offsetof(ip_hdr, frag), offsetof(ip_hdr, csum))
+            || !same(offsetof(ip_hdr, src_ip), sizeof(ip_hdr))
+            || !same(tcp_off + offsetof(tcp_hdr, ack), tcp_off + offsetof(tcp_hdr, ack) + 4)
+            || !same(tcp_off + sizeof(tcp_hdr), f.hdr_len)) {
+        return false;
+    }
+    // Latest window and push
+    auto fth = reinterpret_cast<tcp_hdr*>(fhdr + tcp_off);
+    fth->window = hton(uint16_t(h.window));
+    fth->f_psh = h.f_psh;
+    p.trim_front(f.hdr_len);
+    f.p.append(std::move(p));
+    f.next_seq += data_len;
+    ++f.segments;
+    return true;
+}
+
+void gro::flush(std::vector<flow>::iterator f) {
+    auto p = std::move(f->p);
+    auto from = f->from;
+    if (f->segments > 1) {
+        auto iph = p.get_header<ip_hdr>(0);
+        iph->len = hton(uint16_t(p.len()));
+        iph->csum = 0;
+        iph->csum = ip_checksum(iph, sizeof(*iph));
+    }
+    _flows.erase(f);
+    _deliver(std::move(p), from);
+}
+
+void gro::flush() {
+    while (!_flows.empty()) {
+        flush(_flows.begin());
+    }
+}
+
+}
@@ -0,0 +1,72 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#ifndef GRO_HH_
+#define GRO_HH_
+
+#include "ethernet.hh"
+#include "packet.hh"
+#include <functional>
+#include <vector>
+
+namespace net {
+
+// Software receive offload.  IPv4 packets received in a batch are passed
+// through receive(); consecutive in-order TCP segments of a flow that
+// carry nothing but data and an ACK are held back, and merged into one
+// packet with a fragment per segment, as LRO would have.  flush() hands
+// on whatever is held at the end of the batch.
+//
+// Packets of a flow are delivered in the order they were received.  Only
+// segments whose checksums were found good are merged, and the merged
+// packet is marked so that they are not checked again.
+class gro {
+public:
+    using deliver_fn = std::function<void (packet, ethernet_address)>;
+private:
+    struct flow {
+        packet p;
+        ethernet_address from;
+        uint16_t hdr_len;
+        uint32_t next_seq;
+        unsigned segments;
+    };
+    // Few flows send enough in a single batch to be worth merging
+    static constexpr size_t max_flows = 8;
+    std::vector<flow> _flows;
+    deliver_fn _deliver;
+    bool _csum_offload;
+public:
+    // csum_offload says whether the device checked the checksums already
+    gro(deliver_fn deliver, bool csum_offload);
+    // p starts with the IP header
+    void receive(packet p, ethernet_address from);
+    void flush();
+    bool empty() const { return _flows.empty(); }
+private:
+    bool mergeable(packet& p);
+    bool append(flow& f, packet& p);
+    void flush(std::vector<flow>::iterator f);
+};
+
+}
+
+#endif
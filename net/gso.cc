@@ -0,0 +1,109 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#include "gso.hh"
+#include "ip.hh"
+#include "tcp.hh"
+#include "ip_checksum.hh"
+#include <cstddef>
+
+namespace net {
+
+void gso_segment(packet p, const hw_features& hw, circular_buffer<packet>& out) {
+    auto oi = p.offload_info();
+    auto mss = oi.tso_seg_size;
+    oi.tso_seg_size = 0;
+    const size_t ip_off = sizeof(eth_hdr);
+    auto iph = ntoh(*p.get_header<ip_hdr>(ip_off));
+    const size_t ip_hdr_len = iph.ihl * 4;
+    const size_t tcp_off = ip_off + ip_hdr_len;
+    auto th = ntoh(*p.get_header<tcp_hdr>(tcp_off));
+    const size_t tcp_hdr_len = th.data_offset * 4;
+    const size_t hdr_len = tcp_off + tcp_hdr_len;
+    // Header template, copied in front of each segment's payload
+    char hdr[sizeof(eth_hdr) + ipv4_hdr_len_max + tcp_hdr_len_max];
+    std::copy_n(p.get_header(0, hdr_len), hdr_len, hdr);
+    auto ip = hdr + ip_off;
+    auto tcp = hdr + tcp_off;
+    const uint32_t data_len = p.len() - hdr_len;
+    auto payload = p.share(hdr_len, data_len);
+
+    // Each segment's headers differ from the template only in the IP
+    // length, id and checksum, and the TCP sequence number, flags and
+    // checksum: sum the rest once
+    checksummer ip_csum;
+    ip_csum.sum(ip, offsetof(ip_hdr, len));
+    ip_csum.sum(ip + offsetof(ip_hdr, frag), offsetof(ip_hdr, csum) - offsetof(ip_hdr, frag));
+    ip_csum.sum(ip + offsetof(ip_hdr, src_ip), ip_hdr_len - offsetof(ip_hdr, src_ip));
+    // The TCP checksum field holds the pseudo header sum, less its length
+    checksummer pseudo_csum;
+    pseudo_csum.sum(uint16_t(th.checksum));
+    auto tcp_csum = pseudo_csum;
+    const size_t tcp_flags = offsetof(tcp_hdr, ack) + 4;
+    tcp_csum.sum(tcp, offsetof(tcp_hdr, seq));
+    tcp_csum.sum(tcp + offsetof(tcp_hdr, ack), tcp_flags - offsetof(tcp_hdr, ack));
+    tcp_csum.sum(tcp + offsetof(tcp_hdr, window), offsetof(tcp_hdr, checksum) - offsetof(tcp_hdr, window));
+    tcp_csum.sum(tcp + offsetof(tcp_hdr, urgent), tcp_hdr_len - offsetof(tcp_hdr, urgent));
+
+    uint16_t id = iph.id;
+    for (uint32_t off = 0; off < data_len; off += mss) {
+        auto len = std::min(uint32_t(mss), data_len - off);
+        auto seg = payload.share(off, len);
+        auto h = seg.prepend_uninitialized_header(hdr_len);
+        std::copy_n(hdr, hdr_len, h);
+        auto seg_iph = reinterpret_cast<ip_hdr*>(h + ip_off);
+        auto seg_th = reinterpret_cast<tcp_hdr*>(h + tcp_off);
+
+        seg_iph->len = hton(uint16_t(ip_hdr_len + tcp_hdr_len + len));
+        seg_iph->id = hton(id++);
+        if (!hw.tx_csum_ip_offload) {
+            auto ip_seg_csum = ip_csum;
+            ip_seg_csum.sum(h + ip_off + offsetof(ip_hdr, len), offsetof(ip_hdr, frag) - offsetof(ip_hdr, len));
+            seg_iph->csum = ip_seg_csum.get();
+        }
+
+        seg_th->seq = hton(th.seq + off);
+        // FIN and PSH belong to the last segment only
+        if (off + len < data_len) {
+            seg_th->f_fin = false;
+            seg_th->f_psh = false;
+        }
+        if (hw.tx_csum_l4_offload) {
+            // Left for the device to complete, as with TSO
+            auto csum = pseudo_csum;
+            csum.sum(uint16_t(tcp_hdr_len + len));
+            seg_th->checksum = ~csum.get();
+        } else {
+            auto csum = tcp_csum;
+            csum.sum(uint16_t(tcp_hdr_len + len));
+            csum.sum(h + tcp_off + offsetof(tcp_hdr, seq), offsetof(tcp_hdr, ack) - offsetof(tcp_hdr, seq));
+            csum.sum(h + tcp_off + tcp_flags, offsetof(tcp_hdr, window) - tcp_flags);
+            // Last, as it may be of odd length
+            csum.sum(payload.share(off, len));
+            seg_th->checksum = csum.get();
+        }
+
+        seg.set_offload_info(oi);
+        out.push_back(std::move(seg));
+    }
+}
+
+}
@@ -0,0 +1,42 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#ifndef GSO_HH_
+#define GSO_HH_
+
+#include "core/circular_buffer.hh"
+#include "net.hh"
+#include "packet.hh"
+
+namespace net {
+
+// Software TCP segmentation offload.  p is an ethernet frame carrying a
+// TCP/IPv4 segment with offload_info::tso_seg_size set, built the way it
+// would be for a device doing TSO: the TCP checksum field holds the sum
+// of the pseudo header without its length.  Appends to out a frame for
+// every tso_seg_size bytes of payload, each with a copy of the original
+// headers, fixed up for it.  Checksums are completed, or left to the
+// device, according to hw.
+void gso_segment(packet p, const hw_features& hw, circular_buffer<packet>& out);
+
+}
+
+#endif
@@ -430,10 +430,12 @@ struct l4connid<InetTraits>::connid_hash : private std::hash<ipaddr>, private st
     size_t operator()(const l4connid<InetTraits>& id) const noexcept {
         using h1 = std::hash<ipaddr>;
         using h2 = std::hash<uint16_t>;
-        return h1::operator()(id.local_ip)
-            ^ h1::operator()(id.foreign_ip)
-            ^ h2::operator()(id.local_port)
-            ^ h2::operator()(id.foreign_port);
+        // Addresses and ports in fields of their own, so that they do not
+        // cancel each other out: many peers sharing a port, or a peer
+        // using many ports, are the common case
+        uint64_t ips = uint64_t(h1::operator()(id.local_ip)) << 32 | uint32_t(h1::operator()(id.foreign_ip));
+        uint64_t ports = uint64_t(h2::operator()(id.local_port)) << 16 | uint16_t(h2::operator()(id.foreign_port));
+        return ips ^ ports * 0x9e3779b97f4a7c15ULL;
     }
 };
 
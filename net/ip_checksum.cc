@@ -22,15 +22,93 @@
 #include "ip_checksum.hh"
 #include "net.hh"
 #include <arpa/inet.h>
+#include <cstring>
+#include <immintrin.h>
 
 namespace net {
 
-void checksummer::sum(const char* data, size_t len) {
-    auto orig_len = len;
-    if (odd) {
-        csum += uint8_t(*data++);
-        --len;
+namespace ip_checksum_impl {
+
+static inline uint16_t fold(__int128 csum) {
+    __int128 csum1 = (csum & 0xffff'ffff'ffff'ffff) + (csum >> 64);
+    uint64_t csum2 = (csum1 & 0xffff'ffff'ffff'ffff) + (csum1 >> 64);
+    csum2 = (csum2 & 0xffff) + ((csum2 >> 16) & 0xffff) + ((csum2 >> 32) & 0xffff) + (csum2 >> 48);
+    csum2 = (csum2 & 0xffff) + (csum2 >> 16);
+    csum2 = (csum2 & 0xffff) + (csum2 >> 16);
+    return csum2;
+}
+
+static inline uint64_t add_carry(uint64_t a, uint64_t b) {
+    a += b;
+    return a + (a < b);
+}
+
+// The vector implementations sum little endian words, which are cheaper to
+// load.  The ones' complement sum of byte swapped words is the byte swapped
+// sum (RFC 1071 2.(B)), so swapping the folded result yields the big
+// endian sum.
+static inline uint16_t fold_swap(uint64_t s) {
+    s = (s & 0xffff'ffff) + (s >> 32);
+    s = (s & 0xffff'ffff) + (s >> 32);
+    s = (s & 0xffff) + (s >> 16);
+    s = (s & 0xffff) + (s >> 16);
+    return (s >> 8) | ((s & 0xff) << 8);
+}
+
+// What is left after the vector loop, less than a vector's worth
+template <bool Copy>
+static inline uint64_t sum_tail(char* dst, const char* src, size_t len) {
+    uint64_t s = 0;
+    for (; len >= 8; len -= 8, src += 8) {
+        uint64_t v;
+        std::memcpy(&v, src, 8);
+        if (Copy) {
+            std::memcpy(dst, &v, 8);
+            dst += 8;
+        }
+        s = add_carry(s, v);
+    }
+    if (len >= 4) {
+        uint32_t v;
+        std::memcpy(&v, src, 4);
+        if (Copy) {
+            std::memcpy(dst, &v, 4);
+            dst += 4;
+        }
+        s = add_carry(s, v);
+        len -= 4;
+        src += 4;
+    }
+    if (len >= 2) {
+        uint16_t v;
+        std::memcpy(&v, src, 2);
+        if (Copy) {
+            std::memcpy(dst, &v, 2);
+            dst += 2;
+        }
+        s = add_carry(s, v);
+        len -= 2;
+        src += 2;
     }
+    if (len) {
+        if (Copy) {
+            *dst = *src;
+        }
+        s = add_carry(s, uint8_t(*src));
+    }
+    return s;
+}
+
+bool has_avx2() {
+    static const bool ret = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }();
+    return ret;
+}
+
+uint16_t sum_scalar(const char* data, size_t len) {
+    __int128 csum = 0;
     auto p64 = reinterpret_cast<const packed<uint64_t>*>(data);
     while (len >= 8) {
         csum += ntohq(*p64++);
@@ -46,16 +124,136 @@ void checksummer::sum(const char* data, size_t len) {
         csum += *p8++ << 8;
         len -= 1;
     }
+    return fold(csum);
+}
+
+// Each 32-bit word is added to a 64-bit lane, where it cannot overflow
+template <bool Copy>
+static inline uint16_t sse2_sum(char* dst, const char* src, size_t len) {
+    const auto zero = _mm_setzero_si128();
+    auto a0 = zero, a1 = zero, a2 = zero, a3 = zero;
+    for (; len >= 32; len -= 32, src += 32) {
+        auto v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        auto v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+        if (Copy) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), v0);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), v1);
+            dst += 32;
+        }
+        a0 = _mm_add_epi64(a0, _mm_unpacklo_epi32(v0, zero));
+        a1 = _mm_add_epi64(a1, _mm_unpackhi_epi32(v0, zero));
+        a2 = _mm_add_epi64(a2, _mm_unpacklo_epi32(v1, zero));
+        a3 = _mm_add_epi64(a3, _mm_unpackhi_epi32(v1, zero));
+    }
+    auto a = _mm_add_epi64(_mm_add_epi64(a0, a1), _mm_add_epi64(a2, a3));
+    uint64_t s = add_carry(_mm_cvtsi128_si64(a), _mm_cvtsi128_si64(_mm_unpackhi_epi64(a, a)));
+    return fold_swap(add_carry(s, sum_tail<Copy>(dst, src, len)));
+}
+
+uint16_t sum_sse2(const char* data, size_t len) {
+    return sse2_sum<false>(nullptr, data, len);
+}
+
+template <bool Copy>
+__attribute__((target("avx2")))
+static inline uint16_t avx2_sum(char* dst, const char* src, size_t len) {
+    const auto zero = _mm256_setzero_si256();
+    auto a0 = zero, a1 = zero, a2 = zero, a3 = zero;
+    for (; len >= 64; len -= 64, src += 64) {
+        auto v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+        auto v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 32));
+        if (Copy) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), v0);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 32), v1);
+            dst += 64;
+        }
+        a0 = _mm256_add_epi64(a0, _mm256_unpacklo_epi32(v0, zero));
+        a1 = _mm256_add_epi64(a1, _mm256_unpackhi_epi32(v0, zero));
+        a2 = _mm256_add_epi64(a2, _mm256_unpacklo_epi32(v1, zero));
+        a3 = _mm256_add_epi64(a3, _mm256_unpackhi_epi32(v1, zero));
+    }
+    if (len >= 32) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+        if (Copy) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), v);
+            dst += 32;
+        }
+        a0 = _mm256_add_epi64(a0, _mm256_unpacklo_epi32(v, zero));
+        a1 = _mm256_add_epi64(a1, _mm256_unpackhi_epi32(v, zero));
+        len -= 32;
+        src += 32;
+    }
+    auto a = _mm256_add_epi64(_mm256_add_epi64(a0, a1), _mm256_add_epi64(a2, a3));
+    auto b = _mm_add_epi64(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+    uint64_t s = add_carry(_mm_cvtsi128_si64(b), _mm_cvtsi128_si64(_mm_unpackhi_epi64(b, b)));
+    return fold_swap(add_carry(s, sum_tail<Copy>(dst, src, len)));
+}
+
+__attribute__((target("avx2")))
+uint16_t sum_avx2(const char* data, size_t len) {
+    return avx2_sum<false>(nullptr, data, len);
+}
+
+uint16_t copy_and_sum_scalar(char* dst, const char* src, size_t len) {
+    std::memcpy(dst, src, len);
+    return sum_scalar(src, len);
+}
+
+uint16_t copy_and_sum_sse2(char* dst, const char* src, size_t len) {
+    return sse2_sum<true>(dst, src, len);
+}
+
+__attribute__((target("avx2")))
+uint16_t copy_and_sum_avx2(char* dst, const char* src, size_t len) {
+    return avx2_sum<true>(dst, src, len);
+}
+
+}
+
+using sum_fn = uint16_t (*)(const char* data, size_t len);
+using copy_and_sum_fn = uint16_t (*)(char* dst, const char* src, size_t len);
+
+static sum_fn pick_sum() {
+    using namespace ip_checksum_impl;
+    return has_avx2() ? sum_avx2 : sum_sse2;
+}
+
+static copy_and_sum_fn pick_copy_and_sum() {
+    using namespace ip_checksum_impl;
+    return has_avx2() ? copy_and_sum_avx2 : copy_and_sum_sse2;
+}
+
+void checksummer::sum(const char* data, size_t len) {
+    static const sum_fn sum_data = pick_sum();
+    if (!len) {
+        return;
+    }
+    auto orig_len = len;
+    if (odd) {
+        csum += uint8_t(*data++);
+        --len;
+    }
+    csum += sum_data(data, len);
+    odd ^= orig_len & 1;
+}
+
+void checksummer::copy_and_sum(char* dst, const char* src, size_t len) {
+    static const copy_and_sum_fn copy_and_sum_data = pick_copy_and_sum();
+    if (!len) {
+        return;
+    }
+    auto orig_len = len;
+    if (odd) {
+        *dst++ = *src;
+        csum += uint8_t(*src++);
+        --len;
+    }
+    csum += copy_and_sum_data(dst, src, len);
     odd ^= orig_len & 1;
 }
 
 uint16_t checksummer::get() const {
-    __int128 csum1 = (csum & 0xffff'ffff'ffff'ffff) + (csum >> 64);
-    uint64_t csum = (csum1 & 0xffff'ffff'ffff'ffff) + (csum1 >> 64);
-    csum = (csum & 0xffff) + ((csum >> 16) & 0xffff) + ((csum >> 32) & 0xffff) + (csum >> 48);
-    csum = (csum & 0xffff) + (csum >> 16);
-    csum = (csum & 0xffff) + (csum >> 16);
-    return htons(~csum);
+    return htons(~ip_checksum_impl::fold(csum));
 }
 
 void checksummer::sum(const packet& p) {
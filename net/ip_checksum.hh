@@ -29,12 +29,20 @@
 
 namespace net {
 
+// Internet (ones' complement) checksum, RFC 1071.
+//
+// Buffers are summed with AVX2 when the processor has it, and with SSE2
+// otherwise; the choice is made at run time.  copy_and_sum() does the
+// copy and the sum in the same pass, for callers that copy data anyway.
+
 uint16_t ip_checksum(const void* data, size_t len);
 
 struct checksummer {
     __int128 csum = 0;
     bool odd = false;
     void sum(const char* data, size_t len);
+    // Copies len bytes from src to dst, summing them on the way
+    void copy_and_sum(char* dst, const char* src, size_t len);
     void sum(const packet& p);
     void sum(uint8_t data) {
         if (!odd) {
@@ -69,6 +77,23 @@ struct checksummer {
     uint16_t get() const;
 };
 
+// The individual implementations, exposed for tests and benchmarks.  Each
+// returns the sum of data as big endian 16-bit words, an odd last byte
+// padded with zero, folded to 16 bits.
+namespace ip_checksum_impl {
+
+bool has_avx2();
+uint16_t sum_scalar(const char* data, size_t len);
+uint16_t sum_sse2(const char* data, size_t len);
+// require has_avx2()
+uint16_t sum_avx2(const char* data, size_t len);
+uint16_t copy_and_sum_scalar(char* dst, const char* src, size_t len);
+uint16_t copy_and_sum_sse2(char* dst, const char* src, size_t len);
+// require has_avx2()
+uint16_t copy_and_sum_avx2(char* dst, const char* src, size_t len);
+
+}
+
 }
 
 #endif /* IP_CHECKSUM_HH_ */
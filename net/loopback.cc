@@ -0,0 +1,298 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#include "loopback.hh"
+#include "ip.hh"
+#include "tcp.hh"
+#include "udp.hh"
+#include "toeplitz.hh"
+#include <boost/lockfree/spsc_queue.hpp>
+#include <experimental/optional>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+
+namespace net {
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// A frame on its way, in memory allocated by the sending shard and freed
+// by the receiving one
+struct frame {
+    char* data;
+    uint32_t len;
+    uint32_t rss_hash;
+    clock_type::time_point arrival;
+};
+
+class loopback_device;
+
+// The rings from every queue of a sending end to every queue of a
+// receiving one.  A single end sends to itself.
+class loopback_link {
+    using ring = boost::lockfree::spsc_queue<frame>;
+public:
+    const loopback_config cfg;
+    const unsigned ends;
+    // Frames dropped because the ring was full
+    std::atomic<uint64_t> overflowed = { 0 };
+private:
+    std::vector<std::unique_ptr<ring>> _rings;
+public:
+    loopback_link(loopback_config cfg, unsigned ends) : cfg(cfg), ends(ends) {
+        if (!cfg.queues || cfg.queues > smp::count) {
+            throw std::invalid_argument("loopback link queues must be between 1 and the number of shards");
+        }
+        for (size_t i = 0; i < ends * cfg.queues * cfg.queues; ++i) {
+            _rings.push_back(std::make_unique<ring>(cfg.ring_size));
+        }
+    }
+    ring& to(unsigned end, unsigned from_qid, unsigned to_qid) {
+        return *_rings[(end * cfg.queues + to_qid) * cfg.queues + from_qid];
+    }
+    unsigned peer(unsigned end) const {
+        return ends == 1 ? end : 1 - end;
+    }
+};
+
+class loopback_qp : public qp {
+    loopback_device& _dev;
+    loopback_link& _link;
+    unsigned _end;
+    unsigned _qid;
+    std::default_random_engine _random;
+    std::bernoulli_distribution _lose;
+    std::bernoulli_distribution _reorder;
+    double _bytes_per_ns;
+    clock_type::time_point _busy_until;
+    // A frame that the frames sent after it get to overtake
+    std::experimental::optional<std::pair<unsigned, frame>> _held;
+    reactor::poller _rx_poller;
+public:
+    loopback_qp(loopback_device& dev, loopback_link& link, unsigned end, unsigned qid);
+    ~loopback_qp();
+    virtual future<> send(packet p) override;
+private:
+    void transmit(unsigned to_qid, frame f);
+    bool poll_rx_once();
+};
+
+class loopback_device : public device {
+    std::shared_ptr<loopback_link> _link;
+    unsigned _end;
+public:
+    loopback_device(std::shared_ptr<loopback_link> link, unsigned end)
+        : _link(std::move(link)), _end(end) {}
+    virtual ethernet_address hw_address() override {
+        return { 0x02, 0x00, 0x00, 0x00, 0x00, uint8_t(_end + 1) };
+    }
+    virtual net::hw_features hw_features() override {
+        net::hw_features f;
+        f.tx_csum_ip_offload = true;
+        f.tx_csum_l4_offload = true;
+        f.rx_csum_offload = true;
+        return f;
+    }
+    virtual uint16_t hw_queues_count() override {
+        return _link->cfg.queues;
+    }
+    virtual std::unique_ptr<qp> init_local_queue(boost::program_options::variables_map opts, uint16_t qid) override {
+        return std::make_unique<loopback_qp>(*this, *_link, _end, qid);
+    }
+    // Receive queue of the end the frame goes to, as an RSS hash would
+    // pick it; hash2qid is the same for both ends
+    std::pair<unsigned, uint32_t> steer(packet& p);
+};
+
+loopback_qp::loopback_qp(loopback_device& dev, loopback_link& link, unsigned end, unsigned qid)
+    : qp(false, "network", qid)
+    , _dev(dev)
+    , _link(link)
+    , _end(end)
+    , _qid(qid)
+    , _random(end * smp::count + qid)
+    , _lose(link.cfg.loss)
+    , _reorder(link.cfg.reorder)
+    , _bytes_per_ns(link.cfg.gbps / 8 / link.cfg.queues)
+    , _rx_poller([this] { return poll_rx_once(); }) {
+}
+
+loopback_qp::~loopback_qp() {
+    if (_held) {
+        std::free(_held->second.data);
+    }
+}
+
+std::pair<unsigned, uint32_t> loopback_device::steer(packet& p) {
+    auto iph = p.get_header<ip_hdr>(sizeof(eth_hdr));
+    auto eh = p.get_header<eth_hdr>();
+    if (!iph || ntoh(eh->eth_proto) != uint16_t(eth_protocol_num::ipv4)) {
+        return { 0, 0 };
+    }
+    // As ipv4::forward() would have it
+    forward_hash data;
+    data.push_back(iph->src_ip.ip);
+    data.push_back(iph->dst_ip.ip);
+    auto h = ntoh(*iph);
+    auto l4_off = sizeof(eth_hdr) + h.ihl * 4;
+    if (!h.mf() && !h.offset()) {
+        if (h.ip_proto == uint8_t(ip_protocol_num::tcp)) {
+            if (auto th = p.get_header<tcp_hdr>(l4_off)) {
+                data.push_back(th->src_port);
+                data.push_back(th->dst_port);
+            }
+        } else if (h.ip_proto == uint8_t(ip_protocol_num::udp)) {
+            if (auto uh = p.get_header<udp_hdr>(l4_off)) {
+                data.push_back(uh->src_port);
+                data.push_back(uh->dst_port);
+            }
+        }
+    }
+    auto hash = toeplitz_hash(rss_key(), data);
+    return { hash2qid(hash), hash };
+}
+
+future<> loopback_qp::send(packet p) {
+    _stats.tx.good.update_pkts_bunch(1);
+    _stats.tx.good.update_frags_stats(p.nr_frags(), p.len());
+    if (_lose(_random)) {
+        return make_ready_future<>();
+    }
+    auto now = clock_type::now();
+    auto arrival = now + _link.cfg.delay;
+    if (_bytes_per_ns) {
+        auto serialization = std::chrono::nanoseconds(uint64_t(p.len() / _bytes_per_ns));
+        _busy_until = std::max(_busy_until, now) + serialization;
+        arrival = _busy_until + _link.cfg.delay;
+    }
+    auto steering = _dev.steer(p);
+    // Copied, as the sender may still be holding on to what it sent, for
+    // retransmission
+    auto data = static_cast<char*>(std::malloc(p.len()));
+    if (!data) {
+        return make_ready_future<>();
+    }
+    auto out = data;
+    for (auto&& f : p.fragments()) {
+        out = std::copy_n(f.base, f.size, out);
+    }
+    frame f{data, uint32_t(p.len()), steering.second, arrival};
+    if (!_held && _reorder(_random)) {
+        _held = std::make_pair(steering.first, f);
+        return make_ready_future<>();
+    }
+    transmit(steering.first, f);
+    if (_held) {
+        // Overtaken; delivered no earlier than what overtook it, so that
+        // its ring stays in arrival order
+        _held->second.arrival = std::max(_held->second.arrival, arrival);
+        transmit(_held->first, _held->second);
+        _held = {};
+    }
+    return make_ready_future<>();
+}
+
+void loopback_qp::transmit(unsigned to_qid, frame f) {
+    if (!_link.to(_link.peer(_end), _qid, to_qid).push(f)) {
+        ++_link.overflowed;
+        std::free(f.data);
+    }
+}
+
+bool loopback_qp::poll_rx_once() {
+    bool work = false;
+    if (_held) {
+        // Nothing came to overtake it this poll cycle
+        transmit(_held->first, _held->second);
+        _held = {};
+        work = true;
+    }
+    auto now = clock_type::now();
+    uint64_t received = 0;
+    for (unsigned from = 0; from < _link.cfg.queues; ++from) {
+        auto& r = _link.to(_end, from, _qid);
+        while (r.read_available() && r.front().arrival <= now) {
+            auto f = r.front();
+            r.pop();
+            packet p(fragment{f.data, f.len}, make_free_deleter(f.data));
+            p.set_rss_hash(f.rss_hash);
+            _stats.rx.good.update_frags_stats(1, f.len);
+            _dev.l2receive(std::move(p));
+            ++received;
+        }
+    }
+    if (received) {
+        _stats.rx.good.update_pkts_bunch(received);
+    }
+    return work || received;
+}
+
+}
+
+std::pair<std::unique_ptr<device>, std::unique_ptr<device>> create_loopback_link(loopback_config cfg) {
+    auto link = std::make_shared<loopback_link>(cfg, 2);
+    return { std::make_unique<loopback_device>(link, 0), std::make_unique<loopback_device>(link, 1) };
+}
+
+std::unique_ptr<device> create_loopback_net_device(loopback_config cfg) {
+    return std::make_unique<loopback_device>(std::make_shared<loopback_link>(cfg, 1), 0);
+}
+
+std::unique_ptr<device> create_loopback_net_device(boost::program_options::variables_map opts) {
+    loopback_config cfg;
+    cfg.delay = std::chrono::microseconds(opts["loopback-delay"].as<unsigned>());
+    cfg.gbps = opts["loopback-gbps"].as<double>();
+    cfg.loss = opts["loopback-loss"].as<double>();
+    cfg.reorder = opts["loopback-reorder"].as<double>();
+    cfg.queues = smp::count;
+    cfg.ring_size = opts["loopback-ring-size"].as<unsigned>();
+    return create_loopback_net_device(cfg);
+}
+
+boost::program_options::options_description
+get_loopback_net_options_description()
+{
+    boost::program_options::options_description opts(
+            "Loopback net options");
+    opts.add_options()
+        ("loopback", "Use an in-memory device that delivers what the stack sends back to it")
+        ("loopback-delay",
+                boost::program_options::value<unsigned>()->default_value(0),
+                "One way delay of the loopback device (us)")
+        ("loopback-gbps",
+                boost::program_options::value<double>()->default_value(0),
+                "Bandwidth of the loopback device, or 0 for unlimited (Gb/s)")
+        ("loopback-loss",
+                boost::program_options::value<double>()->default_value(0),
+                "Fraction of frames the loopback device drops")
+        ("loopback-reorder",
+                boost::program_options::value<double>()->default_value(0),
+                "Fraction of frames the loopback device delivers after later ones")
+        ("loopback-ring-size",
+                boost::program_options::value<unsigned>()->default_value(1024),
+                "Frames that may be in flight between two queues of the loopback device")
+        ;
+    return opts;
+}
+
+}
@@ -0,0 +1,68 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#ifndef LOOPBACK_HH_
+#define LOOPBACK_HH_
+
+#include "net.hh"
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <memory>
+#include <utility>
+
+namespace net {
+
+// What the link between loopback devices does to the frames sent over it
+struct loopback_config {
+    // One way propagation delay
+    std::chrono::microseconds delay{0};
+    // Bandwidth of each direction, shared evenly by the queues; zero means
+    // unlimited
+    double gbps = 0;
+    // Chance of a frame being dropped
+    double loss = 0;
+    // Chance of a frame being overtaken by those sent after it in the same
+    // poll cycle
+    double reorder = 0;
+    // Number of queues, with frames spread over them by RSS
+    unsigned queues = 1;
+    // Frames that may be in flight from one queue to another; more are
+    // dropped
+    size_t ring_size = 1024;
+};
+
+// A device whose frames go to another device of this process, or back to
+// itself, through shared rings that the receiving queue polls.  Two native
+// stacks, on one shard or several, can be connected this way, or a single
+// stack can talk to itself, so that the stack can be exercised and
+// benchmarked without a tap device or a NIC.
+//
+// Receive queues are chosen by a Toeplitz hash of the IPv4 addresses and
+// TCP or UDP ports, as a NIC would, and queue n is served by shard n.
+// Checksums are offloaded, as nothing corrupts frames in memory.
+std::pair<std::unique_ptr<device>, std::unique_ptr<device>> create_loopback_link(loopback_config cfg);
+std::unique_ptr<device> create_loopback_net_device(loopback_config cfg);
+std::unique_ptr<device> create_loopback_net_device(boost::program_options::variables_map opts);
+boost::program_options::options_description get_loopback_net_options_description();
+
+}
+
+#endif /* LOOPBACK_HH_ */
@@ -24,9 +24,12 @@
 #include "net.hh"
 #include "ip.hh"
 #include "tcp-stack.hh"
+#include "tcp.hh"
 #include "udp.hh"
 #include "virtio.hh"
 #include "dpdk.hh"
+#include "loopback.hh"
+#include "xdp.hh"
 #include "xenfront.hh"
 #include "proxy.hh"
 #include "dhcp.hh"
@@ -76,11 +79,21 @@ void create_native_net_device(boost::program_options::variables_map opts) {
 
 #ifdef HAVE_XEN
     auto xen = is_xen();
+#endif
+    if (opts.count("loopback")) {
+        dev = create_loopback_net_device(opts);
+    } else
+#ifdef HAVE_XEN
     if (xen != xen_info::nonxen) {
         dev = xen::create_xenfront_net_device(opts, xen == xen_info::userspace);
     } else
 #endif
 
+#ifdef HAVE_XDP
+    if (opts.count("xdp-device")) {
+        dev = create_xdp_net_device(opts);
+    } else
+#endif
 #ifdef HAVE_DPDK
     if (opts.count("dpdk-pmd")) {
         // Hardcoded port index 0.
@@ -179,6 +192,10 @@ add_native_net_options_description(boost::program_options::options_description &
     }
 #endif
     opts.add(get_virtio_net_options_description());
+    opts.add(get_loopback_net_options_description());
+#ifdef HAVE_XDP
+    opts.add(get_xdp_net_options_description());
+#endif
 #ifdef HAVE_DPDK
     opts.add(get_dpdk_net_options_description());
 #endif
@@ -187,15 +204,27 @@ add_native_net_options_description(boost::program_options::options_description &
 native_network_stack::native_network_stack(boost::program_options::variables_map opts, std::shared_ptr<device> dev)
     : _netif(std::move(dev))
     , _inet(&_netif) {
+    _netif.enable_gso(opts["gso"].as<std::string>() != "off");
+    _netif.enable_gro(opts["lro"].as<std::string>() != "off");
     _inet.get_udp().set_queue_size(opts["udpv4-queue-size"].as<int>());
+    _inet.get_tcp().enable_sack(opts["tcp-sack"].as<std::string>() != "off");
+    _inet.get_tcp().set_congestion_control(opts["tcp-congestion-control"].as<std::string>());
+    _inet.get_tcp().enable_timestamps(opts["tcp-timestamps"].as<std::string>() != "off");
+    _inet.get_tcp().enable_rack(opts["tcp-rack"].as<std::string>() != "off");
+    _inet.get_tcp().set_rto_min(std::chrono::milliseconds(opts["tcp-rto-min"].as<unsigned>()));
     _dhcp = opts["host-ipv4-addr"].defaulted()
             && opts["gw-ipv4-addr"].defaulted()
-            && opts["netmask-ipv4-addr"].defaulted() && opts["dhcp"].as<bool>();
+            && opts["netmask-ipv4-addr"].defaulted() && opts["dhcp"].as<bool>()
+            && !opts.count("loopback");
     if (!_dhcp) {
         _inet.set_host_address(ipv4_address(_dhcp ? 0 : opts["host-ipv4-addr"].as<std::string>()));
         _inet.set_gw_address(ipv4_address(opts["gw-ipv4-addr"].as<std::string>()));
         _inet.set_netmask_address(ipv4_address(opts["netmask-ipv4-addr"].as<std::string>()));
     }
+    if (opts.count("loopback")) {
+        // We are the only host on the link
+        _inet.learn(_netif.hw_address(), _inet.host_address());
+    }
 }
 
 server_socket
@@ -330,7 +359,25 @@ boost::program_options::options_description nns_options() {
 #endif
         ("lro",
                 boost::program_options::value<std::string>()->default_value("on"),
-                "Enable LRO")
+                "Enable LRO, in software if the device has none (on / off)")
+        ("gso",
+                boost::program_options::value<std::string>()->default_value("on"),
+                "Segment large TCP sends in software if the device cannot (on / off)")
+        ("tcp-sack",
+                boost::program_options::value<std::string>()->default_value("on"),
+                "Enable TCP selective acknowledgments (on / off)")
+        ("tcp-congestion-control",
+                boost::program_options::value<std::string>()->default_value("cubic"),
+                "TCP congestion control algorithm (reno / cubic)")
+        ("tcp-timestamps",
+                boost::program_options::value<std::string>()->default_value("on"),
+                "Enable TCP timestamps (on / off)")
+        ("tcp-rack",
+                boost::program_options::value<std::string>()->default_value("on"),
+                "Enable TCP time based loss detection, with selective acknowledgments (on / off)")
+        ("tcp-rto-min",
+                boost::program_options::value<unsigned>()->default_value(1000),
+                "Lower bound of the TCP retransmission timeout (ms)")
         ;
 
     add_native_net_options_description(opts);
@@ -25,6 +25,7 @@
 #include "net.hh"
 #include <utility>
 #include "toeplitz.hh"
+#include "gso.hh"
 
 using std::move;
 
@@ -259,6 +260,11 @@ void device::set_local_queue(std::unique_ptr<qp> dev) {
     engine().at_destroy([dev = std::move(dev)] {});
 }
 
+void device::set_local_queue(qp& q) {
+    assert(!_queues[engine().cpu_id()]);
+    _queues[engine().cpu_id()] = &q;
+}
+
 
 l3_protocol::l3_protocol(interface* netif, eth_protocol_num proto_num, packet_provider_type func)
     : _netif(netif), _proto_num(proto_num)  {
@@ -276,8 +282,15 @@ interface::interface(std::shared_ptr<device> dev)
     , _rx(_dev->receive([this] (packet p) { return dispatch_packet(std::move(p)); }))
     , _hw_address(_dev->hw_address())
     , _hw_features(_dev->hw_features()) {
+    enable_gso(true);
+    enable_gro(true);
     dev->local_queue().register_packet_provider([this, idx = 0u] () mutable {
             std::experimental::optional<packet> p;
+            if (!_gso_packetq.empty()) {
+                p = std::move(_gso_packetq.front());
+                _gso_packetq.pop_front();
+                return p;
+            }
             for (size_t i = 0; i < _pkt_providers.size(); i++) {
                 auto l3p = _pkt_providers[idx++]();
                 if (idx == _pkt_providers.size())
@@ -289,6 +302,12 @@ interface::interface(std::shared_ptr<device> dev)
                     eh->src_mac = _hw_address;
                     eh->eth_proto = uint16_t(l3pv.proto_num);
                     *eh = hton(*eh);
+                    if (_gso && l3pv.p.offload_info_ref().tso_seg_size) {
+                        gso_segment(std::move(l3pv.p), _hw_features, _gso_packetq);
+                        p = std::move(_gso_packetq.front());
+                        _gso_packetq.pop_front();
+                        return p;
+                    }
                     p = std::move(l3pv.p);
                     return p;
                 }
@@ -297,6 +316,39 @@ interface::interface(std::shared_ptr<device> dev)
         });
 }
 
+void interface::enable_gso(bool enable) {
+    if (!_dev->hw_features().tx_tso) {
+        _gso = enable;
+        _hw_features.tx_tso = enable;
+    }
+}
+
+void interface::enable_gro(bool enable) {
+    if (_dev->hw_features().rx_lro) {
+        return;
+    }
+    _hw_features.rx_lro = enable;
+    if (!enable) {
+        if (_gro) {
+            _gro->flush();
+        }
+        _gro_poller = {};
+        _gro.reset();
+    } else if (!_gro) {
+        _gro = std::make_unique<gro>([this] (packet p, ethernet_address from) {
+            deliver(_proto_map.at(uint16_t(eth_protocol_num::ipv4)), std::move(p), from);
+        }, _hw_features.rx_csum_offload);
+        // What one poll brought in is handed up in the next one at the latest
+        _gro_poller = reactor::poller([this] {
+            if (_gro->empty()) {
+                return false;
+            }
+            _gro->flush();
+            return true;
+        });
+    }
+}
+
 subscription<packet, ethernet_address>
 interface::register_l3(eth_protocol_num proto_num,
         std::function<future<> (packet p, ethernet_address from)> next,
@@ -353,10 +405,10 @@ future<> interface::dispatch_packet(packet p) {
                 auto h = ntoh(*eh);
                 auto from = h.src_mac;
                 p.trim_front(sizeof(*eh));
-                // avoid chaining, since queue lenth is unlimited
-                // drop instead.
-                if (l3.ready.available()) {
-                    l3.ready = l3.packet_stream.produce(std::move(p), from);
+                if (_gro && h.eth_proto == uint16_t(eth_protocol_num::ipv4)) {
+                    _gro->receive(std::move(p), from);
+                } else {
+                    deliver(l3, std::move(p), from);
                 }
             }
         }
@@ -364,4 +416,12 @@ future<> interface::dispatch_packet(packet p) {
     return make_ready_future<>();
 }
 
+void interface::deliver(l3_rx_stream& l3, packet p, ethernet_address from) {
+    // avoid chaining, since queue lenth is unlimited
+    // drop instead.
+    if (l3.ready.available()) {
+        l3.ready = l3.packet_stream.produce(std::move(p), from);
+    }
+}
+
 }
@@ -29,6 +29,7 @@
 #include "core/scollectd.hh"
 #include "net/toeplitz.hh"
 #include "ethernet.hh"
+#include "gro.hh"
 #include "packet.hh"
 #include "const.hh"
 #include <unordered_map>
@@ -117,12 +118,26 @@ class interface {
     ethernet_address _hw_address;
     net::hw_features _hw_features;
     std::vector<l3_protocol::packet_provider_type> _pkt_providers;
+    // Segments of TCP packets larger than the device takes, see enable_gso()
+    bool _gso = false;
+    circular_buffer<packet> _gso_packetq;
+    // Merges received TCP segments if the device does not, see enable_gro()
+    std::unique_ptr<gro> _gro;
+    std::experimental::optional<reactor::poller> _gro_poller;
 private:
     future<> dispatch_packet(packet p);
+    void deliver(l3_rx_stream& l3, packet p, ethernet_address from);
 public:
     explicit interface(std::shared_ptr<device> dev);
     ethernet_address hw_address() { return _hw_address; }
     const net::hw_features& hw_features() const { return _hw_features; }
+    // If the device has no TCP segmentation offload, have TCP send large
+    // segments anyway, and split them just before they reach the device.
+    // On by default.
+    void enable_gso(bool enable);
+    // If the device has no LRO, merge consecutive segments of TCP flows
+    // received in a poll into one before handing them up.  On by default.
+    void enable_gro(bool enable);
     subscription<packet, ethernet_address> register_l3(eth_protocol_num proto_num,
             std::function<future<> (packet p, ethernet_address from)> next,
             std::function<bool (forward_hash&, packet&, size_t)> forward);
@@ -275,6 +290,9 @@ class device {
         return hash % hw_queues_count();
     }
     void set_local_queue(std::unique_ptr<qp> dev);
+    // Like the above, but the caller keeps the queue, and destroys it once
+    // nothing on this cpu uses the device any more
+    void set_local_queue(qp& q);
     template <typename Func>
     unsigned forward_dst(unsigned src_cpuid, Func&& hashfn) {
         auto& qp = queue_for_cpu(src_cpuid);
@@ -24,6 +24,12 @@
 #include "packet.hh"
 #include "api.hh"
 #include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <array>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
 
 namespace net {
 
@@ -208,98 +214,212 @@ posix_ap_network_stack::connect(socket_address sa, socket_address local) {
     });
 }
 
-struct cmsg_with_pktinfo {
-    struct cmsghdrcmh;
-    struct in_pktinfo pktinfo;
-};
-
+// Datagrams are received a batch at a time, with recvmmsg() into a ring of
+// preallocated buffers, and queued until receive() asks for them.  Sent
+// datagrams are queued, and the queue is flushed with sendmmsg() by a poller
+// at the end of each poll cycle; a run of datagrams of the same size to the
+// same destination goes to the kernel as a single message, to be split up
+// by UDP GSO, where the kernel supports it.
+//
+// So a send completes once the datagram is queued, not once it was handed
+// to the kernel, and an error sending it only drops it, as the network
+// could; see udp_channel::send().  Senders wait for room once too much is
+// queued.  Closing the channel drops what is still queued and fails the
+// sends waiting for room.
 class posix_udp_channel : public udp_channel_impl {
 private:
     static constexpr int MAX_DATAGRAM_SIZE = 65507;
-    struct recv_ctx {
-        struct msghdr _hdr;
-        struct iovec _iov;
-        socket_address _src_addr;
-        char* _buffer;
-        cmsg_with_pktinfo _cmsg;
-
-        recv_ctx() {
-            memset(&_hdr, 0, sizeof(_hdr));
-            _hdr.msg_iov = &_iov;
-            _hdr.msg_iovlen = 1;
-            _hdr.msg_name = &_src_addr.u.sa;
-            _hdr.msg_namelen = sizeof(_src_addr.u.sas);
-            memset(&_cmsg, 0, sizeof(_cmsg));
-            _hdr.msg_control = &_cmsg;
-            _hdr.msg_controllen = sizeof(_cmsg);
-        }
-
-        void prepare() {
-            _buffer = new char[MAX_DATAGRAM_SIZE];
-            _iov.iov_base = _buffer;
-            _iov.iov_len = MAX_DATAGRAM_SIZE;
-        }
+    // Datagrams received, or messages sent, by a single system call
+    static constexpr unsigned max_batch = 32;
+    // Received datagrams up to this size are copied out, so that their
+    // buffer stays in the ring; larger ones take it with them
+    static constexpr size_t max_copied_datagram = 4096;
+    // As with UDP_MAX_SEGMENTS; a segment must also fit the path MTU, so
+    // only datagrams that fit an ethernet frame are coalesced
+    static constexpr unsigned max_gso_segments = 64;
+    static constexpr size_t max_gso_segment_size = 1472;
+    struct recv_slot {
+        std::unique_ptr<char[]> buffer;
+        struct iovec iov;
+        socket_address src;
+        alignas(struct cmsghdr) char cmsg[CMSG_SPACE(sizeof(struct in_pktinfo))];
     };
-    struct send_ctx {
-        struct msghdr _hdr;
-        std::vector<struct iovec> _iovecs;
-        socket_address _dst;
-        packet _p;
-
-        send_ctx() {
-            memset(&_hdr, 0, sizeof(_hdr));
-            _hdr.msg_name = &_dst.u.sa;
-            _hdr.msg_namelen = sizeof(_dst.u.sas);
-        }
-
-        void prepare(ipv4_addr dst, packet p) {
-            _dst = make_ipv4_address(dst);
-            _p = std::move(p);
-            _iovecs = std::move(to_iovec(_p));
-            _hdr.msg_iov = _iovecs.data();
-            _hdr.msg_iovlen = _iovecs.size();
-        }
+    struct send_slot {
+        alignas(struct cmsghdr) char cmsg[CMSG_SPACE(sizeof(uint16_t))];
+        // Queued datagrams the message carries
+        unsigned datagrams;
+        size_t iov_start;
+    };
+    struct queued_send {
+        socket_address dst;
+        packet p;
     };
     std::unique_ptr<pollable_fd> _fd;
     ipv4_addr _address;
-    recv_ctx _recv;
-    send_ctx _send;
-    bool _closed;
+    bool _gso;
+    std::array<recv_slot, max_batch> _recv_slots;
+    std::array<struct mmsghdr, max_batch> _recv_msgs;
+    circular_buffer<udp_datagram> _received;
+    std::array<send_slot, max_batch> _send_slots;
+    std::array<struct mmsghdr, max_batch> _send_msgs;
+    std::vector<struct iovec> _send_iovecs;
+    circular_buffer<queued_send> _send_queue;
+    // Bytes that may still be queued, as with the native stack
+    semaphore _send_queue_space = {212992};
+    // Shared with the sends that got room, which may only get to run once
+    // the channel is gone
+    lw_shared_ptr<bool> _closed = make_lw_shared<bool>(false);
+    reactor::poller _flush_poller;
 public:
     posix_udp_channel(ipv4_addr bind_address)
-            : _closed(false) {
+            : _flush_poller([this] { return flush(); }) {
         auto sa = make_ipv4_address(bind_address);
         file_desc fd = file_desc::socket(sa.u.sa.sa_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
         fd.setsockopt(SOL_IP, IP_PKTINFO, true);
         if (engine().posix_reuseport_available()) {
             fd.setsockopt(SOL_SOCKET, SO_REUSEPORT, 1);
         }
+        // A zero segment size, the default, leaves the socket as it was;
+        // older kernels do not know the option
+        int no_segmentation = 0;
+        _gso = ::setsockopt(fd.get(), SOL_UDP, UDP_SEGMENT, &no_segmentation, sizeof(no_segmentation)) == 0;
         fd.bind(sa.u.sa, sizeof(sa.u.sas));
         _address = ipv4_addr(fd.get_address());
         _fd = std::make_unique<pollable_fd>(std::move(fd));
+        for (auto& s : _recv_slots) {
+            s.buffer.reset(new char[MAX_DATAGRAM_SIZE]);
+        }
     }
-    virtual ~posix_udp_channel() { if (!_closed) close(); };
+    virtual ~posix_udp_channel() { if (!*_closed) close(); };
     virtual future<udp_datagram> receive() override;
     virtual future<> send(ipv4_addr dst, const char *msg);
     virtual future<> send(ipv4_addr dst, packet p);
     virtual void close() override {
-        _closed = true;
+        // What the kernel would take right away still goes out
+        flush();
+        *_closed = true;
         _fd.reset();
+        while (!_send_queue.empty()) {
+            _send_queue.pop_front();
+        }
+        _send_queue_space.broken();
     }
-    virtual bool is_closed() const override { return _closed; }
+    virtual bool is_closed() const override { return *_closed; }
+private:
+    int receive_batch();
+    bool flush();
+    unsigned prepare_send_batch();
+    void complete_sends(unsigned messages);
 };
 
 future<> posix_udp_channel::send(ipv4_addr dst, const char *message) {
-    auto len = strlen(message);
-    return _fd->sendto(make_ipv4_address(dst), message, len)
-            .then([len] (size_t size) { assert(size == len); });
+    return send(dst, packet(message, strlen(message)));
 }
 
 future<> posix_udp_channel::send(ipv4_addr dst, packet p) {
     auto len = p.len();
-    _send.prepare(dst, std::move(p));
-    return _fd->sendmsg(&_send._hdr)
-            .then([len] (size_t size) { assert(size == len); });
+    assert(len <= MAX_DATAGRAM_SIZE);
+    if (*_closed) {
+        return make_exception_future<>(broken_semaphore());
+    }
+    return _send_queue_space.wait(len).then([this, closed = _closed, dst, p = std::move(p)] () mutable {
+        if (*closed) {
+            return;
+        }
+        _send_queue.push_back(queued_send{make_ipv4_address(dst), std::move(p)});
+    });
+}
+
+// Fills in messages for the head of the send queue, returning how many
+unsigned posix_udp_channel::prepare_send_batch() {
+    _send_iovecs.clear();
+    unsigned nr = 0;
+    auto i = _send_queue.begin();
+    while (i != _send_queue.end() && nr < max_batch) {
+        auto& slot = _send_slots[nr];
+        auto& hdr = _send_msgs[nr].msg_hdr;
+        auto& first = *i;
+        auto segment_size = first.p.len();
+        bool coalesce = _gso && segment_size <= max_gso_segment_size;
+        size_t total = 0;
+        slot.datagrams = 0;
+        slot.iov_start = _send_iovecs.size();
+        // All but the last segment must be segment_size long
+        size_t last_len;
+        do {
+            for (auto&& f : i->p.fragments()) {
+                _send_iovecs.push_back({f.base, f.size});
+            }
+            last_len = i->p.len();
+            total += last_len;
+            ++slot.datagrams;
+            ++i;
+        } while (coalesce && i != _send_queue.end()
+                && slot.datagrams < max_gso_segments
+                && last_len == segment_size
+                && i->p.len() && i->p.len() <= segment_size
+                && total + i->p.len() <= MAX_DATAGRAM_SIZE
+                && i->dst.u.in.sin_addr.s_addr == first.dst.u.in.sin_addr.s_addr
+                && i->dst.u.in.sin_port == first.dst.u.in.sin_port);
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_name = &first.dst.u.sa;
+        hdr.msg_namelen = sizeof(first.dst.u.in);
+        hdr.msg_iovlen = _send_iovecs.size() - slot.iov_start;
+        if (slot.datagrams > 1) {
+            hdr.msg_control = slot.cmsg;
+            hdr.msg_controllen = sizeof(slot.cmsg);
+            auto cm = CMSG_FIRSTHDR(&hdr);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t gso_size = segment_size;
+            memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+        }
+        ++nr;
+    }
+    // Only now, as the vector may have moved while growing
+    for (unsigned m = 0; m < nr; ++m) {
+        _send_msgs[m].msg_hdr.msg_iov = _send_iovecs.data() + _send_slots[m].iov_start;
+    }
+    return nr;
+}
+
+void posix_udp_channel::complete_sends(unsigned messages) {
+    size_t len = 0;
+    for (unsigned m = 0; m < messages; ++m) {
+        for (unsigned d = 0; d < _send_slots[m].datagrams; ++d) {
+            len += _send_queue.front().p.len();
+            _send_queue.pop_front();
+        }
+    }
+    _send_queue_space.signal(len);
+}
+
+bool posix_udp_channel::flush() {
+    bool work = false;
+    while (!*_closed && !_send_queue.empty()) {
+        auto nr = prepare_send_batch();
+        auto r = ::sendmmsg(_fd->get_file_desc().get(), _send_msgs.data(), nr, MSG_DONTWAIT);
+        if (r < 0) {
+            if (errno == EAGAIN || errno == ENOBUFS) {
+                // Tried again next poll cycle
+                break;
+            }
+            if (_send_slots[0].datagrams > 1 && (errno == EINVAL || errno == EMSGSIZE || errno == EIO)) {
+                // The route or device cannot take segmented datagrams
+                _gso = false;
+                continue;
+            }
+            // Lost, as if the network had dropped it
+            r = 1;
+        }
+        complete_sends(r);
+        work = true;
+        if (unsigned(r) < nr) {
+            break;
+        }
+    }
+    return work;
 }
 
 udp_channel
@@ -320,13 +440,66 @@ class posix_datagram : public udp_datagram_impl {
     virtual packet& get_data() override { return _p; }
 };
 
+// Receives what the socket has, up to a batch, into _received; returns the
+// error, if any, or 0
+int posix_udp_channel::receive_batch() {
+    for (unsigned i = 0; i < max_batch; ++i) {
+        auto& slot = _recv_slots[i];
+        auto& hdr = _recv_msgs[i].msg_hdr;
+        slot.iov.iov_base = slot.buffer.get();
+        slot.iov.iov_len = MAX_DATAGRAM_SIZE;
+        hdr.msg_iov = &slot.iov;
+        hdr.msg_iovlen = 1;
+        hdr.msg_name = &slot.src.u.sa;
+        hdr.msg_namelen = sizeof(slot.src.u.sas);
+        hdr.msg_control = slot.cmsg;
+        hdr.msg_controllen = sizeof(slot.cmsg);
+        hdr.msg_flags = 0;
+    }
+    auto r = ::recvmmsg(_fd->get_file_desc().get(), _recv_msgs.data(), max_batch, MSG_DONTWAIT, nullptr);
+    if (r < 0) {
+        return errno;
+    }
+    for (int i = 0; i < r; ++i) {
+        auto& slot = _recv_slots[i];
+        auto& hdr = _recv_msgs[i].msg_hdr;
+        size_t size = _recv_msgs[i].msg_len;
+        auto dst = _address;
+        for (auto cm = CMSG_FIRSTHDR(&hdr); cm; cm = CMSG_NXTHDR(&hdr, cm)) {
+            if (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_PKTINFO) {
+                in_pktinfo pktinfo;
+                memcpy(&pktinfo, CMSG_DATA(cm), sizeof(pktinfo));
+                dst = ipv4_addr(pktinfo.ipi_addr.s_addr, _address.port);
+            }
+        }
+        packet p;
+        if (size <= max_copied_datagram) {
+            p = packet(slot.buffer.get(), size);
+        } else {
+            auto buf = slot.buffer.release();
+            p = packet(fragment{buf, size}, make_deleter([buf] { delete[] buf; }));
+            slot.buffer.reset(new char[MAX_DATAGRAM_SIZE]);
+        }
+        _received.push_back(udp_datagram(std::make_unique<posix_datagram>(slot.src, dst, std::move(p))));
+    }
+    return 0;
+}
+
 future<udp_datagram>
 posix_udp_channel::receive() {
-    _recv.prepare();
-    return _fd->recvmsg(&_recv._hdr).then([this] (size_t size) {
-        auto dst = ipv4_addr(_recv._cmsg.pktinfo.ipi_addr.s_addr, _address.port);
-        return make_ready_future<udp_datagram>(udp_datagram(std::make_unique<posix_datagram>(
-            _recv._src_addr, dst, packet(fragment{_recv._buffer, size}, make_deleter([buf = _recv._buffer] { delete[] buf; })))));
+    if (_received.empty()) {
+        auto err = receive_batch();
+        if (err && err != EAGAIN) {
+            return make_exception_future<udp_datagram>(std::system_error(err, std::system_category()));
+        }
+    }
+    if (!_received.empty()) {
+        auto dgram = std::move(_received.front());
+        _received.pop_front();
+        return make_ready_future<udp_datagram>(std::move(dgram));
+    }
+    return _fd->readable().then([this] {
+        return receive();
     });
 }
 
@@ -25,10 +25,14 @@
 #include "core/align.hh"
 #include "core/future.hh"
 #include "native-stack-impl.hh"
+#include <cmath>
+#include <limits>
 
 namespace net {
 
-void tcp_option::parse(uint8_t* beg, uint8_t* end) {
+void tcp_option::parse(uint8_t* beg, uint8_t* end, bool syn) {
+    _nr_remote_sack_blocks = 0;
+    _remote_timestamps = false;
     while (beg < end) {
         auto kind = option_kind(*beg);
         if (kind != option_kind::nop && kind != option_kind::eol) {
@@ -40,21 +44,51 @@ void tcp_option::parse(uint8_t* beg, uint8_t* end) {
         }
         switch (kind) {
         case option_kind::mss:
-            _mss_received = true;
-            _remote_mss = ntoh(reinterpret_cast<mss*>(beg)->mss);
+            if (syn) {
+                _mss_received = true;
+                _remote_mss = ntoh(reinterpret_cast<mss*>(beg)->mss);
+            }
             beg += option_len::mss;
             break;
         case option_kind::win_scale:
-            _win_scale_received = true;
-            _remote_win_scale = reinterpret_cast<win_scale*>(beg)->shift;
-            // We can turn on win_scale option, 7 is Linux's default win scale size
-            _local_win_scale = 7;
+            if (syn) {
+                _win_scale_received = true;
+                _remote_win_scale = reinterpret_cast<win_scale*>(beg)->shift;
+                // We can turn on win_scale option, 7 is Linux's default win scale size
+                _local_win_scale = 7;
+            }
             beg += option_len::win_scale;
             break;
         case option_kind::sack:
-            _sack_received = true;
+            _sack_received |= syn;
             beg += option_len::sack;
             break;
+        case option_kind::sack_blocks: {
+            auto len = *(beg + 1);
+            if (len < 2) {
+                return;
+            }
+            auto nr = std::min<unsigned>((len - 2u) / sizeof(sack_block), max_sack_blocks);
+            auto blocks = reinterpret_cast<sack_block*>(beg + 2);
+            for (unsigned i = 0; i < nr; ++i) {
+                _remote_sack_blocks[i] = ntoh(blocks[i]);
+            }
+            _nr_remote_sack_blocks = nr;
+            beg += len;
+            break;
+        }
+        case option_kind::timestamps: {
+            if (*(beg + 1) != uint8_t(option_len::timestamps)) {
+                return;
+            }
+            auto ts = ntoh(*reinterpret_cast<timestamps*>(beg));
+            _timestamps_received |= syn;
+            _remote_timestamps = true;
+            _remote_tsval = ts.t1;
+            _remote_tsecr = ts.t2;
+            beg += option_len::timestamps;
+            break;
+        }
         case option_kind::nop:
             beg += option_len::nop;
             break;
@@ -94,17 +128,54 @@ uint8_t tcp_option::fill(tcp_hdr* th, uint8_t options_size) {
             off += win_scale->len;
             size += win_scale->len;
         }
-    }
-    if (size > 0) {
-        // Insert NOP option
-        auto size_max = align_up(uint8_t(size + 1), tcp_option::align);
-        while (size < size_max - uint8_t(option_len::eol)) {
-            new (off) tcp_option::nop;
-            off += option_len::nop;
-            size += option_len::nop;
-        }
-        new (off) tcp_option::eol;
-        size += option_len::eol;
+        if (_sack_permitted && (_sack_received || !ack_on)) {
+            auto sack = new (off) tcp_option::sack;
+            off += sack->len;
+            size += sack->len;
+        }
+        if (_timestamps_permitted && (_timestamps_received || !ack_on)) {
+            auto ts = new (off) tcp_option::timestamps;
+            ts->t1 = _local_tsval;
+            ts->t2 = _local_tsecr;
+            off += ts->len;
+            size += ts->len;
+            *ts = hton(*ts);
+        }
+        if (size > 0) {
+            // Insert NOP option
+            auto size_max = align_up(uint8_t(size + 1), tcp_option::align);
+            while (size < size_max - uint8_t(option_len::eol)) {
+                new (off) tcp_option::nop;
+                off += option_len::nop;
+                size += option_len::nop;
+            }
+            new (off) tcp_option::eol;
+            size += option_len::eol;
+        }
+    } else {
+        // Two NOPs in front of each keep the fields 32-bit aligned, as
+        // everyone does
+        if (_timestamps_enabled) {
+            new (off++) tcp_option::nop;
+            new (off++) tcp_option::nop;
+            auto ts = new (off) tcp_option::timestamps;
+            ts->t1 = _local_tsval;
+            ts->t2 = _local_tsecr;
+            off += ts->len;
+            size += 2 + uint8_t(ts->len);
+            *ts = hton(*ts);
+        }
+        if (_nr_local_sack_blocks) {
+            new (off++) tcp_option::nop;
+            new (off++) tcp_option::nop;
+            *off++ = uint8_t(option_kind::sack_blocks);
+            *off++ = 2 + _nr_local_sack_blocks * sizeof(sack_block);
+            auto blocks = reinterpret_cast<sack_block*>(off);
+            for (unsigned i = 0; i < _nr_local_sack_blocks; ++i) {
+                blocks[i] = hton(_local_sack_blocks[i]);
+            }
+            size += 4 + _nr_local_sack_blocks * sizeof(sack_block);
+        }
     }
     assert(size == options_size);
 
@@ -120,15 +191,136 @@ uint8_t tcp_option::get_size(bool syn_on, bool ack_on) {
         if (_win_scale_received || !ack_on) {
             size += option_len::win_scale;
         }
-    }
-    if (size > 0) {
-        size += option_len::eol;
-        // Insert NOP option to align on 32-bit
-        size = align_up(size, tcp_option::align);
+        if (_sack_permitted && (_sack_received || !ack_on)) {
+            size += option_len::sack;
+        }
+        if (_timestamps_permitted && (_timestamps_received || !ack_on)) {
+            size += option_len::timestamps;
+        }
+        if (size > 0) {
+            size += option_len::eol;
+            // Insert NOP option to align on 32-bit
+            size = align_up(size, tcp_option::align);
+        }
+    } else {
+        if (_timestamps_enabled) {
+            size += 2 + uint8_t(option_len::timestamps);
+        }
+        size += local_sack_blocks_size();
     }
     return size;
 }
 
+void reno_congestion_control::on_ack(uint32_t& cwnd, uint32_t& ssthresh, uint32_t smss, const ack_sample& ack) {
+    if (cwnd < ssthresh) {
+        // In slow start phase
+        cwnd += std::min(ack.acked_bytes, smss);
+    } else {
+        // In congestion avoidance phase
+        uint32_t round_up = 1;
+        cwnd += std::max(round_up, smss * smss / cwnd);
+    }
+}
+
+uint32_t reno_congestion_control::on_loss(uint32_t cwnd, uint32_t flight, uint32_t smss) {
+    return std::max(flight / 2, 2 * smss);
+}
+
+constexpr double cubic_congestion_control::c;
+constexpr double cubic_congestion_control::beta;
+constexpr unsigned cubic_congestion_control::hystart_min_samples;
+constexpr unsigned cubic_congestion_control::hystart_low_window;
+
+void cubic_congestion_control::hystart_update(uint32_t cwnd, uint32_t& ssthresh, uint32_t smss, const ack_sample& ack) {
+    if (!_round_started || ack.unacknowledged >= _round_end) {
+        _round_started = true;
+        _round_end = ack.next;
+        _last_round_min_rtt = _round_min_rtt;
+        _round_min_rtt = clock_type::duration::max();
+        _round_samples = 0;
+    }
+    if (!ack.rtt) {
+        return;
+    }
+    _round_min_rtt = std::min(_round_min_rtt, *ack.rtt);
+    ++_round_samples;
+    if (cwnd < hystart_low_window * smss || _round_samples < hystart_min_samples
+            || _last_round_min_rtt == clock_type::duration::max()) {
+        return;
+    }
+    // The queue at the bottleneck is building up once the round trip time
+    // grows by RttThresh = clamp(lastRoundMinRTT / 8, 4ms, 16ms).  Leave
+    // slow start right away rather than through conservative slow start.
+    clock_type::duration thresh = std::min(std::max(_last_round_min_rtt / 8, clock_type::duration(4ms)),
+            clock_type::duration(16ms));
+    if (_round_min_rtt >= _last_round_min_rtt + thresh) {
+        ssthresh = cwnd;
+        _hystart_done = true;
+    }
+}
+
+void cubic_congestion_control::on_ack(uint32_t& cwnd, uint32_t& ssthresh, uint32_t smss, const ack_sample& ack) {
+    if (ack.rtt) {
+        _min_rtt = std::min(_min_rtt, *ack.rtt);
+    }
+    if (cwnd < ssthresh) {
+        if (!_hystart_done) {
+            hystart_update(cwnd, ssthresh, smss, ack);
+        }
+        cwnd += std::min(ack.acked_bytes, smss);
+        return;
+    }
+    auto now = clock_type::now();
+    if (!_epoch_start) {
+        _epoch_start = now;
+        if (cwnd < _w_max) {
+            _k = std::cbrt((_w_max - cwnd) / smss / c);
+            _origin = _w_max;
+        } else {
+            _k = 0;
+            _origin = cwnd;
+        }
+        _w_est = cwnd;
+    }
+    // RFC 8312 4.1: aim for W_cubic(t + RTT), but grow by at most half of
+    // cwnd per RTT
+    auto rtt = _min_rtt == clock_type::duration::max() ? clock_type::duration(0) : _min_rtt;
+    auto t = std::chrono::duration<double>(now - *_epoch_start + rtt).count();
+    auto target = _origin + c * std::pow(t - _k, 3) * smss;
+    target = std::min(std::max(target, double(cwnd)), 1.5 * cwnd);
+    // RFC 8312 4.2: never grow slower than Reno would in the same time
+    _w_est += 3 * (1 - beta) / (1 + beta) * smss * ack.acked_bytes / cwnd;
+    auto next = std::max(cwnd + (target - cwnd) * ack.acked_bytes / cwnd, _w_est);
+    cwnd = std::min(next, double(std::numeric_limits<uint32_t>::max() / 2));
+}
+
+uint32_t cubic_congestion_control::on_loss(uint32_t cwnd, uint32_t flight, uint32_t smss) {
+    _epoch_start = {};
+    _hystart_done = true;
+    // RFC 8312 4.6: fast convergence, release bandwidth to newer flows if
+    // the window did not get back to where it was at the previous loss
+    if (cwnd < _w_max) {
+        _w_max = cwnd * (1 + beta) / 2;
+    } else {
+        _w_max = cwnd;
+    }
+    return std::max(uint32_t(flight * beta), 2 * smss);
+}
+
+void cubic_congestion_control::on_timeout() {
+    _epoch_start = {};
+}
+
+std::unique_ptr<congestion_control> make_congestion_control(const sstring& name) {
+    if (name == "reno") {
+        return std::make_unique<reno_congestion_control>();
+    } else if (name == "cubic") {
+        return std::make_unique<cubic_congestion_control>();
+    }
+    throw std::invalid_argument(sprint("unknown TCP congestion control algorithm '%s'", name));
+}
+
+
 ipv4_tcp::ipv4_tcp(ipv4& inet)
 	: _inet_l4(inet), _tcp(std::make_unique<tcp<ipv4_traits>>(_inet_l4)) {
 }
@@ -26,6 +26,7 @@
 #include "core/queue.hh"
 #include "core/semaphore.hh"
 #include "core/print.hh"
+#include "core/flat_hash_map.hh"
 #include "net.hh"
 #include "ip_checksum.hh"
 #include "ip.hh"
@@ -35,6 +36,7 @@
 #include <map>
 #include <functional>
 #include <deque>
+#include <array>
 #include <chrono>
 #include <experimental/optional>
 #include <random>
@@ -91,9 +93,39 @@ void tcp_debug(const char* fmt, Args&&... args) {
 #endif
 }
 
+struct tcp_seq {
+    uint32_t raw;
+};
+
+inline tcp_seq ntoh(tcp_seq s) {
+    return tcp_seq { ntoh(s.raw) };
+}
+
+inline tcp_seq hton(tcp_seq s) {
+    return tcp_seq { hton(s.raw) };
+}
+
+inline
+std::ostream& operator<<(std::ostream& os, tcp_seq s) {
+    return os << s.raw;
+}
+
+inline tcp_seq make_seq(uint32_t raw) { return tcp_seq{raw}; }
+inline tcp_seq& operator+=(tcp_seq& s, int32_t n) { s.raw += n; return s; }
+inline tcp_seq& operator-=(tcp_seq& s, int32_t n) { s.raw -= n; return s; }
+inline tcp_seq operator+(tcp_seq s, int32_t n) { return s += n; }
+inline tcp_seq operator-(tcp_seq s, int32_t n) { return s -= n; }
+inline int32_t operator-(tcp_seq s, tcp_seq q) { return s.raw - q.raw; }
+inline bool operator==(tcp_seq s, tcp_seq q)  { return s.raw == q.raw; }
+inline bool operator!=(tcp_seq s, tcp_seq q) { return !(s == q); }
+inline bool operator<(tcp_seq s, tcp_seq q) { return s - q < 0; }
+inline bool operator>(tcp_seq s, tcp_seq q) { return q < s; }
+inline bool operator<=(tcp_seq s, tcp_seq q) { return !(s > q); }
+inline bool operator>=(tcp_seq s, tcp_seq q) { return !(s < q); }
+
 struct tcp_option {
     // The kind and len field are fixed and defined in TCP protocol
-    enum class option_kind: uint8_t { mss = 2, win_scale = 3, sack = 4, timestamps = 8,  nop = 1, eol = 0 };
+    enum class option_kind: uint8_t { mss = 2, win_scale = 3, sack = 4, sack_blocks = 5, timestamps = 8,  nop = 1, eol = 0 };
     enum class option_len:  uint8_t { mss = 4, win_scale = 3, sack = 2, timestamps = 10, nop = 1, eol = 1 };
     struct mss {
         option_kind kind = option_kind::mss;
@@ -111,6 +143,14 @@ struct tcp_option {
         option_kind kind = option_kind::sack;
         option_len len = option_len::sack;
     } __attribute__((packed));
+    // The SACK option proper (RFC 2018) is variable length: a kind and
+    // length byte followed by up to max_sack_blocks of these
+    struct sack_block {
+        packed<tcp_seq> left;
+        packed<tcp_seq> right;
+        template <typename Adjuster>
+        void adjust_endianness(Adjuster a) { a(left, right); }
+    } __attribute__((packed));
     struct timestamps {
         option_kind kind = option_kind::timestamps;
         option_len len = option_len::timestamps;
@@ -126,8 +166,14 @@ struct tcp_option {
         option_kind kind = option_kind::eol;
     } __attribute__((packed));
     static const uint8_t align = 4;
-
-    void parse(uint8_t* beg, uint8_t* end);
+    // 40 bytes of option space hold 4 blocks when no other option is sent
+    static constexpr unsigned max_sack_blocks = 4;
+    // and 3 next to the (NOP padded) timestamps option
+    static constexpr unsigned max_sack_blocks_with_timestamps = 3;
+
+    // The options of a <SYN> negotiate the connection; on later segments
+    // only SACK blocks and timestamps are picked up
+    void parse(uint8_t* beg, uint8_t* end, bool syn);
     uint8_t fill(tcp_hdr* th, uint8_t option_size);
     uint8_t get_size(bool syn_on, bool ack_on);
 
@@ -136,46 +182,47 @@ struct tcp_option {
     bool _win_scale_received = false;
     bool _timestamps_received = false;
     bool _sack_received = false;
+    // Whether we offer (or accept) SACK-permitted on <SYN>
+    bool _sack_permitted = true;
+    // Whether we offer (or accept) timestamps on <SYN>
+    bool _timestamps_permitted = true;
+    // Both ends agreed to send timestamps on every segment (RFC 7323)
+    bool _timestamps_enabled = false;
 
     // Option data
     uint16_t _remote_mss = 536;
     uint16_t _local_mss;
     uint8_t _remote_win_scale = 0;
     uint8_t _local_win_scale = 0;
+    // SACK blocks in the last parsed segment, in host byte order
+    std::array<sack_block, max_sack_blocks> _remote_sack_blocks;
+    unsigned _nr_remote_sack_blocks = 0;
+    // SACK blocks to send with non-<SYN> segments, in host byte order
+    std::array<sack_block, max_sack_blocks> _local_sack_blocks;
+    unsigned _nr_local_sack_blocks = 0;
+    // Timestamps of the last parsed segment, if it carried them
+    bool _remote_timestamps = false;
+    uint32_t _remote_tsval = 0;
+    uint32_t _remote_tsecr = 0;
+    // Timestamps to send with the next segment
+    uint32_t _local_tsval = 0;
+    uint32_t _local_tsecr = 0;
+
+    unsigned max_local_sack_blocks() const {
+        return _timestamps_enabled ? max_sack_blocks_with_timestamps : max_sack_blocks;
+    }
+    // Option space the SACK blocks to send take, NOP padding included
+    uint8_t local_sack_blocks_size() const {
+        return _nr_local_sack_blocks ? 4 + _nr_local_sack_blocks * sizeof(sack_block) : 0;
+    }
+    // Drops the blocks that do not fit in room bytes
+    void fit_local_sack_blocks(unsigned room) {
+        _nr_local_sack_blocks = std::min<unsigned>(_nr_local_sack_blocks, room < 4 ? 0 : (room - 4) / sizeof(sack_block));
+    }
 };
 inline uint8_t*& operator+=(uint8_t*& x, tcp_option::option_len len) { x += uint8_t(len); return x; }
 inline uint8_t& operator+=(uint8_t& x, tcp_option::option_len len) { x += uint8_t(len); return x; }
 
-struct tcp_seq {
-    uint32_t raw;
-};
-
-inline tcp_seq ntoh(tcp_seq s) {
-    return tcp_seq { ntoh(s.raw) };
-}
-
-inline tcp_seq hton(tcp_seq s) {
-    return tcp_seq { hton(s.raw) };
-}
-
-inline
-std::ostream& operator<<(std::ostream& os, tcp_seq s) {
-    return os << s.raw;
-}
-
-inline tcp_seq make_seq(uint32_t raw) { return tcp_seq{raw}; }
-inline tcp_seq& operator+=(tcp_seq& s, int32_t n) { s.raw += n; return s; }
-inline tcp_seq& operator-=(tcp_seq& s, int32_t n) { s.raw -= n; return s; }
-inline tcp_seq operator+(tcp_seq s, int32_t n) { return s += n; }
-inline tcp_seq operator-(tcp_seq s, int32_t n) { return s -= n; }
-inline int32_t operator-(tcp_seq s, tcp_seq q) { return s.raw - q.raw; }
-inline bool operator==(tcp_seq s, tcp_seq q)  { return s.raw == q.raw; }
-inline bool operator!=(tcp_seq s, tcp_seq q) { return !(s == q); }
-inline bool operator<(tcp_seq s, tcp_seq q) { return s - q < 0; }
-inline bool operator>(tcp_seq s, tcp_seq q) { return q < s; }
-inline bool operator<=(tcp_seq s, tcp_seq q) { return !(s > q); }
-inline bool operator>=(tcp_seq s, tcp_seq q) { return !(s < q); }
-
 struct tcp_hdr {
     packed<uint16_t> src_port;
     packed<uint16_t> dst_port;
@@ -201,6 +248,79 @@ struct tcp_hdr {
 struct tcp_tag {};
 using tcp_packet_merger = packet_merger<tcp_seq, tcp_tag>;
 
+// Congestion control algorithm of a connection.  The connection keeps cwnd
+// and ssthresh and runs loss recovery (RFC 5681, 6582 and 6675) itself;
+// the algorithm decides how cwnd grows as data is acknowledged, and where
+// ssthresh goes when data is lost.
+class congestion_control {
+public:
+    // HyStart++ compares round trips a few milliseconds apart, far below
+    // lowres_clock's 10ms
+    using clock_type = std::chrono::steady_clock;
+    struct ack_sample {
+        // Bytes newly acknowledged
+        uint32_t acked_bytes;
+        // SND.UNA after the acknowledgment, and SND.NXT
+        tcp_seq unacknowledged;
+        tcp_seq next;
+        // Round trip time measured by the acknowledgment, if any
+        std::experimental::optional<clock_type::duration> rtt;
+    };
+    virtual ~congestion_control() {}
+    // Called for each segment, or part of one, newly acknowledged.  Fast
+    // recovery sets cwnd by itself afterwards.
+    virtual void on_ack(uint32_t& cwnd, uint32_t& ssthresh, uint32_t smss, const ack_sample& ack) = 0;
+    // Called when loss is detected, once per loss event; flight is the
+    // amount of data outstanding.  Returns the new ssthresh.
+    virtual uint32_t on_loss(uint32_t cwnd, uint32_t flight, uint32_t smss) = 0;
+    // Called when the retransmission timer expires, after on_loss()
+    virtual void on_timeout() {}
+};
+
+// RFC 5681 slow start and congestion avoidance
+class reno_congestion_control : public congestion_control {
+public:
+    virtual void on_ack(uint32_t& cwnd, uint32_t& ssthresh, uint32_t smss, const ack_sample& ack) override;
+    virtual uint32_t on_loss(uint32_t cwnd, uint32_t flight, uint32_t smss) override;
+};
+
+// CUBIC (RFC 8312) with HyStart++ (RFC 9406) leaving slow start once the
+// round trip time starts to grow, before the bottleneck queue overflows
+class cubic_congestion_control : public congestion_control {
+    static constexpr double c = 0.4;
+    static constexpr double beta = 0.7;
+    // cwnd before the last reduction
+    double _w_max = 0;
+    // Start of the current congestion avoidance epoch
+    std::experimental::optional<clock_type::time_point> _epoch_start;
+    // Time to grow back to _w_max, in seconds
+    double _k = 0;
+    double _origin = 0;
+    // Window the Reno algorithm would have, for the TCP-friendly region
+    double _w_est = 0;
+    clock_type::duration _min_rtt = clock_type::duration::max();
+    // HyStart++ runs in the initial slow start only.  Its rounds end when
+    // SND.UNA reaches _round_end.
+    static constexpr unsigned hystart_min_samples = 8;
+    static constexpr unsigned hystart_low_window = 16;
+    bool _hystart_done = false;
+    tcp_seq _round_end = tcp_seq{0};
+    bool _round_started = false;
+    unsigned _round_samples = 0;
+    clock_type::duration _round_min_rtt = clock_type::duration::max();
+    clock_type::duration _last_round_min_rtt = clock_type::duration::max();
+private:
+    void hystart_update(uint32_t cwnd, uint32_t& ssthresh, uint32_t smss, const ack_sample& ack);
+public:
+    virtual void on_ack(uint32_t& cwnd, uint32_t& ssthresh, uint32_t smss, const ack_sample& ack) override;
+    virtual uint32_t on_loss(uint32_t cwnd, uint32_t flight, uint32_t smss) override;
+    virtual void on_timeout() override;
+};
+
+// Makes the named algorithm: "reno" or "cubic".  Throws
+// std::invalid_argument for any other name.
+std::unique_ptr<congestion_control> make_congestion_control(const sstring& name);
+
 template <typename InetTraits>
 class tcp {
 public:
@@ -214,7 +334,9 @@ class tcp {
     class tcb;
 
     class tcb : public enable_lw_shared_from_this<tcb> {
-        using clock_type = lowres_clock;
+        // Round trip times, and with them timestamps and RACK, are taken
+        // with a finer clock than the lowres_clock the timers run on
+        using clock_type = std::chrono::steady_clock;
         static constexpr tcp_state CLOSED         = tcp_state::CLOSED;
         static constexpr tcp_state LISTEN         = tcp_state::LISTEN;
         static constexpr tcp_state SYN_SENT       = tcp_state::SYN_SENT;
@@ -239,6 +361,12 @@ class tcp {
             uint16_t data_len;
             unsigned nr_transmits;
             clock_type::time_point tx_time;
+            // The peer reported the whole segment in a SACK block
+            bool sacked = false;
+            // Presumed lost, see update_scoreboard()
+            bool lost = false;
+            // Its retransmission is presumed lost too, see rack_detect_loss()
+            bool rexmit_lost = false;
         };
         struct send {
             tcp_seq unacknowledged;
@@ -259,7 +387,8 @@ class tcp {
             // Wait for all data are acked
             std::experimental::optional<promise<>> _all_data_acked_promise;
             // Limit number of data queued into send queue
-            semaphore user_queue_space = {212992};
+            // Filled to tcp::_send_buffer by the constructor
+            semaphore user_queue_space = {0};
             // Round-trip time variation
             std::chrono::milliseconds rttvar;
             // Smoothed round-trip time
@@ -274,10 +403,31 @@ class tcp {
             uint16_t dupacks = 0;
             unsigned syn_retransmit = 0;
             unsigned fin_retransmit = 0;
+            // Retransmission timeouts since SND.UNA last moved
+            unsigned data_retransmit = 0;
             uint32_t limited_transfer = 0;
             uint32_t partial_ack = 0;
             tcp_seq recover;
             bool window_probe = false;
+            // Both ends agreed to use selective acknowledgments (RFC 2018)
+            bool sack_enabled = false;
+            // In SACK based loss recovery (RFC 6675), which ends once
+            // everything up to recover is acknowledged
+            bool sack_recovery = false;
+            // End of the highest segment retransmitted in this recovery
+            tcp_seq high_rxt;
+            // Time based loss detection (RACK, RFC 8985), on top of SACK
+            bool rack_enabled = false;
+            // Transmit time and end of the most recently sent segment that
+            // was delivered, and the round trip time it took
+            clock_type::time_point rack_xmit_time;
+            tcp_seq rack_end_seq;
+            clock_type::duration rack_rtt;
+            std::experimental::optional<clock_type::duration> rack_min_rtt;
+            // End of the highest segment delivered
+            tcp_seq rack_fack;
+            // A segment was delivered after one sent later than it
+            bool rack_reordering_seen = false;
         } _snd;
         struct receive {
             tcp_seq next;
@@ -288,21 +438,36 @@ class tcp {
             tcp_seq initial;
             std::deque<packet> data;
             tcp_packet_merger out_of_order;
+            // Sequence numbers of recently received out-of-order segments,
+            // most recent first, each in a different out_of_order block.
+            // The blocks holding them are the ones we SACK.
+            std::deque<tcp_seq> recent_out_of_order;
             std::experimental::optional<promise<>> _data_received_promise;
+            // RFC7323: the timestamp to echo, when it was received, and the
+            // acknowledgment number we last sent
+            uint32_t ts_recent = 0;
+            clock_type::time_point ts_recent_time;
+            tcp_seq last_ack_sent;
         } _rcv;
         tcp_option _option;
+        std::unique_ptr<congestion_control> _cc;
         timer<lowres_clock> _delayed_ack;
         // Retransmission timeout
         std::chrono::milliseconds _rto{1000};
         std::chrono::milliseconds _persist_time_out{1000};
-        static constexpr std::chrono::milliseconds _rto_min{1000};
         static constexpr std::chrono::milliseconds _rto_max{60000};
-        // Clock granularity
-        static constexpr std::chrono::milliseconds _rto_clk_granularity{1};
+        // Timer granularity, that of lowres_clock
+        static constexpr std::chrono::milliseconds _rto_clk_granularity{10};
         static constexpr uint16_t _max_nr_retransmit{5};
+        // RFC7323: TS.Recent is too old to reject segments by after 24 days
+        static constexpr std::chrono::hours _ts_recent_lifetime{24 * 24};
         timer<lowres_clock> _retransmit;
         timer<lowres_clock> _persist;
-        uint16_t _nr_full_seg_received = 0;
+        // Waits out reordering windows, which are often well under
+        // lowres_clock's 10ms on a fast link
+        timer<> _rack_reorder;
+        // Bytes received since we last sent an ACK, see should_send_ack()
+        uint32_t _nr_bytes_unacked = 0;
         struct isn_secret {
             // 512 bits secretkey for ISN generating
             uint32_t key[16];
@@ -324,7 +489,7 @@ class tcp {
         void input_handle_listen_state(tcp_hdr* th, packet p);
         void input_handle_syn_sent_state(tcp_hdr* th, packet p);
         void input_handle_other_state(tcp_hdr* th, packet p);
-        void output_one(bool data_retransmit = false);
+        void output_one(unacked_segment* retransmit_seg = nullptr, tcp_seq retransmit_seq = tcp_seq{0});
         future<> wait_for_data();
         void abort_reader();
         future<> wait_for_all_data_acked();
@@ -367,31 +532,27 @@ class tcp {
         void respond_with_reset(tcp_hdr* th);
         bool merge_out_of_order();
         void insert_out_of_order(tcp_seq seq, packet p);
+        typename std::map<tcp_seq, packet>::iterator out_of_order_block(tcp_seq seq);
+        void set_sack_blocks();
         void trim_receive_data_after_window();
         bool should_send_ack(uint16_t seg_len);
         void clear_delayed_ack();
-        packet get_transmit_packet();
+        packet get_transmit_packet(uint16_t seg_size);
         void retransmit_one() {
-            bool data_retransmit = true;
-            output_one(data_retransmit);
+            output_one(&_snd.data.front(), _snd.unacknowledged);
+        }
+        void retransmit_one(unacked_segment& seg, tcp_seq seq) {
+            output_one(&seg, seq);
         }
         void start_retransmit_timer() {
-            auto now = clock_type::now();
-            start_retransmit_timer(now);
-        };
-        void start_retransmit_timer(clock_type::time_point now) {
-            auto tp = now + _rto;
+            auto tp = lowres_clock::now() + _rto;
             _retransmit.rearm(tp);
         };
         void stop_retransmit_timer() {
             _retransmit.cancel();
         };
         void start_persist_timer() {
-            auto now = clock_type::now();
-            start_persist_timer(now);
-        };
-        void start_persist_timer(clock_type::time_point now) {
-            auto tp = now + _persist_time_out;
+            auto tp = lowres_clock::now() + _persist_time_out;
             _persist.rearm(tp);
         };
         void stop_persist_timer() {
@@ -400,8 +561,44 @@ class tcp {
         void persist();
         void retransmit();
         void fast_retransmit();
-        void update_rto(clock_type::time_point tx_time);
-        void update_cwnd(uint32_t acked_bytes);
+        bool update_scoreboard(tcp_seq seg_ack);
+        void rack_update(unacked_segment& seg, tcp_seq end);
+        bool rack_detect_loss(tcp_seq seg_ack);
+        void rack_reorder_timeout();
+        static bool rack_sent_after(clock_type::time_point t1, tcp_seq seq1, clock_type::time_point t2, tcp_seq seq2) {
+            return t1 > t2 || (t1 == t2 && seq1 > seq2);
+        }
+        // The timestamp clock ticks every millisecond (RFC7323 section 5.4)
+        static uint32_t timestamp(clock_type::time_point t) {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch()).count();
+        }
+        // RFC7323 RTTM: the round trip time told by the timestamp the
+        // segment being processed echoes
+        std::experimental::optional<clock_type::duration> timestamps_rtt() {
+            if (!_option._timestamps_enabled || !_option._remote_timestamps) {
+                return {};
+            }
+            auto rtt = int32_t(timestamp(clock_type::now()) - _option._remote_tsecr);
+            if (rtt < 0) {
+                return {};
+            }
+            return std::chrono::duration_cast<clock_type::duration>(std::chrono::milliseconds(rtt));
+        }
+        // RFC7323 PAWS: whether the segment being processed carries an
+        // older timestamp than TS.Recent, making it an old duplicate
+        bool paws_reject(tcp_hdr* th) {
+            return _option._timestamps_enabled && _option._remote_timestamps && !th->f_rst
+                && int32_t(_option._remote_tsval - _rcv.ts_recent) < 0
+                && clock_type::now() - _rcv.ts_recent_time < _ts_recent_lifetime;
+        }
+        bool sack_loss_detected() {
+            // RFC6675: DupAcks >= DupThresh or IsLost(HighACK + 1)
+            return _snd.dupacks >= 3 || (!_snd.data.empty() && _snd.data.front().lost);
+        }
+        void enter_sack_recovery();
+        void sack_transmit();
+        void update_rto(clock_type::duration rtt);
+        void update_cwnd(uint32_t acked_bytes, std::experimental::optional<clock_type::duration> rtt = {});
         void cleanup();
         uint32_t can_send() {
             if (_snd.window_probe) {
@@ -409,19 +606,25 @@ class tcp {
             }
             // Can not send more than advertised window allows
             auto x = std::min(uint32_t(_snd.unacknowledged + _snd.window - _snd.next), _snd.unsent_len);
-            // Can not send more than congestion window allows
-            x = std::min(_snd.cwnd, x);
-            if (_snd.dupacks == 1 || _snd.dupacks == 2) {
+            // Can not have more in flight than congestion window allows
+            auto flight = uint32_t(_snd.next - _snd.unacknowledged);
+            if (_snd.sack_recovery) {
+                // RFC6675 Step C: send while cwnd - pipe >= 1 SMSS
+                auto pipe = sack_pipe();
+                x = _snd.cwnd >= pipe + _snd.mss ? std::min(x, _snd.cwnd - pipe) : 0;
+            } else if (_snd.dupacks == 1 || _snd.dupacks == 2) {
                 // RFC5681 Step 3.1
                 // Send cwnd + 2 * smss per RFC3042
-                auto flight = flight_size();
                 auto max = _snd.cwnd + 2 * _snd.mss;
                 x = flight <= max ? std::min(x, max - flight) : 0;
                 _snd.limited_transfer += x;
-            } else if (_snd.dupacks >= 3) {
-                // RFC5681 Step 3.5
-                // Sent 1 full-sized segment at most
-                x = std::min(uint32_t(_snd.mss), x);
+            } else {
+                x = flight <= _snd.cwnd ? std::min(x, _snd.cwnd - flight) : 0;
+                if (_snd.dupacks >= 3) {
+                    // RFC5681 Step 3.5
+                    // Sent 1 full-sized segment at most
+                    x = std::min(uint32_t(_snd.mss), x);
+                }
             }
             return x;
         }
@@ -430,9 +633,41 @@ class tcp {
             std::for_each(_snd.data.begin(), _snd.data.end(), [&] (unacked_segment& seg) { size += seg.p.len(); });
             return size;
         }
+        // FlightSize for the ssthresh computation on loss, leaving out
+        // segments sent by limited transmit (RFC3042)
+        uint32_t loss_flight_size() {
+            auto flight = flight_size();
+            return flight - std::min(flight, _snd.limited_transfer);
+        }
+        // RFC6675 SetPipe(): an estimate of the data still in the network
+        uint32_t sack_pipe() {
+            uint32_t pipe = 0;
+            auto seq = _snd.unacknowledged;
+            for (auto&& seg : _snd.data) {
+                auto len = seg.p.len();
+                if (!seg.sacked) {
+                    if (!seg.lost) {
+                        pipe += len;
+                    }
+                    if (seq < _snd.high_rxt && !seg.rexmit_lost) {
+                        pipe += len;
+                    }
+                }
+                seq += len;
+            }
+            return pipe;
+        }
         uint16_t local_mss() {
             return _tcp.hw_features().mtu - net::tcp_hdr_len_min - InetTraits::ip_hdr_len_min;
         }
+        // The most data a segment carrying sack_size bytes of SACK blocks
+        // may hold, so that it fits both the MTU and the peer's MSS.  The
+        // blocks take room from the data, as the timestamps already taken
+        // out of _snd.mss do; Linux's tcp_current_mss() does the same.
+        uint16_t segment_size(uint8_t sack_size) {
+            auto mtu_room = local_mss() - (_option._timestamps_enabled ? 2 + uint8_t(tcp_option::option_len::timestamps) : 0);
+            return std::min(_snd.mss, uint16_t(mtu_room)) - sack_size;
+        }
         void queue_packet(packet p) {
             _packetq.emplace_back(typename InetTraits::l4packet{_foreign_ip, std::move(p)});
         }
@@ -462,7 +697,7 @@ class tcp {
         }
         void do_established() {
             _state = ESTABLISHED;
-            update_rto(_snd.syn_tx_time);
+            update_rto(clock_type::now() - _snd.syn_tx_time);
             _connect_done.set_value();
         }
         void do_reset() {
@@ -493,6 +728,8 @@ class tcp {
             _snd.unacknowledged = _snd.initial;
             _snd.next = _snd.initial + 1;
             _snd.recover = _snd.initial;
+            _snd.rack_end_seq = _snd.initial;
+            _snd.rack_fack = _snd.initial;
         }
         void do_local_fin_acked() {
             _snd.unacknowledged += 1;
@@ -518,6 +755,7 @@ class tcp {
             _snd.dupacks = 0;
             _snd.limited_transfer = 0;
             _snd.partial_ack = 0;
+            _snd.sack_recovery = false;
         }
         uint32_t data_segment_acked(tcp_seq seg_ack);
         bool segment_acceptable(tcp_seq seg_seq, unsigned seg_len);
@@ -525,8 +763,8 @@ class tcp {
         friend class connection;
     };
     inet_type& _inet;
-    std::unordered_map<connid, lw_shared_ptr<tcb>, connid_hash> _tcbs;
-    std::unordered_map<uint16_t, listener*> _listening;
+    flat_hash_map<connid, lw_shared_ptr<tcb>, connid_hash> _tcbs;
+    flat_hash_map<uint16_t, listener*> _listening;
     std::random_device _rd;
     std::default_random_engine _e;
     std::uniform_int_distribution<uint16_t> _port_dist{41952, 65535};
@@ -535,6 +773,22 @@ class tcp {
     circular_buffer<ipv4_traits::l4packet> _packetq;
     semaphore _queue_space = {212992};
     scollectd::registrations _collectd_regs;
+    bool _sack = true;
+    bool _timestamps = true;
+    bool _rack = true;
+    std::chrono::milliseconds _rto_min{1000};
+    size_t _send_buffer = 212992;
+    sstring _congestion_control = "cubic";
+public:
+    // Loss recovery events, summed over all connections
+    struct stats {
+        // Retransmission timer expiries with data outstanding
+        uint64_t retransmit_timeouts = 0;
+        // Data segments sent again, for whatever reason
+        uint64_t retransmitted_segments = 0;
+    };
+private:
+    stats _stats;
 public:
     class connection {
         lw_shared_ptr<tcb> _tcb;
@@ -603,6 +857,31 @@ class tcp {
     future<connection> connect(socket_address sa);
     const net::hw_features& hw_features() const { return _inet._inet.hw_features(); }
     future<> poll_tcb(ipaddr to, lw_shared_ptr<tcb> tcb);
+    // Whether new connections offer and accept selective acknowledgments
+    void enable_sack(bool enable) { _sack = enable; }
+    // Whether new connections offer and accept timestamps (RFC 7323)
+    void enable_timestamps(bool enable) { _timestamps = enable; }
+    // Whether new connections that use SACK also detect losses by time
+    // (RACK, RFC 8985)
+    void enable_rack(bool enable) { _rack = enable; }
+    // Lower bound of the retransmission timeout.  RFC6298 asks for a
+    // second; networks whose round trips take microseconds do better
+    // with a few milliseconds.
+    void set_rto_min(std::chrono::milliseconds rto_min) { _rto_min = rto_min; }
+    // Data a new connection holds until it is acknowledged, sent or not,
+    // before send() waits; this caps its window.  It has to cover the
+    // bandwidth-delay product of the path, and the largest single send.
+    void set_send_buffer(size_t size) { _send_buffer = size; }
+    // Congestion control algorithm of new connections, see
+    // make_congestion_control()
+    void set_congestion_control(sstring name) {
+        make_congestion_control(name);
+        _congestion_control = std::move(name);
+    }
+    const stats& get_stats() const { return _stats; }
+    // Connections not yet closed, including those still waiting to be
+    // accepted
+    size_t connections() const { return _tcbs.size(); }
 private:
     void send_packet_without_tcb(ipaddr from, ipaddr to, packet p);
     void respond_with_reset(tcp_hdr* rth, ipaddr local_ip, ipaddr foreign_ip);
@@ -706,7 +985,7 @@ void tcp<InetTraits>::received(packet p, ipaddr from, ipaddr to) {
         return;
     }
 
-    if (!hw_features().rx_csum_offload) {
+    if (!hw_features().rx_csum_offload && !p.offload_info_ref().csum_verified) {
         checksummer csum;
         InetTraits::tcp_pseudo_header_checksum(csum, from, to, p.len());
         csum.sum(p);
@@ -797,9 +1076,14 @@ tcp<InetTraits>::tcb::tcb(tcp& t, connid id)
     , _foreign_ip(id.foreign_ip)
     , _local_port(id.local_port)
     , _foreign_port(id.foreign_port)
-    , _delayed_ack([this] { _nr_full_seg_received = 0; output(); })
+    , _cc(make_congestion_control(t._congestion_control))
+    , _delayed_ack([this] { _nr_bytes_unacked = 0; output(); })
     , _retransmit([this] { retransmit(); })
-    , _persist([this] { persist(); }) {
+    , _persist([this] { persist(); })
+    , _rack_reorder([this] { rack_reorder_timeout(); }) {
+    _option._sack_permitted = t._sack;
+    _option._timestamps_permitted = t._timestamps;
+    _snd.user_queue_space.signal(t._send_buffer);
 }
 
 template <typename InetTraits>
@@ -851,20 +1135,34 @@ void tcp<InetTraits>::respond_with_reset(tcp_hdr* rth, ipaddr local_ip, ipaddr f
 template <typename InetTraits>
 uint32_t tcp<InetTraits>::tcb::data_segment_acked(tcp_seq seg_ack) {
     uint32_t total_acked_bytes = 0;
+    // With timestamps, every ACK of new data measures the round trip,
+    // retransmissions or not
+    auto ts_rtt = timestamps_rtt();
+    if (ts_rtt) {
+        update_rto(*ts_rtt);
+    }
     // Full ACK of segment
     while (!_snd.data.empty()
             && (_snd.unacknowledged + _snd.data.front().p.len() <= seg_ack)) {
         auto acked_bytes = _snd.data.front().p.len();
         _snd.unacknowledged += acked_bytes;
-        // Ignore retransmitted segments when setting the RTO
-        if (_snd.data.front().nr_transmits == 0) {
-            update_rto(_snd.data.front().tx_time);
+        // Ignore retransmitted segments when setting the RTO, and SACKed
+        // ones, which reached the peer well before this ACK was sent.
+        // Where there is a choice, congestion control gets the time since
+        // transmission, as timestamps only count milliseconds.
+        auto rtt = ts_rtt;
+        if (_snd.data.front().nr_transmits == 0 && !_snd.data.front().sacked) {
+            rtt = clock_type::now() - _snd.data.front().tx_time;
+            if (!ts_rtt) {
+                update_rto(*rtt);
+            }
         }
-        update_cwnd(acked_bytes);
+        update_cwnd(acked_bytes, rtt);
         total_acked_bytes += acked_bytes;
         _snd.user_queue_space.signal(_snd.data.front().data_len);
         _snd.data.pop_front();
     }
+    _snd.data_retransmit = 0;
     // Partial ACK of segment
     if (_snd.unacknowledged < seg_ack) {
         auto acked_bytes = seg_ack - _snd.unacknowledged;
@@ -903,7 +1201,7 @@ bool tcp<InetTraits>::tcb::segment_acceptable(tcp_seq seg_seq, unsigned seg_len)
 template <typename InetTraits>
 void tcp<InetTraits>::tcb::init_from_options(tcp_hdr* th, uint8_t* opt_start, uint8_t* opt_end) {
     // Handle tcp options
-    _option.parse(opt_start, opt_end);
+    _option.parse(opt_start, opt_end, true);
 
     // Remote receive window scale factor
     _snd.window_scale = _option._remote_win_scale;
@@ -935,6 +1233,19 @@ void tcp<InetTraits>::tcb::init_from_options(tcp_hdr* th, uint8_t* opt_start, ui
 
     // Setup initial slow start threshold
     _snd.ssthresh = th->window << _snd.window_scale;
+
+    _snd.sack_enabled = _option._sack_permitted && _option._sack_received;
+    _snd.rack_enabled = _snd.sack_enabled && _tcp._rack;
+
+    _option._timestamps_enabled = _option._timestamps_permitted && _option._timestamps_received;
+    _rcv.last_ack_sent = _rcv.next;
+    if (_option._timestamps_enabled) {
+        _rcv.ts_recent = _option._remote_tsval;
+        _rcv.ts_recent_time = clock_type::now();
+        // Every segment carries the option, so less data fits
+        _snd.mss -= 2 + uint8_t(tcp_option::option_len::timestamps);
+        _rcv.mss -= 2 + uint8_t(tcp_option::option_len::timestamps);
+    }
 }
 
 template <typename InetTraits>
@@ -1038,6 +1349,15 @@ void tcp<InetTraits>::tcb::input_handle_syn_sent_state(tcp_hdr* th, packet p) {
 
 template <typename InetTraits>
 void tcp<InetTraits>::tcb::input_handle_other_state(tcp_hdr* th, packet p) {
+    auto opt_len = th->data_offset * 4 - sizeof(tcp_hdr);
+    if ((_snd.sack_enabled || _option._timestamps_enabled) && opt_len) {
+        // Pick up SACK blocks and timestamps
+        auto opt_start = reinterpret_cast<uint8_t*>(p.get_header(0, th->data_offset * 4)) + sizeof(tcp_hdr);
+        _option.parse(opt_start, opt_start + opt_len, false);
+    } else {
+        _option._nr_remote_sack_blocks = 0;
+        _option._remote_timestamps = false;
+    }
     p.trim_front(th->data_offset * 4);
     bool do_output = false;
     bool do_output_data = false;
@@ -1045,12 +1365,25 @@ void tcp<InetTraits>::tcb::input_handle_other_state(tcp_hdr* th, packet p) {
     auto seg_ack = th->ack;
     auto seg_len = p.len();
 
+    // RFC7323 PAWS: drop old duplicates, as if they were out of the window
+    if (paws_reject(th)) {
+        return output();
+    }
+
     // 4.1 first check sequence number
     if (!segment_acceptable(seg_seq, seg_len)) {
         //<SEQ=SND.NXT><ACK=RCV.NXT><CTL=ACK>
         return output();
     }
 
+    // RFC7323: echo the timestamp of the earliest segment the next ACK
+    // acknowledges, so the round trip includes the time the ACK is delayed
+    if (_option._remote_timestamps && seg_seq <= _rcv.last_ack_sent
+            && int32_t(_option._remote_tsval - _rcv.ts_recent) >= 0) {
+        _rcv.ts_recent = _option._remote_tsval;
+        _rcv.ts_recent_time = clock_type::now();
+    }
+
     // In the following it is assumed that the segment is the idealized
     // segment that begins at RCV.NXT and does not exceed the window.
     if (seg_seq < _rcv.next) {
@@ -1062,12 +1395,16 @@ void tcp<InetTraits>::tcb::input_handle_other_state(tcp_hdr* th, packet p) {
     }
     // FIXME: We should trim data outside the right edge of the receive window as well
 
-    if (seg_seq != _rcv.next) {
-        insert_out_of_order(seg_seq, std::move(p));
+    if (seg_seq != _rcv.next && (seg_len || th->f_syn || th->f_rst || th->f_fin)) {
+        if (seg_len) {
+            insert_out_of_order(seg_seq, std::move(p));
+        }
         // A TCP receiver SHOULD send an immediate duplicate ACK
         // when an out-of-order segment arrives.
         return output();
     }
+    // A pure ACK beyond RCV.NXT means data the peer sent before it was
+    // lost; its acknowledgment and SACK information are still good.
 
     // 4.2 second check the RST bit
     if (th->f_rst) {
@@ -1153,6 +1490,9 @@ void tcp<InetTraits>::tcb::input_handle_other_state(tcp_hdr* th, packet p) {
         // ESTABLISHED STATE or
         // CLOSE_WAIT STATE: Do the same processing as for the ESTABLISHED state.
         if (in_state(ESTABLISHED | CLOSE_WAIT)){
+            // Record what the peer SACKed before the cumulative ACK trims
+            // the retransmission queue
+            bool newly_sacked = _snd.sack_enabled && update_scoreboard(seg_ack);
             // If SND.UNA < SEG.ACK =< SND.NXT then, set SND.UNA <- SEG.ACK.
             if (_snd.unacknowledged < seg_ack && seg_ack <= _snd.next) {
                 // Remote ACKed data we sent
@@ -1178,7 +1518,27 @@ void tcp<InetTraits>::tcb::input_handle_other_state(tcp_hdr* th, packet p) {
                     }
                 };
 
-                if (_snd.dupacks >= 3) {
+                if (_snd.sack_enabled) {
+                    if (_snd.sack_recovery && seg_ack > _snd.recover) {
+                        tcp_debug("ack: sack recovery done\n");
+                        // RFC6675: the cumulative ACK for RecoveryPoint
+                        // terminates loss recovery; cwnd stays at ssthresh
+                        exit_fast_recovery();
+                        set_retransmit_timer();
+                    } else if (_snd.sack_recovery) {
+                        // RFC6675 Step C: keep repairing holes
+                        set_retransmit_timer();
+                        sack_transmit();
+                    } else {
+                        exit_fast_recovery();
+                        set_retransmit_timer();
+                        // Enough may be SACKed now to declare the new first
+                        // segment lost without waiting for duplicate ACKs
+                        if (sack_loss_detected()) {
+                            enter_sack_recovery();
+                        }
+                    }
+                } else if (_snd.dupacks >= 3) {
                     // We are in fast retransmit / fast recovery phase
                     uint32_t smss = _snd.mss;
                     if (seg_ack > _snd.recover) {
@@ -1219,7 +1579,21 @@ void tcp<InetTraits>::tcb::input_handle_other_state(tcp_hdr* th, packet p) {
                     exit_fast_recovery();
                     set_retransmit_timer();
                 }
-            } else if (!_snd.data.empty() && seg_len == 0 &&
+            } else if (_snd.sack_enabled && newly_sacked && seg_len == 0 &&
+                th->f_fin == 0 && th->f_syn == 0 &&
+                th->ack == _snd.unacknowledged) {
+                // RFC6675: with SACK, a duplicate ACK is one that carries
+                // new SACK information; the window need not be the same.
+                _snd.dupacks++;
+                if (_snd.sack_recovery) {
+                    sack_transmit();
+                } else if (sack_loss_detected()) {
+                    enter_sack_recovery();
+                } else {
+                    // RFC3042 limited transmit
+                    do_output_data = true;
+                }
+            } else if (!_snd.sack_enabled && !_snd.data.empty() && seg_len == 0 &&
                 th->f_fin == 0 && th->f_syn == 0 &&
                 th->ack == _snd.unacknowledged &&
                 uint32_t(th->window << _snd.window_scale) == _snd.window) {
@@ -1242,7 +1616,7 @@ void tcp<InetTraits>::tcb::input_handle_other_state(tcp_hdr* th, packet p) {
                     if (seg_ack - 1 > _snd.recover) {
                         _snd.recover = _snd.next - 1;
                         // RFC5681 Step 3.2
-                        _snd.ssthresh = std::max((flight_size() - _snd.limited_transfer) / 2, 2 * smss);
+                        _snd.ssthresh = _cc->on_loss(_snd.cwnd, loss_flight_size(), smss);
                         fast_retransmit();
                     } else {
                         // Do not enter fast retransmit and do not reset ssthresh
@@ -1390,7 +1764,7 @@ void tcp<InetTraits>::tcb::input_handle_other_state(tcp_hdr* th, packet p) {
 }
 
 template <typename InetTraits>
-packet tcp<InetTraits>::tcb::get_transmit_packet() {
+packet tcp<InetTraits>::tcb::get_transmit_packet(uint16_t seg_size) {
     // easy case: empty queue
     if (_snd.unsent.empty()) {
         return packet();
@@ -1400,9 +1774,11 @@ packet tcp<InetTraits>::tcb::get_transmit_packet() {
     uint32_t len;
     if (_tcp.hw_features().tx_tso) {
         // FIXME: Info tap device the size of the splitted packet
-        len = _tcp.hw_features().max_packet_len - net::tcp_hdr_len_min - InetTraits::ip_hdr_len_min;
+        // Whole segments only, with room for the largest TCP header
+        len = _tcp.hw_features().max_packet_len - net::tcp_hdr_len_max - InetTraits::ip_hdr_len_min;
+        len -= len % seg_size;
     } else {
-        len = std::min(uint16_t(_tcp.hw_features().mtu - net::tcp_hdr_len_min - InetTraits::ip_hdr_len_min), _snd.mss);
+        len = seg_size;
     }
     can_send = std::min(can_send, len);
     // easy case: one small packet
@@ -1439,17 +1815,37 @@ packet tcp<InetTraits>::tcb::get_transmit_packet() {
 }
 
 template <typename InetTraits>
-void tcp<InetTraits>::tcb::output_one(bool data_retransmit) {
+void tcp<InetTraits>::tcb::output_one(unacked_segment* retransmit_seg, tcp_seq retransmit_seq) {
     if (in_state(CLOSED)) {
         return;
     }
 
-    packet p = data_retransmit ? _snd.data.front().p.share() : get_transmit_packet();
-    packet clone = p.share();  // early clone to prevent share() from calling packet::unuse_internal_data() on header.
-    uint16_t len = p.len();
+    auto now = clock_type::now();
+    bool data_retransmit = retransmit_seg;
     bool syn_on = syn_needs_on();
     bool ack_on = ack_needs_on();
 
+    // The SACK blocks go first, as they take room from the data
+    uint16_t seg_size = segment_size(0);
+    if (ack_on && !syn_on) {
+        set_sack_blocks();
+        if (data_retransmit) {
+            // Already sized: send only the blocks that still fit
+            auto len = retransmit_seg->data_len;
+            _option.fit_local_sack_blocks(seg_size > len ? seg_size - len : 0);
+        }
+        seg_size = segment_size(_option.local_sack_blocks_size());
+    }
+    packet p = data_retransmit ? retransmit_seg->p.share() : get_transmit_packet(seg_size);
+    if (data_retransmit) {
+        retransmit_seg->tx_time = now;
+        ++_tcp._stats.retransmitted_segments;
+    }
+    packet clone = p.share();  // early clone to prevent share() from calling packet::unuse_internal_data() on header.
+    uint16_t len = p.len();
+
+    _option._local_tsval = timestamp(now);
+    _option._local_tsecr = ack_on ? _rcv.ts_recent : 0;
     auto options_size = _option.get_size(syn_on, ack_on);
     auto th = p.prepend_header<tcp_hdr>(options_size);
 
@@ -1466,13 +1862,16 @@ void tcp<InetTraits>::tcb::output_one(bool data_retransmit) {
 
     tcp_seq seq;
     if (data_retransmit) {
-        seq = _snd.unacknowledged;
+        seq = retransmit_seq;
     } else {
         seq = syn_on ? _snd.initial : _snd.next;
         _snd.next += len;
     }
     th->seq = seq;
     th->ack = _rcv.next;
+    if (ack_on) {
+        _rcv.last_ack_sent = _rcv.next;
+    }
     th->data_offset = (sizeof(*th) + options_size) / 4;
     th->window = _rcv.window >> _rcv.window_scale;
     th->checksum = 0;
@@ -1490,33 +1889,28 @@ void tcp<InetTraits>::tcb::output_one(bool data_retransmit) {
     uint16_t pseudo_hdr_seg_len = 0;
 
     oi.tcp_hdr_len = sizeof(tcp_hdr) + options_size;
-
-    if (_tcp.hw_features().tx_csum_l4_offload) {
-        oi.needs_csum = true;
-
-        //
-        // tx checksum offloading: both virtio-net's VIRTIO_NET_F_CSUM dpdk's
-        // PKT_TX_TCP_CKSUM - requires th->checksum to be initialized to ones'
-        // complement sum of the pseudo header.
-        //
-        // For TSO the csum should be calculated for a pseudo header with
-        // segment length set to 0. All the rest is the same as for a TCP Tx
-        // CSUM offload case.
-        //
-        if (_tcp.hw_features().tx_tso && len > _snd.mss) {
-            oi.tso_seg_size = _snd.mss;
-        } else {
-            pseudo_hdr_seg_len = sizeof(*th) + options_size + len;
-        }
+    oi.needs_csum = _tcp.hw_features().tx_csum_l4_offload;
+
+    //
+    // tx checksum offloading: both virtio-net's VIRTIO_NET_F_CSUM dpdk's
+    // PKT_TX_TCP_CKSUM - requires th->checksum to be initialized to ones'
+    // complement sum of the pseudo header.
+    //
+    // For TSO the csum should be calculated for a pseudo header with
+    // segment length set to 0. All the rest is the same as for a TCP Tx
+    // CSUM offload case, whether or not the device computes checksums:
+    // if it does not, whoever splits the packet does (see net/gso.hh).
+    //
+    if (_tcp.hw_features().tx_tso && len > seg_size) {
+        oi.tso_seg_size = seg_size;
     } else {
         pseudo_hdr_seg_len = sizeof(*th) + options_size + len;
-        oi.needs_csum = false;
     }
 
     InetTraits::tcp_pseudo_header_checksum(csum, _local_ip, _foreign_ip,
                                            pseudo_hdr_seg_len);
 
-    if (_tcp.hw_features().tx_csum_l4_offload) {
+    if (oi.needs_csum || oi.tso_seg_size) {
         th->checksum = ~csum.get();
     } else {
         csum.sum(p);
@@ -1528,14 +1922,17 @@ void tcp<InetTraits>::tcb::output_one(bool data_retransmit) {
     p.set_offload_info(oi);
 
     if (!data_retransmit && (len || syn_on || fin_on)) {
-        auto now = clock_type::now();
-        if (len) {
+        // Keep what goes out as several segments as that many segments,
+        // so that they are acknowledged, SACKed and retransmitted one by one
+        uint16_t seg_size = oi.tso_seg_size ? oi.tso_seg_size : len;
+        for (uint32_t off = 0; off < len; off += seg_size) {
+            uint16_t seg_len = std::min(seg_size, uint16_t(len - off));
             unsigned nr_transmits = 0;
-            _snd.data.emplace_back(unacked_segment{std::move(clone),
-                                   len, nr_transmits, now});
+            _snd.data.emplace_back(unacked_segment{seg_len == len ? std::move(clone) : clone.share(off, seg_len),
+                                   seg_len, nr_transmits, now});
         }
         if (!_retransmit.armed()) {
-            start_retransmit_timer(now);
+            start_retransmit_timer();
         }
     }
 
@@ -1650,18 +2047,20 @@ template <typename InetTraits>
 bool tcp<InetTraits>::tcb::should_send_ack(uint16_t seg_len) {
     // We've received a TSO packet, do ack immediately
     if (seg_len > _rcv.mss) {
-        _nr_full_seg_received = 0;
+        _nr_bytes_unacked = 0;
         _delayed_ack.cancel();
         return true;
     }
 
-    // We've received a full sized segment, ack for every second full sized segment
-    if (seg_len == _rcv.mss) {
-        if (_nr_full_seg_received++ >= 1) {
-            _nr_full_seg_received = 0;
-            _delayed_ack.cancel();
-            return true;
-        }
+    // Ack for every second full sized segment's worth of data.  Counting
+    // bytes rather than full sized segments keeps a sender whose segments
+    // are cut short at write boundaries, and whose cwnd is down to two
+    // segments after a loss, from waiting for the delayed ACK.
+    _nr_bytes_unacked += seg_len;
+    if (_nr_bytes_unacked >= 2u * _rcv.mss) {
+        _nr_bytes_unacked = 0;
+        _delayed_ack.cancel();
+        return true;
     }
 
     // If the timer is armed and its callback hasn't been run.
@@ -1721,6 +2120,61 @@ bool tcp<InetTraits>::tcb::merge_out_of_order() {
 template <typename InetTraits>
 void tcp<InetTraits>::tcb::insert_out_of_order(tcp_seq seg, packet p) {
     _rcv.out_of_order.merge(seg, std::move(p));
+    if (_snd.sack_enabled) {
+        // RFC2018: the first SACK block reports the most recently received
+        // segment, the rest repeat the most recently reported blocks.
+        auto& recent = _rcv.recent_out_of_order;
+        auto block = out_of_order_block(seg);
+        recent.erase(std::remove_if(recent.begin(), recent.end(), [this, block] (tcp_seq s) {
+            return out_of_order_block(s) == block;
+        }), recent.end());
+        recent.push_front(seg);
+        if (recent.size() > tcp_option::max_sack_blocks) {
+            recent.pop_back();
+        }
+    }
+}
+
+// Returns the out of order block containing seq, or end() if there is none
+template <typename InetTraits>
+typename std::map<tcp_seq, packet>::iterator
+tcp<InetTraits>::tcb::out_of_order_block(tcp_seq seq) {
+    auto& map = _rcv.out_of_order.map;
+    auto it = map.upper_bound(seq);
+    if (it == map.begin()) {
+        return map.end();
+    }
+    --it;
+    if (seq < it->first + it->second.len()) {
+        return it;
+    }
+    return map.end();
+}
+
+template <typename InetTraits>
+void tcp<InetTraits>::tcb::set_sack_blocks() {
+    unsigned nr = 0;
+    if (_snd.sack_enabled) {
+        auto& recent = _rcv.recent_out_of_order;
+        for (auto it = recent.begin(); it != recent.end();) {
+            // Blocks vanish once RCV.NXT reaches them, and grow into each
+            // other as the holes between them are filled.
+            auto block = out_of_order_block(*it);
+            auto left = block == _rcv.out_of_order.map.end() ? tcp_seq{0} : block->first;
+            auto dup = std::any_of(_option._local_sack_blocks.begin(), _option._local_sack_blocks.begin() + nr,
+                    [left] (auto& b) { return tcp_seq(b.left) == left; });
+            if (block == _rcv.out_of_order.map.end() || dup) {
+                it = recent.erase(it);
+                continue;
+            }
+            if (nr == _option.max_local_sack_blocks()) {
+                break;
+            }
+            _option._local_sack_blocks[nr++] = tcp_option::sack_block{left, left + block->second.len()};
+            ++it;
+        }
+    }
+    _option._nr_local_sack_blocks = nr;
 }
 
 template <typename InetTraits>
@@ -1784,8 +2238,9 @@ void tcp<InetTraits>::tcb::retransmit() {
     // Update ssthresh only for the first retransmit
     uint32_t smss = _snd.mss;
     if (unacked_seg.nr_transmits == 0) {
-        _snd.ssthresh = std::max(flight_size() / 2, 2 * smss);
+        _snd.ssthresh = _cc->on_loss(_snd.cwnd, flight_size(), smss);
     }
+    _cc->on_timeout();
     // RFC6582 Step 4
     _snd.recover = _snd.next - 1;
     // Start the slow start process
@@ -1793,13 +2248,26 @@ void tcp<InetTraits>::tcb::retransmit() {
     // End fast recovery
     exit_fast_recovery();
 
-    if (unacked_seg.nr_transmits < _max_nr_retransmit) {
+    ++_tcp._stats.retransmit_timeouts;
+    // Count timeouts rather than transmissions, which fast retransmit
+    // and RACK add to as well
+    if (_snd.data_retransmit++ < _max_nr_retransmit) {
         unacked_seg.nr_transmits++;
     } else {
         // Delete connection when max num of retransmission is reached
         cleanup();
         return;
     }
+    if (_snd.sack_enabled) {
+        // Everything not SACKed is presumed lost now.  Repair it in slow
+        // start as ACKs come back, skipping what the peer already has.
+        for (auto&& seg : _snd.data) {
+            seg.lost = !seg.sacked;
+            seg.rexmit_lost = false;
+        }
+        _snd.sack_recovery = true;
+        _snd.high_rxt = _snd.unacknowledged + unacked_seg.p.len();
+    }
     retransmit_one();
 
     output_update_rto();
@@ -1815,10 +2283,221 @@ void tcp<InetTraits>::tcb::fast_retransmit() {
     }
 }
 
+// Marks the segments covered by the SACK blocks of the segment being
+// processed, and the segments presumed lost as a result.  Returns whether
+// any segment was newly SACKed.
+template <typename InetTraits>
+bool tcp<InetTraits>::tcb::update_scoreboard(tcp_seq seg_ack) {
+    if (seg_ack < _snd.unacknowledged || seg_ack > _snd.next) {
+        seg_ack = _snd.unacknowledged;
+    }
+    bool newly_sacked = false;
+    for (unsigned i = 0; i < _option._nr_remote_sack_blocks; ++i) {
+        tcp_seq left = _option._remote_sack_blocks[i].left;
+        tcp_seq right = _option._remote_sack_blocks[i].right;
+        // Ignore blocks that are bogus, or below SND.UNA (D-SACK)
+        if (right <= left || left < _snd.unacknowledged || right > _snd.next) {
+            continue;
+        }
+        auto seq = _snd.unacknowledged;
+        for (auto&& seg : _snd.data) {
+            if (seq >= right) {
+                break;
+            }
+            auto len = seg.p.len();
+            if (!seg.sacked && left <= seq && seq + len <= right) {
+                seg.sacked = true;
+                newly_sacked = true;
+                if (_snd.rack_enabled) {
+                    rack_update(seg, seq + len);
+                }
+            }
+            seq += len;
+        }
+    }
+    if (newly_sacked) {
+        // RFC6675 IsLost(): DupThresh segments, or more than
+        // (DupThresh - 1) * SMSS bytes, above a segment have been SACKed
+        unsigned sacked_segs = 0;
+        uint32_t sacked_bytes = 0;
+        for (auto it = _snd.data.rbegin(); it != _snd.data.rend(); ++it) {
+            if (it->sacked) {
+                sacked_segs++;
+                sacked_bytes += it->p.len();
+            } else if (sacked_segs >= 3 || sacked_bytes > 2u * _snd.mss) {
+                it->lost = true;
+            }
+        }
+    }
+    if (_snd.rack_enabled) {
+        // What the cumulative ACK covers was delivered too
+        auto seq = _snd.unacknowledged;
+        for (auto&& seg : _snd.data) {
+            auto end = seq + seg.p.len();
+            if (end > seg_ack) {
+                break;
+            }
+            if (!seg.sacked) {
+                rack_update(seg, end);
+            }
+            seq = end;
+        }
+        rack_detect_loss(seg_ack);
+    }
+    return newly_sacked;
+}
+
+// RFC8985 Step 2: remember the most recently sent of the segments
+// delivered, whose round trip is the freshest
+template <typename InetTraits>
+void tcp<InetTraits>::tcb::rack_update(unacked_segment& seg, tcp_seq end) {
+    auto rtt = clock_type::now() - seg.tx_time;
+    if (seg.nr_transmits && _snd.rack_min_rtt && rtt < *_snd.rack_min_rtt) {
+        // Too quick to be for the last transmission, the peer got an
+        // earlier one
+        return;
+    }
+    if (!_snd.rack_min_rtt || rtt < *_snd.rack_min_rtt) {
+        _snd.rack_min_rtt = rtt;
+    }
+    // RFC8985 Step 3: a segment never retransmitted that arrives after a
+    // higher one was reordered in the network
+    if (!seg.nr_transmits && end < _snd.rack_fack) {
+        _snd.rack_reordering_seen = true;
+    }
+    if (end > _snd.rack_fack) {
+        _snd.rack_fack = end;
+    }
+    if (rack_sent_after(seg.tx_time, end, _snd.rack_xmit_time, _snd.rack_end_seq)) {
+        _snd.rack_xmit_time = seg.tx_time;
+        _snd.rack_end_seq = end;
+        _snd.rack_rtt = rtt;
+    }
+}
+
+// RFC8985 Step 5: a segment is lost once one sent after it was delivered
+// and a reordering window has passed since it would have been too.  Marks
+// such segments, arms a timer for the ones whose window has yet to pass,
+// and returns whether any segment was newly marked.
+template <typename InetTraits>
+bool tcp<InetTraits>::tcb::rack_detect_loss(tcp_seq seg_ack) {
+    // RFC8985 Step 4: no reordering window while repairing losses, or
+    // with DupThresh segments SACKed, until reordering was seen
+    unsigned sacked_segs = std::count_if(_snd.data.begin(), _snd.data.end(), [] (auto& seg) { return seg.sacked; });
+    clock_type::duration reo_wnd{0};
+    if (_snd.rack_min_rtt && (_snd.rack_reordering_seen || (!_snd.sack_recovery && sacked_segs < 3))) {
+        reo_wnd = *_snd.rack_min_rtt / 4;
+        if (!_snd.first_rto_sample) {
+            reo_wnd = std::min(reo_wnd, clock_type::duration(_snd.srtt));
+        }
+    }
+    auto now = clock_type::now();
+    clock_type::duration timeout{0};
+    bool newly_lost = false;
+    auto seq = _snd.unacknowledged;
+    for (auto&& seg : _snd.data) {
+        auto end = seq + seg.p.len();
+        // Retransmitted in this recovery, and it is that retransmission
+        // we would be declaring lost
+        bool retransmitted = _snd.sack_recovery && seq < _snd.high_rxt;
+        bool undecided = retransmitted ? !seg.rexmit_lost : !seg.lost;
+        if (end > seg_ack && !seg.sacked && undecided
+                && rack_sent_after(_snd.rack_xmit_time, _snd.rack_end_seq, seg.tx_time, end)) {
+            auto remaining = seg.tx_time + _snd.rack_rtt + reo_wnd - now;
+            if (remaining <= clock_type::duration(0)) {
+                seg.lost = true;
+                seg.rexmit_lost = retransmitted;
+                newly_lost = true;
+            } else {
+                timeout = std::max(timeout, remaining);
+            }
+        }
+        seq = end;
+    }
+    if (timeout > clock_type::duration(0)) {
+        _rack_reorder.rearm(timer<>::clock::now() + timeout);
+    }
+    return newly_lost;
+}
+
+template <typename InetTraits>
+void tcp<InetTraits>::tcb::rack_reorder_timeout() {
+    if (!in_state(ESTABLISHED | CLOSE_WAIT) || _snd.data.empty()) {
+        return;
+    }
+    if (rack_detect_loss(_snd.unacknowledged)) {
+        if (_snd.sack_recovery) {
+            sack_transmit();
+        } else if (sack_loss_detected()) {
+            enter_sack_recovery();
+        }
+    }
+}
+
 template <typename InetTraits>
-void tcp<InetTraits>::tcb::update_rto(clock_type::time_point tx_time) {
+void tcp<InetTraits>::tcb::enter_sack_recovery() {
+    tcp_debug("sack: enter loss recovery\n");
+    // RFC6675 Step 4
+    uint32_t smss = _snd.mss;
+    _snd.recover = _snd.next - 1;
+    _snd.ssthresh = _cc->on_loss(_snd.cwnd, loss_flight_size(), smss);
+    _snd.cwnd = _snd.ssthresh;
+    _snd.sack_recovery = true;
+    // Retransmit the first segment, which is presumed lost whatever the
+    // scoreboard says
+    auto& unacked_seg = _snd.data.front();
+    unacked_seg.lost = true;
+    unacked_seg.nr_transmits++;
+    _snd.high_rxt = _snd.unacknowledged + unacked_seg.p.len();
+    retransmit_one();
+    sack_transmit();
+}
+
+// RFC6675 Step C: while cwnd - pipe >= 1 SMSS, send what NextSeg() picks:
+// (1) the first lost segment not yet retransmitted, else (2) new data, else
+// (3) the first segment below the highest SACKed one not yet retransmitted.
+template <typename InetTraits>
+void tcp<InetTraits>::tcb::sack_transmit() {
+    uint32_t smss = _snd.mss;
+    auto pipe = sack_pipe();
+    auto high_sack = _snd.unacknowledged;
+    auto seq = _snd.unacknowledged;
+    for (auto&& seg : _snd.data) {
+        seq += seg.p.len();
+        if (seg.sacked) {
+            high_sack = seq;
+        }
+    }
+    bool new_data = _snd.unsent_len && _snd.next < _snd.unacknowledged + _snd.window;
+    seq = _snd.unacknowledged;
+    for (auto&& seg : _snd.data) {
+        if (_snd.cwnd < pipe + smss) {
+            break;
+        }
+        auto len = seg.p.len();
+        // RACK may find a retransmission lost as well; send it once more
+        if (!seg.sacked && (seq >= _snd.high_rxt || seg.rexmit_lost)) {
+            if (!seg.lost && (new_data || seq + len > high_sack)) {
+                // Lost segments come first, so nothing more to repair
+                break;
+            }
+            if (seg.nr_transmits < _max_nr_retransmit) {
+                seg.nr_transmits++;
+            }
+            retransmit_one(seg, seq);
+            seg.rexmit_lost = false;
+            _snd.high_rxt = std::max(_snd.high_rxt, seq + len);
+            pipe += len;
+        }
+        seq += len;
+    }
+    output();
+}
+
+template <typename InetTraits>
+void tcp<InetTraits>::tcb::update_rto(clock_type::duration rtt) {
     // Update RTO according to RFC6298
-    auto R = std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - tx_time);
+    auto R = std::chrono::duration_cast<std::chrono::milliseconds>(rtt);
     if (_snd.first_rto_sample) {
         _snd.first_rto_sample = false;
         // RTTVAR <- R/2
@@ -1836,22 +2515,15 @@ void tcp<InetTraits>::tcb::update_rto(clock_type::time_point tx_time) {
     // RTO <- SRTT + max(G, K * RTTVAR)
     _rto =  _snd.srtt + std::max(_rto_clk_granularity, 4 * _snd.rttvar);
 
-    // Make sure 1 sec << _rto << 60 sec
-    _rto = std::max(_rto, _rto_min);
+    // Make sure _rto_min << _rto << 60 sec
+    _rto = std::max(_rto, _tcp._rto_min);
     _rto = std::min(_rto, _rto_max);
 }
 
 template <typename InetTraits>
-void tcp<InetTraits>::tcb::update_cwnd(uint32_t acked_bytes) {
-    uint32_t smss = _snd.mss;
-    if (_snd.cwnd < _snd.ssthresh) {
-        // In slow start phase
-        _snd.cwnd += std::min(acked_bytes, smss);
-    } else {
-        // In congestion avoidance phase
-        uint32_t round_up = 1;
-        _snd.cwnd += std::max(round_up, smss * smss / _snd.cwnd);
-    }
+void tcp<InetTraits>::tcb::update_cwnd(uint32_t acked_bytes, std::experimental::optional<clock_type::duration> rtt) {
+    _cc->on_ack(_snd.cwnd, _snd.ssthresh, _snd.mss,
+            congestion_control::ack_sample{acked_bytes, _snd.unacknowledged, _snd.next, rtt});
 }
 
 template <typename InetTraits>
@@ -1859,8 +2531,11 @@ void tcp<InetTraits>::tcb::cleanup() {
     _snd.unsent.clear();
     _snd.data.clear();
     _rcv.out_of_order.map.clear();
+    _rcv.recent_out_of_order.clear();
     _rcv.data.clear();
     stop_retransmit_timer();
+    stop_persist_timer();
+    _rack_reorder.cancel();
     clear_delayed_ack();
     remove_from_tcbs();
 }
@@ -1899,7 +2574,7 @@ std::experimental::optional<typename InetTraits::l4packet> tcp<InetTraits>::tcb:
 
     auto p = std::move(_packetq.front());
     _packetq.pop_front();
-    if (!_packetq.empty() || (_snd.dupacks < 3 && can_send() > 0)) {
+    if (!_packetq.empty() || ((_snd.dupacks < 3 || _snd.sack_recovery) && can_send() > 0)) {
         // If there are packets to send in the queue or tcb is allowed to send
         // more add tcp back to polling set to keep sending. In addition, dupacks >= 3
         // is an indication that an segment is lost, stop sending more in this case.
@@ -1921,15 +2596,15 @@ void tcp<InetTraits>::connection::close_write() {
 template <typename InetTraits>
 constexpr uint16_t tcp<InetTraits>::tcb::_max_nr_retransmit;
 
-template <typename InetTraits>
-constexpr std::chrono::milliseconds tcp<InetTraits>::tcb::_rto_min;
-
 template <typename InetTraits>
 constexpr std::chrono::milliseconds tcp<InetTraits>::tcb::_rto_max;
 
 template <typename InetTraits>
 constexpr std::chrono::milliseconds tcp<InetTraits>::tcb::_rto_clk_granularity;
 
+template <typename InetTraits>
+constexpr std::chrono::hours tcp<InetTraits>::tcb::_ts_recent_lifetime;
+
 template <typename InetTraits>
 typename tcp<InetTraits>::tcb::isn_secret tcp<InetTraits>::tcb::_isn_secret;
 
@@ -0,0 +1,170 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#ifndef XDP_UMEM_HH_
+#define XDP_UMEM_HH_
+
+#include <linux/if_xdp.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// The bookkeeping of an AF_XDP socket's rings and of the frames of its
+// UMEM, apart from the socket, so that it can be exercised without one.
+
+namespace xdp {
+
+// Each frame of the UMEM holds one packet
+static constexpr uint32_t frame_size = 4096;
+
+// One of the rings an AF_XDP socket shares with the kernel, laid out in
+// area as off says.  We produce into the fill and tx rings, and consume
+// from the rx and completion ones; our own index needs no atomic access,
+// the kernel's does.
+template <typename Desc>
+class ring {
+    uint32_t* _producer;
+    uint32_t* _consumer;
+    uint32_t* _flags;
+    Desc* _descs;
+    uint32_t _mask;
+public:
+    ring(char* area, const xdp_ring_offset& off, uint32_t size)
+        : _producer(reinterpret_cast<uint32_t*>(area + off.producer))
+        , _consumer(reinterpret_cast<uint32_t*>(area + off.consumer))
+        , _flags(reinterpret_cast<uint32_t*>(area + off.flags))
+        , _descs(reinterpret_cast<Desc*>(area + off.desc))
+        , _mask(size - 1) {
+    }
+    Desc& operator[](uint32_t idx) {
+        return _descs[idx & _mask];
+    }
+    // Producer side
+    uint32_t producer() const {
+        return *_producer;
+    }
+    uint32_t free_entries() const {
+        return _mask + 1 - (*_producer - __atomic_load_n(_consumer, __ATOMIC_ACQUIRE));
+    }
+    void produce(uint32_t n) {
+        __atomic_store_n(_producer, *_producer + n, __ATOMIC_RELEASE);
+    }
+    // Consumer side
+    uint32_t consumer() const {
+        return *_consumer;
+    }
+    uint32_t available() const {
+        return __atomic_load_n(_producer, __ATOMIC_ACQUIRE) - *_consumer;
+    }
+    void consume(uint32_t n) {
+        __atomic_store_n(_consumer, *_consumer + n, __ATOMIC_RELEASE);
+    }
+    // Whether the kernel only looks at the ring when told to
+    bool needs_wakeup() const {
+        return __atomic_load_n(_flags, __ATOMIC_RELAXED) & XDP_RING_NEED_WAKEUP;
+    }
+};
+
+// Who holds the frames of a UMEM of twice the ring size: frames
+// [0, ring size) are for receiving, the rest for sending.  A frame is
+// named by its offset into the UMEM.
+class umem_frames {
+    uint32_t _ring_size;
+    // Receive frames to hand back to the kernel
+    std::vector<uint64_t> _rx_free;
+    // Receive frames the stack is holding on to
+    uint32_t _rx_lent = 0;
+    std::vector<uint64_t> _tx_free;
+public:
+    explicit umem_frames(uint32_t ring_size) : _ring_size(ring_size) {
+        for (uint32_t i = 0; i < ring_size; ++i) {
+            _rx_free.push_back(uint64_t(i) * frame_size);
+            _tx_free.push_back(uint64_t(ring_size + i) * frame_size);
+        }
+    }
+    // The frame holding a received packet; the driver may have put it
+    // past some headroom
+    static uint64_t frame_of(uint64_t addr) {
+        return addr & ~uint64_t(frame_size - 1);
+    }
+    // Receiving: a frame the kernel filled is either lent to the stack,
+    // until it is done with it, or given back right away once copied.
+    // The stack gets at most half of them, so that the kernel always has
+    // some to receive into.
+    bool can_lend() const {
+        return _rx_lent < _ring_size / 2;
+    }
+    void lend() {
+        ++_rx_lent;
+    }
+    void returned(uint64_t frame) {
+        --_rx_lent;
+        _rx_free.push_back(frame);
+    }
+    void recycle(uint64_t frame) {
+        _rx_free.push_back(frame);
+    }
+    // Hands free receive frames to the kernel, as many as fill takes
+    void refill(ring<uint64_t>& fill) {
+        auto n = std::min<size_t>(_rx_free.size(), fill.free_entries());
+        if (!n) {
+            return;
+        }
+        auto idx = fill.producer();
+        for (size_t i = 0; i < n; ++i) {
+            fill[idx + i] = _rx_free.back();
+            _rx_free.pop_back();
+        }
+        fill.produce(n);
+    }
+    // Sending: frames are taken to copy packets into, and come back
+    // through the completion ring once the kernel has sent them
+    size_t tx_available() const {
+        return _tx_free.size();
+    }
+    uint64_t take_tx() {
+        auto frame = _tx_free.back();
+        _tx_free.pop_back();
+        return frame;
+    }
+    bool complete(ring<uint64_t>& completion) {
+        auto n = completion.available();
+        if (!n) {
+            return false;
+        }
+        auto idx = completion.consumer();
+        for (uint32_t i = 0; i < n; ++i) {
+            _tx_free.push_back(completion[idx + i]);
+        }
+        completion.consume(n);
+        return true;
+    }
+    size_t rx_free() const {
+        return _rx_free.size();
+    }
+    uint32_t rx_lent() const {
+        return _rx_lent;
+    }
+};
+
+}
+
+#endif /* XDP_UMEM_HH_ */
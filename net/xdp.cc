@@ -0,0 +1,467 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#include "xdp.hh"
+#include "xdp-umem.hh"
+#include "core/posix.hh"
+#include "core/print.hh"
+#include <linux/bpf.h>
+#include <linux/ethtool.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <linux/sockios.h>
+#include <net/if.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+using namespace net;
+
+namespace xdp {
+
+static int bpf(int cmd, bpf_attr& attr) {
+    return syscall(__NR_bpf, cmd, &attr, sizeof(attr));
+}
+
+static uint64_t ptr_to_u64(const void* p) {
+    return reinterpret_cast<uintptr_t>(p);
+}
+
+// Maps ring off of fd, as laid out by the kernel
+template <typename Desc>
+static mmap_area map_ring(file_desc& fd, const xdp_ring_offset& off, uint32_t size, off_t pgoff) {
+    return fd.map(off.desc + size * sizeof(Desc), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pgoff);
+}
+
+class device : public net::device {
+    std::string _ifname;
+    unsigned _ifindex;
+    ethernet_address _hw_address;
+    net::hw_features _hw_features;
+    uint16_t _queues = 1;
+    rss_key_type _rss_key = default_rsskey_40bytes;
+    std::vector<uint32_t> _redir_table;
+    // The sockets of the queues, for the XDP program to redirect to
+    int _xsks_map = -1;
+    int _prog = -1;
+    // The attachment of the program to the interface, which goes with it
+    int _link = -1;
+    // The interface's indirection table from before we changed it, as a
+    // request to put it back
+    std::vector<char> _saved_rss;
+public:
+    explicit device(boost::program_options::variables_map opts);
+    ~device();
+    virtual ethernet_address hw_address() override {
+        return _hw_address;
+    }
+    virtual net::hw_features hw_features() override {
+        return _hw_features;
+    }
+    virtual const rss_key_type& rss_key() const override {
+        return _rss_key;
+    }
+    virtual uint16_t hw_queues_count() override {
+        return _queues;
+    }
+    virtual unsigned hash2qid(uint32_t hash) override {
+        return _redir_table[hash % _redir_table.size()];
+    }
+    virtual std::unique_ptr<net::qp> init_local_queue(boost::program_options::variables_map opts, uint16_t qid) override;
+    unsigned ifindex() const {
+        return _ifindex;
+    }
+    void register_socket(uint32_t qid, int fd);
+private:
+    void setup_rss(file_desc& ctl, ifreq ifr, bool rewrite);
+    static std::vector<char> set_rss_request(const uint32_t* indir, uint32_t size);
+    void attach_program(bool generic);
+};
+
+class qp : public net::qp {
+    device& _dev;
+    uint32_t _ring_size;
+    std::unique_ptr<char, free_deleter> _umem;
+    file_desc _fd;
+    xdp_mmap_offsets _offsets;
+    mmap_area _fill_area;
+    mmap_area _completion_area;
+    mmap_area _rx_area;
+    mmap_area _tx_area;
+    ring<uint64_t> _fill;
+    ring<uint64_t> _completion;
+    ring<xdp_desc> _rx;
+    ring<xdp_desc> _tx;
+    umem_frames _frames;
+    reactor::poller _rx_poller;
+public:
+    qp(device& dev, boost::program_options::variables_map opts, uint16_t qid);
+    virtual future<> send(packet p) override;
+    virtual uint32_t send(circular_buffer<packet>& p) override;
+private:
+    static char* allocate_umem(size_t size);
+    static xdp_mmap_offsets configure(file_desc& fd, char* umem, uint32_t ring_size);
+    bool poll_rx_once();
+    bool receive();
+};
+
+device::device(boost::program_options::variables_map opts)
+    : _ifname(opts["xdp-device"].as<std::string>()) {
+    _ifindex = if_nametoindex(_ifname.c_str());
+    if (!_ifindex || _ifname.size() >= IFNAMSIZ) {
+        throw std::runtime_error(sprint("no network interface %s", _ifname));
+    }
+    auto ctl = file_desc::socket(AF_INET, SOCK_DGRAM);
+    ifreq ifr = {};
+    std::copy(_ifname.begin(), _ifname.end(), ifr.ifr_name);
+    ctl.ioctl(SIOCGIFHWADDR, ifr);
+    std::copy_n(ifr.ifr_hwaddr.sa_data, 6, _hw_address.mac.begin());
+    ctl.ioctl(SIOCGIFMTU, ifr);
+    // Frames must fit in one UMEM frame, past the headroom drivers may
+    // leave in front of received ones
+    auto max_mtu = frame_size - XDP_PACKET_HEADROOM - eth_hdr_len;
+    if (unsigned(ifr.ifr_mtu) > max_mtu) {
+        throw std::runtime_error(sprint("%s has an MTU of %d; AF_XDP frames fit %d at most", _ifname, ifr.ifr_mtu, max_mtu));
+    }
+    _hw_features.mtu = ifr.ifr_mtu;
+
+    ethtool_channels channels = {};
+    channels.cmd = ETHTOOL_GCHANNELS;
+    ifr.ifr_data = reinterpret_cast<char*>(&channels);
+    if (::ioctl(ctl.get(), SIOCETHTOOL, &ifr) == 0) {
+        auto nr = std::max(channels.combined_count, channels.rx_count);
+        _queues = std::max(1u, std::min(nr, smp::count));
+    }
+    attach_program(opts["xdp-generic"].as<std::string>() == "on");
+    // Last, as the destructor that restores the table only runs once
+    // construction is complete
+    setup_rss(ctl, ifr, opts["xdp-rss"].as<std::string>() == "on");
+}
+
+device::~device() {
+    if (!_saved_rss.empty()) {
+        ifreq ifr = {};
+        std::copy(_ifname.begin(), _ifname.end(), ifr.ifr_name);
+        ifr.ifr_data = _saved_rss.data();
+        auto ctl = ::socket(AF_INET, SOCK_DGRAM, 0);
+        if (ctl == -1 || ::ioctl(ctl, SIOCETHTOOL, &ifr) == -1) {
+            print("%s: cannot restore the RSS indirection table: %s\n", _ifname, strerror(errno));
+        }
+        if (ctl != -1) {
+            ::close(ctl);
+        }
+    }
+    for (auto fd : { _link, _prog, _xsks_map }) {
+        if (fd != -1) {
+            ::close(fd);
+        }
+    }
+}
+
+// Learns the indirection table and key of the interface, so that
+// hash2qid() knows where the interface will deliver a flow.  If the table
+// spreads flows over queues we do not serve, it is pointed at ours when
+// rewrite is set, and put back as it was when the device goes; otherwise
+// that is an error.  The hash function is assumed to be Toeplitz, as it
+// almost always is.
+void device::setup_rss(file_desc& ctl, ifreq ifr, bool rewrite) {
+    ethtool_rxfh head = {};
+    head.cmd = ETHTOOL_GRSSH;
+    ifr.ifr_data = reinterpret_cast<char*>(&head);
+    if (::ioctl(ctl.get(), SIOCETHTOOL, &ifr) == -1 || !head.indir_size) {
+        // No RSS, as with veth: all we can do is hope flows are spread
+        // the way we would
+        for (unsigned i = 0; i < _queues; ++i) {
+            _redir_table.push_back(i);
+        }
+        return;
+    }
+    std::vector<char> buf(sizeof(ethtool_rxfh) + head.indir_size * sizeof(uint32_t) + head.key_size);
+    auto rxfh = reinterpret_cast<ethtool_rxfh*>(buf.data());
+    rxfh->cmd = ETHTOOL_GRSSH;
+    rxfh->indir_size = head.indir_size;
+    rxfh->key_size = head.key_size;
+    ifr.ifr_data = reinterpret_cast<char*>(rxfh);
+    ctl.ioctl(SIOCETHTOOL, ifr);
+    auto indir = rxfh->rss_config;
+    auto key = reinterpret_cast<uint8_t*>(indir + head.indir_size);
+    if (head.key_size) {
+        _rss_key.assign(key, key + head.key_size);
+    }
+    std::vector<uint32_t> table(indir, indir + head.indir_size);
+    if (std::any_of(table.begin(), table.end(), [this] (uint32_t q) { return q >= _queues; })) {
+        if (!rewrite) {
+            throw std::runtime_error(sprint("%s spreads flows over more than %d queues; try ethtool -X %s equal %d, or --xdp-rss on",
+                    _ifname, _queues, _ifname, _queues));
+        }
+        auto saved = set_rss_request(table.data(), head.indir_size);
+        for (unsigned i = 0; i < head.indir_size; ++i) {
+            table[i] = i % _queues;
+        }
+        auto ours = set_rss_request(table.data(), head.indir_size);
+        ifr.ifr_data = ours.data();
+        ctl.ioctl(SIOCETHTOOL, ifr);
+        _saved_rss = std::move(saved);
+    }
+    _redir_table = std::move(table);
+    _rss_table_bits = std::lround(std::log2(head.indir_size));
+}
+
+// An ETHTOOL_SRSSH request for the given indirection table, keeping the
+// key and hash function
+std::vector<char> device::set_rss_request(const uint32_t* indir, uint32_t size) {
+    std::vector<char> buf(sizeof(ethtool_rxfh) + size * sizeof(uint32_t));
+    auto rxfh = reinterpret_cast<ethtool_rxfh*>(buf.data());
+    rxfh->cmd = ETHTOOL_SRSSH;
+    rxfh->indir_size = size;
+    std::copy_n(indir, size, rxfh->rss_config);
+    return buf;
+}
+
+// Loads and attaches a program that redirects every frame to the socket of
+// the queue it arrived on, passing it to the kernel if there is none:
+//
+//     r2 = ctx->rx_queue_index
+//     return bpf_redirect_map(xsks_map, r2, XDP_PASS)
+void device::attach_program(bool generic) {
+    bpf_attr attr = {};
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(uint32_t);
+    attr.max_entries = _queues;
+    _xsks_map = bpf(BPF_MAP_CREATE, attr);
+    throw_system_error_on(_xsks_map == -1, "bpf(BPF_MAP_CREATE)");
+
+    bpf_insn insns[] = {
+        { BPF_LDX | BPF_W | BPF_MEM, BPF_REG_2, BPF_REG_1, offsetof(xdp_md, rx_queue_index), 0 },
+        { BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, _xsks_map },
+        { 0, 0, 0, 0, 0 },
+        { BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS },
+        { BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map },
+        { BPF_JMP | BPF_EXIT, 0, 0, 0, 0 },
+    };
+    static const char license[] = "Dual BSD/GPL";
+    attr = {};
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = ptr_to_u64(insns);
+    attr.insn_cnt = sizeof(insns) / sizeof(insns[0]);
+    attr.license = ptr_to_u64(license);
+    _prog = bpf(BPF_PROG_LOAD, attr);
+    throw_system_error_on(_prog == -1, "bpf(BPF_PROG_LOAD)");
+
+    attr = {};
+    attr.link_create.prog_fd = _prog;
+    attr.link_create.target_ifindex = _ifindex;
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = generic ? XDP_FLAGS_SKB_MODE : 0;
+    _link = bpf(BPF_LINK_CREATE, attr);
+    throw_system_error_on(_link == -1, "bpf(BPF_LINK_CREATE)");
+}
+
+void device::register_socket(uint32_t qid, int fd) {
+    bpf_attr attr = {};
+    attr.map_fd = _xsks_map;
+    attr.key = ptr_to_u64(&qid);
+    attr.value = ptr_to_u64(&fd);
+    throw_system_error_on(bpf(BPF_MAP_UPDATE_ELEM, attr) == -1, "bpf(BPF_MAP_UPDATE_ELEM)");
+}
+
+std::unique_ptr<net::qp> device::init_local_queue(boost::program_options::variables_map opts, uint16_t qid) {
+    return std::make_unique<qp>(*this, opts, qid);
+}
+
+qp::qp(device& dev, boost::program_options::variables_map opts, uint16_t qid)
+    : net::qp(true, "network", qid)
+    , _dev(dev)
+    , _ring_size(opts["xdp-ring-size"].as<unsigned>())
+    , _umem(allocate_umem(2 * _ring_size * frame_size))
+    , _fd(file_desc::socket(AF_XDP, SOCK_RAW))
+    , _offsets(configure(_fd, _umem.get(), _ring_size))
+    , _fill_area(map_ring<uint64_t>(_fd, _offsets.fr, _ring_size, XDP_UMEM_PGOFF_FILL_RING))
+    , _completion_area(map_ring<uint64_t>(_fd, _offsets.cr, _ring_size, XDP_UMEM_PGOFF_COMPLETION_RING))
+    , _rx_area(map_ring<xdp_desc>(_fd, _offsets.rx, _ring_size, XDP_PGOFF_RX_RING))
+    , _tx_area(map_ring<xdp_desc>(_fd, _offsets.tx, _ring_size, XDP_PGOFF_TX_RING))
+    , _fill(_fill_area.get(), _offsets.fr, _ring_size)
+    , _completion(_completion_area.get(), _offsets.cr, _ring_size)
+    , _rx(_rx_area.get(), _offsets.rx, _ring_size)
+    , _tx(_tx_area.get(), _offsets.tx, _ring_size)
+    , _frames(_ring_size)
+    , _rx_poller([this] { return poll_rx_once(); }) {
+    sockaddr_xdp sxdp = {};
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_ifindex = _dev.ifindex();
+    sxdp.sxdp_queue_id = qid;
+    sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP;
+    if (opts["xdp-copy"].as<std::string>() == "on") {
+        sxdp.sxdp_flags |= XDP_COPY;
+    }
+    _fd.bind(reinterpret_cast<sockaddr&>(sxdp), sizeof(sxdp));
+    _dev.register_socket(qid, _fd.get());
+    _frames.refill(_fill);
+}
+
+// From our own memory, so that it is local to the shard and, with
+// --hugepages, backed by them
+char* qp::allocate_umem(size_t size) {
+    void* p;
+    auto r = ::posix_memalign(&p, frame_size, size);
+    if (r) {
+        throw std::bad_alloc();
+    }
+    return static_cast<char*>(p);
+}
+
+xdp_mmap_offsets qp::configure(file_desc& fd, char* umem, uint32_t ring_size) {
+    if (!ring_size || (ring_size & (ring_size - 1))) {
+        throw std::invalid_argument("xdp-ring-size must be a power of two");
+    }
+    xdp_umem_reg reg = {};
+    reg.addr = ptr_to_u64(umem);
+    reg.len = uint64_t(2) * ring_size * frame_size;
+    reg.chunk_size = frame_size;
+    fd.setsockopt(SOL_XDP, XDP_UMEM_REG, reg);
+    for (auto opt : { XDP_UMEM_FILL_RING, XDP_UMEM_COMPLETION_RING, XDP_RX_RING, XDP_TX_RING }) {
+        fd.setsockopt(SOL_XDP, opt, ring_size);
+    }
+    return fd.getsockopt<xdp_mmap_offsets>(SOL_XDP, XDP_MMAP_OFFSETS);
+}
+
+bool qp::poll_rx_once() {
+    bool work = _frames.complete(_completion);
+    work |= receive();
+    _frames.refill(_fill);
+    return work;
+}
+
+bool qp::receive() {
+    auto n = std::min(_rx.available(), 64u);
+    if (!n) {
+        if (_fill.needs_wakeup()) {
+            ::recvfrom(_fd.get(), nullptr, 0, MSG_DONTWAIT, nullptr, nullptr);
+        }
+        return false;
+    }
+    auto idx = _rx.consumer();
+    for (uint32_t i = 0; i < n; ++i) {
+        auto desc = _rx[idx + i];
+        auto frame = umem_frames::frame_of(desc.addr);
+        fragment f{_umem.get() + desc.addr, desc.len};
+        packet p;
+        if (_frames.can_lend()) {
+            _frames.lend();
+            p = packet(f, make_deleter(deleter(), [this, frame] {
+                _frames.returned(frame);
+            }));
+        } else {
+            // The stack is sitting on too many frames for the kernel to
+            // have enough to receive into; copy, as the DPDK backend does
+            p = packet(f);
+            _frames.recycle(frame);
+            _stats.rx.good.update_copy_stats(1, desc.len);
+        }
+        _stats.rx.good.update_frags_stats(1, desc.len);
+        _dev.l2receive(std::move(p));
+    }
+    _rx.consume(n);
+    _stats.rx.good.update_pkts_bunch(n);
+    return true;
+}
+
+uint32_t qp::send(circular_buffer<packet>& pb) {
+    _frames.complete(_completion);
+    auto room = std::min<size_t>(_tx.free_entries(), _frames.tx_available());
+    auto idx = _tx.producer();
+    uint32_t sent = 0;
+    while (!pb.empty() && sent < room) {
+        auto& p = pb.front();
+        // No bigger than the MTU, which the device made sure fits
+        assert(p.len() <= frame_size);
+        auto frame = _frames.take_tx();
+        auto out = _umem.get() + frame;
+        for (auto&& f : p.fragments()) {
+            out = std::copy_n(f.base, f.size, out);
+        }
+        _tx[idx + sent] = xdp_desc{frame, uint32_t(p.len()), 0};
+        _stats.tx.good.update_frags_stats(p.nr_frags(), p.len());
+        _stats.tx.good.update_copy_stats(p.nr_frags(), p.len());
+        ++sent;
+        pb.pop_front();
+    }
+    if (sent) {
+        _tx.produce(sent);
+        if (_tx.needs_wakeup()) {
+            // Errors just mean the kernel is busy with the ring already
+            ::sendto(_fd.get(), nullptr, 0, MSG_DONTWAIT, nullptr, 0);
+        }
+    }
+    return sent;
+}
+
+future<> qp::send(packet p) {
+    circular_buffer<packet> pb;
+    pb.push_back(std::move(p));
+    send(pb);
+    return make_ready_future<>();
+}
+
+}
+
+boost::program_options::options_description
+get_xdp_net_options_description()
+{
+    boost::program_options::options_description opts(
+            "AF_XDP net options");
+    opts.add_options()
+        ("xdp-device",
+                boost::program_options::value<std::string>(),
+                "Network interface to use through AF_XDP sockets")
+        ("xdp-ring-size",
+                boost::program_options::value<unsigned>()->default_value(2048),
+                "AF_XDP ring size (must be power-of-two)")
+        ("xdp-copy",
+                boost::program_options::value<std::string>()->default_value("off"),
+                "Have the kernel copy frames, for drivers without zero copy support (on / off)")
+        ("xdp-generic",
+                boost::program_options::value<std::string>()->default_value("off"),
+                "Run the XDP program in the driver independent mode (on / off)")
+        ("xdp-rss",
+                boost::program_options::value<std::string>()->default_value("off"),
+                "Point the interface's RSS indirection table at the queues served while running, "
+                "instead of requiring it to (on / off)")
+        ;
+    return opts;
+}
+
+std::unique_ptr<net::device> create_xdp_net_device(boost::program_options::variables_map opts) {
+    return std::make_unique<xdp::device>(opts);
+}
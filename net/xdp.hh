@@ -0,0 +1,39 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#ifndef XDP_HH_
+#define XDP_HH_
+
+#include <memory>
+#include "net.hh"
+
+// A device on an AF_XDP socket per queue, bound to a regular kernel
+// network interface (a NIC whose driver supports XDP, or a veth for
+// testing).  Queue n of the interface is served by shard n.  The RSS
+// indirection table of the interface must only use the queues served;
+// with --xdp-rss on, it is made to while the device is in use.
+//
+// Frames from a veth peer still have checksums for hardware to fill in;
+// turn that off on the peer with "ethtool -K <peer> tx off".
+std::unique_ptr<net::device> create_xdp_net_device(boost::program_options::variables_map opts);
+boost::program_options::options_description get_xdp_net_options_description();
+
+#endif /* XDP_HH_ */
@@ -86,7 +86,7 @@ class sring {
     void dump() {
         printf("Shared ring status: req_prod: %d, req_event %d, rsp_prod %d, rsp_event %d\n", req_prod, req_event, rsp_prod, rsp_event);
     }
-    sring<T>() = default;
+    sring() = default;
 };
 
 using phys = uint64_t;
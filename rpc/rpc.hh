@@ -149,7 +149,7 @@ class protocol {
             }
             virtual void timeout() override {
                 reply.done = true;
-                reply.p.set_exception(timeout_error());
+                reply.p.set_exception(cached_exception_ptr<timeout_error>());
             }
             virtual ~reply_handler() {}
         };
@@ -219,7 +219,7 @@ struct rcv_reply_base  {
     }
     ~rcv_reply_base() {
         if (!done) {
-            p.set_exception(closed_error());
+            p.set_exception(cached_exception_ptr<closed_error>());
         }
     }
 };
@@ -288,7 +288,7 @@ auto send_helper(MsgType xt, signature<Ret (InArgs...)> xsig) {
         auto send(typename protocol<Serializer, MsgType>::client& dst, std::experimental::optional<clock_type::time_point> timeout, const InArgs&... args) {
             if (dst.error()) {
                 using cleaned_ret_type = typename wait_signature<Ret>::cleaned_type;
-                return futurize<cleaned_ret_type>::make_exception_future(closed_error());
+                return futurize<cleaned_ret_type>::make_exception_future(cached_exception_ptr<closed_error>());
             }
 
             // send message
@@ -344,6 +344,15 @@ protocol<Serializer, MsgType>::server::connection::respond(int64_t msg_id, sstri
 template<typename Serializer, typename MsgType, typename... RetTypes>
 inline future<> reply(wait_type, future<RetTypes...>&& r, int64_t msgid, typename protocol<Serializer, MsgType>::server::connection& client) {
     client.get_stats_internal().sent_messages++;
+    if (r.failed()) {
+        // Classify the failure without rethrowing it; handlers failing in
+        // bulk (e.g. on timeouts) would otherwise pay for unwinding.
+        auto eptr = r.get_exception();
+        if (auto ex = try_catch<std::exception>(eptr)) {
+            return client.respond(-msgid, sstring(sstring::initialized_later(), 16) + ex->what());
+        }
+        std::rethrow_exception(std::move(eptr));
+    }
     try {
         auto&& data = r.get();
         auto str = ::apply(marshall<Serializer, const RetTypes&...>,
@@ -357,10 +366,13 @@ inline future<> reply(wait_type, future<RetTypes...>&& r, int64_t msgid, typenam
 // specialization for no_wait_type which does not send a reply
 template<typename Serializer, typename MsgType>
 inline future<> reply(no_wait_type, future<no_wait_type>&& r, int64_t msgid, typename protocol<Serializer, MsgType>::server::connection& client) {
-    try {
-        r.get();
-    } catch (std::exception& ex) {
-        client.get_protocol().log(client.info(), msgid, to_sstring("exception \"") + ex.what() + "\" in no_wait handler ignored");
+    if (r.failed()) {
+        auto eptr = r.get_exception();
+        if (auto ex = try_catch<std::exception>(eptr)) {
+            client.get_protocol().log(client.info(), msgid, to_sstring("exception \"") + ex->what() + "\" in no_wait handler ignored");
+        } else {
+            std::rethrow_exception(std::move(eptr));
+        }
     }
     return make_ready_future<>();
 }
@@ -34,9 +34,26 @@ boost_tests = [
     'fstream_test',
     'foreign_ptr_test',
     'semaphore_test',
+    'abort_source_test',
+    'async_sequence_test',
+    'log_test',
     'shared_ptr_test',
     'fileiotest',
     'packet_test',
+    'gso_test',
+    'gro_test',
+    'ip_checksum_test',
+    'flat_hash_map_test',
+    'crc32c_test',
+    'scheduling_group_test',
+    'tcp_sack_test',
+    'loopback_test',
+]
+
+# Only built when configure finds what they need
+optional_boost_tests = [
+    'lz4_stream_test',
+    'xdp_test',
 ]
 
 other_tests = [
@@ -87,6 +104,9 @@ if __name__ == "__main__":
             test_to_run.append((os.path.join(prefix, test),'other'))
         for test in boost_tests:
             test_to_run.append((os.path.join(prefix, test),'boost'))
+        for test in optional_boost_tests:
+            if os.path.exists(os.path.join(prefix, test)):
+                test_to_run.append((os.path.join(prefix, test),'boost'))
         test_to_run.append(('tests/memcached/test.py --mode ' + mode + (' --fast' if args.fast else ''),'other'))
         test_to_run.append((os.path.join(prefix, 'distributed_test') + ' -c 2','other'))
 
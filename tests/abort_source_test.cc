@@ -0,0 +1,173 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#include "tests/test-utils.hh"
+#include "core/abort_source.hh"
+#include "core/sleep.hh"
+#include "core/semaphore.hh"
+#include "core/queue.hh"
+#include "core/pipe.hh"
+#include "core/future-util.hh"
+#include "core/reactor.hh"
+
+using namespace seastar;
+using namespace std::chrono_literals;
+
+template <typename... T>
+static void require_aborted(future<T...>& f) {
+    BOOST_REQUIRE(f.available());
+    BOOST_REQUIRE_THROW(f.get(), abort_requested_exception);
+}
+
+template <typename... T>
+static future<> expect_aborted(future<T...> f) {
+    return f.then_wrapped([] (future<T...> f) {
+        BOOST_REQUIRE_THROW(f.get(), abort_requested_exception);
+    });
+}
+
+SEASTAR_TEST_CASE(test_abort_source_notifies_subscribers) {
+    abort_source as;
+    int called = 0;
+    auto st1 = as.subscribe([&called] { ++called; });
+    auto st2 = as.subscribe([&called] { ++called; });
+    {
+        auto st3 = as.subscribe([&called] { called += 100; });
+    }
+    st2.unsubscribe();
+    BOOST_REQUIRE(st1);
+    BOOST_REQUIRE(!st2);
+    as.request_abort();
+    BOOST_REQUIRE_EQUAL(called, 1);
+    BOOST_REQUIRE(as.abort_requested());
+    BOOST_REQUIRE(!st1);
+    BOOST_REQUIRE_THROW(as.check(), abort_requested_exception);
+    // subscriptions made after the abort are inactive
+    auto st4 = as.subscribe([&called] { ++called; });
+    BOOST_REQUIRE(!st4);
+    return make_ready_future<>();
+}
+
+SEASTAR_TEST_CASE(test_sleep_abortable) {
+    auto as = make_lw_shared<abort_source>();
+    auto start = std::chrono::high_resolution_clock::now();
+    auto f = sleep_abortable(10s, *as).then_wrapped([as, start] (future<> f) {
+        BOOST_REQUIRE_THROW(f.get(), abort_requested_exception);
+        BOOST_REQUIRE(std::chrono::high_resolution_clock::now() - start < 5s);
+    });
+    sleep(1ms).then([as] {
+        as->request_abort();
+    });
+    return f.then([as] {
+        // already aborted: fails without arming a timer
+        auto f = sleep_abortable(10s, *as);
+        require_aborted(f);
+    });
+}
+
+SEASTAR_TEST_CASE(test_sleep_abortable_completes) {
+    return do_with(abort_source(), [] (abort_source& as) {
+        return sleep_abortable(1ms, as).then([&as] {
+            // the completed sleep must have dropped its subscription
+            as.request_abort();
+        });
+    });
+}
+
+SEASTAR_TEST_CASE(test_semaphore_abort) {
+    return do_with(semaphore(0), abort_source(), [] (semaphore& sem, abort_source& as) {
+        auto aborted = sem.wait(as, 1);
+        auto waiter = sem.wait(1);
+        BOOST_REQUIRE(!aborted.available());
+        as.request_abort();
+        require_aborted(aborted);
+        // the aborted waiter does not consume units meant for the next one
+        sem.signal(1);
+        BOOST_REQUIRE(waiter.available());
+        waiter.get();
+        BOOST_REQUIRE_EQUAL(sem.current(), 0u);
+        auto late = sem.wait(as, 1);
+        require_aborted(late);
+        return make_ready_future<>();
+    });
+}
+
+SEASTAR_TEST_CASE(test_queue_abort) {
+    return do_with(queue<int>(1), abort_source(), [] (queue<int>& q, abort_source& as) {
+        auto pop = q.pop_eventually(as);
+        BOOST_REQUIRE(!pop.available());
+        as.request_abort();
+        return expect_aborted(std::move(pop)).then([&q] {
+            // the queue is still usable after an aborted wait
+            BOOST_REQUIRE(q.push(1));
+            return q.pop_eventually();
+        }).then([] (int v) {
+            BOOST_REQUIRE_EQUAL(v, 1);
+        });
+    });
+}
+
+SEASTAR_TEST_CASE(test_queue_push_abort) {
+    return do_with(queue<int>(1), abort_source(), [] (queue<int>& q, abort_source& as) {
+        BOOST_REQUIRE(q.push(1));
+        auto push = q.push_eventually(2, as);
+        BOOST_REQUIRE(!push.available());
+        as.request_abort();
+        return expect_aborted(std::move(push)).then([&q] {
+            BOOST_REQUIRE_EQUAL(q.pop(), 1);
+            BOOST_REQUIRE(q.empty());
+        });
+    });
+}
+
+SEASTAR_TEST_CASE(test_pipe_abort) {
+    return do_with(seastar::pipe<int>(1), abort_source(), [] (seastar::pipe<int>& p, abort_source& as) {
+        auto read = p.reader.read(as);
+        BOOST_REQUIRE(!read.available());
+        as.request_abort();
+        return expect_aborted(std::move(read)).then([&p] {
+            return p.writer.write(7);
+        }).then([&p] {
+            return p.reader.read();
+        }).then([] (std::experimental::optional<int> v) {
+            BOOST_REQUIRE(v);
+            BOOST_REQUIRE_EQUAL(*v, 7);
+        });
+    });
+}
+
+SEASTAR_TEST_CASE(test_with_timeout_expires) {
+    auto pr = make_lw_shared<promise<int>>();
+    auto deadline = std::chrono::high_resolution_clock::now() + 10ms;
+    return with_timeout(deadline, pr->get_future()).then_wrapped([pr] (future<int> f) {
+        BOOST_REQUIRE_THROW(f.get(), timed_out_error);
+        // a late result is discarded
+        pr->set_value(1);
+    });
+}
+
+SEASTAR_TEST_CASE(test_with_timeout_completes) {
+    auto deadline = std::chrono::high_resolution_clock::now() + 10s;
+    return with_timeout(deadline, sleep(1ms).then([] { return 3; })).then([] (int v) {
+        BOOST_REQUIRE_EQUAL(v, 3);
+    });
+}
@@ -0,0 +1,221 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#include "tests/test-utils.hh"
+#include "core/async_sequence.hh"
+#include "core/future-util.hh"
+#include "core/reactor.hh"
+#include "core/sleep.hh"
+#include <boost/iterator/counting_iterator.hpp>
+#include <numeric>
+
+using namespace seastar;
+using namespace std::chrono_literals;
+
+static std::vector<int> iota_vector(int n) {
+    std::vector<int> v(n);
+    std::iota(v.begin(), v.end(), 0);
+    return v;
+}
+
+// Returns values [0, n) in batches of batch_size, each batch after a
+// reactor round-trip, and records the largest number of values handed out
+// but not yet accounted for by the consumer.
+class counting_sequence_impl : public async_sequence_impl<int> {
+    int _next = 0;
+    int _n;
+    int _batch_size;
+public:
+    counting_sequence_impl(int n, int batch_size) : _n(n), _batch_size(batch_size) {}
+    virtual future<std::vector<int>> next_batch() override {
+        return later().then([this] {
+            std::vector<int> ret;
+            while (_next < _n && int(ret.size()) < _batch_size) {
+                ret.push_back(_next++);
+            }
+            return ret;
+        });
+    }
+    int produced() const { return _next; }
+};
+
+class failing_sequence_impl : public async_sequence_impl<int> {
+    bool _first = true;
+public:
+    virtual future<std::vector<int>> next_batch() override {
+        if (_first) {
+            _first = false;
+            return make_ready_future<std::vector<int>>(std::vector<int>{1, 2, 3});
+        }
+        return make_exception_future<std::vector<int>>(std::runtime_error("failed"));
+    }
+};
+
+SEASTAR_TEST_CASE(test_ready_sequence) {
+    return make_ready_async_sequence(iota_vector(10)).to_vector().then([] (std::vector<int> v) {
+        BOOST_REQUIRE(v == iota_vector(10));
+    });
+}
+
+SEASTAR_TEST_CASE(test_map_filter) {
+    auto seq = make_async_sequence<int, counting_sequence_impl>(1000, 7);
+    return std::move(seq).filter([] (int x) {
+        return x % 2 == 0;
+    }).map([] (int x) {
+        return sstring(to_sstring(x));
+    }).to_vector().then([] (std::vector<sstring> v) {
+        BOOST_REQUIRE_EQUAL(v.size(), 500u);
+        BOOST_REQUIRE_EQUAL(v[0], "0");
+        BOOST_REQUIRE_EQUAL(v[499], "998");
+    });
+}
+
+SEASTAR_TEST_CASE(test_filter_skips_empty_batches) {
+    // a whole batch filtered out must not end the sequence
+    auto seq = make_async_sequence<int, counting_sequence_impl>(100, 5);
+    return std::move(seq).filter([] (int x) {
+        return x >= 90;
+    }).to_vector().then([] (std::vector<int> v) {
+        BOOST_REQUIRE_EQUAL(v.size(), 10u);
+        BOOST_REQUIRE_EQUAL(v.front(), 90);
+    });
+}
+
+SEASTAR_TEST_CASE(test_chunk) {
+    auto seq = make_async_sequence<int, counting_sequence_impl>(100, 7);
+    auto sizes = make_lw_shared<std::vector<size_t>>();
+    auto sum = make_lw_shared<int>(0);
+    return std::move(seq).chunk(16).consume([sizes, sum] (std::vector<int> batch) {
+        sizes->push_back(batch.size());
+        *sum += std::accumulate(batch.begin(), batch.end(), 0);
+    }).then([sizes, sum] {
+        BOOST_REQUIRE_EQUAL(sizes->size(), 7u);
+        for (unsigned i = 0; i < 6; ++i) {
+            BOOST_REQUIRE_EQUAL((*sizes)[i], 16u);
+        }
+        BOOST_REQUIRE_EQUAL(sizes->back(), 4u);
+        BOOST_REQUIRE_EQUAL(*sum, 99 * 100 / 2);
+    });
+}
+
+SEASTAR_TEST_CASE(test_buffer_reads_ahead_bounded) {
+    auto impl = std::make_unique<counting_sequence_impl>(10000, 10);
+    auto source = impl.get();
+    auto seq = async_sequence<int>(std::move(impl)).buffer(100);
+    return do_with(std::move(seq), int(0), [source] (async_sequence<int>& seq, int& consumed) {
+        // let the buffer fill up without consuming anything
+        return sleep(10ms).then([&seq, &consumed, source] {
+            BOOST_REQUIRE_GE(source->produced(), 100);
+            BOOST_REQUIRE_LE(source->produced(), 110);
+            return repeat([&seq, &consumed, source] {
+                return seq.next_batch().then([&consumed, source] (std::vector<int> batch) {
+                    for (auto x : batch) {
+                        BOOST_REQUIRE_EQUAL(x, consumed++);
+                    }
+                    BOOST_REQUIRE_LE(source->produced() - consumed, 110);
+                    return batch.empty() ? stop_iteration::yes : stop_iteration::no;
+                });
+            });
+        }).then([&consumed] {
+            BOOST_REQUIRE_EQUAL(consumed, 10000);
+        });
+    });
+}
+
+SEASTAR_TEST_CASE(test_merge) {
+    std::vector<async_sequence<int>> sources;
+    for (int i = 0; i < 4; ++i) {
+        sources.push_back(make_async_sequence<int, counting_sequence_impl>(100 * (i + 1), 3 + i));
+    }
+    return merge(std::move(sources)).to_vector().then([] (std::vector<int> v) {
+        BOOST_REQUIRE_EQUAL(v.size(), 1000u);
+        BOOST_REQUIRE_EQUAL(std::accumulate(v.begin(), v.end(), 0),
+                99 * 100 / 2 + 199 * 200 / 2 + 299 * 300 / 2 + 399 * 400 / 2);
+    });
+}
+
+SEASTAR_TEST_CASE(test_failure_propagates) {
+    auto seq = make_async_sequence<int, failing_sequence_impl>();
+    return std::move(seq).map([] (int x) {
+        return x * 2;
+    }).buffer(10).to_vector().then_wrapped([] (future<std::vector<int>> f) {
+        BOOST_REQUIRE_THROW(f.get(), std::runtime_error);
+    });
+}
+
+SEASTAR_TEST_CASE(test_subscription_backpressure) {
+    struct producer {
+        stream<int> s;
+        int produced = 0;
+    };
+    auto p = make_lw_shared<producer>();
+    auto seq = make_async_sequence_from_subscription<int>(10, [p] (auto next) {
+        return p->s.listen(std::move(next));
+    });
+    p->s.started().then([p] {
+        return do_for_each(boost::make_counting_iterator(0), boost::make_counting_iterator(1000), [p] (int i) {
+            ++p->produced;
+            return p->s.produce(i);
+        });
+    }).then_wrapped([p] (future<> f) {
+        f.get();
+        p->s.close();
+    });
+    return do_with(std::move(seq), int(0), [p] (async_sequence<int>& seq, int& consumed) {
+        return repeat([&seq, &consumed, p] {
+            return seq.next_batch().then([&consumed, p] (std::vector<int> batch) {
+                // the producer is held back once 10 values are waiting
+                BOOST_REQUIRE_LE(batch.size(), 10u);
+                for (auto x : batch) {
+                    BOOST_REQUIRE_EQUAL(x, consumed++);
+                }
+                BOOST_REQUIRE_LE(p->produced - consumed, 10);
+                return later().then([empty = batch.empty()] {
+                    return empty ? stop_iteration::yes : stop_iteration::no;
+                });
+            });
+        }).then([&consumed] {
+            BOOST_REQUIRE_EQUAL(consumed, 1000);
+        });
+    });
+}
+
+SEASTAR_TEST_CASE(test_batched_subscription) {
+    auto s = make_lw_shared<stream<std::vector<int>>>();
+    auto seq = make_async_sequence_from_batched_subscription<int>(100, [s] (auto next) {
+        return s->listen(std::move(next));
+    });
+    s->started().then([s] {
+        return do_for_each(boost::make_counting_iterator(0), boost::make_counting_iterator(10), [s] (int i) {
+            return s->produce(iota_vector(10));
+        });
+    }).then([s] {
+        s->set_exception(std::runtime_error("producer failed"));
+    });
+    auto count = make_lw_shared<int>(0);
+    return std::move(seq).for_each([count] (int) {
+        ++*count;
+    }).then_wrapped([count] (future<> f) {
+        BOOST_REQUIRE_THROW(f.get(), std::runtime_error);
+        BOOST_REQUIRE_EQUAL(*count, 100);
+    });
+}
@@ -0,0 +1,136 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+// Compares a 10-step .then() chain with the equivalent coroutine, counting
+// time, tasks run and allocations per chain.  Each step either returns a
+// ready future or one that is fulfilled by a separately scheduled task.
+//
+// The coroutine variants need a build configured with --enable-coroutines.
+
+#include <chrono>
+#include "core/app-template.hh"
+#include "core/reactor.hh"
+#include "core/future-util.hh"
+#include "core/memory.hh"
+#include "core/print.hh"
+#ifdef SEASTAR_COROUTINES_ENABLED
+#include "core/coroutine.hh"
+#endif
+
+namespace bpo = boost::program_options;
+using clk = std::chrono::steady_clock;
+
+static constexpr int steps = 10;
+
+static future<int> ready_step(int x) {
+    return make_ready_future<int>(x + 1);
+}
+
+static future<int> deferred_step(int x) {
+    promise<int> pr;
+    auto f = pr.get_future();
+    schedule(make_task([pr = std::move(pr), x] () mutable {
+        pr.set_value(x + 1);
+    }));
+    return f;
+}
+
+template <future<int> (*step)(int)>
+static future<int> then_chain(int x) {
+    return step(x).then([] (int x) {
+        return step(x);
+    }).then([] (int x) {
+        return step(x);
+    }).then([] (int x) {
+        return step(x);
+    }).then([] (int x) {
+        return step(x);
+    }).then([] (int x) {
+        return step(x);
+    }).then([] (int x) {
+        return step(x);
+    }).then([] (int x) {
+        return step(x);
+    }).then([] (int x) {
+        return step(x);
+    }).then([] (int x) {
+        return step(x);
+    });
+}
+
+#ifdef SEASTAR_COROUTINES_ENABLED
+template <future<int> (*step)(int)>
+static future<int> coroutine_chain(int x) {
+    x = co_await step(x);
+    x = co_await step(x);
+    x = co_await step(x);
+    x = co_await step(x);
+    x = co_await step(x);
+    x = co_await step(x);
+    x = co_await step(x);
+    x = co_await step(x);
+    x = co_await step(x);
+    x = co_await step(x);
+    co_return x;
+}
+#endif
+
+static future<> measure(const char* name, unsigned iterations, future<int> (*chain)(int)) {
+    auto tasks = engine().tasks_processed();
+    auto mallocs = memory::stats().mallocs();
+    auto start = clk::now();
+    return do_with(unsigned(0), [iterations, chain] (unsigned& i) {
+        return do_until([&i, iterations] { return i == iterations; }, [&i, chain] {
+            return chain(0).then([&i] (int x) {
+                assert(x == steps);
+                ++i;
+            });
+        });
+    }).then([=] {
+        auto elapsed = std::chrono::duration<double, std::nano>(clk::now() - start).count();
+        print("%-20s %8.1f ns %8.2f tasks %8.2f allocations per chain\n", name,
+                elapsed / iterations,
+                double(engine().tasks_processed() - tasks) / iterations,
+                double(memory::stats().mallocs() - mallocs) / iterations);
+    });
+}
+
+int main(int ac, char** av) {
+    app_template app;
+    app.add_options()
+        ("iterations", bpo::value<unsigned>()->default_value(1000000), "number of chains to run for each variant")
+        ;
+    return app.run(ac, av, [&app] {
+        auto iterations = app.configuration()["iterations"].as<unsigned>();
+        return measure("then, ready", iterations, then_chain<ready_step>).then([iterations] {
+            return measure("then, deferred", iterations, then_chain<deferred_step>);
+        }).then([iterations] {
+#ifdef SEASTAR_COROUTINES_ENABLED
+            return measure("coroutine, ready", iterations, coroutine_chain<ready_step>).then([iterations] {
+                return measure("coroutine, deferred", iterations, coroutine_chain<deferred_step>);
+            });
+#else
+            print("coroutines not enabled; configure with --enable-coroutines\n");
+            return make_ready_future<>();
+#endif
+        });
+    });
+}
@@ -0,0 +1,80 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+// Measures crc32c throughput of each implementation over a range of buffer
+// sizes.  Does not need the reactor.
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include "core/crc32c.hh"
+#include "core/print.hh"
+
+using clk = std::chrono::steady_clock;
+using update_fn = uint32_t (*)(uint32_t, const char*, size_t);
+
+static double measure(update_fn update, const std::vector<char>& data, size_t size) {
+    auto iterations = std::max<size_t>(1, (size_t(256) << 20) / size);
+    uint32_t crc = 0xffffffff;
+    auto start = clk::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        crc = update(crc, data.data(), size);
+    }
+    auto elapsed = std::chrono::duration<double>(clk::now() - start).count();
+    // keep the loop from being optimized away
+    if (crc == 0x12345678) {
+        std::cout << "";
+    }
+    return iterations * size / elapsed / 1e9;
+}
+
+int main(int ac, char** av) {
+    std::vector<char> data(1 << 20);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = i * 7 + (i >> 8);
+    }
+    struct impl {
+        const char* name;
+        update_fn update;
+        bool supported;
+    } impls[] = {
+        { "table", crc32c_impl::update_table, true },
+        { "sse4.2", crc32c_impl::update_sse42, crc32c_impl::has_sse42() },
+        { "sse4.2+pclmul", crc32c_impl::update_sse42_pclmul, crc32c_impl::has_sse42() && crc32c_impl::has_pclmul() },
+    };
+    print("%-10s", "size");
+    for (auto& i : impls) {
+        print(" %14s", i.name);
+    }
+    print("\n");
+    for (size_t size : { 64, 256, 1024, 4096, 16384, 65536, 1 << 20 }) {
+        print("%-10d", size);
+        for (auto& i : impls) {
+            if (i.supported) {
+                print(" %9.2f GB/s", measure(i.update, data, size));
+            } else {
+                print(" %14s", "n/a");
+            }
+        }
+        print("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#include <random>
+#include <numeric>
+#include "core/reactor.hh"
+#include "core/fstream.hh"
+#include "core/crc32c.hh"
+#include "core/checksummed-stream.hh"
+#include "core/do_with.hh"
+#include "core/seastar.hh"
+#include "test-utils.hh"
+
+SEASTAR_TEST_CASE(test_crc32c_known_values) {
+    BOOST_REQUIRE_EQUAL(crc32c_of("", 0), 0u);
+    BOOST_REQUIRE_EQUAL(crc32c_of("123456789", 9), 0xe3069283);
+    crc32c c;
+    c.process("1234", 4);
+    c.process("56789", 5);
+    BOOST_REQUIRE_EQUAL(c.get(), 0xe3069283);
+    return make_ready_future<>();
+}
+
+SEASTAR_TEST_CASE(test_crc32c_implementations_agree) {
+    std::vector<char> data(100000);
+    std::default_random_engine rnd;
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (auto& c : data) {
+        c = byte(rnd);
+    }
+    for (size_t offset : { 0, 1, 7 }) {
+        for (size_t size : { 0, 1, 8, 100, 3071, 3072, 3073, 9216, 99000 }) {
+            auto p = data.data() + offset;
+            auto expected = crc32c_impl::update_table(0xffffffff, p, size);
+            if (crc32c_impl::has_sse42()) {
+                BOOST_REQUIRE_EQUAL(crc32c_impl::update_sse42(0xffffffff, p, size), expected);
+                if (crc32c_impl::has_pclmul()) {
+                    BOOST_REQUIRE_EQUAL(crc32c_impl::update_sse42_pclmul(0xffffffff, p, size), expected);
+                }
+            }
+        }
+    }
+    return make_ready_future<>();
+}
+
+static future<> write_file(lw_shared_ptr<std::vector<char>> data) {
+    return open_file_dma("testfile.tmp",
+            open_flags::rw | open_flags::create | open_flags::truncate).then([data] (file f) {
+        checksummed_output_stream_options options;
+        options.chunk_size = 4096;
+        return do_with(make_checksummed_output_stream(make_file_output_stream(std::move(f)), options), [data] (output_stream<char>& out) {
+            return out.write(data->data(), data->size()).then([&out] {
+                return out.close();
+            });
+        });
+    });
+}
+
+static future<temporary_buffer<char>> read_file(size_t size) {
+    return open_file_dma("testfile.tmp", open_flags::ro).then([size] (file f) {
+        return do_with(make_checksummed_input_stream(make_file_input_stream(std::move(f))), [size] (input_stream<char>& in) {
+            return in.read_exactly(size).finally([&in] {
+                return in.close();
+            });
+        });
+    });
+}
+
+SEASTAR_TEST_CASE(test_checksummed_stream_round_trip) {
+    auto data = make_lw_shared<std::vector<char>>(100000);
+    std::iota(data->begin(), data->end(), 0);
+    return write_file(data).then([data] {
+        return read_file(data->size());
+    }).then([data] (temporary_buffer<char> buf) {
+        BOOST_REQUIRE_EQUAL(buf.size(), data->size());
+        BOOST_REQUIRE(std::equal(buf.begin(), buf.end(), data->begin()));
+    });
+}
+
+SEASTAR_TEST_CASE(test_checksummed_stream_detects_corruption) {
+    auto data = make_lw_shared<std::vector<char>>(100000);
+    std::iota(data->begin(), data->end(), 0);
+    return write_file(data).then([] {
+        return open_file_dma("testfile.tmp", open_flags::rw);
+    }).then([] (file f) {
+        // flip a bit in the second frame
+        return f.dma_read_exactly<char>(4096, 4096).then([f] (temporary_buffer<char> buf) mutable {
+            buf.get_write()[100] ^= 1;
+            auto p = buf.get();
+            auto size = buf.size();
+            return f.dma_write(4096, p, size).then([buf = std::move(buf)] (size_t) {});
+        }).then([f] () mutable {
+            return f.close();
+        });
+    }).then([data] {
+        return read_file(data->size());
+    }).then_wrapped([] (future<temporary_buffer<char>> f) {
+        BOOST_REQUIRE_THROW(f.get(), checksum_error);
+    });
+}
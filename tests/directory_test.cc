@@ -20,10 +20,56 @@
  */
 
 
+#include <chrono>
 #include "core/reactor.hh"
 #include "core/app-template.hh"
 #include "core/print.hh"
 #include "core/shared_ptr.hh"
+#include "core/seastar.hh"
+#include "core/thread.hh"
+
+namespace bpo = boost::program_options;
+using clk = std::chrono::steady_clock;
+
+// Benchmark mode: time listing `dir` one entry at a time and in batches.
+// With --populate, fills the directory with that many empty files first
+// (and removes them afterwards).
+static void benchmark(sstring dir, unsigned populate, unsigned iterations) {
+    for (unsigned i = 0; i < populate; ++i) {
+        open_file_dma(sprint("%s/f%d", dir, i), open_flags::wo | open_flags::create).get0().close().get();
+    }
+    for (unsigned i = 0; i < iterations; ++i) {
+        uint64_t entries = 0;
+        uint64_t typed = 0;
+        auto start = clk::now();
+        auto f = engine().open_directory(dir).get0();
+        f.list_directory([&] (directory_entry de) {
+            ++entries;
+            typed += bool(de.type);
+            return make_ready_future<>();
+        }).done().get();
+        f.close().get();
+        auto single = std::chrono::duration<double>(clk::now() - start).count();
+
+        uint64_t batches = 0;
+        entries = 0;
+        start = clk::now();
+        f = engine().open_directory(dir).get0();
+        f.list_directory_batched([&] (std::vector<directory_entry> batch) {
+            ++batches;
+            entries += batch.size();
+            return make_ready_future<>();
+        }).done().get();
+        f.close().get();
+        auto batched = std::chrono::duration<double>(clk::now() - start).count();
+
+        print("%d entries (%d with type): per-entry %.3f s (%.0f entries/s), batched %.3f s (%.0f entries/s, %d batches)\n",
+                entries, typed, single, entries / single, batched, entries / batched, batches);
+    }
+    for (unsigned i = 0; i < populate; ++i) {
+        remove_file(sprint("%s/f%d", dir, i)).get();
+    }
+}
 
 int main(int ac, char** av) {
     class lister {
@@ -41,13 +87,26 @@ int main(int ac, char** av) {
             return make_ready_future<>();
         }
     };
-    return app_template().run_deprecated(ac, av, [] {
-        return engine().open_directory(".").then([] (file f) {
-            auto l = make_lw_shared<lister>(std::move(f));
-            return l->done().then([l] {
-                // ugly thing to keep *l alive
-                engine().exit(0);
+    app_template app;
+    app.add_options()
+        ("dir", bpo::value<std::string>()->default_value("."), "directory to list")
+        ("benchmark", "measure listing throughput instead of printing the entries")
+        ("populate", bpo::value<unsigned>()->default_value(0), "in benchmark mode, create this many files in the directory first")
+        ("iterations", bpo::value<unsigned>()->default_value(3), "in benchmark mode, number of times to list the directory")
+        ;
+    return app.run(ac, av, [&app] {
+        auto&& config = app.configuration();
+        sstring dir = config["dir"].as<std::string>();
+        if (config.count("benchmark")) {
+            auto populate = config["populate"].as<unsigned>();
+            auto iterations = config["iterations"].as<unsigned>();
+            return seastar::async([dir, populate, iterations] {
+                benchmark(dir, populate, iterations);
             });
+        }
+        return engine().open_directory(dir).then([] (file f) {
+            auto l = make_lw_shared<lister>(std::move(f));
+            return l->done().finally([l] {});
         });
     });
 }
@@ -0,0 +1,91 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+// Measures the cost of failing a future and having a then_wrapped()
+// continuation recognize the failure, comparing the classic
+// rethrow-and-catch idiom with try_catch() inspection and with a shared
+// preallocated exception from cached_exception_ptr().
+
+#include <chrono>
+#include "core/app-template.hh"
+#include "core/reactor.hh"
+#include "core/future-util.hh"
+#include "core/semaphore.hh"
+#include "core/print.hh"
+
+namespace bpo = boost::program_options;
+using clk = std::chrono::steady_clock;
+
+static future<> fail_fresh() {
+    return make_exception_future<>(semaphore_timed_out());
+}
+
+static future<> fail_cached() {
+    return make_exception_future<>(cached_exception_ptr<semaphore_timed_out>());
+}
+
+static bool classify_rethrow(future<> f) {
+    try {
+        f.get();
+        return false;
+    } catch (semaphore_timed_out&) {
+        return true;
+    }
+}
+
+static bool classify_try_catch(future<> f) {
+    return f.failed() && try_catch<semaphore_timed_out>(f.get_exception());
+}
+
+static future<> measure(const char* name, unsigned iterations, future<> (*fail)(), bool (*classify)(future<>)) {
+    auto start = clk::now();
+    return do_with(unsigned(0), unsigned(0), [iterations, fail, classify] (unsigned& i, unsigned& timeouts) {
+        return do_until([&i, iterations] { return i == iterations; }, [&i, &timeouts, fail, classify] {
+            ++i;
+            return fail().then_wrapped([&timeouts, classify] (future<> f) {
+                timeouts += classify(std::move(f));
+            });
+        }).then([&timeouts, iterations] {
+            assert(timeouts == iterations);
+        });
+    }).then([=] {
+        auto elapsed = std::chrono::duration<double, std::nano>(clk::now() - start).count();
+        print("%-40s %8.1f ns per failure, %8.0f failures/s\n", name,
+                elapsed / iterations, iterations / (elapsed / 1e9));
+    });
+}
+
+int main(int ac, char** av) {
+    app_template app;
+    app.add_options()
+        ("iterations", bpo::value<unsigned>()->default_value(1000000), "number of failures for each variant")
+        ;
+    return app.run(ac, av, [&app] {
+        auto iterations = app.configuration()["iterations"].as<unsigned>();
+        return measure("fresh exception, rethrow", iterations, fail_fresh, classify_rethrow).then([iterations] {
+            return measure("fresh exception, try_catch", iterations, fail_fresh, classify_try_catch);
+        }).then([iterations] {
+            return measure("cached exception, rethrow", iterations, fail_cached, classify_rethrow);
+        }).then([iterations] {
+            return measure("cached exception, try_catch", iterations, fail_cached, classify_try_catch);
+        });
+    });
+}
@@ -24,6 +24,8 @@
 #include "core/semaphore.hh"
 #include "core/file.hh"
 #include "core/reactor.hh"
+#include "core/seastar.hh"
+#include <set>
 
 struct file_test {
     file_test(file&& f) : f(std::move(f)) {}
@@ -69,3 +71,55 @@ SEASTAR_TEST_CASE(test1) {
 }
 
 
+SEASTAR_TEST_CASE(test_stat_files) {
+    return open_file_dma("statfile.tmp", open_flags::rw | open_flags::create | open_flags::truncate).then([] (file f) {
+        auto buf = allocate_aligned_buffer<unsigned char>(4096, 4096);
+        std::fill(buf.get(), buf.get() + 4096, 0);
+        auto b = buf.get();
+        return f.dma_write(0, b, 4096).then([f, buf = std::move(buf)] (size_t) mutable {
+            return f.close();
+        });
+    }).then([] {
+        return stat_files({ "statfile.tmp", "statfile-nonexistent.tmp", "." });
+    }).then([] (std::vector<std::experimental::optional<file_metadata>> md) {
+        BOOST_REQUIRE_EQUAL(md.size(), 3u);
+        BOOST_REQUIRE(md[0]);
+        BOOST_REQUIRE(md[0]->type == directory_entry_type::regular);
+        BOOST_REQUIRE_EQUAL(md[0]->size, 4096u);
+        BOOST_REQUIRE(!md[1]);
+        BOOST_REQUIRE(md[2]);
+        BOOST_REQUIRE(md[2]->type == directory_entry_type::directory);
+        return cached_stat_files({ "statfile.tmp" });
+    }).then([] (std::vector<std::experimental::optional<file_metadata>> md) {
+        BOOST_REQUIRE(md[0]);
+        return remove_file("statfile.tmp");
+    }).then([] {
+        // remove_file() invalidated the cached entry
+        return cached_stat_files({ "statfile.tmp" });
+    }).then([] (std::vector<std::experimental::optional<file_metadata>> md) {
+        BOOST_REQUIRE(!md[0]);
+    });
+}
+
+SEASTAR_TEST_CASE(test_list_directory_sequence) {
+    auto names = make_lw_shared<std::set<sstring>>();
+    return open_directory(".").then([names] (file f) {
+        auto sub = make_lw_shared(f.list_directory([names] (directory_entry de) {
+            names->insert(de.name);
+            return make_ready_future<>();
+        }));
+        return sub->done().then([f, sub] () mutable {
+            return f.close();
+        });
+    }).then([] {
+        return open_directory(".");
+    }).then([names] (file f) {
+        return f.list_directory_sequence(16).map([] (directory_entry de) {
+            return de.name;
+        }).to_vector().then([f, names] (std::vector<sstring> seq_names) mutable {
+            BOOST_REQUIRE_EQUAL(seq_names.size(), names->size());
+            BOOST_REQUIRE(std::set<sstring>(seq_names.begin(), seq_names.end()) == *names);
+            return f.close();
+        });
+    });
+}
@@ -0,0 +1,114 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE core
+
+#include <boost/test/included/unit_test.hpp>
+#include "core/flat_hash_map.hh"
+#include "core/sstring.hh"
+#include <random>
+#include <unordered_map>
+
+BOOST_AUTO_TEST_CASE(test_insert_find_erase) {
+    flat_hash_map<int, sstring> m;
+    BOOST_REQUIRE(m.find(1) == m.end());
+    BOOST_REQUIRE(m.emplace(1, "one").second);
+    BOOST_REQUIRE(!m.emplace(1, "uno").second);
+    BOOST_REQUIRE(m.insert({2, "two"}).second);
+    m[3] = "three";
+    BOOST_REQUIRE_EQUAL(m.size(), 3);
+    BOOST_REQUIRE_EQUAL(m.find(1)->second, sstring("one"));
+    BOOST_REQUIRE_EQUAL(m[2], sstring("two"));
+    BOOST_REQUIRE_EQUAL(m.erase(2), 1);
+    BOOST_REQUIRE_EQUAL(m.erase(2), 0);
+    BOOST_REQUIRE(m.find(2) == m.end());
+    BOOST_REQUIRE_EQUAL(m.size(), 2);
+    size_t n = 0;
+    for (auto&& e : m) {
+        BOOST_REQUIRE(e.first == 1 || e.first == 3);
+        ++n;
+    }
+    BOOST_REQUIRE_EQUAL(n, 2);
+    m.clear();
+    BOOST_REQUIRE(m.empty());
+    BOOST_REQUIRE(m.begin() == m.end());
+}
+
+// Agrees with std::unordered_map over a long run of random operations,
+// on a small key space so that erased slots pile up and get reused, and
+// the table is rebuilt without them
+BOOST_AUTO_TEST_CASE(test_random_operations) {
+    flat_hash_map<uint32_t, uint32_t> m;
+    std::unordered_map<uint32_t, uint32_t> ref;
+    std::default_random_engine rnd;
+    for (uint32_t keys : { 10, 1000, 100000 }) {
+        std::uniform_int_distribution<uint32_t> key(0, keys - 1);
+        for (int i = 0; i < 500000; ++i) {
+            auto k = key(rnd);
+            switch (rnd() % 3) {
+            case 0:
+                BOOST_REQUIRE_EQUAL(m.emplace(k, i).second, ref.emplace(k, i).second);
+                break;
+            case 1:
+                BOOST_REQUIRE_EQUAL(m.erase(k), ref.erase(k));
+                break;
+            case 2: {
+                auto j = m.find(k);
+                auto r = ref.find(k);
+                BOOST_REQUIRE_EQUAL(j == m.end(), r == ref.end());
+                if (r != ref.end()) {
+                    BOOST_REQUIRE_EQUAL(j->second, r->second);
+                }
+                break;
+            }
+            }
+            BOOST_REQUIRE_EQUAL(m.size(), ref.size());
+        }
+        BOOST_REQUIRE_LE(m.capacity(), 4 * keys + 16);
+        for (auto&& e : ref) {
+            BOOST_REQUIRE_EQUAL(m.find(e.first)->second, e.second);
+        }
+        m.clear();
+        ref.clear();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_values_are_moved_and_destroyed) {
+    auto counter = std::make_shared<int>();
+    {
+        flat_hash_map<int, std::shared_ptr<int>> m;
+        for (int i = 0; i < 1000; ++i) {
+            m.emplace(i, counter);
+        }
+        BOOST_REQUIRE_EQUAL(counter.use_count(), 1001);
+        for (int i = 0; i < 1000; i += 2) {
+            m.erase(i);
+        }
+        BOOST_REQUIRE_EQUAL(counter.use_count(), 501);
+        auto moved = std::move(m);
+        BOOST_REQUIRE_EQUAL(moved.size(), 500);
+        BOOST_REQUIRE(m.empty());
+        BOOST_REQUIRE_EQUAL(counter.use_count(), 501);
+    }
+    BOOST_REQUIRE_EQUAL(counter.use_count(), 1);
+}
@@ -0,0 +1,89 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+// Compares number formatting in to_sstring() and sprint() with the
+// snprintf() and boost::format code they replaced.
+
+#include <chrono>
+#include <cstdio>
+#include "core/app-template.hh"
+#include "core/reactor.hh"
+#include "core/sstring.hh"
+#include "core/print.hh"
+
+namespace bpo = boost::program_options;
+using clk = std::chrono::steady_clock;
+
+template <typename T>
+static sstring snprintf_to_sstring(const char* fmt, T value) {
+    char tmp[64];
+    auto len = std::snprintf(tmp, sizeof(tmp), fmt, value);
+    return sstring(tmp, len);
+}
+
+template <typename Func>
+static void measure(const char* name, unsigned iterations, Func&& func) {
+    size_t total = 0;
+    auto start = clk::now();
+    for (unsigned i = 0; i < iterations; ++i) {
+        total += func(i);
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(clk::now() - start).count();
+    print("%-40s %8.1f ns per call (%d chars)\n", name, elapsed / iterations, total);
+}
+
+int main(int ac, char** av) {
+    app_template app;
+    app.add_options()
+        ("iterations", bpo::value<unsigned>()->default_value(1000000), "number of calls for each variant")
+        ;
+    return app.run(ac, av, [&app] {
+        auto iterations = app.configuration()["iterations"].as<unsigned>();
+        // values of varying length, so the loops are not trivially predicted
+        auto integer = [] (unsigned i) { return long(i) * 2654435761l % 1000000007 - 500000000; };
+        auto floating = [] (unsigned i) { return double(i) * 1.6180339887 / 7.0; };
+
+        measure("snprintf(\"%ld\")", iterations, [&] (unsigned i) {
+            return snprintf_to_sstring("%ld", integer(i)).size();
+        });
+        measure("to_sstring(long)", iterations, [&] (unsigned i) {
+            return to_sstring(integer(i)).size();
+        });
+        measure("snprintf(\"%g\"), 6 digits", iterations, [&] (unsigned i) {
+            return snprintf_to_sstring("%g", floating(i)).size();
+        });
+        measure("snprintf(\"%.17g\"), round trip", iterations, [&] (unsigned i) {
+            return snprintf_to_sstring("%.17g", floating(i)).size();
+        });
+        measure("to_sstring(double), round trip", iterations, [&] (unsigned i) {
+            return to_sstring(floating(i)).size();
+        });
+        measure("boost::format(\"%s: %d/%d\")", iterations, [&] (unsigned i) {
+            boost::format fmt("%s: %d/%d");
+            apply_format(fmt, "key", integer(i), i);
+            return fmt.str().size();
+        });
+        measure("sprint(\"%s: %d/%d\")", iterations, [&] (unsigned i) {
+            return sprint("%s: %d/%d", "key", integer(i), i).size();
+        });
+        return make_ready_future<>();
+    });
+}
@@ -27,6 +27,9 @@
 #include "core/do_with.hh"
 #include "core/shared_future.hh"
 #include "core/thread.hh"
+#ifdef SEASTAR_COROUTINES_ENABLED
+#include "core/coroutine.hh"
+#endif
 #include <boost/iterator/counting_iterator.hpp>
 
 class expected_exception : std::runtime_error {
@@ -429,6 +432,112 @@ SEASTAR_TEST_CASE(test_parallel_for_each_waits_for_all_fibers_even_if_one_of_the
     });
 }
 
+SEASTAR_TEST_CASE(test_max_concurrent_for_each) {
+    struct counters {
+        unsigned in_flight = 0;
+        unsigned max_in_flight = 0;
+        unsigned done = 0;
+    };
+    return do_with(counters(), [] (counters& c) {
+        return max_concurrent_for_each(boost::irange(0, 1000), 7, [&c] (int i) {
+            if (i % 3 == 0) {
+                // completes immediately; must not occupy a slot
+                ++c.done;
+                return make_ready_future<>();
+            }
+            c.max_in_flight = std::max(c.max_in_flight, ++c.in_flight);
+            return later().then([&c] {
+                --c.in_flight;
+                ++c.done;
+            });
+        }).then([&c] {
+            BOOST_REQUIRE_EQUAL(c.done, 1000u);
+            BOOST_REQUIRE_EQUAL(c.in_flight, 0u);
+            BOOST_REQUIRE_EQUAL(c.max_in_flight, 7u);
+        });
+    });
+}
+
+SEASTAR_TEST_CASE(test_max_concurrent_for_each_early_failure) {
+    return do_with(0, 0, [] (int& started, int& in_flight) {
+        return max_concurrent_for_each(boost::irange(0, 1000), 4, [&started, &in_flight] (int i) {
+            ++started;
+            ++in_flight;
+            return later().then([&in_flight, i] {
+                --in_flight;
+                if (i == 10) {
+                    throw expected_exception();
+                }
+            });
+        }).then_wrapped([&started, &in_flight] (future<> f) {
+            BOOST_REQUIRE(f.failed());
+            BOOST_REQUIRE_THROW(f.get(), expected_exception);
+            // nothing was started after the failure was seen, and the
+            // invocations in flight at that point were waited for
+            BOOST_REQUIRE_EQUAL(in_flight, 0);
+            BOOST_REQUIRE_LE(started, 10 + 4);
+        });
+    });
+}
+
+SEASTAR_TEST_CASE(test_max_concurrent_for_each_throwing_func) {
+    auto started = make_lw_shared<int>(0);
+    return max_concurrent_for_each(boost::irange(0, 100), 2, [started] (int i) {
+        ++*started;
+        if (i == 5) {
+            throw expected_exception();
+        }
+        return make_ready_future<>();
+    }).then_wrapped([started] (future<> f) {
+        BOOST_REQUIRE_THROW(f.get(), expected_exception);
+        BOOST_REQUIRE_EQUAL(*started, 6);
+    });
+}
+
+SEASTAR_TEST_CASE(test_bounded_map_reduce) {
+    auto in_flight = make_lw_shared<unsigned>(0);
+    auto square = [in_flight] (long x) {
+        BOOST_REQUIRE_LT(++*in_flight, 5u);
+        return later().then([in_flight, x] {
+            --*in_flight;
+            return x * x;
+        });
+    };
+    long n = 1000;
+    return map_reduce(boost::make_counting_iterator<long>(0), boost::make_counting_iterator<long>(n),
+            4, square, long(0), std::plus<long>()).then([n] (auto result) {
+        auto m = n - 1; // counting does not include upper bound
+        BOOST_REQUIRE_EQUAL(result, (m * (m + 1) * (2*m + 1)) / 6);
+    });
+}
+
+SEASTAR_TEST_CASE(test_try_catch) {
+    struct derived : std::logic_error {
+        derived() : std::logic_error("derived") {}
+    };
+    auto ex = std::make_exception_ptr(derived());
+    BOOST_REQUIRE(try_catch<derived>(ex));
+    BOOST_REQUIRE(try_catch<std::logic_error>(ex));
+    BOOST_REQUIRE(try_catch<std::exception>(ex));
+    BOOST_REQUIRE_EQUAL(sstring(try_catch<std::exception>(ex)->what()), sstring("derived"));
+    BOOST_REQUIRE(!try_catch<std::runtime_error>(ex));
+    BOOST_REQUIRE(!try_catch<expected_exception>(ex));
+    BOOST_REQUIRE(!try_catch<std::exception>(std::exception_ptr()));
+    BOOST_REQUIRE(!try_catch<std::exception>(std::make_exception_ptr(3)));
+    BOOST_REQUIRE(try_catch<int>(std::make_exception_ptr(3)));
+    return make_ready_future<>();
+}
+
+SEASTAR_TEST_CASE(test_cached_exception_ptr) {
+    auto& a = cached_exception_ptr<expected_exception>();
+    auto& b = cached_exception_ptr<expected_exception>();
+    BOOST_REQUIRE(a == b);
+    return make_exception_future<>(a).then_wrapped([] (future<> f) {
+        BOOST_REQUIRE(f.failed());
+        BOOST_REQUIRE(try_catch<expected_exception>(f.get_exception()));
+    });
+}
+
 SEASTAR_TEST_CASE(test_high_priority_task_runs_before_ready_continuations) {
     return now().then([] {
         auto flag = make_lw_shared<bool>(false);
@@ -638,3 +747,54 @@ SEASTAR_TEST_CASE(test_shared_future_propagates_errors_to_all) {
         check_fails_with_expected(std::move(f));
     });
 }
+
+#ifdef SEASTAR_COROUTINES_ENABLED
+
+static future<int> add_one_later(int x) {
+    co_await later();
+    co_return x + 1;
+}
+
+static future<int, sstring> two_values() {
+    co_return std::make_tuple(3, sstring("three"));
+}
+
+static future<> throw_after_await() {
+    co_await later();
+    throw expected_exception();
+}
+
+SEASTAR_TEST_CASE(test_coroutine_await_ready_and_unready) {
+    auto x = co_await make_ready_future<int>(1);
+    BOOST_REQUIRE_EQUAL(x, 1);
+    x = co_await add_one_later(x);
+    BOOST_REQUIRE_EQUAL(x, 2);
+    auto t = co_await two_values();
+    BOOST_REQUIRE_EQUAL(std::get<0>(t), 3);
+    BOOST_REQUIRE_EQUAL(std::get<1>(t), "three");
+}
+
+SEASTAR_TEST_CASE(test_coroutine_ready_future_does_not_schedule) {
+    auto tasks = engine().tasks_processed();
+    for (int i = 0; i < 100; ++i) {
+        co_await make_ready_future<>();
+    }
+    BOOST_REQUIRE_EQUAL(engine().tasks_processed(), tasks);
+}
+
+SEASTAR_TEST_CASE(test_coroutine_exceptions) {
+    auto f = throw_after_await();
+    BOOST_REQUIRE(!f.available());
+    try {
+        co_await std::move(f);
+        BOOST_FAIL("should have thrown");
+    } catch (expected_exception&) {
+    }
+    try {
+        co_await make_exception_future<>(expected_exception());
+        BOOST_FAIL("should have thrown");
+    } catch (expected_exception&) {
+    }
+}
+
+#endif
@@ -0,0 +1,190 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE core
+
+#include <boost/test/included/unit_test.hpp>
+#include "net/gro.hh"
+#include "net/ip.hh"
+#include "net/tcp.hh"
+
+using namespace net;
+
+static const ipv4_address src("10.0.0.1");
+static const ipv4_address dst("10.0.0.2");
+static const ethernet_address from{2, 0, 0, 0, 0, 1};
+static const uint16_t mss = 1448;
+static const size_t options_len = 12;
+static const size_t hdr_len = sizeof(ip_hdr) + sizeof(tcp_hdr) + options_len;
+
+static char pattern(uint32_t seq) {
+    return seq % 251;
+}
+
+struct segment_spec {
+    uint16_t port = 10000;
+    uint32_t seq = 0;
+    uint16_t len = mss;
+    uint16_t window = 1000;
+    bool fin = false;
+    bool corrupt = false;
+};
+
+// A TCP/IPv4 segment as received from the wire, less its ethernet header
+static packet make_segment(segment_spec s) {
+    std::vector<char> data(s.len);
+    for (size_t i = 0; i < s.len; ++i) {
+        data[i] = pattern(s.seq + i);
+    }
+    packet p(data.data(), data.size());
+
+    auto th = p.prepend_header<tcp_hdr>(options_len);
+    th->src_port = s.port;
+    th->dst_port = 20000;
+    th->seq = net::tcp_seq{s.seq};
+    th->ack = net::tcp_seq{1};
+    th->data_offset = (sizeof(tcp_hdr) + options_len) / 4;
+    th->f_ack = true;
+    th->f_fin = s.fin;
+    th->window = s.window;
+    th->urgent = 0;
+    th->checksum = 0;
+    // NOP NOP and a timestamps option
+    auto opt = reinterpret_cast<uint8_t*>(th + 1);
+    opt[0] = opt[1] = 1;
+    opt[2] = 8;
+    opt[3] = 10;
+    std::fill_n(opt + 4, 8, 0x55);
+    *th = hton(*th);
+    checksummer csum;
+    ipv4_traits::tcp_pseudo_header_checksum(csum, src, dst, p.len());
+    csum.sum(p);
+    th->checksum = csum.get();
+
+    auto iph = p.prepend_header<ip_hdr>();
+    iph->ihl = sizeof(ip_hdr) / 4;
+    iph->ver = 4;
+    iph->dscp = 0;
+    iph->ecn = 0;
+    iph->len = p.len();
+    iph->id = 7;
+    iph->frag = 0;
+    iph->ttl = 64;
+    iph->ip_proto = uint8_t(ip_protocol_num::tcp);
+    iph->csum = 0;
+    iph->src_ip = src;
+    iph->dst_ip = dst;
+    *iph = hton(*iph);
+    iph->csum = ip_checksum(iph, sizeof(*iph));
+
+    if (s.corrupt) {
+        p.linearize();
+        p.frag(0).base[p.len() - 1] ^= 1;
+    }
+    return p;
+}
+
+struct received {
+    uint16_t port;
+    uint32_t seq;
+    uint16_t len;
+    uint16_t window;
+    bool fin;
+    bool csum_verified;
+};
+
+// Checks what gro delivered and sums it up
+static received check(packet& p) {
+    p.linearize();
+    auto frame = p.frag(0).base;
+    auto iph = reinterpret_cast<ip_hdr*>(frame);
+    BOOST_REQUIRE_EQUAL(ip_checksum(iph, sizeof(*iph)), 0);
+    BOOST_REQUIRE_EQUAL(ntoh(*iph).len, p.len());
+    auto th = ntoh(*reinterpret_cast<tcp_hdr*>(frame + sizeof(ip_hdr)));
+    BOOST_REQUIRE_EQUAL(th.data_offset * 4, sizeof(tcp_hdr) + options_len);
+    auto len = p.len() - hdr_len;
+    if (p.offload_info().csum_verified) {
+        for (size_t i = 0; i < len; ++i) {
+            BOOST_REQUIRE_EQUAL(frame[hdr_len + i], pattern(net::tcp_seq(th.seq).raw + i));
+        }
+    }
+    return received{th.src_port, net::tcp_seq(th.seq).raw, uint16_t(len), th.window, bool(th.f_fin), p.offload_info().csum_verified};
+}
+
+struct gro_test {
+    std::vector<received> delivered;
+    gro g{[this] (packet p, ethernet_address) { delivered.push_back(check(p)); }, false};
+    void receive(segment_spec s) {
+        g.receive(make_segment(s), from);
+    }
+};
+
+BOOST_AUTO_TEST_CASE(test_gro_merges_in_order_segments) {
+    gro_test t;
+    for (uint32_t i = 0; i < 5; ++i) {
+        t.receive({10000, 1 + i * mss, mss, uint16_t(1000 + i)});
+    }
+    BOOST_REQUIRE(t.delivered.empty());
+    t.g.flush();
+    BOOST_REQUIRE(t.g.empty());
+    BOOST_REQUIRE_EQUAL(t.delivered.size(), 1);
+    auto& r = t.delivered[0];
+    BOOST_REQUIRE_EQUAL(r.seq, 1);
+    BOOST_REQUIRE_EQUAL(r.len, 5 * mss);
+    BOOST_REQUIRE_EQUAL(r.window, 1004);
+    BOOST_REQUIRE(r.csum_verified);
+}
+
+BOOST_AUTO_TEST_CASE(test_gro_keeps_the_order_of_a_flow) {
+    gro_test t;
+    t.receive({10000, 1});
+    t.receive({10000, 1 + mss});
+    t.receive({10001, 1});
+    // A hole, then a FIN, which is never merged
+    t.receive({10000, 1 + 3 * mss});
+    t.receive({10000, 1 + 4 * mss, 100, 1000, true});
+    t.g.flush();
+    BOOST_REQUIRE_EQUAL(t.delivered.size(), 4);
+    BOOST_REQUIRE_EQUAL(t.delivered[0].port, 10000);
+    BOOST_REQUIRE_EQUAL(t.delivered[0].seq, 1);
+    BOOST_REQUIRE_EQUAL(t.delivered[0].len, 2 * mss);
+    BOOST_REQUIRE_EQUAL(t.delivered[1].seq, 1 + 3 * mss);
+    BOOST_REQUIRE_EQUAL(t.delivered[1].len, mss);
+    BOOST_REQUIRE_EQUAL(t.delivered[2].seq, 1 + 4 * mss);
+    BOOST_REQUIRE(t.delivered[2].fin);
+    BOOST_REQUIRE_EQUAL(t.delivered[3].port, 10001);
+}
+
+BOOST_AUTO_TEST_CASE(test_gro_does_not_merge_corrupt_segments) {
+    gro_test t;
+    t.receive({10000, 1});
+    t.receive({10000, 1 + mss, mss, 1000, false, true});
+    t.receive({10000, 1 + 2 * mss});
+    t.g.flush();
+    BOOST_REQUIRE_EQUAL(t.delivered.size(), 3);
+    BOOST_REQUIRE(t.delivered[0].csum_verified);
+    // Left for TCP to drop
+    BOOST_REQUIRE_EQUAL(t.delivered[1].seq, 1 + mss);
+    BOOST_REQUIRE(!t.delivered[1].csum_verified);
+    BOOST_REQUIRE_EQUAL(t.delivered[2].seq, 1 + 2 * mss);
+}
@@ -0,0 +1,163 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE core
+
+#include <boost/test/included/unit_test.hpp>
+#include "net/gso.hh"
+#include "net/ip.hh"
+#include "net/tcp.hh"
+
+using namespace net;
+
+static const ipv4_address src("10.0.0.1");
+static const ipv4_address dst("10.0.0.2");
+static const net::tcp_seq isn{1000};
+static const size_t options_len = 12;
+static const size_t hdr_len = sizeof(eth_hdr) + sizeof(ip_hdr) + sizeof(tcp_hdr) + options_len;
+
+static char pattern(size_t offset) {
+    return offset % 251;
+}
+
+// A TCP segment of data_len bytes as TCP would hand it down for TSO
+static packet make_super_packet(size_t data_len, uint16_t mss) {
+    std::vector<char> data(data_len);
+    for (size_t i = 0; i < data_len; ++i) {
+        data[i] = pattern(i);
+    }
+    packet p(data.data(), data.size());
+
+    auto th = p.prepend_header<tcp_hdr>(options_len);
+    th->src_port = 10000;
+    th->dst_port = 20000;
+    th->seq = isn;
+    th->ack = net::tcp_seq{1};
+    th->data_offset = (sizeof(tcp_hdr) + options_len) / 4;
+    th->f_ack = true;
+    th->f_psh = true;
+    th->f_fin = true;
+    th->window = 1000;
+    th->urgent = 0;
+    th->checksum = 0;
+    // NOP NOP and a timestamps option
+    auto opt = reinterpret_cast<uint8_t*>(th + 1);
+    opt[0] = opt[1] = 1;
+    opt[2] = 8;
+    opt[3] = 10;
+    std::fill_n(opt + 4, 8, 0x55);
+    *th = hton(*th);
+    checksummer csum;
+    ipv4_traits::tcp_pseudo_header_checksum(csum, src, dst, 0);
+    th->checksum = ~csum.get();
+
+    auto iph = p.prepend_header<ip_hdr>();
+    iph->ihl = sizeof(ip_hdr) / 4;
+    iph->ver = 4;
+    iph->dscp = 0;
+    iph->ecn = 0;
+    iph->len = p.len();
+    iph->id = 7;
+    iph->frag = 0;
+    iph->ttl = 64;
+    iph->ip_proto = uint8_t(ip_protocol_num::tcp);
+    iph->csum = 0;
+    iph->src_ip = src;
+    iph->dst_ip = dst;
+    *iph = hton(*iph);
+    iph->csum = ip_checksum(iph, sizeof(*iph));
+
+    auto eh = p.prepend_header<eth_hdr>();
+    eh->dst_mac = ethernet_address{2, 0, 0, 0, 0, 2};
+    eh->src_mac = ethernet_address{2, 0, 0, 0, 0, 1};
+    eh->eth_proto = uint16_t(eth_protocol_num::ipv4);
+    *eh = hton(*eh);
+
+    offload_info oi;
+    oi.protocol = ip_protocol_num::tcp;
+    oi.tcp_hdr_len = sizeof(tcp_hdr) + options_len;
+    oi.tso_seg_size = mss;
+    p.set_offload_info(oi);
+    return p;
+}
+
+static void check_segments(circular_buffer<packet>& segs, size_t data_len, uint16_t mss, bool csum_offload) {
+    BOOST_REQUIRE_EQUAL(segs.size(), (data_len + mss - 1) / mss);
+    size_t off = 0;
+    uint16_t id = 7;
+    for (auto&& seg : segs) {
+        auto len = std::min(size_t(mss), data_len - off);
+        bool last = off + len == data_len;
+        BOOST_REQUIRE_EQUAL(seg.len(), hdr_len + len);
+        BOOST_REQUIRE_EQUAL(seg.offload_info().tso_seg_size, 0);
+        seg.linearize();
+        auto frame = seg.frag(0).base;
+
+        auto iph = reinterpret_cast<ip_hdr*>(frame + sizeof(eth_hdr));
+        BOOST_REQUIRE_EQUAL(ip_checksum(iph, sizeof(*iph)), 0);
+        auto h = ntoh(*iph);
+        BOOST_REQUIRE_EQUAL(h.len, seg.len() - sizeof(eth_hdr));
+        BOOST_REQUIRE_EQUAL(h.id, id++);
+
+        auto tcp_off = sizeof(eth_hdr) + sizeof(ip_hdr);
+        auto tcp_len = seg.len() - tcp_off;
+        auto th = ntoh(*reinterpret_cast<tcp_hdr*>(frame + tcp_off));
+        BOOST_REQUIRE_EQUAL(net::tcp_seq(th.seq).raw, (isn + off).raw);
+        BOOST_REQUIRE_EQUAL(net::tcp_seq(th.ack).raw, 1);
+        BOOST_REQUIRE(th.f_ack);
+        BOOST_REQUIRE_EQUAL(bool(th.f_fin), last);
+        BOOST_REQUIRE_EQUAL(bool(th.f_psh), last);
+        checksummer csum;
+        ipv4_traits::tcp_pseudo_header_checksum(csum, src, dst, tcp_len);
+        if (csum_offload) {
+            BOOST_REQUIRE_EQUAL(uint16_t(th.checksum), ntoh(uint16_t(~csum.get())));
+        } else {
+            csum.sum(frame + tcp_off, tcp_len);
+            BOOST_REQUIRE_EQUAL(csum.get(), 0);
+        }
+
+        for (size_t i = 0; i < len; ++i) {
+            BOOST_REQUIRE_EQUAL(frame[hdr_len + i], pattern(off + i));
+        }
+        off += len;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_gso_computes_checksums) {
+    // Odd, so that the last segment is
+    const size_t data_len = 10001;
+    const uint16_t mss = 1448;
+    circular_buffer<packet> segs;
+    gso_segment(make_super_packet(data_len, mss), hw_features(), segs);
+    check_segments(segs, data_len, mss, false);
+}
+
+BOOST_AUTO_TEST_CASE(test_gso_leaves_checksums_to_the_device) {
+    const size_t data_len = 3 * 1448;
+    const uint16_t mss = 1448;
+    hw_features hw;
+    hw.tx_csum_l4_offload = true;
+    circular_buffer<packet> segs;
+    gso_segment(make_super_packet(data_len, mss), hw, segs);
+    check_segments(segs, data_len, mss, true);
+}
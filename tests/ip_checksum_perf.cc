@@ -0,0 +1,98 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+// Measures Internet checksum throughput of each implementation, alone and
+// combined with a copy, over packet sized buffers.  Does not need the
+// reactor.
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include "net/ip_checksum.hh"
+#include "core/print.hh"
+
+using namespace net::ip_checksum_impl;
+using clk = std::chrono::steady_clock;
+using sum_fn = uint16_t (*)(const char*, size_t);
+using copy_and_sum_fn = uint16_t (*)(char*, const char*, size_t);
+
+template <typename Func>
+static double measure(size_t size, Func&& func) {
+    auto iterations = std::max<size_t>(1, (size_t(256) << 20) / size);
+    uint16_t csum = 0;
+    auto start = clk::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        csum += func();
+    }
+    auto elapsed = std::chrono::duration<double>(clk::now() - start).count();
+    // keep the loop from being optimized away
+    if (csum == 0x1234) {
+        std::cout << "";
+    }
+    return iterations * size / elapsed / 1e9;
+}
+
+int main(int ac, char** av) {
+    std::vector<char> data(1 << 16);
+    std::vector<char> copy(data.size());
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = i * 7 + (i >> 8);
+    }
+    struct impl {
+        const char* name;
+        sum_fn sum;
+        copy_and_sum_fn copy_and_sum;
+        bool supported;
+    } impls[] = {
+        { "scalar", sum_scalar, copy_and_sum_scalar, true },
+        { "sse2", sum_sse2, copy_and_sum_sse2, true },
+        { "avx2", sum_avx2, copy_and_sum_avx2, has_avx2() },
+    };
+    print("%-10s", "size");
+    for (auto& i : impls) {
+        print(" %14s", i.name);
+    }
+    for (auto& i : impls) {
+        print(" %14s", sprint("copy+%s", i.name));
+    }
+    print("\n");
+    // An IP header, a small request, a minimal and a full sized frame, a
+    // jumbo frame and a TSO or LRO sized segment
+    for (size_t size : { 20, 64, 576, 1500, 9000, 65535 }) {
+        print("%-10d", size);
+        for (auto& i : impls) {
+            if (i.supported) {
+                print(" %9.2f GB/s", measure(size, [&] { return i.sum(data.data(), size); }));
+            } else {
+                print(" %14s", "n/a");
+            }
+        }
+        for (auto& i : impls) {
+            if (i.supported) {
+                print(" %9.2f GB/s", measure(size, [&] { return i.copy_and_sum(copy.data(), data.data(), size); }));
+            } else {
+                print(" %14s", "n/a");
+            }
+        }
+        print("\n");
+    }
+    return 0;
+}
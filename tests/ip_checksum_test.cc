@@ -0,0 +1,94 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE core
+
+#include <boost/test/included/unit_test.hpp>
+#include <random>
+#include "net/ip_checksum.hh"
+
+using namespace net;
+
+BOOST_AUTO_TEST_CASE(test_ip_checksum_known_values) {
+    // The example of RFC 1071 4.1
+    const char data[] = { 0x00, 0x01, char(0xf2), 0x03, char(0xf4), char(0xf5), char(0xf6), char(0xf7) };
+    BOOST_REQUIRE_EQUAL(ntohs(ip_checksum(data, sizeof(data))), uint16_t(~0xddf2));
+    checksummer csum;
+    csum.sum(data, 3);
+    csum.sum(data + 3, 0);
+    csum.sum(data + 3, 5);
+    BOOST_REQUIRE_EQUAL(ntohs(csum.get()), uint16_t(~0xddf2));
+    BOOST_REQUIRE_EQUAL(ip_checksum(data, 0), 0xffff);
+}
+
+static std::vector<char> random_data(size_t size) {
+    std::vector<char> data(size);
+    std::default_random_engine rnd;
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (auto& c : data) {
+        c = byte(rnd);
+    }
+    return data;
+}
+
+BOOST_AUTO_TEST_CASE(test_ip_checksum_implementations_agree) {
+    using namespace ip_checksum_impl;
+    auto data = random_data(70000);
+    std::vector<char> copy(data.size());
+    for (size_t offset : { 0, 1, 7 }) {
+        for (size_t size : { 0, 1, 2, 7, 20, 31, 32, 33, 63, 64, 65, 127, 1500, 1501, 9000, 65535 }) {
+            auto p = data.data() + offset;
+            auto expected = sum_scalar(p, size);
+            BOOST_REQUIRE_EQUAL(sum_sse2(p, size), expected);
+            std::fill(copy.begin(), copy.end(), 0);
+            BOOST_REQUIRE_EQUAL(copy_and_sum_sse2(copy.data() + offset, p, size), expected);
+            BOOST_REQUIRE(std::equal(p, p + size, copy.data() + offset));
+            if (has_avx2()) {
+                BOOST_REQUIRE_EQUAL(sum_avx2(p, size), expected);
+                std::fill(copy.begin(), copy.end(), 0);
+                BOOST_REQUIRE_EQUAL(copy_and_sum_avx2(copy.data() + offset, p, size), expected);
+                BOOST_REQUIRE(std::equal(p, p + size, copy.data() + offset));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_ip_checksum_of_pieces) {
+    // Odd sized pieces shift the following ones by a byte
+    auto data = random_data(3000);
+    checksummer whole;
+    whole.sum(data.data(), data.size());
+    std::vector<char> copy(data.size());
+    checksummer pieces;
+    checksummer copied;
+    size_t off = 0;
+    for (size_t len : { 1, 13, 64, 99, 1, 1000, 0, 1822 }) {
+        pieces.sum(data.data() + off, len);
+        copied.copy_and_sum(copy.data() + off, data.data() + off, len);
+        off += len;
+    }
+    BOOST_REQUIRE_EQUAL(off, data.size());
+    BOOST_REQUIRE_EQUAL(pieces.get(), whole.get());
+    BOOST_REQUIRE_EQUAL(copied.get(), whole.get());
+    BOOST_REQUIRE(copy == data);
+}
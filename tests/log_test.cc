@@ -0,0 +1,165 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#include "tests/test-utils.hh"
+#include "util/log.hh"
+#include "core/reactor.hh"
+#include <boost/algorithm/string/predicate.hpp>
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace seastar;
+using namespace std::chrono_literals;
+
+static logger test_log("log_test");
+
+// Sends log output to a fresh file for the duration of a test.
+class log_capture {
+    sstring _path;
+public:
+    log_capture() {
+        char path[] = "/tmp/log_test-XXXXXX";
+        auto fd = ::mkstemp(path);
+        BOOST_REQUIRE(fd >= 0);
+        ::close(fd);
+        _path = path;
+        set_log_output(_path);
+    }
+    ~log_capture() {
+        set_log_output("");
+        ::unlink(_path.c_str());
+    }
+    std::vector<std::string> lines() {
+        flush_logs();
+        std::ifstream in(_path.c_str());
+        std::vector<std::string> ret;
+        std::string line;
+        while (std::getline(in, line)) {
+            ret.push_back(line);
+        }
+        return ret;
+    }
+};
+
+struct counted_arg {
+    int& formatted;
+};
+
+std::ostream& operator<<(std::ostream& out, const counted_arg& a) {
+    ++a.formatted;
+    return out << "counted";
+}
+
+SEASTAR_TEST_CASE(test_log_levels) {
+    log_capture capture;
+    int formatted = 0;
+    test_log.set_level(log_level::info);
+    test_log.debug("hidden %s", counted_arg{formatted});
+    test_log.trace("hidden %s", counted_arg{formatted});
+    BOOST_REQUIRE_EQUAL(formatted, 0);
+    test_log.info("shown %s %d", counted_arg{formatted}, 1);
+    test_log.error("shown %s %d", counted_arg{formatted}, 2);
+    BOOST_REQUIRE_EQUAL(formatted, 2);
+    test_log.set_level(log_level::trace);
+    test_log.trace("shown %d", 3);
+    auto lines = capture.lines();
+    BOOST_REQUIRE_EQUAL(lines.size(), 3u);
+    BOOST_REQUIRE(boost::starts_with(lines[0], "INFO "));
+    BOOST_REQUIRE(boost::ends_with(lines[0], sprint("[shard %d] log_test - shown counted 1", engine().cpu_id())));
+    BOOST_REQUIRE(boost::starts_with(lines[1], "ERROR"));
+    BOOST_REQUIRE(boost::ends_with(lines[1], "log_test - shown counted 2"));
+    BOOST_REQUIRE(boost::starts_with(lines[2], "TRACE"));
+    test_log.set_level(log_level::info);
+    return make_ready_future<>();
+}
+
+SEASTAR_TEST_CASE(test_logger_registry) {
+    auto& registry = global_logger_registry();
+    auto names = registry.get_all_logger_names();
+    BOOST_REQUIRE(std::find(names.begin(), names.end(), "log_test") != names.end());
+    registry.set_logger_level("log_test", log_level::debug);
+    BOOST_REQUIRE(test_log.level() == log_level::debug);
+    BOOST_REQUIRE(registry.get_logger_level("log_test") == log_level::debug);
+    {
+        logger scoped("log_test_scoped");
+        registry.set_all_loggers_level(log_level::warn);
+        BOOST_REQUIRE(scoped.level() == log_level::warn);
+        BOOST_REQUIRE(test_log.level() == log_level::warn);
+        BOOST_REQUIRE_THROW(logger("log_test_scoped"), std::runtime_error);
+    }
+    BOOST_REQUIRE_THROW(registry.set_logger_level("log_test_scoped", log_level::info), std::out_of_range);
+    BOOST_REQUIRE(parse_log_level("trace") == log_level::trace);
+    BOOST_REQUIRE_THROW(parse_log_level("verbose"), std::invalid_argument);
+    std::ostringstream os;
+    os << log_level::warn;
+    BOOST_REQUIRE_EQUAL(os.str(), "warn");
+    test_log.set_level(log_level::info);
+    return make_ready_future<>();
+}
+
+SEASTAR_TEST_CASE(test_log_rate_limit) {
+    log_capture capture;
+    logger::rate_limit rl(1h);
+    for (int i = 0; i < 10; ++i) {
+        test_log.warn(rl, "limited %d", i);
+    }
+    auto lines = capture.lines();
+    BOOST_REQUIRE_EQUAL(lines.size(), 1u);
+    BOOST_REQUIRE(boost::ends_with(lines[0], "limited 0"));
+
+    logger::rate_limit short_rl(1ms);
+    test_log.warn(short_rl, "first");
+    test_log.warn(short_rl, "suppressed");
+    test_log.warn(short_rl, "suppressed");
+    ::usleep(2000);
+    test_log.warn(short_rl, "second");
+    lines = capture.lines();
+    BOOST_REQUIRE_EQUAL(lines.size(), 4u);
+    BOOST_REQUIRE(boost::ends_with(lines[1], "first"));
+    BOOST_REQUIRE(boost::ends_with(lines[2], "second"));
+    BOOST_REQUIRE(boost::ends_with(lines[3], "(2 similar messages suppressed)"));
+    return make_ready_future<>();
+}
+
+SEASTAR_TEST_CASE(test_log_many_messages) {
+    // far more than the writer can keep up with if it were synchronous;
+    // every message must either be written or counted as dropped
+    log_capture capture;
+    auto dropped_before = dropped_log_messages();
+    const int count = 100000;
+    for (int i = 0; i < count; ++i) {
+        test_log.info("message %d", i);
+    }
+    auto lines = capture.lines();
+    auto dropped = dropped_log_messages() - dropped_before;
+    size_t messages = 0;
+    for (auto&& l : lines) {
+        if (boost::contains(l, "log_test - message ")) {
+            ++messages;
+        }
+    }
+    BOOST_REQUIRE_EQUAL(messages + dropped, size_t(count));
+    BOOST_REQUIRE(boost::ends_with(lines.back(), sprint("message %d", count - 1)) || dropped);
+    return make_ready_future<>();
+}
@@ -0,0 +1,122 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+// Compares the throughput of plain file streams with lz4-compressed ones.
+//
+// Run it with --file on a tmpfs to measure the compression cost alone, or
+// on a disk to see how much the reduced I/O buys back.
+
+#include <chrono>
+#include <random>
+#include "core/app-template.hh"
+#include "core/reactor.hh"
+#include "core/fstream.hh"
+#include "core/lz4-stream.hh"
+#include "core/seastar.hh"
+#include "core/thread.hh"
+#include "core/print.hh"
+
+namespace bpo = boost::program_options;
+using clk = std::chrono::steady_clock;
+
+// Compressible, but not trivially so: words picked at random from a small
+// dictionary.
+static temporary_buffer<char> make_data(size_t size) {
+    static const char* words[] = { "seastar ", "future ", "reactor ", "shard ", "packet ", "stream ", "0123 ", "\n" };
+    temporary_buffer<char> buf(size);
+    std::default_random_engine rnd;
+    std::uniform_int_distribution<unsigned> pick(0, 7);
+    size_t pos = 0;
+    while (pos < size) {
+        auto w = words[pick(rnd)];
+        auto n = std::min(strlen(w), size - pos);
+        std::copy_n(w, n, buf.get_write() + pos);
+        pos += n;
+    }
+    return buf;
+}
+
+static double mbps(uint64_t bytes, clk::duration d) {
+    return bytes / std::chrono::duration<double>(d).count() / (1 << 20);
+}
+
+static void run(sstring name, uint64_t total, const temporary_buffer<char>& data, bool compress, size_t chunk_size) {
+    auto start = clk::now();
+    auto f = open_file_dma(name, open_flags::rw | open_flags::create | open_flags::truncate).get0();
+    auto out = make_file_output_stream(std::move(f), 128 * 1024);
+    if (compress) {
+        lz4_output_stream_options options;
+        options.chunk_size = chunk_size;
+        out = make_lz4_output_stream(std::move(out), options);
+    }
+    for (uint64_t written = 0; written < total; written += data.size()) {
+        out.write(data.get(), data.size()).get();
+    }
+    out.close().get();
+    auto write_time = clk::now() - start;
+
+    start = clk::now();
+    f = open_file_dma(name, open_flags::ro).get0();
+    auto on_disk = f.size().get0();
+    file_input_stream_options options;
+    options.buffer_size = 128 * 1024;
+    options.read_ahead = 2;
+    auto in = make_file_input_stream(std::move(f), options);
+    if (compress) {
+        in = make_lz4_input_stream(std::move(in));
+    }
+    uint64_t read = 0;
+    for (;;) {
+        auto buf = in.read().get0();
+        if (buf.empty()) {
+            break;
+        }
+        read += buf.size();
+    }
+    in.close().get();
+    auto read_time = clk::now() - start;
+    assert(read == total);
+
+    print("%-5s  on disk: %8.1f MB  write: %8.1f MB/s  read: %8.1f MB/s\n",
+            compress ? "lz4" : "raw", double(on_disk) / (1 << 20),
+            mbps(total, write_time), mbps(total, read_time));
+}
+
+int main(int ac, char** av) {
+    app_template app;
+    app.add_options()
+        ("file", bpo::value<std::string>()->default_value("lz4_stream_perf.tmp"), "file to write to (put it on a tmpfs or a disk)")
+        ("size", bpo::value<unsigned>()->default_value(256), "amount of data to write, in MB")
+        ("chunk-size", bpo::value<unsigned>()->default_value(64 * 1024), "lz4 frame size")
+        ;
+    return app.run(ac, av, [&app] {
+        return seastar::async([&app] {
+            auto&& config = app.configuration();
+            sstring name = config["file"].as<std::string>();
+            uint64_t total = uint64_t(config["size"].as<unsigned>()) << 20;
+            auto chunk_size = config["chunk-size"].as<unsigned>();
+            auto data = make_data(1 << 20);
+            run(name, total, data, false, chunk_size);
+            run(name, total, data, true, chunk_size);
+            remove_file(name).get();
+        });
+    });
+}
@@ -0,0 +1,194 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#include <algorithm>
+#include <random>
+#include "core/reactor.hh"
+#include "core/fstream.hh"
+#include "core/lz4-stream.hh"
+#include "core/do_with.hh"
+#include "core/seastar.hh"
+#include "core/vector-data-sink.hh"
+#include "test-utils.hh"
+
+// Half text-like, half random data, so both the compressed and the
+// stored-as-is frame kinds show up in the stream.
+static std::vector<char> make_data(size_t size) {
+    std::vector<char> data(size);
+    std::default_random_engine rnd;
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = (i / 65536) % 2 ? byte(rnd) : "seastar "[i % 8];
+    }
+    return data;
+}
+
+static future<> write_file(lw_shared_ptr<std::vector<char>> data, lz4_output_stream_options options = {}) {
+    return open_file_dma("testfile.tmp",
+            open_flags::rw | open_flags::create | open_flags::truncate).then([data, options] (file f) {
+        return do_with(make_lz4_output_stream(make_file_output_stream(std::move(f)), options), [data] (output_stream<char>& out) {
+            return out.write(data->data(), data->size()).then([&out] {
+                return out.close();
+            });
+        });
+    });
+}
+
+static future<> test_round_trip(size_t size, size_t chunk_size) {
+    auto data = make_lw_shared<std::vector<char>>(make_data(size));
+    lz4_output_stream_options options;
+    options.chunk_size = chunk_size;
+    return write_file(data, options).then([] {
+        return open_file_dma("testfile.tmp", open_flags::ro);
+    }).then([data] (file f) {
+        return f.size().then([data] (uint64_t compressed_size) {
+            // the text-like half must have shrunk
+            BOOST_REQUIRE(data->empty() || compressed_size < data->size());
+        }).then([f, data] {
+            return do_with(make_lz4_input_stream(make_file_input_stream(f)), [data] (input_stream<char>& in) {
+                return in.read_exactly(data->size()).then([&in, data] (temporary_buffer<char> buf) {
+                    BOOST_REQUIRE_EQUAL(buf.size(), data->size());
+                    BOOST_REQUIRE(std::equal(buf.begin(), buf.end(), data->begin()));
+                    return in.close();
+                });
+            });
+        });
+    });
+}
+
+SEASTAR_TEST_CASE(test_lz4_empty_stream) {
+    return test_round_trip(0, 4096);
+}
+
+SEASTAR_TEST_CASE(test_lz4_single_frame) {
+    return test_round_trip(1000, 4096);
+}
+
+SEASTAR_TEST_CASE(test_lz4_many_frames) {
+    return test_round_trip((1 << 20) + 17, 64 * 1024);
+}
+
+SEASTAR_TEST_CASE(test_lz4_truncated_stream) {
+    auto data = make_lw_shared<std::vector<char>>(make_data(10000));
+    return write_file(data).then([] {
+        return open_file_dma("testfile.tmp", open_flags::rw);
+    }).then([data] (file f) {
+        return f.size().then([f] (uint64_t size) mutable {
+            return f.truncate(size - 1);
+        }).then([f, data] {
+            return do_with(make_lz4_input_stream(make_file_input_stream(f)), [data] (input_stream<char>& in) {
+                return in.read_exactly(data->size()).then_wrapped([&in] (future<temporary_buffer<char>> f) {
+                    BOOST_REQUIRE_THROW(f.get(), lz4_stream_error);
+                    return in.close();
+                });
+            });
+        });
+    });
+}
+
+// The decompressor reuses its buffer only once the reader dropped what it
+// was given; buffers kept across reads must not change under the reader.
+SEASTAR_TEST_CASE(test_lz4_kept_buffers) {
+    auto data = make_lw_shared<std::vector<char>>(make_data(40000));
+    lz4_output_stream_options options;
+    // not a multiple of the text's period, so that frames differ
+    options.chunk_size = 4099;
+    return write_file(data, options).then([] {
+        return open_file_dma("testfile.tmp", open_flags::ro);
+    }).then([data] (file f) {
+        return do_with(make_lz4_input_stream(make_file_input_stream(f)), std::vector<temporary_buffer<char>>(),
+                [data] (input_stream<char>& in, std::vector<temporary_buffer<char>>& kept) {
+            return repeat([&in, &kept] {
+                return in.read().then([&kept] (temporary_buffer<char> buf) {
+                    if (buf.empty()) {
+                        return stop_iteration::yes;
+                    }
+                    kept.push_back(std::move(buf));
+                    return stop_iteration::no;
+                });
+            }).then([&in, &kept, data] {
+                BOOST_REQUIRE_GT(kept.size(), 1u);
+                std::vector<char> read;
+                for (auto&& b : kept) {
+                    read.insert(read.end(), b.begin(), b.end());
+                }
+                BOOST_REQUIRE(read == *data);
+                return in.close();
+            });
+        });
+    });
+}
+
+// Hands out a buffer, then end of stream
+class buffer_source_impl : public data_source_impl {
+    temporary_buffer<char> _buf;
+public:
+    explicit buffer_source_impl(temporary_buffer<char> buf) : _buf(std::move(buf)) {}
+    virtual future<temporary_buffer<char>> get() override {
+        return make_ready_future<temporary_buffer<char>>(std::move(_buf));
+    }
+};
+
+// The decompressor's buffer is sized by the first frame, and must grow
+// when a later frame is larger.
+SEASTAR_TEST_CASE(test_lz4_growing_frames) {
+    auto data = make_lw_shared<std::vector<char>>(make_data(20000));
+    lz4_output_stream_options options;
+    options.chunk_size = 8192;
+    return do_with(vector_data_sink::vector_type(), [data, options] (vector_data_sink::vector_type& frames) {
+        auto out = make_lz4_output_stream(output_stream<char>(data_sink(std::make_unique<vector_data_sink>(frames)), 65536), options);
+        return do_with(std::move(out), [data] (output_stream<char>& out) {
+            // a short first frame, then full sized ones
+            return out.write(data->data(), 100).then([&out] {
+                return out.flush();
+            }).then([&out, data] {
+                return out.write(data->data() + 100, data->size() - 100);
+            }).then([&out] {
+                return out.close();
+            });
+        }).then([&frames, data] {
+            std::vector<char> stream;
+            for (auto&& p : frames) {
+                for (auto&& f : p.fragments()) {
+                    stream.insert(stream.end(), f.base, f.base + f.size);
+                }
+            }
+            temporary_buffer<char> buf(stream.size());
+            std::copy(stream.begin(), stream.end(), buf.get_write());
+            auto in = input_stream<char>(data_source(std::make_unique<buffer_source_impl>(std::move(buf))));
+            return do_with(make_lz4_input_stream(std::move(in)), std::vector<char>(),
+                    [data] (input_stream<char>& in, std::vector<char>& read) {
+                return repeat([&in, &read] {
+                    return in.read().then([&read] (temporary_buffer<char> buf) {
+                        if (buf.empty()) {
+                            return stop_iteration::yes;
+                        }
+                        read.insert(read.end(), buf.begin(), buf.end());
+                        return stop_iteration::no;
+                    });
+                }).then([&in, &read, data] {
+                    BOOST_REQUIRE(read == *data);
+                    return in.close();
+                });
+            });
+        });
+    });
+}
@@ -128,3 +128,26 @@ SEASTAR_TEST_CASE(test_flush_on_empty_buffer_does_not_push_empty_packet_down_str
         return out->close();
     }).finally([out]{});
 }
+
+SEASTAR_TEST_CASE(test_zero_copy_write_after_buffered_write) {
+    auto v = make_shared<std::vector<packet>>();
+    auto out = make_shared<output_stream<char>>(
+        data_sink(std::make_unique<vector_data_sink>(*v)), 8);
+
+    return out->write("12", 2).then([out] {
+        temporary_buffer<char> buf(3);
+        std::copy_n("345", 3, buf.get_write());
+        return out->write(std::move(buf));
+    }).then([out] {
+        return out->write("6", 1);
+    }).then([out] {
+        return out->write(packet("78", 2));
+    }).then([out] {
+        return out->close();
+    }).then([v, out] {
+        BOOST_REQUIRE_EQUAL(v->size(), 3u);
+        BOOST_REQUIRE(to_sstring((*v)[0]) == "12");
+        BOOST_REQUIRE(to_sstring((*v)[1]) == "345");
+        BOOST_REQUIRE(to_sstring((*v)[2]) == "678");
+    });
+}
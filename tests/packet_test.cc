@@ -65,3 +65,22 @@ BOOST_AUTO_TEST_CASE(test_headers_are_contiguous_even_with_many_fragments) {
     BOOST_REQUIRE_EQUAL(p.nr_frags(), 9);
 }
 
+
+BOOST_AUTO_TEST_CASE(test_shares_keep_data_alive_after_original_moves_its_header) {
+    using tcp_header = std::array<char, 20>;
+    char data1[100] = {};
+    char data2[100] = {};
+    bool freed1 = false;
+    bool freed2 = false;
+    packet p(fragment{data1, sizeof(data1)}, make_deleter([&] { freed1 = true; }));
+    p.append(packet(fragment{data2, sizeof(data2)}, make_deleter([&] { freed2 = true; })));
+    auto shared = p.share();
+    p.prepend_header<tcp_header>();
+    // Moves the header out of p's internal data, adding to p's deleter
+    auto other = p.share();
+    p = packet();
+    other = packet();
+    BOOST_REQUIRE(!freed1 && !freed2);
+    shared = packet();
+    BOOST_REQUIRE(freed1 && freed2);
+}
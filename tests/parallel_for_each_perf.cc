@@ -0,0 +1,85 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+// Compares parallel_for_each() with max_concurrent_for_each() at several
+// concurrency levels over the same range, reporting time and allocations
+// per element.  Each element either completes immediately
+// or defers to a separately scheduled task.
+
+#include <chrono>
+#include <boost/range/irange.hpp>
+#include "core/app-template.hh"
+#include "core/reactor.hh"
+#include "core/future-util.hh"
+#include "core/memory.hh"
+#include "core/print.hh"
+
+namespace bpo = boost::program_options;
+using clk = std::chrono::steady_clock;
+
+static future<> deferred_op(int) {
+    return later();
+}
+
+static future<> ready_op(int) {
+    return make_ready_future<>();
+}
+
+template <typename Run>
+static future<> measure(sstring name, unsigned elements, Run run) {
+    auto mallocs = memory::stats().mallocs();
+    auto start = clk::now();
+    return run(boost::irange(0u, elements)).then([=] {
+        auto elapsed = std::chrono::duration<double, std::nano>(clk::now() - start).count();
+        print("%-40s %8.1f ns %8.2f allocations per element\n", name,
+                elapsed / elements,
+                double(memory::stats().mallocs() - mallocs) / elements);
+    });
+}
+
+template <future<> (*op)(int)>
+static future<> measure_all(sstring kind, unsigned elements) {
+    return measure("parallel_for_each, " + kind, elements, [] (auto range) {
+        return parallel_for_each(range, op);
+    }).then([kind, elements] {
+        return do_with(std::vector<size_t>{1, 16, 256, 4096}, [kind, elements] (auto& levels) {
+            return do_for_each(levels, [kind, elements] (size_t concurrency) {
+                return measure(sprint("max_concurrent_for_each(%d), %s", concurrency, kind), elements,
+                        [concurrency] (auto range) {
+                    return max_concurrent_for_each(range, concurrency, op);
+                });
+            });
+        });
+    });
+}
+
+int main(int ac, char** av) {
+    app_template app;
+    app.add_options()
+        ("elements", bpo::value<unsigned>()->default_value(1000000), "number of elements to process per variant")
+        ;
+    return app.run(ac, av, [&app] {
+        auto elements = app.configuration()["elements"].as<unsigned>();
+        return measure_all<ready_op>("ready", elements).then([elements] {
+            return measure_all<deferred_op>("deferred", elements);
+        });
+    });
+}
@@ -0,0 +1,91 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#include "core/scheduling.hh"
+#include "core/thread.hh"
+#include "core/reactor.hh"
+#include "core/future-util.hh"
+#include "core/sleep.hh"
+#include "core/do_with.hh"
+#include "test-utils.hh"
+
+using namespace std::chrono_literals;
+
+SEASTAR_TEST_CASE(test_continuations_inherit_scheduling_group) {
+    auto sg = make_lw_shared<scheduling_group>("test", 100);
+    BOOST_REQUIRE(&current_scheduling_group() == &default_scheduling_group());
+    return with_scheduling_group(*sg, [sg] {
+        BOOST_REQUIRE(&current_scheduling_group() == sg.get());
+        return later().then([sg] {
+            BOOST_REQUIRE(&current_scheduling_group() == sg.get());
+            return seastar::async([sg] {
+                later().get();
+                BOOST_REQUIRE(&current_scheduling_group() == sg.get());
+            });
+        }).then([sg] {
+            BOOST_REQUIRE(&current_scheduling_group() == sg.get());
+        });
+    }).then([sg] {
+        BOOST_REQUIRE(&current_scheduling_group() == &default_scheduling_group());
+        BOOST_REQUIRE(sg->tasks_processed() > 0);
+    });
+}
+
+// Spins in short tasks until told to stop.
+static future<> burn(scheduling_group& sg, bool& done, uint64_t& count) {
+    return with_scheduling_group(sg, [&done, &count] {
+        return do_until([&done] { return done; }, [&count] {
+            auto end = std::chrono::steady_clock::now() + 20us;
+            while (std::chrono::steady_clock::now() < end) {
+            }
+            ++count;
+            return later();
+        });
+    });
+}
+
+SEASTAR_TEST_CASE(test_scheduling_group_shares) {
+    struct state {
+        scheduling_group sg1{"low", 100};
+        scheduling_group sg2{"high", 300};
+        bool done = false;
+        uint64_t count1 = 0;
+        uint64_t count2 = 0;
+    };
+    auto s = make_lw_shared<state>();
+    auto f1 = burn(s->sg1, s->done, s->count1);
+    auto f2 = burn(s->sg2, s->done, s->count2);
+    return sleep(500ms).then([s, f1 = std::move(f1), f2 = std::move(f2)] () mutable {
+        s->done = true;
+        return when_all(std::move(f1), std::move(f2)).discard_result();
+    }).then([s] {
+        auto ratio = double(s->sg2.runtime().count()) / s->sg1.runtime().count();
+        BOOST_REQUIRE(s->count1 > 0);
+#ifndef DEBUG
+        BOOST_REQUIRE(ratio > 2.5);
+        BOOST_REQUIRE(ratio < 3.5);
+#else
+        // debug mode is too slow to test this accurately
+        (void)ratio;
+#endif
+    });
+}
@@ -31,6 +31,7 @@
 #include "core/sleep.hh"
 #include "core/shared_mutex.hh"
 #include <boost/range/irange.hpp>
+#include <numeric>
 
 using namespace seastar;
 using namespace std::chrono_literals;
@@ -103,6 +104,86 @@ SEASTAR_TEST_CASE(test_semaphore_mix_1) {
     });
 }
 
+SEASTAR_TEST_CASE(test_semaphore_timeout_out_of_order) {
+    // deadlines that do not follow queue order must still expire on time
+    return do_with(semaphore(0), std::vector<int>(), [] (semaphore& sem, std::vector<int>& timed_out) {
+        auto waiter = [&sem, &timed_out] (int i, semaphore::duration timeout) {
+            return sem.wait(timeout).then_wrapped([&timed_out, i] (future<> f) {
+                if (f.failed()) {
+                    BOOST_REQUIRE(try_catch<semaphore_timed_out>(f.get_exception()));
+                    timed_out.push_back(i);
+                }
+            });
+        };
+        std::vector<future<>> waits;
+        waits.push_back(waiter(0, 30ms));
+        waits.push_back(waiter(1, 5ms));
+        waits.push_back(waiter(2, 60s));
+        waits.push_back(waiter(3, 15ms));
+        return sleep(40ms).then([&sem, &timed_out, waits = std::move(waits)] () mutable {
+            BOOST_REQUIRE(timed_out == (std::vector<int>{1, 3, 0}));
+            BOOST_REQUIRE_EQUAL(sem.waiters(), 1u);
+            sem.signal();
+            return when_all(waits.begin(), waits.end()).discard_result();
+        }).then([&sem, &timed_out] {
+            BOOST_REQUIRE_EQUAL(timed_out.size(), 3u);
+            BOOST_REQUIRE_EQUAL(sem.waiters(), 0u);
+            BOOST_REQUIRE_EQUAL(sem.current(), 0u);
+        });
+    });
+}
+
+SEASTAR_TEST_CASE(test_semaphore_many_timeouts) {
+    return do_with(semaphore(0), 0, 0, [] (semaphore& sem, int& ok, int& timed_out) {
+        std::vector<future<>> waits;
+        for (int i = 0; i < 1000; ++i) {
+            waits.push_back(sem.wait(i % 2 ? 5ms : 60s).then_wrapped([&ok, &timed_out] (future<> f) {
+                if (f.failed()) {
+                    f.ignore_ready_future();
+                    ++timed_out;
+                } else {
+                    ++ok;
+                }
+            }));
+        }
+        return sleep(20ms).then([&sem, &ok, &timed_out, waits = std::move(waits)] () mutable {
+            BOOST_REQUIRE_EQUAL(timed_out, 500);
+            BOOST_REQUIRE_EQUAL(sem.waiters(), 500u);
+            sem.signal(500);
+            return when_all(waits.begin(), waits.end()).discard_result();
+        }).then([&sem, &ok] {
+            BOOST_REQUIRE_EQUAL(ok, 500);
+            BOOST_REQUIRE_EQUAL(sem.current(), 0u);
+        });
+    });
+}
+
+SEASTAR_TEST_CASE(test_named_semaphore_stats) {
+    auto sem = make_lw_shared<named_semaphore>("test", 0);
+    BOOST_REQUIRE_EQUAL(sem->name(), sstring("test"));
+    BOOST_REQUIRE(sem->try_wait(0));
+    auto timed = sem->wait(1ms);
+    auto granted = sem->wait();
+    BOOST_REQUIRE_EQUAL(sem->waiters(), 2u);
+    return sleep(10ms).then([sem, timed = std::move(timed), granted = std::move(granted)] () mutable {
+        BOOST_REQUIRE(timed.failed());
+        timed.ignore_ready_future();
+        sem->signal();
+        BOOST_REQUIRE(granted.available());
+        auto& st = sem->wait_stats();
+        BOOST_REQUIRE_EQUAL(st.waits, 2u);
+        BOOST_REQUIRE_EQUAL(st.timeouts, 1u);
+        BOOST_REQUIRE_EQUAL(st.aborts, 0u);
+        BOOST_REQUIRE_EQUAL(sem->waiters(), 0u);
+        auto total = std::accumulate(st.wait_time_histogram.begin(), st.wait_time_histogram.end(), uint64_t(0));
+        BOOST_REQUIRE_EQUAL(total, 1u);
+        // the granted wait lasted at least the 10ms sleep
+        BOOST_REQUIRE_GE(st.wait_time_us, 10000u);
+        BOOST_REQUIRE_EQUAL(std::accumulate(st.wait_time_histogram.begin(), st.wait_time_histogram.begin() + 4, uint64_t(0)), 0u);
+        return std::move(granted);
+    });
+}
+
 SEASTAR_TEST_CASE(test_broken_semaphore) {
     auto sem = make_lw_shared<semaphore>(0);
     struct oops {};
@@ -24,7 +24,10 @@
 
 #include <boost/test/included/unit_test.hpp>
 #include "core/sstring.hh"
+#include "core/print.hh"
 #include <list>
+#include <cmath>
+#include <cstdlib>
 
 BOOST_AUTO_TEST_CASE(test_equality) {
     BOOST_REQUIRE_EQUAL(sstring("aaa"), sstring("aaa"));
@@ -128,3 +131,77 @@ BOOST_AUTO_TEST_CASE(test_ctor_iterator) {
     sstring s(data.begin(), data.end());
     BOOST_REQUIRE_EQUAL(s, "abc");
 }
+
+BOOST_AUTO_TEST_CASE(test_to_sstring_integers) {
+    BOOST_REQUIRE_EQUAL(to_sstring(0), sstring("0"));
+    BOOST_REQUIRE_EQUAL(to_sstring(-7), sstring("-7"));
+    BOOST_REQUIRE_EQUAL(to_sstring(10), sstring("10"));
+    BOOST_REQUIRE_EQUAL(to_sstring(99u), sstring("99"));
+    BOOST_REQUIRE_EQUAL(to_sstring(100l), sstring("100"));
+    BOOST_REQUIRE_EQUAL(to_sstring(std::numeric_limits<int>::min()), sstring("-2147483648"));
+    BOOST_REQUIRE_EQUAL(to_sstring(std::numeric_limits<long long>::min()), sstring("-9223372036854775808"));
+    BOOST_REQUIRE_EQUAL(to_sstring(std::numeric_limits<unsigned long long>::max()), sstring("18446744073709551615"));
+    for (long v = 1; v < 1000000000000000000l; v = v * 7 + 3) {
+        BOOST_REQUIRE_EQUAL(to_sstring(v), sstring(std::to_string(v)));
+        BOOST_REQUIRE_EQUAL(to_sstring(-v), sstring(std::to_string(-v)));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_to_sstring_floating) {
+    BOOST_REQUIRE_EQUAL(to_sstring(0.0), sstring("0"));
+    BOOST_REQUIRE_EQUAL(to_sstring(-0.0), sstring("-0"));
+    BOOST_REQUIRE_EQUAL(to_sstring(1.0), sstring("1"));
+    BOOST_REQUIRE_EQUAL(to_sstring(0.1), sstring("0.1"));
+    BOOST_REQUIRE_EQUAL(to_sstring(0.3), sstring("0.3"));
+    BOOST_REQUIRE_EQUAL(to_sstring(-2.5), sstring("-2.5"));
+    BOOST_REQUIRE_EQUAL(to_sstring(1.0 / 3), sstring("0.3333333333333333"));
+    BOOST_REQUIRE_EQUAL(to_sstring(12345.678), sstring("12345.678"));
+    BOOST_REQUIRE_EQUAL(to_sstring(1e16), sstring("10000000000000000"));
+    BOOST_REQUIRE_EQUAL(to_sstring(1e17), sstring("1e+17"));
+    BOOST_REQUIRE_EQUAL(to_sstring(1e-4), sstring("0.0001"));
+    BOOST_REQUIRE_EQUAL(to_sstring(1e-5), sstring("1e-05"));
+    BOOST_REQUIRE_EQUAL(to_sstring(-1.5e-7), sstring("-1.5e-07"));
+    BOOST_REQUIRE_EQUAL(to_sstring(5e-324), sstring("5e-324"));
+    BOOST_REQUIRE_EQUAL(to_sstring(1.7976931348623157e308), sstring("1.7976931348623157e+308"));
+    BOOST_REQUIRE_EQUAL(to_sstring(std::numeric_limits<double>::infinity()), sstring("inf"));
+    BOOST_REQUIRE_EQUAL(to_sstring(0.1f), sstring("0.1"));
+    BOOST_REQUIRE_EQUAL(to_sstring(3.4028235e38f), sstring("3.4028235e+38"));
+
+    // every double must read back as itself
+    uint64_t bits = 0x123456789abcdefull;
+    for (int i = 0; i < 100000; ++i) {
+        bits = bits * 6364136223846793005ull + 1442695040888963407ull;
+        double d;
+        std::memcpy(&d, &bits, sizeof(d));
+        if (!std::isfinite(d)) {
+            continue;
+        }
+        BOOST_REQUIRE_EQUAL(std::strtod(to_sstring(d).c_str(), nullptr), d);
+        float f;
+        auto fbits = uint32_t(bits >> 32);
+        std::memcpy(&f, &fbits, sizeof(f));
+        if (std::isfinite(f)) {
+            BOOST_REQUIRE_EQUAL(std::strtof(to_sstring(f).c_str(), nullptr), f);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_sprint) {
+    auto boost_sprint = [] (const char* fmt, auto&&... a) {
+        boost::format bfmt(fmt);
+        apply_format(bfmt, a...);
+        return bfmt.str();
+    };
+    // formatted without boost::format
+    BOOST_REQUIRE_EQUAL(sprint("%d %s %u%%", -12, "x", 7u), "-12 x 7%");
+    BOOST_REQUIRE_EQUAL(sprint("%s/%s", sstring("a"), std::string("b")), "a/b");
+    BOOST_REQUIRE_EQUAL(sprint("no args"), "no args");
+    BOOST_REQUIRE_EQUAL(sprint("%s %d", 1.5, 1.0 / 3), boost_sprint("%s %d", 1.5, 1.0 / 3));
+    BOOST_REQUIRE_EQUAL(sprint("%d", std::numeric_limits<long>::min()), boost_sprint("%d", std::numeric_limits<long>::min()));
+    // formatted by boost::format
+    BOOST_REQUIRE_EQUAL(sprint("%5d|%-3s|%x", 42, "a", 255), "   42|a  |ff");
+    BOOST_REQUIRE_EQUAL(sprint("%s %s", 'c', true), boost_sprint("%s %s", 'c', true));
+    BOOST_REQUIRE_EQUAL(sprint("%2% %1%", 1, 2), "2 1");
+    BOOST_REQUIRE_THROW(sprint("%d %d", 1), boost::io::too_few_args);
+    BOOST_REQUIRE_THROW(sprint("%d", 1, 2), boost::io::too_many_args);
+}
@@ -0,0 +1,70 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+// Goodput of each TCP congestion control algorithm across an emulated
+// link with a drop-tail bottleneck, between two native stacks in this
+// process.
+
+#include "core/app-template.hh"
+#include "tests/tcp_link.hh"
+#include <algorithm>
+
+namespace bpo = boost::program_options;
+
+static future<> measure(lossy_network& net, sstring algorithm, size_t size) {
+    net.inet0.get_tcp().set_congestion_control(algorithm);
+    auto dropped = net.link.dropped + net.link.overflowed;
+    auto timeouts = net.inet0.get_tcp().get_stats().retransmit_timeouts;
+    return net.measure_goodput(size).then([&net, algorithm, dropped, timeouts] (double goodput) {
+        print("%-8s %8.1f MB/s %8d frames dropped %8d timeouts\n", algorithm, goodput,
+                net.link.dropped + net.link.overflowed - dropped,
+                net.inet0.get_tcp().get_stats().retransmit_timeouts - timeouts);
+    });
+}
+
+int main(int ac, char** av) {
+    app_template app;
+    app.add_options()
+        ("rtt", bpo::value<double>()->default_value(10), "round trip time (ms)")
+        ("bandwidth", bpo::value<double>()->default_value(0.1), "link bandwidth (Gb/s)")
+        ("queue", bpo::value<size_t>()->default_value(32), "bottleneck queue (KB)")
+        ("loss", bpo::value<double>()->default_value(0), "random loss rate of data segments")
+        ("size", bpo::value<size_t>()->default_value(32), "data to send over each connection (MB)")
+        ;
+    return app.run(ac, av, [&app] {
+        auto&& config = app.configuration();
+        auto delay = std::chrono::nanoseconds(uint64_t(config["rtt"].as<double>() * 1e6 / 2));
+        auto size = config["size"].as<size_t>() << 20;
+        auto queue = config["queue"].as<size_t>() << 10;
+        // Never destroyed; the program ends with the measurement
+        auto net = new lossy_network(delay, config["bandwidth"].as<double>(), config["loss"].as<double>(), queue);
+        // Room for twice what the link and its queue hold, so that the
+        // window is up to congestion control rather than the send buffer
+        auto bdp = size_t(config["bandwidth"].as<double>() * 1e9 / 8 * config["rtt"].as<double>() / 1e3);
+        auto send_buffer = std::max(size_t(212992), 2 * (bdp + queue));
+        net->inet0.get_tcp().set_send_buffer(send_buffer);
+        print("bandwidth-delay product %d KB, send buffer %d KB\n", bdp >> 10, send_buffer >> 10);
+        return measure(*net, "reno", size).then([net, size] {
+            return measure(*net, "cubic", size);
+        });
+    });
+}
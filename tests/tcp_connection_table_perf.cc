@@ -0,0 +1,124 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+// Measures looking up TCP connections, as a packet arriving for each of
+// them in random order would, in a table of a million of them: with
+// std::unordered_map, with flat_hash_map, and with flat_hash_map while
+// prefetching for packets further on in the batch.  Does not need the reactor.
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "core/flat_hash_map.hh"
+#include "core/print.hh"
+#include "net/ip.hh"
+
+using clk = std::chrono::steady_clock;
+using connid = net::l4connid<net::ipv4_traits>;
+using connid_hash = connid::connid_hash;
+struct tcb {
+    uint64_t packets = 0;
+};
+
+// Looks up every key, returning the time per lookup in ns.  Each lookup
+// waits for the one before, as processing the packet that needed it would,
+// so that the processor cannot overlap their cache misses on its own.
+template <typename Func>
+static double measure(const std::vector<connid>& keys, Func&& lookup) {
+    const int passes = 5;
+    size_t found = 0;
+    auto start = clk::now();
+    for (int pass = 0; pass < passes; ++pass) {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            auto t = lookup(i);
+            found += t != nullptr;
+            // Never changes i, but the processor does not know that
+            i += reinterpret_cast<uintptr_t>(t) >> 63;
+        }
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(clk::now() - start).count();
+    // keep the loop from being optimized away
+    if (found == 12345) {
+        std::cout << "";
+    }
+    return elapsed / (passes * keys.size());
+}
+
+int main(int ac, char** av) {
+    const size_t nr_connections = 1000000;
+    // Clients from a /16 connecting to a handful of server ports
+    std::default_random_engine rnd;
+    std::vector<connid> keys;
+    std::vector<connid> absent;
+    {
+        std::unordered_map<connid, bool, connid_hash> seen;
+        auto local_ip = net::ipv4_address("10.0.0.1");
+        while (keys.size() < nr_connections || absent.size() < nr_connections) {
+            connid id{local_ip, net::ipv4_address(0x0a010000 | (rnd() & 0xffff)),
+                uint16_t(80 + rnd() % 4), uint16_t(1024 + rnd() % 64512)};
+            if (!seen.emplace(id, true).second) {
+                continue;
+            }
+            (keys.size() < nr_connections ? keys : absent).push_back(id);
+        }
+    }
+    std::vector<tcb> tcbs(nr_connections);
+    std::unordered_map<connid, tcb*, connid_hash> node_map;
+    flat_hash_map<connid, tcb*, connid_hash> flat_map;
+    for (size_t i = 0; i < nr_connections; ++i) {
+        node_map.emplace(keys[i], &tcbs[i]);
+        flat_map.emplace(keys[i], &tcbs[i]);
+    }
+    std::shuffle(keys.begin(), keys.end(), rnd);
+
+    print("%d connections, ns per lookup\n", nr_connections);
+    print("%-16s %10s %10s\n", "", "present", "absent");
+    auto node_lookup = [&] (const std::vector<connid>& k) {
+        return measure(k, [&] (size_t i) {
+            auto j = node_map.find(k[i]);
+            return j == node_map.end() ? nullptr : j->second;
+        });
+    };
+    print("%-16s %10.1f %10.1f\n", "unordered_map", node_lookup(keys), node_lookup(absent));
+    auto flat_lookup = [&] (const std::vector<connid>& k) {
+        return measure(k, [&] (size_t i) {
+            auto j = flat_map.find(k[i]);
+            return j == flat_map.end() ? nullptr : j->second;
+        });
+    };
+    print("%-16s %10.1f %10.1f\n", "flat_hash_map", flat_lookup(keys), flat_lookup(absent));
+    // As a poller would for the rest of a batch of received packets
+    const size_t lookahead = 8;
+    auto prefetching_lookup = [&] (const std::vector<connid>& k) {
+        return measure(k, [&] (size_t i) {
+            if (i + lookahead < k.size()) {
+                flat_map.prefetch(k[i + lookahead]);
+            }
+            auto j = flat_map.find(k[i]);
+            return j == flat_map.end() ? nullptr : j->second;
+        });
+    };
+    print("%-16s %10.1f %10.1f\n", "  + prefetch", prefetching_lookup(keys), prefetching_lookup(absent));
+    return 0;
+}
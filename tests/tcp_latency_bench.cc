@@ -0,0 +1,91 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+// Request/response latency between two native stacks in this process,
+// across an emulated link that loses segments at random, retransmissions
+// included.  Compares the RFC6298 one second RTO floor with a lower one,
+// with and without RACK loss detection.
+
+#include "core/app-template.hh"
+#include "tests/tcp_link.hh"
+#include <algorithm>
+
+namespace bpo = boost::program_options;
+
+struct recovery_config {
+    sstring name;
+    bool timestamps;
+    bool rack;
+    std::chrono::milliseconds rto_min;
+};
+
+static future<> measure(lossy_network& net, recovery_config config, size_t count, size_t request, size_t response) {
+    for (auto inet : { &net.inet0, &net.inet1 }) {
+        inet->get_tcp().enable_timestamps(config.timestamps);
+        inet->get_tcp().enable_rack(config.rack);
+        inet->get_tcp().set_rto_min(config.rto_min);
+    }
+    auto dropped = net.link.dropped;
+    return net.measure_latency(count, request, response).then([&net, config, dropped] (auto latencies) {
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&latencies] (double p) {
+            auto i = std::min(size_t(p * latencies.size()), latencies.size() - 1);
+            return std::chrono::duration<double, std::milli>(latencies[i]).count();
+        };
+        print("%-20s %8.2f %8.2f %8.2f %8.2f %8d\n", config.name,
+                percentile(0.5), percentile(0.99), percentile(0.999), percentile(1),
+                net.link.dropped - dropped);
+    });
+}
+
+int main(int ac, char** av) {
+    app_template app;
+    app.add_options()
+        ("rtt", bpo::value<double>()->default_value(0.2), "round trip time (ms)")
+        ("bandwidth", bpo::value<double>()->default_value(1), "link bandwidth (Gb/s)")
+        ("loss", bpo::value<double>()->default_value(0.01), "random loss rate of data segments")
+        ("requests", bpo::value<size_t>()->default_value(500), "request/response exchanges per configuration")
+        ("request-size", bpo::value<size_t>()->default_value(100), "request size (bytes)")
+        ("response-size", bpo::value<size_t>()->default_value(32), "response size (KB)")
+        ("rto-min", bpo::value<unsigned>()->default_value(10), "lower RTO floor to compare with (ms)")
+        ;
+    return app.run(ac, av, [&app] {
+        auto&& config = app.configuration();
+        auto delay = std::chrono::nanoseconds(uint64_t(config["rtt"].as<double>() * 1e6 / 2));
+        auto count = config["requests"].as<size_t>();
+        auto request = config["request-size"].as<size_t>();
+        auto response = config["response-size"].as<size_t>() << 10;
+        auto rto_min = std::chrono::milliseconds(config["rto-min"].as<unsigned>());
+        // Never destroyed; the program ends with the measurement
+        auto net = new lossy_network(delay, config["bandwidth"].as<double>(), config["loss"].as<double>());
+        net->link.lose_retransmissions = true;
+        auto configs = make_lw_shared<std::vector<recovery_config>>(std::vector<recovery_config>{
+            { "rto-min 1000ms", false, false, std::chrono::milliseconds(1000) },
+            { sprint("rto-min %dms", rto_min.count()), true, false, rto_min },
+            { sprint("rto-min %dms, rack", rto_min.count()), true, true, rto_min },
+        });
+        print("%-20s %8s %8s %8s %8s %8s\n", "latency (ms)", "p50", "p99", "p99.9", "max", "dropped");
+        return do_for_each(configs->begin(), configs->end(), [net, count, request, response] (auto& c) {
+            return measure(*net, c, count, request, response);
+        }).finally([configs] {});
+    });
+}
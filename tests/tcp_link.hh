@@ -0,0 +1,437 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#pragma once
+
+#include "core/future-util.hh"
+#include "core/reactor.hh"
+#include "core/sleep.hh"
+#include "net/ip.hh"
+#include "net/tcp.hh"
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// An emulated point-to-point ethernet link between two native stacks in
+// this process.  Frames are serialized at a fixed bandwidth and delivered
+// after a fixed delay.  Frames that find more than queue_limit bytes
+// waiting to be serialized are dropped, as at a drop-tail bottleneck.
+//
+// On top of that, TCP segments carrying new data are dropped at random,
+// and those listed in drop_segments always; retransmissions listed in
+// drop_retransmissions are dropped too.  Pure ACKs and, unless
+// lose_retransmissions is set, retransmissions always get through: losing
+// those costs most loss recovery schemes a retransmission timeout alike,
+// and only makes comparisons noisy.  Each random loss takes out
+// loss_burst consecutive segments.
+class lossy_link {
+    using clock_type = timer<>::clock;
+    struct in_flight {
+        clock_type::time_point arrival;
+        net::packet p;
+    };
+    struct direction {
+        circular_buffer<in_flight> q;
+        clock_type::time_point busy_until;
+        timer<> deliver;
+        // Source port, end of the highest data sent and numbers of new
+        // data segments and of retransmissions sent, of the last
+        // connection opened; stragglers from earlier ones are let through
+        uint16_t port = 0;
+        net::tcp_seq high_seq;
+        unsigned segments = 0;
+        unsigned retransmissions = 0;
+    };
+    enum class segment_kind { other, new_data, retransmission };
+    class link_qp : public net::qp {
+        lossy_link& _link;
+        unsigned _side;
+    public:
+        link_qp(lossy_link& link, unsigned side)
+            : qp(false, "lossy-link", side), _link(link), _side(side) {}
+        virtual future<> send(net::packet p) override {
+            _link.transmit(_side, std::move(p));
+            return make_ready_future<>();
+        }
+    };
+    class link_device : public net::device {
+        lossy_link& _link;
+        unsigned _side;
+    public:
+        link_device(lossy_link& link, unsigned side) : _link(link), _side(side) {}
+        virtual net::ethernet_address hw_address() override {
+            return { 0x02, 0x00, 0x00, 0x00, 0x00, uint8_t(_side + 1) };
+        }
+        virtual net::hw_features hw_features() override {
+            return net::hw_features();
+        }
+        virtual std::unique_ptr<net::qp> init_local_queue(boost::program_options::variables_map opts, uint16_t qid) override {
+            return std::make_unique<link_qp>(_link, _side);
+        }
+    };
+    std::shared_ptr<link_device> _devices[2];
+    // Ours rather than the reactor's, so that the link can go
+    std::unique_ptr<net::qp> _queues[2];
+    direction _dir[2];
+    std::chrono::nanoseconds _delay;
+    double _bytes_per_ns;
+    size_t _queue_limit;
+    std::default_random_engine _random{1};
+    std::bernoulli_distribution _lose;
+    unsigned _burst_left = 0;
+public:
+    uint64_t dropped = 0;
+    uint64_t overflowed = 0;
+    // Of all frames sent, Ethernet header included
+    size_t largest_frame = 0;
+    bool lose_retransmissions = false;
+    unsigned loss_burst = 1;
+    // Indices, counting from zero, of the new data segments of each
+    // connection to drop
+    std::vector<unsigned> drop_segments;
+    // Likewise, of the retransmissions
+    std::vector<unsigned> drop_retransmissions;
+public:
+    // queue_limit of zero means no limit
+    lossy_link(std::chrono::nanoseconds delay, double gbps, double loss, size_t queue_limit = 0)
+        : _delay(delay), _bytes_per_ns(gbps / 8), _queue_limit(queue_limit), _lose(loss) {
+        for (unsigned side = 0; side < 2; ++side) {
+            _devices[side] = std::make_shared<link_device>(*this, side);
+            _queues[side] = _devices[side]->init_local_queue({}, side);
+            _devices[side]->set_local_queue(*_queues[side]);
+            _dir[side].deliver.set_callback([this, side] { deliver(side); });
+        }
+    }
+    std::shared_ptr<net::device> end(unsigned side) {
+        return _devices[side];
+    }
+private:
+    segment_kind classify(direction& d, net::packet& p) {
+        using namespace net;
+        auto eh = p.get_header<eth_hdr>();
+        if (!eh || ntoh(eh->eth_proto) != uint16_t(eth_protocol_num::ipv4)) {
+            return segment_kind::other;
+        }
+        auto iph = ntoh(*p.get_header<ip_hdr>(sizeof(eth_hdr)));
+        if (iph.ip_proto != uint8_t(ip_protocol_num::tcp)) {
+            return segment_kind::other;
+        }
+        auto th_off = sizeof(eth_hdr) + iph.ihl * 4;
+        auto th = ntoh(*p.get_header<tcp_hdr>(th_off));
+        auto data_len = iph.len - iph.ihl * 4 - th.data_offset * 4;
+        if (th.f_syn) {
+            d.port = th.src_port;
+            d.high_seq = th.seq + 1;
+            d.segments = 0;
+            d.retransmissions = 0;
+            return segment_kind::other;
+        }
+        if (!data_len || th.src_port != d.port) {
+            return segment_kind::other;
+        }
+        if (th.seq + data_len <= d.high_seq) {
+            ++d.retransmissions;
+            return segment_kind::retransmission;
+        }
+        d.high_seq = th.seq + data_len;
+        ++d.segments;
+        return segment_kind::new_data;
+    }
+    bool lose(direction& d, net::packet& p) {
+        auto listed = [] (const std::vector<unsigned>& drops, unsigned index) {
+            return std::find(drops.begin(), drops.end(), index) != drops.end();
+        };
+        auto kind = classify(d, p);
+        if ((kind == segment_kind::new_data && listed(drop_segments, d.segments - 1))
+                || (kind == segment_kind::retransmission && listed(drop_retransmissions, d.retransmissions - 1))) {
+            return true;
+        }
+        if (kind == segment_kind::other || (kind == segment_kind::retransmission && !lose_retransmissions)) {
+            return false;
+        }
+        if (_burst_left || _lose(_random)) {
+            _burst_left = _burst_left ? _burst_left - 1 : loss_burst - 1;
+            return true;
+        }
+        return false;
+    }
+    void transmit(unsigned side, net::packet p) {
+        auto& d = _dir[side];
+        largest_frame = std::max<size_t>(largest_frame, p.len());
+        if (lose(d, p)) {
+            ++dropped;
+            return;
+        }
+        auto now = clock_type::now();
+        auto backlog = d.busy_until > now ? (d.busy_until - now).count() * _bytes_per_ns : 0;
+        if (_queue_limit && backlog + p.len() > _queue_limit) {
+            ++overflowed;
+            return;
+        }
+        // Copy the frame, as a real wire would; the sender keeps sharing
+        // its retransmission queue with the packets it hands us
+        temporary_buffer<char> buf(p.len());
+        auto out = buf.get_write();
+        for (auto&& f : p.fragments()) {
+            out = std::copy_n(f.base, f.size, out);
+        }
+        auto serialization = std::chrono::nanoseconds(uint64_t(p.len() / _bytes_per_ns));
+        d.busy_until = std::max(d.busy_until, now) + serialization;
+        d.q.push_back(in_flight{d.busy_until + _delay, net::packet(net::fragment{buf.get_write(), buf.size()}, buf.release())});
+        if (!d.deliver.armed()) {
+            d.deliver.arm(d.q.front().arrival);
+        }
+    }
+    void deliver(unsigned side) {
+        auto& d = _dir[side];
+        auto now = clock_type::now();
+        while (!d.q.empty() && d.q.front().arrival <= now) {
+            _devices[1 - side]->l2receive(std::move(d.q.front().p));
+            d.q.pop_front();
+        }
+        if (!d.q.empty()) {
+            d.deliver.arm(d.q.front().arrival);
+        }
+    }
+};
+
+// Two native stacks, on either end of a link between two devices.  They
+// have no shutdown path of their own: destroy them only once drain() says
+// the connections they carried are gone, and before the devices' queues.
+// A closed connection has stopped all its timers, so nothing of the
+// stacks is left armed to fire once the test's reactor has exited.
+struct native_stack_pair {
+    using tcp = net::tcp<net::ipv4_traits>;
+    net::interface netif0;
+    net::interface netif1;
+    net::ipv4 inet0;
+    net::ipv4 inet1;
+    tcp::listener listener;
+    native_stack_pair(std::shared_ptr<net::device> dev0, std::shared_ptr<net::device> dev1)
+        : netif0(std::move(dev0))
+        , netif1(std::move(dev1))
+        , inet0(&netif0)
+        , inet1(&netif1)
+        , listener(inet1.get_tcp().listen(10000)) {
+        inet0.set_host_address(net::ipv4_address("10.0.0.1"));
+        inet1.set_host_address(net::ipv4_address("10.0.0.2"));
+        for (auto inet : { &inet0, &inet1 }) {
+            inet->set_gw_address(net::ipv4_address("10.0.0.254"));
+            inet->set_netmask_address(net::ipv4_address("255.255.255.0"));
+        }
+        // ARP replies are handed to the global stack, which is not one of
+        // these; seed the neighbor tables so no ARP traffic is needed
+        inet0.learn(netif1.hw_address(), inet1.host_address());
+        inet1.learn(netif0.hw_address(), inet0.host_address());
+    }
+
+    // Sends size bytes from inet0 to inet1 over a new connection and
+    // returns the goodput in MB/s, measured from connection establishment
+    // until the receiver has it all.  Some more data follows, so that
+    // losses at the tail of the measured range are repaired the usual way
+    // rather than by a timeout.
+    future<double> measure_goodput(size_t size) {
+        const size_t tail = 256 << 10;
+        auto accepted = listener.accept();
+        return inet0.get_tcp().connect(make_ipv4_address(ipv4_addr("10.0.0.2", 10000))).then(
+                [size, tail, accepted = std::move(accepted)] (tcp::connection client) mutable {
+            return accepted.then([size, tail, client = std::move(client)] (tcp::connection server) mutable {
+                struct transfer {
+                    tcp::connection client;
+                    tcp::connection server;
+                    size_t sent = 0;
+                    size_t received = 0;
+                    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                    std::chrono::steady_clock::time_point end;
+                };
+                auto t = make_lw_shared<transfer>(transfer{std::move(client), std::move(server)});
+                auto send = do_until([t, size, tail] { return t->sent == size + tail; }, [t, size, tail] {
+                    auto len = std::min(size + tail - t->sent, size_t(65536));
+                    temporary_buffer<char> buf(len);
+                    for (size_t i = 0; i < len; ++i) {
+                        buf.get_write()[i] = pattern(t->sent + i);
+                    }
+                    t->sent += len;
+                    return t->client.send(net::packet(net::fragment{buf.get_write(), buf.size()}, buf.release()));
+                });
+                auto receive = do_until([t, size, tail] { return t->received == size + tail; }, [t, size] {
+                    return t->server.wait_for_data().then([t, size] {
+                        auto p = t->server.read();
+                        for (auto&& f : p.fragments()) {
+                            bool intact = true;
+                            for (size_t i = 0; i < f.size; ++i) {
+                                intact &= f.base[i] == pattern(t->received + i);
+                            }
+                            if (!intact) {
+                                throw std::runtime_error("received data does not match what was sent");
+                            }
+                            t->received += f.size;
+                        }
+                        if (t->received >= size && t->end == std::chrono::steady_clock::time_point()) {
+                            t->end = std::chrono::steady_clock::now();
+                        }
+                    });
+                });
+                return when_all(std::move(send), std::move(receive)).then([t, size] (auto&& results) {
+                    std::get<0>(results).get();
+                    std::get<1>(results).get();
+                    auto elapsed = std::chrono::duration<double>(t->end - t->start);
+                    return size / elapsed.count() / 1e6;
+                });
+            });
+        });
+    }
+
+    // Runs count exchanges over a new connection, in each of which inet0
+    // sends request_size bytes and inet1 answers with response_size bytes.
+    // Returns how long each took, from sending the request until the
+    // whole response arrived.
+    future<std::vector<std::chrono::steady_clock::duration>>
+    measure_latency(size_t count, size_t request_size, size_t response_size) {
+        auto accepted = listener.accept();
+        return inet0.get_tcp().connect(make_ipv4_address(ipv4_addr("10.0.0.2", 10000))).then(
+                [=, accepted = std::move(accepted)] (tcp::connection client) mutable {
+            return accepted.then([=, client = std::move(client)] (tcp::connection server) mutable {
+                struct exchanges {
+                    tcp::connection client;
+                    tcp::connection server;
+                    size_t served = 0;
+                    std::vector<std::chrono::steady_clock::duration> latencies;
+                };
+                auto e = make_lw_shared<exchanges>(exchanges{std::move(client), std::move(server)});
+                auto serve = do_until([e, count] { return e->served == count; }, [e, request_size, response_size] {
+                    return receive(e->server, request_size).then([e, response_size] {
+                        ++e->served;
+                        return e->server.send(zeros(response_size));
+                    });
+                });
+                auto request = do_until([e, count] { return e->latencies.size() == count; }, [e, request_size, response_size] {
+                    auto start = std::chrono::steady_clock::now();
+                    return e->client.send(zeros(request_size)).then([e, response_size] {
+                        return receive(e->client, response_size);
+                    }).then([e, start] {
+                        e->latencies.push_back(std::chrono::steady_clock::now() - start);
+                    });
+                });
+                return when_all(std::move(serve), std::move(request)).then([e] (auto&& results) {
+                    std::get<0>(results).get();
+                    std::get<1>(results).get();
+                    return std::move(e->latencies);
+                });
+            });
+        });
+    }
+
+    // Sends size bytes each way at once over a new connection, so that
+    // either end has data to send while it waits for the rest of what it
+    // is receiving.  inet1 starts once the first data arrives: accept()
+    // hands out connections still in SYN_RECEIVED, and data queued there
+    // would go out on a <SYN>.
+    future<> exchange(size_t size) {
+        auto accepted = listener.accept();
+        return inet0.get_tcp().connect(make_ipv4_address(ipv4_addr("10.0.0.2", 10000))).then(
+                [size, accepted = std::move(accepted)] (tcp::connection client) mutable {
+            return accepted.then([size, client = std::move(client)] (tcp::connection server) mutable {
+                return do_with(std::move(client), std::move(server), [size] (tcp::connection& client, tcp::connection& server) {
+                    auto serve = server.wait_for_data().then([&server, size] {
+                        return when_all(send(server, size), receive(server, size)).then([] (auto&& results) {
+                            std::get<0>(results).get();
+                            std::get<1>(results).get();
+                        });
+                    });
+                    return when_all(send(client, size), receive(client, size), std::move(serve)).then([] (auto&& results) {
+                        std::get<0>(results).get();
+                        std::get<1>(results).get();
+                        std::get<2>(results).get();
+                    });
+                });
+            });
+        });
+    }
+
+    // Waits until the connections of past measurements are closed
+    future<> drain() {
+        return do_until([this] { return !inet0.get_tcp().connections() && !inet1.get_tcp().connections(); }, [] {
+            return sleep(std::chrono::milliseconds(1));
+        });
+    }
+private:
+    static net::packet zeros(size_t size) {
+        temporary_buffer<char> buf(size);
+        std::fill_n(buf.get_write(), size, 0);
+        return net::packet(net::fragment{buf.get_write(), buf.size()}, buf.release());
+    }
+    // Sends size bytes, in pieces that fit in the send buffer
+    static future<> send(tcp::connection& c, size_t size) {
+        auto left = make_lw_shared<size_t>(size);
+        return do_until([left] { return *left == 0; }, [&c, left] {
+            auto len = std::min(*left, size_t(65536));
+            *left -= len;
+            return c.send(zeros(len));
+        });
+    }
+    // Reads exactly size bytes; the peer sends no more until it has an
+    // answer
+    static future<> receive(tcp::connection& c, size_t size) {
+        auto left = make_lw_shared<size_t>(size);
+        return do_until([left] { return *left == 0; }, [&c, left] {
+            return c.wait_for_data().then([&c, left] {
+                auto len = c.read().len();
+                if (!len) {
+                    throw std::runtime_error("connection closed");
+                }
+                if (len > *left) {
+                    throw std::runtime_error("received more than was sent");
+                }
+                *left -= len;
+            });
+        });
+    }
+    static char pattern(size_t offset) {
+        return offset % 251;
+    }
+};
+
+struct lossy_network_link {
+    lossy_link link;
+    lossy_network_link(std::chrono::nanoseconds delay, double gbps, double loss, size_t queue_limit)
+        : link(delay, gbps, loss, queue_limit) {}
+};
+
+// Two native stacks on either end of a lossy_link
+struct lossy_network : lossy_network_link, native_stack_pair {
+    lossy_network(std::chrono::nanoseconds delay, double gbps, double loss, size_t queue_limit = 0)
+        : lossy_network_link(delay, gbps, loss, queue_limit)
+        , native_stack_pair(link.end(0), link.end(1)) {}
+};
+
+// Runs func on net, then waits for the connections it opened to close so
+// that net can go
+template <typename Network, typename Func>
+inline future<> with_network(std::unique_ptr<Network> net, Func func) {
+    return do_with(std::move(net), [func = std::move(func)] (auto& net) mutable {
+        return futurize<void>::apply(func, *net).finally([&net] {
+            return net->drain();
+        });
+    });
+}
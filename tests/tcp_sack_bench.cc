@@ -0,0 +1,76 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+// Goodput with and without SACK under random, bursty loss across an
+// emulated link, between two native stacks in this process.
+
+#include "core/app-template.hh"
+#include "tests/tcp_link.hh"
+#include <boost/range/irange.hpp>
+
+namespace bpo = boost::program_options;
+
+static future<double> measure(lossy_network& net, bool sack, size_t size) {
+    net.inet0.get_tcp().enable_sack(sack);
+    net.inet1.get_tcp().enable_sack(sack);
+    return net.measure_goodput(size);
+}
+
+int main(int ac, char** av) {
+    app_template app;
+    app.add_options()
+        ("rtt", bpo::value<double>()->default_value(1), "round trip time (ms)")
+        ("bandwidth", bpo::value<double>()->default_value(1), "link bandwidth (Gb/s)")
+        ("loss", bpo::value<double>()->default_value(0.01), "random loss rate of data segments")
+        ("burst", bpo::value<unsigned>()->default_value(3), "consecutive segments lost at a time")
+        ("size", bpo::value<size_t>()->default_value(1), "data to send over each connection (MB)")
+        ("rounds", bpo::value<unsigned>()->default_value(3), "connections with and without SACK each")
+        ;
+    return app.run(ac, av, [&app] {
+        auto&& config = app.configuration();
+        auto delay = std::chrono::nanoseconds(uint64_t(config["rtt"].as<double>() * 1e6 / 2));
+        auto size = config["size"].as<size_t>() << 20;
+        auto rounds = config["rounds"].as<unsigned>();
+        // Never destroyed; the program ends with the measurement
+        auto net = new lossy_network(delay, config["bandwidth"].as<double>(), config["loss"].as<double>());
+        net->link.loss_burst = config["burst"].as<unsigned>();
+        // Single transfers are at the mercy of where the losses fall, so
+        // average over a few of each
+        struct totals {
+            double without_sack = 0;
+            double with_sack = 0;
+        };
+        auto t = make_lw_shared<totals>();
+        auto range = boost::irange(0u, rounds);
+        return do_for_each(range.begin(), range.end(), [net, size, t] (unsigned) {
+            return measure(*net, false, size).then([net, size, t] (double goodput) {
+                t->without_sack += goodput;
+                return measure(*net, true, size);
+            }).then([t] (double goodput) {
+                t->with_sack += goodput;
+            });
+        }).then([net, t, rounds] {
+            print("without SACK %8.1f MB/s\n", t->without_sack / rounds);
+            print("with SACK    %8.1f MB/s\n", t->with_sack / rounds);
+            print("%d frames dropped\n", net->link.dropped);
+        });
+    });
+}
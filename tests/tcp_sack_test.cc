@@ -0,0 +1,94 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#include "tests/test-utils.hh"
+#include "tests/tcp_link.hh"
+#include <algorithm>
+
+using namespace std::chrono_literals;
+
+SEASTAR_TEST_CASE(test_sack_repairs_holes_without_timeout) {
+    // Four holes in one window and a burst of three later on.  The
+    // scoreboard tells the sender what is missing: each lost segment goes
+    // out again exactly once, and none waits for the retransmission
+    // timer.  RACK, which finds losses by time rather than by the
+    // scoreboard, is off.
+    auto net = std::make_unique<lossy_network>(500us, 1, 0);
+    net->link.drop_segments = { 20, 22, 24, 26, 60, 61, 62 };
+    for (auto inet : { &net->inet0, &net->inet1 }) {
+        inet->get_tcp().enable_sack(true);
+        inet->get_tcp().enable_rack(false);
+    }
+    return with_network(std::move(net), [] (lossy_network& net) {
+        return net.measure_goodput(1 << 20).then([&net] (double) {
+            auto& stats = net.inet0.get_tcp().get_stats();
+            BOOST_REQUIRE_EQUAL(net.link.dropped, 7);
+            BOOST_REQUIRE_EQUAL(stats.retransmit_timeouts, 0);
+            BOOST_REQUIRE_EQUAL(stats.retransmitted_segments, net.link.dropped);
+        });
+    });
+}
+
+// Data flows both ways and is lost both ways, so full sized segments, new
+// and retransmitted, carry SACK blocks.  These must take room from the
+// data rather than push the frame past the MTU.
+static future<> check_frames_fit_the_mtu(bool timestamps) {
+    auto net = std::make_unique<lossy_network>(500us, 1, 0);
+    net->link.drop_segments = { 20, 22, 24, 26, 60, 61, 62 };
+    for (auto inet : { &net->inet0, &net->inet1 }) {
+        inet->get_tcp().enable_sack(true);
+        inet->get_tcp().enable_timestamps(timestamps);
+    }
+    return with_network(std::move(net), [] (lossy_network& net) {
+        return net.exchange(1 << 20).then([&net] {
+            BOOST_REQUIRE_EQUAL(net.link.dropped, 14);
+            BOOST_REQUIRE_LE(net.link.largest_frame, sizeof(net::eth_hdr) + net.netif0.hw_features().mtu);
+        });
+    });
+}
+
+SEASTAR_TEST_CASE(test_sack_blocks_fit_the_mtu) {
+    return check_frames_fit_the_mtu(true).then([] {
+        return check_frames_fit_the_mtu(false);
+    });
+}
+
+SEASTAR_TEST_CASE(test_rack_repairs_lost_retransmission) {
+    // A segment is lost, and so is its retransmission.  Without RACK only
+    // the retransmission timer would notice; with it, the data sent after
+    // the retransmission and delivered shows it lost, in a round trip.
+    auto net = std::make_unique<lossy_network>(100us, 1, 0);
+    net->link.drop_segments = { 20 };
+    net->link.drop_retransmissions = { 0 };
+    for (auto inet : { &net->inet0, &net->inet1 }) {
+        inet->get_tcp().enable_sack(true);
+        inet->get_tcp().set_rto_min(10ms);
+    }
+    return with_network(std::move(net), [] (lossy_network& net) {
+        return net.measure_latency(4, 100, 128 << 10).then([&net] (auto) {
+            auto& stats = net.inet1.get_tcp().get_stats();
+            BOOST_REQUIRE_EQUAL(net.link.dropped, 2);
+            BOOST_REQUIRE_EQUAL(stats.retransmit_timeouts, 0);
+            BOOST_REQUIRE_EQUAL(stats.retransmitted_segments, 2);
+        });
+    });
+}
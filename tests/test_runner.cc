@@ -20,6 +20,7 @@
  */
 
 #include <iostream>
+#include <signal.h>
 
 #include "core/app-template.hh"
 #include "core/future-util.hh"
@@ -44,6 +45,16 @@ test_runner::start(int ac, char** av) {
         return;
     }
 
+    // The reactor's timer and notification signals are meant for its own
+    // thread; should the kernel hand one to the process as a whole, it
+    // must not pick this thread, which has no reactor to take it.
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGRTMIN);
+    sigaddset(&mask, SIGRTMIN + 1);
+    sigaddset(&mask, SIGUSR1);
+    ::pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+
     _thread = std::make_unique<posix_thread>([this, ac, av]() mutable {
         app_template app;
         auto exit_code = app.run_deprecated(ac, av, [this] {
@@ -70,8 +70,34 @@ class context_switch_tester {
     future<> stop() {
         return make_ready_future<>();
     }
+    // Creates, runs and destroys short-lived threads back to back;
+    // returns how many were completed in the given time.
+    future<uint64_t> measure_create_destroy(std::chrono::steady_clock::duration duration, size_t stack_size) {
+        auto end = std::chrono::steady_clock::now() + duration;
+        return do_with(uint64_t(0), [end, stack_size] (uint64_t& count) {
+            return do_until([end] { return std::chrono::steady_clock::now() >= end; }, [&count, stack_size] {
+                thread_attributes attr;
+                attr.stack_size = stack_size;
+                return async(std::move(attr), [&count] {
+                    ++count;
+                });
+            }).then([&count] {
+                return count;
+            });
+        });
+    }
 };
 
+static future<> report_create_destroy(distributed<context_switch_tester>& dcst, std::chrono::seconds test_time, size_t stack_size) {
+    return dcst.map_reduce0([test_time, stack_size] (context_switch_tester& cst) {
+        return cst.measure_create_destroy(test_time, stack_size);
+    }, uint64_t(), std::plus<uint64_t>()).then([test_time, stack_size] (uint64_t threads) {
+        threads /= smp::count;
+        print("thread create/destroy time (%3d KB stack): %5.1f ns\n", stack_size / 1024,
+              double(std::chrono::duration_cast<std::chrono::nanoseconds>(test_time).count()) / threads);
+    });
+}
+
 int main(int ac, char** av) {
     static const auto test_time = 5s;
     return app_template().run_deprecated(ac, av, [] {
@@ -86,6 +112,10 @@ int main(int ac, char** av) {
                 switches /= smp::count;
                 print("context switch time: %5.1f ns\n",
                       double(std::chrono::duration_cast<std::chrono::nanoseconds>(test_time).count()) / switches);
+            }).then([&dcst] {
+                return report_create_destroy(dcst, 1s, 128 * 1024);
+            }).then([&dcst] {
+                return report_create_destroy(dcst, 1s, 16 * 1024);
             }).then([&dcst] {
                 return dcst.stop();
             }).then([] {
@@ -29,6 +29,7 @@
 #include "core/do_with.hh"
 #include "core/future-util.hh"
 #include "core/sleep.hh"
+#include <boost/iterator/counting_iterator.hpp>
 
 using namespace seastar;
 using namespace std::chrono_literals;
@@ -134,3 +135,26 @@ SEASTAR_TEST_CASE(test_thread_sched_group) {
 #endif
     });
 }
+
+SEASTAR_TEST_CASE(test_thread_stack_size) {
+    thread_attributes attr;
+    attr.stack_size = 1 << 20;
+    return async(std::move(attr), [] {
+        // would overflow the default 128k stack
+        volatile char buf[512 * 1024];
+        buf[0] = 1;
+        buf[sizeof(buf) - 1] = 2;
+        later().get();
+        BOOST_REQUIRE_EQUAL(buf[0] + buf[sizeof(buf) - 1], 3);
+    }).then([] {
+        // threads reuse pooled stacks; make sure a reused stack works
+        return do_for_each(boost::counting_iterator<int>(0), boost::counting_iterator<int>(100), [] (int i) {
+            return async([i] {
+                later().get();
+                return i;
+            }).then([i] (int r) {
+                BOOST_REQUIRE_EQUAL(r, i);
+            });
+        });
+    });
+}
@@ -37,16 +37,64 @@ typename Duration::rep to_seconds(Duration d) {
     return std::chrono::duration_cast<std::chrono::seconds>(d).count();
 }
 
+// Prints the datagrams sent and received per second, every second
+class pps_meter {
+    timer<> _timer;
+    clock_type::time_point _last;
+public:
+    uint64_t sent {};
+    uint64_t received {};
+    void start() {
+        _last = clock_type::now();
+        _timer.set_callback([this] {
+            auto now = clock_type::now();
+            auto secs = to_seconds(now - _last);
+            std::cout << std::setprecision(2) << std::fixed
+                << "Out: " << (double)sent / secs << " pps, "
+                << "In: " << (double)received / secs << " pps" << std::endl;
+            _last = now;
+            sent = 0;
+            received = 0;
+        });
+        _timer.arm_periodic(1s);
+    }
+};
+
+// Floods a server with requests, as fast as the channel takes them
+class client {
+private:
+    udp_channel _chan;
+    pps_meter _meter;
+    ipv4_addr _server;
+    sstring _request;
+public:
+    void start(ipv4_addr server, size_t request_size) {
+        _server = server;
+        _request = sstring(request_size, 'r');
+        _chan = engine().net().make_udp_channel(ipv4_addr());
+        std::cout << "Sending to " << server << std::endl;
+        _meter.start();
+        keep_doing([this] {
+            return _chan.send(_server, packet(_request.c_str(), _request.size())).then([this] {
+                _meter.sent++;
+            });
+        });
+        keep_doing([this] {
+            return _chan.receive().then([this] (udp_datagram dgram) {
+                _meter.received++;
+            });
+        });
+    }
+};
+
 class server {
 private:
     udp_channel _chan;
-    timer<> _stats_timer;
-    uint64_t _n_sent {};
+    pps_meter _meter;
     size_t _chunk_size;
     bool _copy;
     std::vector<packet> _packets;
     std::unique_ptr<output_stream<char>> _out;
-    clock_type::time_point _last;
     sstring _key;
     size_t _packet_size = 8*KB;
     char* _mem;
@@ -64,7 +112,7 @@ class server {
     }
     future<> send(ipv4_addr dst, packet p) {
         return _chan.send(dst, std::move(p)).then([this] {
-            _n_sent++;
+            _meter.sent++;
         });
     }
     void start(int chunk_size, bool copy, size_t mem_size) {
@@ -73,17 +121,7 @@ class server {
 
         std::cout << "Listening on " << listen_addr << std::endl;
 
-        _last = clock_type::now();
-        _stats_timer.set_callback([this] {
-            auto now = clock_type::now();
-            std::cout << "Out: "
-                << std::setprecision(2) << std::fixed
-                << (double)_n_sent / to_seconds(now - _last)
-                << " pps" << std::endl;
-            _last = now;
-            _n_sent = 0;
-        });
-        _stats_timer.arm_periodic(1s);
+        _meter.start();
 
         _chunk_size = chunk_size;
         _copy = copy;
@@ -101,6 +139,7 @@ class server {
 
         keep_doing([this] {
             return _chan.receive().then([this] (udp_datagram dgram) {
+                _meter.received++;
                 auto chunk = next_chunk();
                 lw_shared_ptr<sstring> item;
                 if (_copy) {
@@ -129,6 +168,7 @@ class server {
 
 int main(int ac, char ** av) {
     server s;
+    client c;
     app_template app;
     app.add_options()
         ("chunk-size", bpo::value<int>()->default_value(1024),
@@ -136,9 +176,17 @@ int main(int ac, char ** av) {
         ("mem-size", bpo::value<int>()->default_value(512),
              "Memory pool size in MiB")
         ("copy", "Copy data rather than send via zero-copy")
+        ("server", bpo::value<std::string>(),
+             "Flood the server at this address:port with requests, rather than being one")
+        ("request-size", bpo::value<int>()->default_value(64),
+             "Size of the requests sent to the server")
         ;
-    return app.run_deprecated(ac, av, [&app, &s] {
+    return app.run_deprecated(ac, av, [&app, &s, &c] {
         auto&& config = app.configuration();
+        if (config.count("server")) {
+            c.start(ipv4_addr(config["server"].as<std::string>()), config["request-size"].as<int>());
+            return;
+        }
         auto chunk_size = config["chunk-size"].as<int>();
         auto mem_size = (size_t)config["mem-size"].as<int>() * MB;
         auto copy = config.count("copy");
@@ -0,0 +1,157 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE core
+
+#include <boost/test/included/unit_test.hpp>
+#include "net/xdp-umem.hh"
+#include <linux/bpf.h>
+#include <random>
+#include <set>
+
+using namespace xdp;
+
+// The memory of a ring, as the kernel would map it, with the indices
+// starting just short of wrapping around
+template <typename Desc>
+struct ring_memory {
+    static constexpr xdp_ring_offset off = { 0, 64, 192, 128 };
+    std::vector<char> area;
+    explicit ring_memory(uint32_t size) : area(off.desc + size * sizeof(Desc)) {
+        producer() = consumer() = 0xfffffffc;
+    }
+    uint32_t& producer() {
+        return *reinterpret_cast<uint32_t*>(area.data() + off.producer);
+    }
+    uint32_t& consumer() {
+        return *reinterpret_cast<uint32_t*>(area.data() + off.consumer);
+    }
+};
+
+template <typename Desc>
+constexpr xdp_ring_offset ring_memory<Desc>::off;
+
+BOOST_AUTO_TEST_CASE(test_ring_indices_wrap) {
+    ring_memory<uint64_t> mem(8);
+    ring<uint64_t> r(mem.area.data(), mem.off, 8);
+    BOOST_REQUIRE_EQUAL(r.free_entries(), 8);
+    BOOST_REQUIRE_EQUAL(r.available(), 0);
+    for (uint32_t i = 0; i < 6; ++i) {
+        r[r.producer() + i] = i;
+    }
+    r.produce(6);
+    BOOST_REQUIRE_EQUAL(mem.producer(), 2);
+    BOOST_REQUIRE_EQUAL(r.free_entries(), 2);
+    BOOST_REQUIRE_EQUAL(r.available(), 6);
+    for (uint32_t i = 0; i < 6; ++i) {
+        BOOST_REQUIRE_EQUAL(r[r.consumer() + i], i);
+    }
+    r.consume(4);
+    BOOST_REQUIRE_EQUAL(r.free_entries(), 6);
+    BOOST_REQUIRE_EQUAL(r.available(), 2);
+    BOOST_REQUIRE_EQUAL(r[r.consumer()], 4);
+}
+
+BOOST_AUTO_TEST_CASE(test_frame_of_skips_headroom) {
+    BOOST_REQUIRE_EQUAL(umem_frames::frame_of(3 * frame_size), 3 * frame_size);
+    BOOST_REQUIRE_EQUAL(umem_frames::frame_of(3 * frame_size + XDP_PACKET_HEADROOM), 3 * frame_size);
+    BOOST_REQUIRE_EQUAL(umem_frames::frame_of(4 * frame_size - 1), 3 * frame_size);
+}
+
+BOOST_AUTO_TEST_CASE(test_receive_frames_are_conserved) {
+    // The kernel takes frames from the fill ring and receives into some
+    // of them; the stack holds on to some of those for a while.  No frame
+    // may get lost or handed out twice, and the stack may never hold
+    // more than half.
+    const uint32_t ring_size = 16;
+    ring_memory<uint64_t> mem(ring_size);
+    ring<uint64_t> fill(mem.area.data(), mem.off, ring_size);
+    umem_frames frames(ring_size);
+    std::vector<uint64_t> in_kernel;
+    std::vector<uint64_t> in_stack;
+    std::default_random_engine random;
+    for (int round = 0; round < 1000; ++round) {
+        frames.refill(fill);
+        auto taken = std::uniform_int_distribution<uint32_t>(0, fill.available())(random);
+        for (uint32_t i = 0; i < taken; ++i) {
+            in_kernel.push_back(fill[mem.consumer() + i]);
+        }
+        mem.consumer() += taken;
+        auto received = std::uniform_int_distribution<size_t>(0, in_kernel.size())(random);
+        for (size_t i = 0; i < received; ++i) {
+            auto frame = umem_frames::frame_of(in_kernel.back() + XDP_PACKET_HEADROOM);
+            in_kernel.pop_back();
+            if (frames.can_lend()) {
+                frames.lend();
+                in_stack.push_back(frame);
+            } else {
+                frames.recycle(frame);
+            }
+        }
+        auto done = std::uniform_int_distribution<size_t>(0, in_stack.size())(random);
+        for (size_t i = 0; i < done; ++i) {
+            frames.returned(in_stack.back());
+            in_stack.pop_back();
+        }
+        BOOST_REQUIRE_LE(frames.rx_lent(), ring_size / 2);
+        BOOST_REQUIRE_EQUAL(frames.rx_lent(), in_stack.size());
+        BOOST_REQUIRE_EQUAL(frames.rx_free() + fill.available() + in_kernel.size() + in_stack.size(), ring_size);
+    }
+    frames.refill(fill);
+    std::set<uint64_t> all(in_kernel.begin(), in_kernel.end());
+    all.insert(in_stack.begin(), in_stack.end());
+    for (uint32_t i = 0; i < fill.available(); ++i) {
+        all.insert(fill[mem.consumer() + i]);
+    }
+    BOOST_REQUIRE_EQUAL(all.size(), ring_size - frames.rx_free());
+    for (auto frame : all) {
+        BOOST_REQUIRE_EQUAL(frame % frame_size, 0);
+        BOOST_REQUIRE_LT(frame, ring_size * frame_size);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_send_frames_come_back_on_completion) {
+    const uint32_t ring_size = 16;
+    ring_memory<uint64_t> mem(ring_size);
+    ring<uint64_t> completion(mem.area.data(), mem.off, ring_size);
+    umem_frames frames(ring_size);
+    BOOST_REQUIRE(!frames.complete(completion));
+    std::set<uint64_t> sent;
+    while (frames.tx_available()) {
+        sent.insert(frames.take_tx());
+    }
+    BOOST_REQUIRE_EQUAL(sent.size(), ring_size);
+    BOOST_REQUIRE_EQUAL(*sent.begin(), ring_size * frame_size);
+    // The kernel completes them all
+    for (auto frame : sent) {
+        *reinterpret_cast<uint64_t*>(mem.area.data() + mem.off.desc + (mem.producer() % ring_size) * sizeof(uint64_t)) = frame;
+        ++mem.producer();
+    }
+    BOOST_REQUIRE(frames.complete(completion));
+    BOOST_REQUIRE_EQUAL(completion.available(), 0);
+    std::set<uint64_t> back;
+    while (frames.tx_available()) {
+        back.insert(frames.take_tx());
+    }
+    BOOST_REQUIRE(back == sent);
+}
@@ -0,0 +1,396 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#include "log.hh"
+#include "core/reactor.hh"
+#include <condition_variable>
+#include <thread>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <system_error>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+
+namespace seastar {
+
+static const char* log_level_names[] = {
+        "error",
+        "warn",
+        "info",
+        "debug",
+        "trace",
+};
+
+std::ostream& operator<<(std::ostream& out, log_level level) {
+    return out << log_level_names[int(level)];
+}
+
+std::istream& operator>>(std::istream& in, log_level& level) {
+    std::string name;
+    in >> name;
+    try {
+        level = parse_log_level(sstring(name));
+    } catch (std::invalid_argument&) {
+        in.setstate(std::ios::failbit);
+    }
+    return in;
+}
+
+log_level parse_log_level(const sstring& name) {
+    for (unsigned i = 0; i < sizeof(log_level_names) / sizeof(log_level_names[0]); ++i) {
+        if (name == log_level_names[i]) {
+            return log_level(i);
+        }
+    }
+    throw std::invalid_argument(sprint("unknown log level '%s'", name));
+}
+
+namespace {
+
+// Bytes written by one thread (the producer) and read by the log writer
+// thread (the consumer).  _head and _tail only grow; the buffer holds
+// _head - _tail bytes, starting at offset _tail % size.
+class log_buffer {
+    static constexpr size_t size = 256 * 1024;
+    std::unique_ptr<char[]> _data{new char[size]};
+    std::atomic<size_t> _head{0};
+    std::atomic<size_t> _tail{0};
+    // producer only
+    uint64_t _dropped = 0;
+private:
+    bool append(const char* p, size_t n) {
+        auto head = _head.load(std::memory_order_relaxed);
+        auto tail = _tail.load(std::memory_order_acquire);
+        if (size - (head - tail) < n) {
+            return false;
+        }
+        auto off = head % size;
+        auto first = std::min(n, size - off);
+        std::memcpy(_data.get() + off, p, first);
+        std::memcpy(_data.get(), p + first, n - first);
+        // seq_cst pairs with the writer's load of _head after it clears
+        // the wakeup flag; see log_writer::run().
+        _head.store(head + n);
+        return true;
+    }
+public:
+    // Returns false if the message was dropped.
+    bool push(const sstring& line, std::atomic<uint64_t>& total_dropped) {
+        if (_dropped) {
+            auto note = sprint("%d log messages dropped\n", _dropped);
+            if (!append(note.data(), note.size())) {
+                ++_dropped;
+                total_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            _dropped = 0;
+        }
+        if (!append(line.c_str(), std::min(line.size(), size))) {
+            ++_dropped;
+            total_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+    size_t head() const {
+        return _head.load();
+    }
+    size_t tail() const {
+        return _tail.load(std::memory_order_acquire);
+    }
+    // consumer only
+    void drain(int fd) {
+        auto tail = _tail.load(std::memory_order_relaxed);
+        auto head = _head.load();
+        while (tail != head) {
+            auto off = tail % size;
+            auto n = std::min(head - tail, size - off);
+            auto r = ::write(fd, _data.get() + off, n);
+            if (r < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                // nowhere to report it; discard
+                r = n;
+            }
+            tail += r;
+            _tail.store(tail, std::memory_order_release);
+        }
+    }
+};
+
+// Drains the buffers of all threads that ever logged to the output file.
+// Buffers are never freed, so the writer can walk them without locking.
+class log_writer {
+    static constexpr unsigned max_buffers = 1024;
+    std::array<log_buffer*, max_buffers> _buffers{};
+    std::atomic<unsigned> _nr_buffers{0};
+    std::mutex _register_mutex;
+    // held by the writer while it writes, so the output can be switched
+    std::mutex _output_mutex;
+    int _output_fd = STDERR_FILENO;
+    int _wakeup_fd;
+    std::atomic<bool> _wakeup_pending{false};
+    std::atomic<bool> _stopping{false};
+    std::mutex _progress_mutex;
+    std::condition_variable _progress;
+    uint64_t _passes = 0;
+    std::thread _thread;
+    std::atomic<uint64_t> _dropped{0};
+private:
+    void drain() {
+        std::lock_guard<std::mutex> g(_output_mutex);
+        auto nr = _nr_buffers.load(std::memory_order_acquire);
+        for (unsigned i = 0; i < nr; ++i) {
+            _buffers[i]->drain(_output_fd);
+        }
+    }
+    void run() {
+        while (true) {
+            uint64_t v;
+            while (::read(_wakeup_fd, &v, sizeof(v)) < 0 && errno == EINTR) {
+            }
+            // Clear the flag before draining: a producer that appends after
+            // we load its _head will see the flag clear and wake us again.
+            _wakeup_pending.store(false);
+            drain();
+            {
+                std::lock_guard<std::mutex> g(_progress_mutex);
+                ++_passes;
+            }
+            _progress.notify_all();
+            if (_stopping.load()) {
+                return;
+            }
+        }
+    }
+    void wake() {
+        uint64_t one = 1;
+        auto r = ::write(_wakeup_fd, &one, sizeof(one));
+        (void)r;
+    }
+public:
+    log_writer() : _wakeup_fd(::eventfd(0, EFD_CLOEXEC)) {
+        if (_wakeup_fd < 0) {
+            throw std::system_error(errno, std::system_category(), "eventfd");
+        }
+        _thread = std::thread([this] { run(); });
+    }
+    ~log_writer() {
+        _stopping.store(true);
+        wake();
+        _thread.join();
+        if (_output_fd != STDERR_FILENO) {
+            ::close(_output_fd);
+        }
+        ::close(_wakeup_fd);
+    }
+    log_buffer* register_buffer() {
+        std::lock_guard<std::mutex> g(_register_mutex);
+        auto nr = _nr_buffers.load(std::memory_order_relaxed);
+        if (nr == max_buffers) {
+            return nullptr;
+        }
+        _buffers[nr] = new log_buffer;
+        _nr_buffers.store(nr + 1, std::memory_order_release);
+        return _buffers[nr];
+    }
+    void push(log_buffer* buf, const sstring& line) {
+        if (!buf) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (buf->push(line, _dropped) && !_wakeup_pending.exchange(true)) {
+            wake();
+        }
+    }
+    void set_output(int fd) {
+        std::lock_guard<std::mutex> g(_output_mutex);
+        if (_output_fd != STDERR_FILENO) {
+            ::close(_output_fd);
+        }
+        _output_fd = fd;
+    }
+    void flush() {
+        auto nr = _nr_buffers.load(std::memory_order_acquire);
+        std::vector<size_t> heads;
+        for (unsigned i = 0; i < nr; ++i) {
+            heads.push_back(_buffers[i]->head());
+        }
+        auto done = [&] {
+            for (unsigned i = 0; i < nr; ++i) {
+                if (_buffers[i]->tail() < heads[i]) {
+                    return false;
+                }
+            }
+            return true;
+        };
+        std::unique_lock<std::mutex> lk(_progress_mutex);
+        while (!done()) {
+            lk.unlock();
+            _wakeup_pending.store(true);
+            wake();
+            lk.lock();
+            auto passes = _passes;
+            _progress.wait(lk, [&] { return _passes != passes; });
+        }
+    }
+    uint64_t dropped() const {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+};
+
+log_writer& writer() {
+    static log_writer w;
+    return w;
+}
+
+thread_local bool buffer_registered = false;
+thread_local log_buffer* local_buffer = nullptr;
+
+log_buffer* get_local_buffer() {
+    if (!buffer_registered) {
+        local_buffer = writer().register_buffer();
+        buffer_registered = true;
+    }
+    return local_buffer;
+}
+
+// Formatting the date is comparatively slow (localtime_r() takes a global
+// lock), so do it once per second per thread.
+const char* format_seconds(std::time_t t) {
+    static thread_local std::time_t last = -1;
+    static thread_local char buf[32];
+    if (t != last) {
+        std::tm tm;
+        ::localtime_r(&t, &tm);
+        std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+        last = t;
+    }
+    return buf;
+}
+
+}
+
+bool logger::rate_limit::check(uint64_t& suppressed) {
+    auto now = std::chrono::steady_clock::now();
+    if (now < _next) {
+        ++_suppressed;
+        return false;
+    }
+    _next = now + _interval;
+    suppressed = _suppressed;
+    _suppressed = 0;
+    return true;
+}
+
+logger::logger(sstring name)
+        : _name(std::move(name)), _level(log_level::info) {
+    global_logger_registry().register_logger(this);
+}
+
+logger::~logger() {
+    global_logger_registry().unregister_logger(this);
+}
+
+void logger::do_log(log_level level, const sstring& msg) {
+    static const char* level_tags[] = { "ERROR", "WARN ", "INFO ", "DEBUG", "TRACE" };
+    auto now = std::chrono::system_clock::now();
+    auto since_epoch = now.time_since_epoch();
+    auto secs = std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(since_epoch - secs).count();
+    char prefix[80];
+    if (local_engine) {
+        std::snprintf(prefix, sizeof(prefix), "%s %s,%03d [shard %u] ", level_tags[int(level)],
+                format_seconds(secs.count()), int(ms), engine().cpu_id());
+    } else {
+        std::snprintf(prefix, sizeof(prefix), "%s %s,%03d [shard -] ", level_tags[int(level)],
+                format_seconds(secs.count()), int(ms));
+    }
+    auto line = sstring(prefix) + _name + " - " + msg + "\n";
+    writer().push(get_local_buffer(), line);
+}
+
+void logger_registry::set_all_loggers_level(log_level level) {
+    std::lock_guard<std::mutex> g(_mutex);
+    for (auto&& l : _loggers) {
+        l.second->set_level(level);
+    }
+}
+
+void logger_registry::set_logger_level(const sstring& name, log_level level) {
+    std::lock_guard<std::mutex> g(_mutex);
+    _loggers.at(name)->set_level(level);
+}
+
+log_level logger_registry::get_logger_level(const sstring& name) const {
+    std::lock_guard<std::mutex> g(_mutex);
+    return _loggers.at(name)->level();
+}
+
+std::vector<sstring> logger_registry::get_all_logger_names() const {
+    std::lock_guard<std::mutex> g(_mutex);
+    std::vector<sstring> names;
+    for (auto&& l : _loggers) {
+        names.push_back(l.first);
+    }
+    return names;
+}
+
+void logger_registry::register_logger(logger* l) {
+    std::lock_guard<std::mutex> g(_mutex);
+    if (!_loggers.emplace(l->name(), l).second) {
+        throw std::runtime_error(sprint("logger '%s' registered twice", l->name()));
+    }
+}
+
+void logger_registry::unregister_logger(logger* l) {
+    std::lock_guard<std::mutex> g(_mutex);
+    _loggers.erase(l->name());
+}
+
+logger_registry& global_logger_registry() {
+    static logger_registry g_registry;
+    return g_registry;
+}
+
+void set_log_output(const sstring& path) {
+    int fd = STDERR_FILENO;
+    if (!path.empty()) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::system_error(errno, std::system_category(), sprint("cannot open log file %s", path));
+        }
+    }
+    writer().set_output(fd);
+}
+
+void flush_logs() {
+    writer().flush();
+}
+
+uint64_t dropped_log_messages() {
+    return writer().dropped();
+}
+
+} // namespace seastar
@@ -0,0 +1,227 @@
+/*
+ * This file is open source software, licensed to you under the terms
+ * of the Apache License, Version 2.0 (the "License").  See the NOTICE file
+ * distributed with this work for additional information regarding copyright
+ * ownership.  You may not use this file except in compliance with the License.
+ *
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*
+ * Copyright (C) 2015 Cloudius Systems, Ltd.
+ */
+
+#pragma once
+
+#include "core/sstring.hh"
+#include "core/print.hh"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <iosfwd>
+
+/// \defgroup logging-module Logging
+///
+/// Loggers format messages on the calling shard and append them to a
+/// per-shard buffer; a background thread writes the buffers out to stderr
+/// or to a file.  Logging therefore never blocks the reactor: if output
+/// cannot keep up and a shard's buffer fills, further messages from that
+/// shard are dropped and counted, and a note is logged once room frees up.
+///
+/// \addtogroup logging-module
+/// @{
+
+namespace seastar {
+
+/// Severity of a log message.  A logger emits messages at its level or
+/// at any more severe level.
+enum class log_level {
+    error,
+    warn,
+    info,
+    debug,
+    trace,
+};
+
+std::ostream& operator<<(std::ostream& out, log_level level);
+std::istream& operator>>(std::istream& in, log_level& level);
+
+/// Parses a level name ("error", "warn", "info", "debug" or "trace").
+///
+/// \throws std::invalid_argument if \c name is not a level name.
+log_level parse_log_level(const sstring& name);
+
+/// A named source of log messages.
+///
+/// Loggers are usually global objects, one per subsystem, and may be used
+/// from any shard.  Their level can be changed at run time, either directly
+/// or by name through the \ref logger_registry.  A message below the
+/// logger's level costs a single load and compare; its arguments are not
+/// formatted.
+///
+/// Format strings use the same syntax as \c sprint().
+class logger {
+public:
+    /// Limits how often a call site may log.
+    ///
+    /// Give each rate-limited call site its own object, typically a
+    /// function-local <tt>static thread_local</tt>.  At most one message
+    /// per interval passes; the number of messages suppressed in between
+    /// is reported right after the next one that does.
+    class rate_limit {
+        std::chrono::steady_clock::duration _interval;
+        std::chrono::steady_clock::time_point _next{};
+        uint64_t _suppressed = 0;
+    public:
+        explicit rate_limit(std::chrono::steady_clock::duration interval)
+                : _interval(interval) {}
+        /// Returns whether a message may be logged now; if so,
+        /// \c suppressed receives the number of messages dropped since the
+        /// last one that was let through.
+        bool check(uint64_t& suppressed);
+    };
+private:
+    sstring _name;
+    std::atomic<log_level> _level;
+private:
+    void do_log(log_level level, const sstring& msg);
+    template <typename... Args>
+    void format_and_log(log_level level, const char* fmt, Args&&... args) {
+        try {
+            do_log(level, sprint(fmt, std::forward<Args>(args)...));
+        } catch (...) {
+            do_log(level, sstring("failed to format log message: ") + fmt);
+        }
+    }
+public:
+    /// Creates a logger and adds it to the global \ref logger_registry.
+    ///
+    /// \param name name of the logger, printed with each message and used
+    ///             to change its level by name; must be unique.
+    explicit logger(sstring name);
+    logger(logger&&) = delete;
+    ~logger();
+
+    const sstring& name() const { return _name; }
+    log_level level() const { return _level.load(std::memory_order_relaxed); }
+    /// Changes the logger's level; takes effect on all shards.
+    void set_level(log_level level) { _level.store(level, std::memory_order_relaxed); }
+    bool is_enabled(log_level level) const {
+        return __builtin_expect(level <= _level.load(std::memory_order_relaxed), false);
+    }
+
+    /// Logs a message at the given level.
+    template <typename... Args>
+    void log(log_level level, const char* fmt, Args&&... args) {
+        if (is_enabled(level)) {
+            format_and_log(level, fmt, std::forward<Args>(args)...);
+        }
+    }
+    /// Logs a message at the given level, unless \c rl suppresses it.
+    template <typename... Args>
+    void log(log_level level, rate_limit& rl, const char* fmt, Args&&... args) {
+        uint64_t suppressed;
+        if (is_enabled(level) && rl.check(suppressed)) {
+            if (suppressed) {
+                format_and_log(level, fmt, std::forward<Args>(args)...);
+                do_log(level, sprint("(%d similar messages suppressed)", suppressed));
+            } else {
+                format_and_log(level, fmt, std::forward<Args>(args)...);
+            }
+        }
+    }
+
+    template <typename... Args>
+    void error(const char* fmt, Args&&... args) {
+        log(log_level::error, fmt, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    void error(rate_limit& rl, const char* fmt, Args&&... args) {
+        log(log_level::error, rl, fmt, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    void warn(const char* fmt, Args&&... args) {
+        log(log_level::warn, fmt, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    void warn(rate_limit& rl, const char* fmt, Args&&... args) {
+        log(log_level::warn, rl, fmt, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    void info(const char* fmt, Args&&... args) {
+        log(log_level::info, fmt, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    void info(rate_limit& rl, const char* fmt, Args&&... args) {
+        log(log_level::info, rl, fmt, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    void debug(const char* fmt, Args&&... args) {
+        log(log_level::debug, fmt, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    void debug(rate_limit& rl, const char* fmt, Args&&... args) {
+        log(log_level::debug, rl, fmt, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    void trace(const char* fmt, Args&&... args) {
+        log(log_level::trace, fmt, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    void trace(rate_limit& rl, const char* fmt, Args&&... args) {
+        log(log_level::trace, rl, fmt, std::forward<Args>(args)...);
+    }
+};
+
+/// Tracks all live loggers by name, so their levels can be set from
+/// configuration or at run time.
+class logger_registry {
+    mutable std::mutex _mutex;
+    std::unordered_map<sstring, logger*> _loggers;
+public:
+    /// Sets the level of every registered logger.
+    void set_all_loggers_level(log_level level);
+    /// Sets the level of the named logger.
+    ///
+    /// \throws std::out_of_range if there is no such logger.
+    void set_logger_level(const sstring& name, log_level level);
+    /// Returns the level of the named logger.
+    ///
+    /// \throws std::out_of_range if there is no such logger.
+    log_level get_logger_level(const sstring& name) const;
+    std::vector<sstring> get_all_logger_names() const;
+
+    void register_logger(logger* l);
+    void unregister_logger(logger* l);
+};
+
+logger_registry& global_logger_registry();
+
+/// Directs log output to a file, which is appended to and created if
+/// needed.  An empty path restores the default, stderr.  Messages already
+/// buffered may go to either destination.
+///
+/// \throws std::system_error if the file cannot be opened.
+void set_log_output(const sstring& path);
+
+/// Waits until all messages logged so far by any shard have been written.
+/// Blocks the calling thread, so it is meant for shutdown and tests.
+void flush_logs();
+
+/// Returns the number of messages dropped, on all shards, because output
+/// could not keep up.
+uint64_t dropped_log_messages();
+
+} // namespace seastar
+
+/// @}